@@ -80,6 +80,7 @@ find_mlir_lib(MLIRTargetLLVMIR)
 find_mlir_lib(MLIRTransformUtils)
 find_mlir_lib(MLIRTranslation)
 find_mlir_lib(MLIRVectorOps)
+find_mlir_lib(MLIRVectorToLLVM)
 
 find_mlir_lib(LLVMCore)
 find_mlir_lib(LLVMSupport)
@@ -138,7 +139,9 @@ set(MLIRLibsOnce
         ${MLIRTargetLLVMIRModuleTranslation}
         ${MLIRTransforms}
         ${MLIRTransformUtils}
-        ${MLIRTranslation})
+        ${MLIRTranslation}
+        ${MLIRVectorOps}
+        ${MLIRVectorToLLVM})
 
 set(MLIRLibs
         ${MLIRLibsOnce}
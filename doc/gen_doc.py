@@ -36,7 +36,6 @@ special_op_handler = dict([
     ("MaxPool", "ImportNodeMaxPool"),
     ("BatchNormalization", "ImportNodeBatchNormalization"),
     ("Pad", "ImportNodePad"),
-    ("Reshape", "ImportNodeReshape"),
     #("Transpose", "ImportNodeTranspose")
 ])
 
@@ -47,12 +46,12 @@ OpsWithShapeInference = [
     'LeakyRelu', 'Elu', 'Selu', 'HardSigmoid', 'Reshape', 'Reciprocal',
     'Identity', 'Cos', 'Log', 'Transpose', 'Softmax', 'ReduceMax', 'ReduceMin',
     'ReduceProd', 'ReduceSum', 'Softplus', 'Softsign', 'Sqrt', 'Unsqueeze',
-    'Sign'
+    'Sign', 'Conv'
 ]
 
 # Operations supporting canonicalization.
 OpsWithCanonicalizer = [
-    'Add', 'Identity', 'Gemm'
+    'Add', 'Identity', 'Gemm', 'Relu', 'LeakyRelu', 'Sigmoid', 'Clip'
 ]
 
 # Add an Op in this list if the Op needs result type deduction which is required
@@ -94,22 +94,20 @@ struct TransformValueToONNXData<int64_t> {
   }
 };
 
-// Helper method for constructing an array attribute from a model input.
+// Helper method for reading the elements of a tensor initializer.
 template <typename T>
-static T* CreateArrayAttribute(onnx::TensorProto initializer, int *size) {
+static std::vector<T> GetInitializerData(onnx::TensorProto initializer) {
   if (initializer.raw_data().size()) {
     // copy & take care of endianness
-    std::vector<char> byteInitializer;
-    std::copy(initializer.raw_data().begin(), initializer.raw_data().end(),
-        back_inserter(byteInitializer));
-    *size = initializer.raw_data().size() / sizeof(T);
-    return reinterpret_cast<T*>(&byteInitializer[0]);
+    std::vector<T> elements(initializer.raw_data().size() / sizeof(T));
+    std::memcpy(elements.data(), initializer.raw_data().data(),
+        elements.size() * sizeof(T));
+    return elements;
   }
 
   // copy, no need to take care of endianness
   auto data = TransformValueToONNXData<T>::data(initializer);
-  *size = data.size();
-  return &data[0];
+  return std::vector<T>(data.begin(), data.end());
 }
 
 void InitializedTensorMapping::AddMapping(
@@ -129,57 +127,47 @@ mlir::Value InitializedTensorMapping::EmitInitializerForInputTensor(
   // Initializer for input.
   onnx::TensorProto initializer = GetInitializedTensor(name);
 
-  // Emit ConstantOp and record the mapping between the input and
-  // the constant value.
-  mlir::ArrayAttr constantArrayAttribute;
-  mlir::Type elementType;
-  int length;
+  // Emit ConstantOp holding the dense elements of the initializer.
+  llvm::ArrayRef<int64_t> tensorDims(initializer.dims().data(),
+      initializer.dims().size());
+  mlir::RankedTensorType tensorType;
+  mlir::DenseElementsAttr valueAttribute;
   switch (initializer.data_type()) {
     case (onnx::TensorProto::FLOAT): {
-      float *typeArray =
-          CreateArrayAttribute<float>(initializer, &length);
-      std::vector<float> arrayAttrInitializer(
-      	typeArray, typeArray + length);
-      llvm::ArrayRef<float> array(typeArray, length);
-      constantArrayAttribute = builder.getF32ArrayAttr(array);
-      elementType = builder.getF32Type();
+      tensorType = mlir::RankedTensorType::get(
+          tensorDims, builder.getF32Type());
+      valueAttribute = mlir::DenseElementsAttr::get(tensorType,
+          llvm::makeArrayRef(GetInitializerData<float>(initializer)));
+      break;
+    }
+    case (onnx::TensorProto::DOUBLE): {
+      tensorType = mlir::RankedTensorType::get(
+          tensorDims, builder.getF64Type());
+      valueAttribute = mlir::DenseElementsAttr::get(tensorType,
+          llvm::makeArrayRef(GetInitializerData<double>(initializer)));
       break;
     }
     case (onnx::TensorProto::INT32): {
-      int32_t *typeArray =
-          CreateArrayAttribute<int32_t>(initializer, &length);
-      std::vector<int32_t> arrayAttrInitializer(
-      	typeArray, typeArray + length);
-      llvm::ArrayRef<int32_t> array(typeArray, length);
-      constantArrayAttribute = builder.getI32ArrayAttr(array);
-      elementType = builder.getIntegerType(32);
+      tensorType = mlir::RankedTensorType::get(
+          tensorDims, builder.getIntegerType(32));
+      valueAttribute = mlir::DenseElementsAttr::get(tensorType,
+          llvm::makeArrayRef(GetInitializerData<int32_t>(initializer)));
       break;
     }
     case (onnx::TensorProto::INT64): {
-      int64_t *typeArray =
-          CreateArrayAttribute<int64_t>(initializer, &length);
-      std::vector<int64_t> arrayAttrInitializer(
-      	typeArray, typeArray + length);
-      llvm::ArrayRef<int64_t> array(typeArray, length);
-      constantArrayAttribute = builder.getI64ArrayAttr(array);
-      elementType = builder.getIntegerType(64);
+      tensorType = mlir::RankedTensorType::get(
+          tensorDims, builder.getIntegerType(64));
+      valueAttribute = mlir::DenseElementsAttr::get(tensorType,
+          llvm::makeArrayRef(GetInitializerData<int64_t>(initializer)));
       break;
     }
+    default:
+      assert(false && "Unsupported initializer data type encountered.");
+      return nullptr;
   }
 
-  // Create empty sparse_value attribute.
-  llvm::ArrayRef<int64_t> array;
-  auto sparseValueAttribute = builder.getI64ArrayAttr(array);
-
-  // Create value attribute.
-  llvm::ArrayRef<int64_t> tensorDims(initializer.dims().data(),
-      initializer.dims().size());
-  mlir::Type tensorType =
-      mlir::RankedTensorType::get(tensorDims, elementType);
-
   return builder.create<mlir::ONNXConstantOp>(
-      loc, tensorType, sparseValueAttribute,
-      constantArrayAttribute);
+      loc, tensorType, /*sparse_value=*/nullptr, valueAttribute);
 }
 
 } // namespace onnf
\ No newline at end of file
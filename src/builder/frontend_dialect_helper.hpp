@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <numeric>
 #include <regex>
 #include <tuple>
@@ -74,10 +75,10 @@ struct InitializedTensorMapping {
   // itself.
   bool ContainKey(std::string name);
 
-  // Emit constant argument (initialized arguments) as a ConstantOp.
+  // Emit constant argument (initialized arguments) as a ConstantOp holding
+  // dense elements.
   // This method will allow operations to use the constant data contained
   // in an ONNX model as they are being compiled.
-  // This method enables the emission of such constant operation on demand.
   //
   // This will allow the propagation of shape information passed in as an
   // argument to operations such as Reshape and will enable other
@@ -281,24 +281,6 @@ private:
         expectedNumResults);
   }
 
-  void ImportNodeReshape(onnx::NodeProto node, int nIn, int nOut) {
-    std::vector<mlir::Value> inputs;
-    std::string item;
-    for (int i = 0; i < node.input().size(); ++i) {
-      item = node.input()[i];
-      // For the second argument, check if there exists an initializer.
-      if (i == 1 && initializedTensors.ContainKey(legalize_name(item))) {
-          inputs.push_back(
-                initializedTensors.EmitInitializerForInputTensor(
-                    UnknownLoc(), builder_, legalize_name(item)));
-      } else if (frontend_symbols_.ContainKey(legalize_name(item))) {
-        inputs.push_back(frontend_symbols_.GetTensorByOnnxName(item));
-      }
-    }
-
-    buildOutputAndOperation<mlir::ONNXReshapeOp>(node, inputs, nIn, nOut);
-  }
-
   /*!
    * Special handle for Conv operations.
    * c++ does not allow template specialization inside a class scope
@@ -414,7 +396,8 @@ private:
 
     // Import the input tensor types that are not constant.
     for (const auto &input : graph.input())
-      arg_types.emplace_back(ImportInputTensorType(input));
+      if (!initializedTensors.ContainKey(legalize_name(input.name())))
+        arg_types.emplace_back(ImportInputTensorType(input));
 
     // Create the main function.
     auto funcType = builder_.getFunctionType(arg_types, {});
@@ -425,7 +408,7 @@ private:
     // inputs and outputs.
     auto entryPoint = mlir::ONNXEntryPointOp::create(
         UnknownLoc(), mainFunc,
-        /*numInputs=*/graph.input().size() - graph.initializer().size(),
+        /*numInputs=*/arg_types.size(),
         /*numOutputs=*/graph.output().size());
 
     // Get the entru block inside the main function and set the insertion point
@@ -437,9 +420,20 @@ private:
     module_.push_back(entryPoint);
 
     // Map graph inputs to entry block arguments.
-    for (int i = 0; i < graph.input().size(); ++i)
-      ImportInputTensorSymbol(
-          graph.input()[i], entryBlock.getArguments()[i]);
+    int argIndex = 0;
+    for (const auto &input : graph.input())
+      if (!initializedTensors.ContainKey(legalize_name(input.name())))
+        ImportInputTensorSymbol(
+            input, entryBlock.getArguments()[argIndex++]);
+
+    // Import initializers as constants, so that the weights of the model are
+    // known to the optimizations and emitted into the compiled model.
+    for (const auto &initializer : graph.initializer()) {
+      auto name = legalize_name(initializer.name());
+      frontend_symbols_.AddMapping(name,
+          initializedTensors.EmitInitializerForInputTensor(
+              UnknownLoc(), builder_, name));
+    }
 
     // Create a NoneTyped constant to be used for optional operation inputs
     // which are not used.
@@ -55,8 +55,8 @@ void FrontendToKrnlLoweringPass::runOnModule() {
 
   // We define the specific operations, or dialects, that are legal targets for
   // this lowering.
-  target
-      .addLegalDialect<KrnlOpsDialect, AffineOpsDialect, StandardOpsDialect>();
+  target.addLegalDialect<KrnlOpsDialect, AffineOpsDialect, StandardOpsDialect,
+                         loop::LoopOpsDialect>();
 
   // TODO: enable this once more ops are supported.
   // We also define the ONNX dialect as Illegal so that the conversion will fail
@@ -97,6 +97,8 @@ void FrontendToKrnlLoweringPass::runOnModule() {
   populateLoweringONNXUnsqueezeOpPattern(patterns, &getContext());
   populateLoweringONNXTransposeOpPattern(patterns, &getContext());
   populateLoweringONNXIdentityOpPattern(patterns, &getContext());
+  populateLoweringONNXConstantOpPattern(patterns, &getContext());
+  populateLoweringONNXLayoutTransformOpPattern(patterns, &getContext());
   // Neural network
   populateLoweringONNXConvOpPattern(patterns, &getContext());
   populateLoweringONNXNormalizationOpPattern(patterns, &getContext());
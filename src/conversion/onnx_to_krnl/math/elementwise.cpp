@@ -8,10 +8,31 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <functional>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "mlir/IR/BlockAndValueMapping.h"
+
 #include "src/conversion/onnx_to_krnl/onnx_to_krnl_common.hpp"
 
 using namespace mlir;
 
+static llvm::cl::opt<bool> collapseElementwiseLoops(
+    "collapse-elementwise-loops",
+    llvm::cl::desc("Iterate over the collapsed dimensions of the operands of "
+                   "element-wise operations, e.g. with a single loop when "
+                   "they have the same shape"),
+    llvm::cl::init(true));
+
+static llvm::cl::opt<bool> elementwiseInPlace(
+    "elementwise-in-place",
+    llvm::cl::desc("Write the result of element-wise operations into the "
+                   "buffer of an operand of the same shape which is no "
+                   "longer used"),
+    llvm::cl::init(true));
+
 template <>
 struct ScalarOp<ONNXAddOp> {
   using FOp = AddFOp;
@@ -54,42 +75,55 @@ struct ScalarOp<ONNXXorOp> {
   using IOp = XOrOp;
 };
 
-template <>
-struct ScalarOp<ONNXExpOp> {
-  using FOp = ExpOp;
-  using IOp = ExpOp; // not use
-};
-
 template <>
 struct ScalarOp<ONNXSumOp> {
   using FOp = AddFOp;
   using IOp = AddIOp;
 };
 
-template <>
-struct ScalarOp<ONNXTanhOp> {
-  using FOp = TanhOp;
-  using IOp = TanhOp; // not use
-};
-
 template <>
 struct ScalarOp<ONNXCosOp> {
   using FOp = CosOp;
   using IOp = CosOp; // not use
 };
 
-template <>
-struct ScalarOp<ONNXLogOp> {
-  using FOp = LogOp;
-  using IOp = LogOp; // not use
-};
-
 template <>
 struct ScalarOp<ONNXSqrtOp> {
   using FOp = SqrtOp;
   using IOp = SqrtOp; // not use
 };
 
+//===----------------------------------------------------------------------===//
+// Scalar unary ops for lowering ONNXExpOp
+//===----------------------------------------------------------------------===//
+template <>
+Value mapToLowerScalarOp<ONNXExpOp>(Operation *op, ArrayRef<Type> result_types,
+                                    ArrayRef<Value> operands,
+                                    ConversionPatternRewriter &rewriter) {
+  return emitExp(rewriter, op->getLoc(), operands[0]);
+}
+
+//===----------------------------------------------------------------------===//
+// Scalar unary ops for lowering ONNXLogOp
+//===----------------------------------------------------------------------===//
+template <>
+Value mapToLowerScalarOp<ONNXLogOp>(Operation *op, ArrayRef<Type> result_types,
+                                    ArrayRef<Value> operands,
+                                    ConversionPatternRewriter &rewriter) {
+  return emitLog(rewriter, op->getLoc(), operands[0]);
+}
+
+//===----------------------------------------------------------------------===//
+// Scalar unary ops for lowering ONNXTanhOp
+//===----------------------------------------------------------------------===//
+template <>
+Value mapToLowerScalarOp<ONNXTanhOp>(Operation *op,
+                                     ArrayRef<Type> result_types,
+                                     ArrayRef<Value> operands,
+                                     ConversionPatternRewriter &rewriter) {
+  return emitTanh(rewriter, op->getLoc(), operands[0]);
+}
+
 //===----------------------------------------------------------------------===//
 // Scalar unary ops for lowering ONNXSinhOp
 //===----------------------------------------------------------------------===//
@@ -106,8 +140,8 @@ Value mapToLowerScalarOp<ONNXSinhOp>(Operation *op, ArrayRef<Type> result_types,
   auto zero = emitConstantOp(rewriter, loc, elementType, 0);
   auto two =  emitConstantOp(rewriter, loc, elementType, 2);
   auto neg = rewriter.create<SubFOp>(loc, zero, operand);
-  auto exp = rewriter.create<ExpOp>(loc, operand);
-  auto negExp = rewriter.create<ExpOp>(loc, neg);
+  auto exp = emitExp(rewriter, loc, operand);
+  auto negExp = emitExp(rewriter, loc, neg);
   auto result = rewriter.create<DivFOp>(
       loc, rewriter.create<SubFOp>(loc, exp, negExp), two);
 
@@ -130,8 +164,8 @@ Value mapToLowerScalarOp<ONNXCoshOp>(Operation *op, ArrayRef<Type> result_types,
   auto zero = emitConstantOp(rewriter, loc, elementType, 0);
   auto two =  emitConstantOp(rewriter, loc, elementType, 2);
   auto neg = rewriter.create<SubFOp>(loc, zero, operand);
-  auto exp = rewriter.create<ExpOp>(loc, operand);
-  auto negExp = rewriter.create<ExpOp>(loc, neg);
+  auto exp = emitExp(rewriter, loc, operand);
+  auto negExp = emitExp(rewriter, loc, neg);
   auto result = rewriter.create<DivFOp>(
       loc, rewriter.create<AddFOp>(loc, exp, negExp), two);
 
@@ -155,7 +189,7 @@ Value mapToLowerScalarOp<ONNXSigmoidOp>(Operation *op,
   auto zero = emitConstantOp(rewriter, loc, elementType, 0);
   auto one = emitConstantOp(rewriter, loc, elementType, 1);
   auto neg = rewriter.create<SubFOp>(loc, zero, operand);
-  auto negExp = rewriter.create<ExpOp>(loc, neg);
+  auto negExp = emitExp(rewriter, loc, neg);
   auto result = rewriter.create<DivFOp>(
       loc, one, rewriter.create<AddFOp>(loc, one, negExp));
 
@@ -220,7 +254,7 @@ Value mapToLowerScalarOp<ONNXEluOp>(Operation *op, ArrayRef<Type> result_types,
   auto zero = emitConstantOp(rewriter, loc, elementType, 0);
   auto one = emitConstantOp(rewriter, loc, elementType, 1);
   auto alpha = rewriter.create<ConstantOp>(loc, alphaAttribute);
-  auto exp = rewriter.create<ExpOp>(loc, operand);
+  auto exp = emitExp(rewriter, loc, operand);
   auto lessThanZero =
       rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, operand, zero);
   auto result = rewriter.create<SelectOp>(
@@ -304,7 +338,7 @@ Value mapToLowerScalarOp<ONNXSeluOp>(Operation *op, ArrayRef<Type> result_types,
   auto zero = emitConstantOp(rewriter, loc, elementType, 0);
   auto alpha = rewriter.create<ConstantOp>(loc, alphaAttribute);
   auto gamma = rewriter.create<ConstantOp>(loc, gammaAttribute);
-  auto exp = rewriter.create<ExpOp>(loc, operand);
+  auto exp = emitExp(rewriter, loc, operand);
   auto greaterThanZero =
       rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, operand, zero);
   auto select = rewriter.create<SelectOp>(
@@ -346,10 +380,10 @@ Value mapToLowerScalarOp<ONNXSoftplusOp>(
   Value operand = operands[0];
   auto elementType = result_types[0];
 
-  auto exp = rewriter.create<ExpOp>(loc, operand);
+  auto exp = emitExp(rewriter, loc, operand);
   auto one = emitConstantOp(rewriter, loc, elementType, 1);
   auto add = rewriter.create<AddFOp>(loc, exp, one);
-  auto result = rewriter.create<LogOp>(loc, add);
+  auto result = emitLog(rewriter, loc, add);
 
   return result;
 }
@@ -465,6 +499,307 @@ Value mapToLowerScalarOp<ONNXMinOp>(Operation *op, ArrayRef<Type> result_types,
   return result;
 }
 
+// Collapsing of the loop nests of element-wise ops.
+//===----------------------------------------------------------------------===//
+namespace {
+// How an operand of an element-wise operation is indexed along a dimension
+// of the result.
+enum class DimIndexing {
+  // The operand dimension has the size of the result dimension.
+  Iterated,
+  // The operand dimension is missing or known to be broadcasted.
+  Broadcasted,
+  // The operand dimension is broadcasted if a condition holds at runtime.
+  Checked,
+};
+} // namespace
+
+// Emit the product of the sizes of the dimensions [begin, end) of `memRef`,
+// returning its static part and the value of its dynamic part, if any.
+static std::pair<int64_t, Value>
+emitDimProduct(ConversionPatternRewriter &rewriter, Location loc,
+               Value memRef, int64_t begin, int64_t end) {
+  auto shape = memRef.getType().cast<MemRefType>().getShape();
+  int64_t staticSize = 1;
+  Value size;
+  for (int64_t i = begin; i < end; ++i) {
+    if (shape[i] >= 0) {
+      staticSize *= shape[i];
+      continue;
+    }
+    Value dim = rewriter.create<DimOp>(loc, memRef, i);
+    size = size ? rewriter.create<MulIOp>(loc, size, dim).getResult() : dim;
+  }
+  return {staticSize, size};
+}
+
+// Emit the loop nest computing the elements of `alloc` from the elements of
+// `operands`, broadcasted according to `dimInfo` as in
+// getLoopIVsForBroadcasting, by iterating over collapsed dimensions: the
+// adjacent dimensions along which every operand is indexed alike, without
+// checking at runtime whether it is broadcasted, are iterated by a single
+// loop over row-major views of the operands and of the result. Operands of
+// the same shape as the result are thus iterated by a single contiguous loop.
+// `emitScalarOp` computes an element of the result from the elements of the
+// operands. Return false, emitting nothing, if no dimension can be collapsed.
+static bool emitCollapsedLoopNest(
+    ConversionPatternRewriter &rewriter, Location loc, Value alloc,
+    ArrayRef<Value> operands,
+    const std::map<int, std::map<int, Value>> &dimInfo,
+    function_ref<Value(ArrayRef<Value>)> emitScalarOp) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto shape = memRefType.getShape();
+  int64_t rank = shape.size();
+  if (!collapseElementwiseLoops || rank < 2 ||
+      !memRefType.getAffineMaps().empty())
+    return false;
+  for (auto operand : operands)
+    if (!operand.getType().cast<MemRefType>().getAffineMaps().empty())
+      return false;
+
+  // Get the runtime condition for the dimension `dimIndex` of the operand
+  // `operandIndex` to be broadcasted, if any.
+  auto getCondition = [&](int operandIndex, int64_t dimIndex) -> Value {
+    auto operandDimInfo = dimInfo.find(operandIndex);
+    if (operandDimInfo == dimInfo.end())
+      return nullptr;
+    auto condition = operandDimInfo->second.find(dimIndex);
+    if (condition == operandDimInfo->second.end())
+      return nullptr;
+    return condition->second;
+  };
+  auto getIndexing = [&](int operandIndex, int64_t dimIndex) {
+    auto operandShape =
+        operands[operandIndex].getType().cast<MemRefType>().getShape();
+    int64_t operandRank = operandShape.size();
+    int64_t operandDimIndex = dimIndex - rank + operandRank;
+    if (operandDimIndex < 0 || operandShape[operandDimIndex] == 1)
+      return DimIndexing::Broadcasted;
+    auto operandDimInfo = dimInfo.find(operandIndex);
+    if (operandDimInfo != dimInfo.end() &&
+        operandDimInfo->second.count(operandDimIndex))
+      return getCondition(operandIndex, operandDimIndex)
+                 ? DimIndexing::Checked
+                 : DimIndexing::Broadcasted;
+    return DimIndexing::Iterated;
+  };
+
+  // Group the adjacent dimensions along which the operands are indexed
+  // alike. Dimensions of size 1 join any group, and a checked dimension is
+  // never grouped with another dimension of size other than 1. The indexing
+  // of the operands along a group is empty if all its dimensions have size 1.
+  SmallVector<int64_t, 4> groupBegins;
+  std::vector<std::vector<DimIndexing>> groupIndexings;
+  for (int64_t i = 0; i < rank; ++i) {
+    std::vector<DimIndexing> indexings;
+    if (shape[i] != 1)
+      for (int j = 0; j < operands.size(); ++j)
+        indexings.push_back(getIndexing(j, i));
+    if (!groupBegins.empty()) {
+      auto &groupIndexing = groupIndexings.back();
+      if (groupIndexing.empty() || indexings.empty()) {
+        if (groupIndexing.empty())
+          groupIndexing = indexings;
+        continue;
+      }
+      if (groupIndexing == indexings &&
+          !llvm::is_contained(indexings, DimIndexing::Checked))
+        continue;
+    }
+    groupBegins.push_back(i);
+    groupIndexings.push_back(indexings);
+  }
+  int64_t numGroups = groupBegins.size();
+  if (numGroups == rank)
+    return false;
+  groupBegins.push_back(rank);
+
+  PatternRewriter::InsertionGuard insertGuard(rewriter);
+
+  // Compute the number of iterations over each group.
+  SmallVector<int64_t, 4> groupShape;
+  SmallVector<Value, 4> groupSizes;
+  for (int64_t i = 0; i < numGroups; ++i) {
+    auto size = emitDimProduct(rewriter, loc, alloc, groupBegins[i],
+                               groupBegins[i + 1]);
+    if (size.second && size.first != 1) {
+      auto staticSize = rewriter.create<ConstantIndexOp>(loc, size.first);
+      size.second = rewriter.create<MulIOp>(loc, size.second, staticSize);
+    }
+    groupShape.push_back(size.second ? -1 : size.first);
+    groupSizes.push_back(size.second);
+  }
+
+  // Emit a row-major view of a buffer with the given shape, if it has another
+  // one.
+  auto emitView = [&](Value memRef, ArrayRef<int64_t> viewShape,
+                      ArrayRef<Value> dimSizes) -> Value {
+    auto type = memRef.getType().cast<MemRefType>();
+    auto viewType = MemRefType::get(viewShape, type.getElementType());
+    if (viewType == type)
+      return memRef;
+    return rewriter.create<KrnlReshapeOp>(loc, viewType, memRef, dimSizes);
+  };
+
+  // Emit the views of the operands over the groups intersecting their
+  // dimensions. An operand broadcasted along all these groups is not viewed,
+  // its single element being loaded from the operand itself.
+  SmallVector<Value, 4> views;
+  SmallVector<int64_t, 4> firstGroups;
+  std::vector<std::vector<DimIndexing>> operandIndexings;
+  std::vector<std::vector<Value>> operandConditions;
+  for (int i = 0; i < operands.size(); ++i) {
+    auto operand = operands[i];
+    auto operandShape = operand.getType().cast<MemRefType>().getShape();
+    int64_t operandRank = operandShape.size();
+    int64_t firstGroup = 0;
+    while (firstGroup < numGroups &&
+           groupBegins[firstGroup + 1] <= rank - operandRank)
+      ++firstGroup;
+
+    SmallVector<int64_t, 4> viewShape;
+    SmallVector<Value, 4> dimSizes;
+    std::vector<DimIndexing> indexings;
+    std::vector<Value> conditions;
+    bool isBroadcasted = true;
+    for (int64_t j = firstGroup; j < numGroups; ++j) {
+      auto indexing = groupIndexings[j].empty() ? DimIndexing::Broadcasted
+                                                : groupIndexings[j][i];
+      int64_t begin =
+          std::max<int64_t>(groupBegins[j] - rank + operandRank, 0);
+      int64_t end = groupBegins[j + 1] - rank + operandRank;
+      Value condition;
+      switch (indexing) {
+      case DimIndexing::Iterated: {
+        // Prefer the static sizes of the operand to those of the result.
+        int64_t staticSize = 1;
+        for (int64_t k = begin; k < end && staticSize >= 0; ++k)
+          staticSize = operandShape[k] < 0 ? -1 : staticSize * operandShape[k];
+        if (staticSize < 0 && groupSizes[j])
+          dimSizes.push_back(groupSizes[j]);
+        viewShape.push_back(staticSize < 0 ? groupShape[j] : staticSize);
+        isBroadcasted = false;
+        break;
+      }
+      case DimIndexing::Broadcasted:
+        viewShape.push_back(1);
+        break;
+      case DimIndexing::Checked: {
+        auto size = emitDimProduct(rewriter, loc, operand, begin, end);
+        viewShape.push_back(-1);
+        dimSizes.push_back(size.second);
+        for (int64_t k = begin; k < end && !condition; ++k)
+          condition = getCondition(i, k);
+        isBroadcasted = false;
+        break;
+      }
+      }
+      indexings.push_back(indexing);
+      conditions.push_back(condition);
+    }
+    views.push_back(isBroadcasted ? nullptr
+                                  : emitView(operand, viewShape, dimSizes));
+    firstGroups.push_back(firstGroup);
+    operandIndexings.push_back(indexings);
+    operandConditions.push_back(conditions);
+  }
+  SmallVector<Value, 4> resultDimSizes;
+  for (auto size : groupSizes)
+    if (size)
+      resultDimSizes.push_back(size);
+  auto resultView = emitView(alloc, groupShape, resultDimSizes);
+
+  // Iterate over the groups.
+  std::vector<Value> originalLoops;
+  std::vector<Value> optimizedLoops;
+  auto optimizedLoopsOp = emitOptimizedLoops(rewriter, loc, originalLoops,
+                                             optimizedLoops, numGroups);
+  KrnlIterateOperandPack pack(rewriter, originalLoops, optimizedLoops);
+  for (int64_t i = 0; i < numGroups; ++i) {
+    pack.pushConstantBound(0);
+    if (groupSizes[i])
+      pack.pushOperandBound(groupSizes[i]);
+    else
+      pack.pushConstantBound(groupShape[i]);
+  }
+  auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
+  Block &iterationBlock = iterateOp.bodyRegion().front();
+
+  // 1. Insert any optimizations in the KrnlOptimizeLoopsOp body.
+  rewriter.setInsertionPointToEnd(&optimizedLoopsOp.region().front());
+  emitOutermostParallelLoop(rewriter, loc, originalLoops, groupShape);
+  emitInnermostVectorizedLoop(rewriter, loc, originalLoops,
+                              resultView.getType().cast<MemRefType>());
+  rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
+
+  // 2. Insert instructions inside the KernelIterateOp body.
+  rewriter.setInsertionPointToStart(&iterationBlock);
+  SmallVector<Value, 4> loopIVs;
+  for (auto arg : iterationBlock.getArguments())
+    loopIVs.push_back(arg);
+  Value zero;
+  auto getZero = [&]() {
+    if (!zero)
+      zero = rewriter.create<ConstantIndexOp>(loc, 0);
+    return zero;
+  };
+
+  SmallVector<Value, 4> loadedVals;
+  for (int i = 0; i < operands.size(); ++i) {
+    SmallVector<Value, 4> indices;
+    if (!views[i]) {
+      int64_t operandRank = operands[i].getType().cast<MemRefType>().getRank();
+      for (int64_t j = 0; j < operandRank; ++j)
+        indices.push_back(getZero());
+      loadedVals.push_back(
+          rewriter.create<LoadOp>(loc, operands[i], indices));
+      continue;
+    }
+    for (int64_t j = 0; j < operandIndexings[i].size(); ++j) {
+      auto loopIV = loopIVs[firstGroups[i] + j];
+      switch (operandIndexings[i][j]) {
+      case DimIndexing::Iterated:
+        indices.push_back(loopIV);
+        break;
+      case DimIndexing::Broadcasted:
+        indices.push_back(getZero());
+        break;
+      case DimIndexing::Checked: {
+        auto index = rewriter.create<SelectOp>(
+            loc, operandConditions[i][j], getZero(), loopIV);
+        indices.push_back(index);
+        break;
+      }
+      }
+    }
+    loadedVals.push_back(rewriter.create<LoadOp>(loc, views[i], indices));
+  }
+  auto result = emitScalarOp(loadedVals);
+  rewriter.create<StoreOp>(loc, result, resultView, loopIVs);
+  return true;
+}
+
+// Get the buffer the result of the element-wise operation `op` is written
+// into. When `inPlace` is set, the operands have the shape of the result if
+// they have its type, and the buffer of such an operand which is no longer
+// used is reused. Otherwise, a buffer is allocated, the sizes of its dynamic
+// dimensions being those of `sizeOperands`.
+static Value getResultBuffer(ConversionPatternRewriter &rewriter, Location loc,
+                             Operation *op, ArrayRef<Value> operands,
+                             MemRefType memRefType,
+                             ArrayRef<Value> sizeOperands, bool inPlace) {
+  if (inPlace && elementwiseInPlace)
+    if (auto buffer =
+            getReusableOperandBuffer(rewriter, op, operands, memRefType))
+      return buffer;
+
+  bool insertDealloc = checkInsertDealloc(op);
+  if (hasAllConstantDimensions(memRefType))
+    return insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+  return insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc,
+                               sizeOperands);
+}
+
 // Element-wise unary ops lowering to Krnl dialect.
 //===----------------------------------------------------------------------===//
 template <typename ElementwiseUnaryOp>
@@ -474,6 +809,9 @@ struct ONNXElementwiseUnaryOpLowering : public ConversionPattern {
   PatternMatchResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const final {
+    // The operations fused into an onnx.FusedElementwise are lowered with it.
+    if (isa_and_nonnull<ONNXFusedElementwiseOp>(op->getParentOp()))
+      return matchFailure();
     // TODO: Check that the types are valid.
     // An element-wise unary operation must have all operands and the result of
     // the same type. This should have been verified by the verifier.
@@ -488,14 +826,19 @@ struct ONNXElementwiseUnaryOpLowering : public ConversionPattern {
     // dimensions with the result at this pre-optimization phase.
     // TODO: verify that dimensions match.
     // TODO: can the dimension of the result differ after optimizations?
-    Value alloc;
-    bool insertDealloc = checkInsertDealloc(op);
-
-    if (hasAllConstantDimensions(memRefType))
-      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
-    else
-      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc,
-                                    {operands[0]});
+    // The result may be written into the buffer of the operand.
+    Value alloc = getResultBuffer(rewriter, loc, op, operands, memRefType,
+                                  {operands[0]}, /*inPlace=*/true);
+
+    auto emitScalarOp = [&](ArrayRef<Value> loadedVals) {
+      return mapToLowerScalarOp<ElementwiseUnaryOp>(
+          op, memRefType.getElementType(), loadedVals, rewriter);
+    };
+    if (emitCollapsedLoopNest(rewriter, loc, alloc, operands[0], {},
+                              emitScalarOp)) {
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
 
     std::vector<Value> originalLoops;
     KrnlOptimizeLoopsOp optimizedLoopsOp;
@@ -508,6 +851,9 @@ struct ONNXElementwiseUnaryOpLowering : public ConversionPattern {
 
     // 1. Insert any optimizations in the KrnlOptimizeLoopsOp body.
     rewriter.setInsertionPointToEnd(&optimizationBlock);
+    emitOutermostParallelLoop(rewriter, loc, originalLoops,
+                              memRefType.getShape());
+    emitInnermostVectorizedLoop(rewriter, loc, originalLoops, memRefType);
     // Return from KrnlOptimizeLoopsOp body.
     // When no optimizations are present we just return the loops
     // unchaged.
@@ -521,9 +867,8 @@ struct ONNXElementwiseUnaryOpLowering : public ConversionPattern {
     for (auto arg : iterationBlock.getArguments())
       loopIVs.push_back(arg);
 
-    auto loadedVal = rewriter.create<LoadOp>(loc, operands[0], loopIVs);
-    auto loweredOpResult = mapToLowerScalarOp<ElementwiseUnaryOp>(
-        op, memRefType.getElementType(), {loadedVal}, rewriter);
+    Value loadedVal = rewriter.create<LoadOp>(loc, operands[0], loopIVs);
+    auto loweredOpResult = emitScalarOp(loadedVal);
     // Store result in the resulting array.
     rewriter.create<StoreOp>(loc, loweredOpResult, alloc, loopIVs);
 
@@ -542,6 +887,9 @@ struct ONNXElementwiseVariadicOpLowering : public ConversionPattern {
   PatternMatchResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const final {
+    // The operations fused into an onnx.FusedElementwise are lowered with it.
+    if (isa_and_nonnull<ONNXFusedElementwiseOp>(op->getParentOp()))
+      return matchFailure();
     // TODO: Check that the types are valid.
     // An element-wise variadic operation must have all operands and the result
     // of the same type. This should have been verified by the verifier.
@@ -551,61 +899,298 @@ struct ONNXElementwiseVariadicOpLowering : public ConversionPattern {
     // Insert an allocation and deallocation for the result of this operation.
     auto memRefType = convertToMemRefType(*op->result_type_begin());
 
-    Value alloc;
-    bool insertDealloc = checkInsertDealloc(op);
     // If the output has a dynamic dimension, we compute its dimension at
     // runtime by using dimensions from the operands.
     // In particular, we need to know from which operand a result dimension
     // comes from.
     // TODO: can the dimension of the result differ after optimizations?
-    if (hasAllConstantDimensions(memRefType))
-      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
-    else
-      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc,
-                                    operands);
+    // An operand of the type of the result may be broadcasted along its
+    // dynamic dimensions, so the result is only written into the buffer of an
+    // operand when its shape is known.
+    Value alloc = getResultBuffer(rewriter, loc, op, operands, memRefType,
+                                  operands,
+                                  hasAllConstantDimensions(memRefType));
 
     // Get run-time dimension information for unknown dimensions used for
     // broadcasting.
     std::map<int, std::map<int, Value>> broadcastedDimInfo =
         getBroadcastedDimInfo(loc, rewriter, memRefType, operands);
 
+    // Emit the loop nest computing the result, the operands being indexed
+    // according to `dimInfo`.
+    auto emitScalarOp = [&](ArrayRef<Value> loadedVals) {
+      Value accumulated = loadedVals[0];
+      for (unsigned i = 1; i < numArgs; i++)
+        accumulated = mapToLowerScalarOp<ElementwiseVariadicOp>(
+            op, memRefType.getElementType(), {accumulated, loadedVals[i]},
+            rewriter);
+      return accumulated;
+    };
+    auto emitLoopNest = [&](std::map<int, std::map<int, Value>> &dimInfo) {
+      if (emitCollapsedLoopNest(rewriter, loc, alloc, operands, dimInfo,
+                                emitScalarOp))
+        return;
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      std::vector<Value> originalLoops;
+      KrnlOptimizeLoopsOp optimizedLoopsOp;
+      KrnlIterateOp iterateOp;
+      emitKrnlLoopsAndIterationForOperand(
+          rewriter, loc, alloc, originalLoops,
+          optimizedLoopsOp, iterateOp);
+      Block &optimizationBlock = optimizedLoopsOp.region().front();
+      Block &iterationBlock = iterateOp.bodyRegion().front();
+
+      // 1. Insert any optimizations in the KrnlOptimizeLoopsOp body.
+      rewriter.setInsertionPointToEnd(&optimizationBlock);
+      emitOutermostParallelLoop(rewriter, loc, originalLoops,
+                                memRefType.getShape());
+      emitInnermostVectorizedLoop(rewriter, loc, originalLoops, memRefType);
+      // Return from KrnlOptimizeLoopsOp body.
+      // When no optimizations are present we just return the loops unchaged.
+      rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
+
+      // 2. Insert instructions inside the KernelIterateOp body.
+      rewriter.setInsertionPointToStart(&iterationBlock);
+
+      // Handle the operation:
+      SmallVector<Value, 4> loopIVs;
+      for (auto arg : iterationBlock.getArguments())
+        loopIVs.push_back(arg);
+
+      // Fold over operands for each of their scalar values
+      Value accumulated, next;
+      auto accumulatedLoopIVs = getLoopIVsForBroadcasting(
+          loc, rewriter, loopIVs, operands[0], dimInfo[0]);
+      accumulated =
+          rewriter.create<LoadOp>(loc, operands[0], accumulatedLoopIVs);
+      for (unsigned i = 1; i < numArgs; i++) {
+        auto nextLoopIVs = getLoopIVsForBroadcasting(
+            loc, rewriter, loopIVs, operands[i], dimInfo[i]);
+        next = rewriter.create<LoadOp>(loc, operands[i], nextLoopIVs);
+        accumulated = mapToLowerScalarOp<ElementwiseVariadicOp>(
+            op, memRefType.getElementType(), {accumulated, next}, rewriter);
+      }
+      // Store result in the resulting array.
+      rewriter.create<StoreOp>(loc, accumulated, alloc, loopIVs);
+    };
+
+    // Selecting the index of an operand along a dimension that may be
+    // broadcasted in every iteration prevents the vectorization of the loops.
+    // Instead, the loop nest is versioned on whether each such dimension is
+    // broadcasted, a null condition telling the operand to be indexed by 0
+    // along a broadcasted dimension, and a missing one by the induction
+    // variable. If there are too many versions, the loop nest is only
+    // specialized for the common case where no dimension is broadcasted.
+    std::vector<std::pair<int, int>> broadcastableDims;
+    for (auto &operandDimInfo : broadcastedDimInfo)
+      for (auto &dimCondition : operandDimInfo.second)
+        broadcastableDims.emplace_back(operandDimInfo.first, dimCondition.first);
+    std::map<int, std::map<int, Value>> versionDimInfo;
+    if (broadcastableDims.empty()) {
+      emitLoopNest(versionDimInfo);
+    } else if (broadcastableDims.size() <=
+               llvm::Log2_64(maxBroadcastVersions)) {
+      std::function<void(size_t)> emitVersions = [&](size_t next) {
+        if (next == broadcastableDims.size()) {
+          emitLoopNest(versionDimInfo);
+          return;
+        }
+        auto operandIndex = broadcastableDims[next].first;
+        auto dimIndex = broadcastableDims[next].second;
+        auto ifOp = rewriter.create<loop::IfOp>(loc,
+            broadcastedDimInfo[operandIndex][dimIndex],
+            /*withElseRegion=*/true);
+        PatternRewriter::InsertionGuard insertGuard(rewriter);
+        rewriter.setInsertionPointToStart(&ifOp.thenRegion().front());
+        versionDimInfo[operandIndex][dimIndex] = nullptr;
+        emitVersions(next + 1);
+        rewriter.setInsertionPointToStart(&ifOp.elseRegion().front());
+        versionDimInfo[operandIndex].erase(dimIndex);
+        emitVersions(next + 1);
+      };
+      emitVersions(0);
+    } else {
+      Value isBroadcasted;
+      for (auto &dim : broadcastableDims) {
+        auto condition = broadcastedDimInfo[dim.first][dim.second];
+        isBroadcasted = isBroadcasted
+                            ? rewriter.create<OrOp>(loc, isBroadcasted,
+                                                    condition).getResult()
+                            : condition;
+      }
+      auto ifOp =
+          rewriter.create<loop::IfOp>(loc, isBroadcasted,
+                                      /*withElseRegion=*/true);
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      rewriter.setInsertionPointToStart(&ifOp.thenRegion().front());
+      emitLoopNest(broadcastedDimInfo);
+      rewriter.setInsertionPointToStart(&ifOp.elseRegion().front());
+      emitLoopNest(versionDimInfo);
+    }
+
+    rewriter.replaceOp(op, alloc);
+
+    return matchSuccess();
+  }
+};
+
+// Fused element-wise ops lowering to Krnl dialect.
+//===----------------------------------------------------------------------===//
+template <typename... Ops>
+struct OpList {};
+
+using FusableUnaryOps =
+    OpList<ONNXCosOp, ONNXCoshOp, ONNXEluOp, ONNXExpOp, ONNXHardSigmoidOp,
+           ONNXLeakyReluOp, ONNXLogOp, ONNXReciprocalOp, ONNXReluOp,
+           ONNXSeluOp, ONNXSigmoidOp, ONNXSignOp, ONNXSinhOp, ONNXSoftplusOp,
+           ONNXSoftsignOp, ONNXSqrtOp, ONNXTanhOp>;
+using FusableVariadicOps =
+    OpList<ONNXAddOp, ONNXAndOp, ONNXDivOp, ONNXMaxOp, ONNXMinOp, ONNXMulOp,
+           ONNXOrOp, ONNXSubOp, ONNXSumOp, ONNXXorOp>;
+
+static bool isOneOf(OpList<>, Operation *op) { return false; }
+
+template <typename Op, typename... Ops>
+static bool isOneOf(OpList<Op, Ops...>, Operation *op) {
+  return isa<Op>(op) || isOneOf(OpList<Ops...>(), op);
+}
+
+static Value emitUnaryScalarOp(OpList<>, Operation *op, Type elementType,
+                               ArrayRef<Value> operands,
+                               ConversionPatternRewriter &rewriter) {
+  return nullptr;
+}
+
+// Emit the scalar operation of the unary operation `op`, if it is one of
+// `Ops`.
+template <typename Op, typename... Ops>
+static Value emitUnaryScalarOp(OpList<Op, Ops...>, Operation *op,
+                               Type elementType, ArrayRef<Value> operands,
+                               ConversionPatternRewriter &rewriter) {
+  if (isa<Op>(op))
+    return mapToLowerScalarOp<Op>(op, elementType, operands, rewriter);
+  return emitUnaryScalarOp(OpList<Ops...>(), op, elementType, operands,
+                           rewriter);
+}
+
+static Value emitVariadicScalarOp(OpList<>, Operation *op, Type elementType,
+                                  ArrayRef<Value> operands,
+                                  ConversionPatternRewriter &rewriter) {
+  return nullptr;
+}
+
+// Emit the scalar operations of the variadic operation `op`, if it is one of
+// `Ops`, folding its operands.
+template <typename Op, typename... Ops>
+static Value emitVariadicScalarOp(OpList<Op, Ops...>, Operation *op,
+                                  Type elementType, ArrayRef<Value> operands,
+                                  ConversionPatternRewriter &rewriter) {
+  if (!isa<Op>(op))
+    return emitVariadicScalarOp(OpList<Ops...>(), op, elementType, operands,
+                                rewriter);
+  Value accumulated = operands[0];
+  for (unsigned i = 1; i < operands.size(); i++)
+    accumulated = mapToLowerScalarOp<Op>(
+        op, elementType, {accumulated, operands[i]}, rewriter);
+  return accumulated;
+}
+
+// Emit the scalar operations of the body of `fusedOp`, computing an element
+// of its result from the elements `inputs` of its inputs.
+static Value emitFusedScalarOps(ONNXFusedElementwiseOp fusedOp,
+                                ArrayRef<Value> inputs,
+                                ConversionPatternRewriter &rewriter) {
+  Block &body = fusedOp.body().front();
+  BlockAndValueMapping mapping;
+  for (auto arg : body.getArguments())
+    mapping.map(arg, inputs[arg.getArgNumber()]);
+  for (auto &op : body.without_terminator()) {
+    SmallVector<Value, 4> operands;
+    for (auto operand : op.getOperands())
+      operands.push_back(mapping.lookup(operand));
+    auto elementType =
+        op.getResult(0).getType().cast<ShapedType>().getElementType();
+    Value result = emitUnaryScalarOp(FusableUnaryOps(), &op, elementType,
+                                     operands, rewriter);
+    if (!result)
+      result = emitVariadicScalarOp(FusableVariadicOps(), &op, elementType,
+                                    operands, rewriter);
+    mapping.map(op.getResult(0), result);
+  }
+  return mapping.lookup(body.getTerminator()->getOperand(0));
+}
+
+struct ONNXFusedElementwiseOpLowering : public ConversionPattern {
+  ONNXFusedElementwiseOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXFusedElementwiseOp::getOperationName(), 1,
+                          ctx) {}
+  PatternMatchResult
+  matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const final {
+    auto fusedOp = cast<ONNXFusedElementwiseOp>(op);
+    auto loc = op->getLoc();
+    for (auto &nestedOp : fusedOp.body().front().without_terminator())
+      if (nestedOp.getNumResults() != 1 ||
+          !(isOneOf(FusableUnaryOps(), &nestedOp) ||
+            isOneOf(FusableVariadicOps(), &nestedOp)))
+        return matchFailure();
+
+    // The inputs either have the type of the result, or a static shape
+    // broadcasted to it. The dynamic dimensions of the result are thus those
+    // of the former, of which there must be a single one: the inputs are not
+    // checked for broadcasting at runtime.
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    SmallVector<Value, 4> sameTypeOperands;
+    for (auto operand : operands)
+      if (operand.getType() == memRefType)
+        sameTypeOperands.push_back(operand);
+    if (!hasAllConstantDimensions(memRefType) && sameTypeOperands.size() != 1)
+      return matchFailure();
+
+    // As for variadic operations, the result is only written into the buffer
+    // of an operand when its shape is known.
+    Value alloc = getResultBuffer(rewriter, loc, op, operands, memRefType,
+                                  sameTypeOperands,
+                                  hasAllConstantDimensions(memRefType));
+
+    // Evaluate the whole body for each element of the result.
+    auto emitScalarOp = [&](ArrayRef<Value> loadedVals) {
+      return emitFusedScalarOps(fusedOp, loadedVals, rewriter);
+    };
+    if (emitCollapsedLoopNest(rewriter, loc, alloc, operands, {},
+                              emitScalarOp)) {
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
+
     std::vector<Value> originalLoops;
     KrnlOptimizeLoopsOp optimizedLoopsOp;
     KrnlIterateOp iterateOp;
     emitKrnlLoopsAndIterationForOperand(
-        rewriter, loc, alloc, originalLoops,
-        optimizedLoopsOp, iterateOp);
+        rewriter, loc, alloc, originalLoops, optimizedLoopsOp, iterateOp);
     Block &optimizationBlock = optimizedLoopsOp.region().front();
     Block &iterationBlock = iterateOp.bodyRegion().front();
 
     // 1. Insert any optimizations in the KrnlOptimizeLoopsOp body.
     rewriter.setInsertionPointToEnd(&optimizationBlock);
-    // Return from KrnlOptimizeLoopsOp body.
-    // When no optimizations are present we just return the loops unchaged.
+    emitOutermostParallelLoop(rewriter, loc, originalLoops,
+                              memRefType.getShape());
+    emitInnermostVectorizedLoop(rewriter, loc, originalLoops, memRefType);
     rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
 
     // 2. Insert instructions inside the KernelIterateOp body.
     rewriter.setInsertionPointToStart(&iterationBlock);
-
-    // Handle the operation:
     SmallVector<Value, 4> loopIVs;
     for (auto arg : iterationBlock.getArguments())
       loopIVs.push_back(arg);
-
-    // Fold over operands for each of their scalar values
-    Value accumulated, next;
-    auto accumulatedLoopIVs = getLoopIVsForBroadcasting(
-        loc, rewriter, loopIVs, operands[0], broadcastedDimInfo[0]);
-    accumulated = rewriter.create<LoadOp>(loc, operands[0], accumulatedLoopIVs);
-    for (unsigned i = 1; i < numArgs; i++) {
-      auto nextLoopIVs = getLoopIVsForBroadcasting(
-          loc, rewriter, loopIVs, operands[i], broadcastedDimInfo[i]);
-      next = rewriter.create<LoadOp>(loc, operands[i], nextLoopIVs);
-      accumulated = mapToLowerScalarOp<ElementwiseVariadicOp>(
-          op, memRefType.getElementType(), {accumulated, next}, rewriter);
+    SmallVector<Value, 4> loadedVals;
+    for (auto operand : operands) {
+      auto operandLoopIVs =
+          getLoopIVsForBroadcasting(loc, rewriter, loopIVs, operand, {});
+      loadedVals.push_back(
+          rewriter.create<LoadOp>(loc, operand, operandLoopIVs));
     }
-    // Store result in the resulting array.
-    rewriter.create<StoreOp>(loc, accumulated, alloc, loopIVs);
+    rewriter.create<StoreOp>(loc, emitScalarOp(loadedVals), alloc, loopIVs);
 
     rewriter.replaceOp(op, alloc);
 
@@ -641,5 +1226,6 @@ void populateLoweringONNXElementwiseOpPattern(
                   ONNXElementwiseVariadicOpLowering<mlir::ONNXSubOp>,
                   ONNXElementwiseVariadicOpLowering<mlir::ONNXSumOp>,
                   ONNXElementwiseUnaryOpLowering<mlir::ONNXTanhOp>,
-                  ONNXElementwiseVariadicOpLowering<mlir::ONNXXorOp>>(ctx);
+                  ONNXElementwiseVariadicOpLowering<mlir::ONNXXorOp>,
+                  ONNXFusedElementwiseOpLowering>(ctx);
 }
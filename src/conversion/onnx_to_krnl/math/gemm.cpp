@@ -12,6 +12,386 @@
 
 using namespace mlir;
 
+namespace {
+
+// Get the size of the first dimension of the given (memref, index) pairs
+// known at compile time, or the run-time size of the first one otherwise.
+GemmSize getGemmSize(ConversionPatternRewriter &rewriter, Location loc,
+                     ArrayRef<std::pair<Value, int64_t>> dims) {
+  for (auto dim : dims) {
+    auto size = dim.first.getType().cast<MemRefType>().getShape()[dim.second];
+    if (size >= 0)
+      return {size, nullptr};
+  }
+  return {-1, rewriter.create<DimOp>(loc, dims[0].first, dims[0].second)};
+}
+
+// Emit the loop nests of the GEMM kernel. Their bounds are affine functions
+// of the induction variables of the enclosing loops, passed as dimensions,
+// and of the sizes of the problem unknown at compile time, passed as
+// symbols.
+class GemmLoopBuilder {
+public:
+  GemmLoopBuilder(ConversionPatternRewriter &rewriter, Location loc)
+      : rewriter(rewriter), loc(loc) {}
+
+  // Get the affine expression of a size of the problem.
+  AffineExpr getSize(GemmSize size) {
+    if (size.constant >= 0)
+      return rewriter.getAffineConstantExpr(size.constant);
+    auto position = llvm::find(symbols, size.value) - symbols.begin();
+    if (position == (int64_t)symbols.size())
+      symbols.emplace_back(size.value);
+    return rewriter.getAffineSymbolExpr(position);
+  }
+
+  // Emit a loop nest where the i-th loop iterates from `lbs[i]` to the
+  // minimum of `ubs[i]`, these expressions being functions of `dims`. The
+  // schedule of the loops is emitted by `emitSchedule`, and the loop body by
+  // `emitBody` given the induction variables. The insertion point is left
+  // after the loop nest.
+  void emitLoopNest(ArrayRef<Value> dims, ArrayRef<AffineExpr> lbs,
+                    ArrayRef<SmallVector<AffineExpr, 2>> ubs,
+                    function_ref<void(ArrayRef<Value>)> emitSchedule,
+                    function_ref<void(ArrayRef<Value>)> emitBody) {
+    std::vector<Value> loops, optimizedLoops;
+    Block *optimizationBlock =
+        defineLoops(rewriter, loc, loops, optimizedLoops, lbs.size());
+    KrnlIterateOperandPack pack(rewriter, loops, optimizedLoops);
+    SmallVector<Value, 8> operands(dims.begin(), dims.end());
+    operands.append(symbols.begin(), symbols.end());
+    auto pushBound = [&](ArrayRef<AffineExpr> exprs) {
+      if (exprs.size() == 1)
+        if (auto constantExpr = exprs[0].dyn_cast<AffineConstantExpr>())
+          return pack.pushConstantBound(constantExpr.getValue());
+      pack.pushAffineMapBound(
+          AffineMap::get(dims.size(), symbols.size(), exprs), operands);
+    };
+    for (int i = 0; i < lbs.size(); ++i) {
+      pushBound(lbs[i]);
+      pushBound(ubs[i]);
+    }
+    auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
+
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToEnd(optimizationBlock);
+    emitSchedule(loops);
+    rewriter.create<KrnlReturnLoopsOp>(loc, loops);
+    Block &iterationBlock = iterateOp.bodyRegion().front();
+    rewriter.setInsertionPointToStart(&iterationBlock);
+    SmallVector<Value, 4> ivs(iterationBlock.getArguments().begin(),
+                              iterationBlock.getArguments().end());
+    emitBody(ivs);
+  }
+
+  // Emit the value of `expr`, a function of `dims`.
+  Value emitIndex(AffineExpr expr, ArrayRef<Value> dims) {
+    SmallVector<Value, 8> operands(dims.begin(), dims.end());
+    operands.append(symbols.begin(), symbols.end());
+    return rewriter.create<AffineApplyOp>(
+        loc, AffineMap::get(dims.size(), symbols.size(), expr), operands);
+  }
+
+private:
+  ConversionPatternRewriter &rewriter;
+  Location loc;
+  SmallVector<Value, 3> symbols;
+};
+
+} // namespace
+
+// Accumulate alpha * A * B into Y following the GotoBLAS algorithm.
+// The loops over the columns of Y and over the reduction dimension are tiled
+// so that a panel of B fits in the L3 cache, and is packed into a contiguous
+// buffer. The rows of Y are tiled so that a block of A fits in the L2 cache,
+// and is packed into a contiguous buffer; these blocks are computed in
+// parallel. Each block of Y is then computed by a microkernel accumulating
+// tiles of registerTileRows x vectorWidth elements into a scratch buffer on
+// the stack, small enough to be promoted to registers, over a panel of the
+// packed B reused from the L1 cache.
+// A null alpha stands for 1.
+void emitPackedGemm(ConversionPatternRewriter &rewriter, Location loc,
+                    Type elementType, GemmSize M, GemmSize N, GemmSize K,
+                    GemmLoadFn loadA, GemmLoadFn loadB,
+                    GemmAccumulateFn accumulateY, Value alpha) {
+  // Nothing is accumulated into Y when the iteration space is known to be
+  // empty, which would also yield empty tiles.
+  if (M.constant == 0 || N.constant == 0 || K.constant == 0)
+    return;
+
+  auto context = rewriter.getContext();
+  bool isInteger = elementType.isa<IntegerType>();
+  auto emitMul = [&](Value lhs, Value rhs) -> Value {
+    if (isInteger)
+      return rewriter.create<MulIOp>(loc, lhs, rhs);
+    return rewriter.create<MulFOp>(loc, lhs, rhs);
+  };
+  auto emitAdd = [&](Value lhs, Value rhs) -> Value {
+    if (isInteger)
+      return rewriter.create<AddIOp>(loc, lhs, rhs);
+    return rewriter.create<AddFOp>(loc, lhs, rhs);
+  };
+
+  // Sizes of the tiles. The register tile holds one vector per row. Cache
+  // tiles are shrunk to the size of the problem when it is known.
+  int64_t vectorWidth = std::max<int64_t>(
+      1, targetVectorSizeInBytes * 8 / elementType.getIntOrFloatBitWidth());
+  int64_t mr = registerTileRows;
+  int64_t nr = vectorWidth;
+  int64_t mc = l2TileRows, nc = l3TileColumns, kc = l1TileReduction;
+  auto roundUp = [](int64_t value, int64_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+  };
+  if (M.constant >= 0)
+    mc = std::min(mc, roundUp(M.constant, mr));
+  if (N.constant >= 0)
+    nc = std::min(nc, roundUp(N.constant, nr));
+  if (K.constant > 0)
+    kc = std::min(kc, K.constant);
+
+  GemmLoopBuilder builder(rewriter, loc);
+  auto m = builder.getSize(M);
+  auto n = builder.getSize(N);
+  auto k = builder.getSize(K);
+  auto d0 = getAffineDimExpr(0, context);
+  auto d1 = getAffineDimExpr(1, context);
+  auto d2 = getAffineDimExpr(2, context);
+  auto d3 = getAffineDimExpr(3, context);
+  auto zero = getAffineConstantExpr(0, context);
+  auto noSchedule = [](ArrayRef<Value> loops) {};
+  auto vectorize = [&](ArrayRef<Value> loops) {
+    if (vectorWidth > 1)
+      rewriter.create<KrnlVectorizeOp>(loc, loops.back(), vectorWidth);
+  };
+  // Iterate over the panels of B: jc over the columns of Y and pc over
+  // the reduction dimension.
+  builder.emitLoopNest(
+      {}, {zero, zero}, {{n.ceilDiv(nc)}, {k.ceilDiv(kc)}}, noSchedule,
+      [&](ArrayRef<Value> panelIVs) {
+        Value jc = panelIVs[0], pc = panelIVs[1];
+        // Extents of the current panel, as functions of (jc, pc).
+        auto ncExprs = SmallVector<AffineExpr, 2>{
+            getAffineConstantExpr(nc, context), n - d0 * nc};
+        auto kcExprs = SmallVector<AffineExpr, 2>{
+            getAffineConstantExpr(kc, context), k - d1 * kc};
+
+        // Pack the panel of B as nc / nr contiguous kc x nr slices.
+        auto packedBType =
+            MemRefType::get({nc / nr, kc, nr}, elementType);
+        Value packedB = rewriter.create<AllocOp>(loc, packedBType);
+        builder.emitLoopNest(
+            {jc, pc}, {zero, zero}, {kcExprs, ncExprs}, noSchedule,
+            [&](ArrayRef<Value> ivs) {
+              auto kk = builder.emitIndex(d1 * kc + d2, {jc, pc, ivs[0]});
+              auto col = builder.emitIndex(d0 * nc + d2, {jc, pc, ivs[1]});
+              auto loadedB = loadB(kk, col);
+              rewriter.create<StoreOp>(
+                  loc, loadedB, packedB,
+                  ArrayRef<Value>(
+                      {builder.emitIndex(d0.floorDiv(nr), ivs[1]), ivs[0],
+                       builder.emitIndex(d0 % nr, ivs[1])}));
+            });
+        // Pad the last slice with zeros.
+        if (N.constant < 0 || N.constant % nr != 0) {
+          auto tailUb = SmallVector<AffineExpr, 2>{
+              getAffineConstantExpr(nc, context),
+              (n - d0 * nc).ceilDiv(nr) * nr};
+          builder.emitLoopNest(
+              {jc, pc}, {zero, n - d0 * nc}, {kcExprs, tailUb}, noSchedule,
+              [&](ArrayRef<Value> ivs) {
+                auto zeroValue = emitConstantOp(rewriter, loc, elementType, 0);
+                rewriter.create<StoreOp>(
+                    loc, zeroValue, packedB,
+                    ArrayRef<Value>(
+                        {builder.emitIndex(d0.floorDiv(nr), ivs[1]), ivs[0],
+                         builder.emitIndex(d0 % nr, ivs[1])}));
+              });
+        }
+
+        // Iterate over the blocks of op(A) in parallel.
+        builder.emitLoopNest(
+            {}, {zero}, {{m.ceilDiv(mc)}},
+            [&](ArrayRef<Value> loops) {
+              rewriter.create<KrnlParallelOp>(loc, loops[0]);
+            },
+            [&](ArrayRef<Value> blockIVs) {
+              Value ic = blockIVs[0];
+              auto mcExprs = SmallVector<AffineExpr, 2>{
+                  getAffineConstantExpr(mc, context), m - d0 * mc};
+
+              // Pack the block of alpha * A as mc / mr contiguous
+              // kc x mr slices.
+              auto packedAType =
+                  MemRefType::get({mc / mr, kc, mr}, elementType);
+              Value packedA = rewriter.create<AllocOp>(loc, packedAType);
+              auto accumulatorType = MemRefType::get({mr, nr}, elementType);
+              Value accumulator =
+                  rewriter.create<KrnlAllocaOp>(loc, accumulatorType);
+              builder.emitLoopNest(
+                  {ic, pc}, {zero, zero}, {mcExprs, kcExprs}, noSchedule,
+                  [&](ArrayRef<Value> ivs) {
+                    auto row = builder.emitIndex(d0 * mc + d2, {ic, pc, ivs[0]});
+                    auto kk = builder.emitIndex(d1 * kc + d2, {ic, pc, ivs[1]});
+                    auto loadedA = loadA(row, kk);
+                    Value alphaA = loadedA;
+                    if (alpha)
+                      alphaA = emitMul(alpha, loadedA);
+                    rewriter.create<StoreOp>(
+                        loc, alphaA, packedA,
+                        ArrayRef<Value>(
+                            {builder.emitIndex(d0.floorDiv(mr), ivs[0]),
+                             ivs[1], builder.emitIndex(d0 % mr, ivs[0])}));
+                  });
+              // Pad the last slice with zeros.
+              if (M.constant < 0 || M.constant % mr != 0) {
+                auto tailUb = SmallVector<AffineExpr, 2>{
+                    getAffineConstantExpr(mc, context),
+                    (m - d0 * mc).ceilDiv(mr) * mr};
+                builder.emitLoopNest(
+                    {ic, pc}, {m - d0 * mc, zero}, {tailUb, kcExprs},
+                    noSchedule, [&](ArrayRef<Value> ivs) {
+                      auto zeroValue =
+                          emitConstantOp(rewriter, loc, elementType, 0);
+                      rewriter.create<StoreOp>(
+                          loc, zeroValue, packedA,
+                          ArrayRef<Value>(
+                              {builder.emitIndex(d0.floorDiv(mr), ivs[0]),
+                               ivs[1], builder.emitIndex(d0 % mr, ivs[0])}));
+                    });
+              }
+
+              // Iterate over the register tiles of the block of Y: jr over
+              // the slices of packed B, ir over the slices of packed A.
+              auto jrUb = SmallVector<AffineExpr, 2>{
+                  getAffineConstantExpr(nc / nr, context),
+                  (n - d0 * nc).ceilDiv(nr)};
+              auto irUb = SmallVector<AffineExpr, 2>{
+                  getAffineConstantExpr(mc / mr, context),
+                  (m - d1 * mc).ceilDiv(mr)};
+              builder.emitLoopNest(
+                  {jc, ic}, {zero, zero}, {jrUb, irUb}, noSchedule,
+                  [&](ArrayRef<Value> tileIVs) {
+                    Value jr = tileIVs[0], ir = tileIVs[1];
+                    auto mrExpr = getAffineConstantExpr(mr, context);
+                    auto nrExpr = getAffineConstantExpr(nr, context);
+
+                    // Clear the accumulators.
+                    builder.emitLoopNest(
+                        {}, {zero, zero}, {{mrExpr}, {nrExpr}}, vectorize,
+                        [&](ArrayRef<Value> ivs) {
+                          auto zeroValue =
+                              emitConstantOp(rewriter, loc, elementType, 0);
+                          rewriter.create<StoreOp>(loc, zeroValue, accumulator,
+                                                   ivs);
+                        });
+
+                    // Microkernel: accumulate the outer products of the
+                    // columns of the slice of packed A and of the rows of the
+                    // slice of packed B. The rows of the tile are unrolled
+                    // and its columns vectorized, so that the loads and
+                    // stores of the accumulators have constant indices and
+                    // are promoted to vector registers across the reduction
+                    // loop.
+                    builder.emitLoopNest(
+                        {pc}, {zero, zero, zero},
+                        {{getAffineConstantExpr(kc, context), k - d0 * kc},
+                         {mrExpr},
+                         {nrExpr}},
+                        [&](ArrayRef<Value> loops) {
+                          rewriter.create<KrnlUnrollJamOp>(loc, loops[1], mr);
+                          vectorize(loops);
+                        },
+                        [&](ArrayRef<Value> ivs) {
+                          auto loadedA = rewriter.create<LoadOp>(
+                              loc, packedA, ArrayRef<Value>({ir, ivs[0], ivs[1]}));
+                          auto loadedB = rewriter.create<LoadOp>(
+                              loc, packedB, ArrayRef<Value>({jr, ivs[0], ivs[2]}));
+                          auto loadedAcc = rewriter.create<LoadOp>(
+                              loc, accumulator, ArrayRef<Value>({ivs[1], ivs[2]}));
+                          auto AB = emitMul(loadedA, loadedB);
+                          auto accumulated = emitAdd(loadedAcc, AB);
+                          rewriter.create<StoreOp>(
+                              loc, accumulated, accumulator,
+                              ArrayRef<Value>({ivs[1], ivs[2]}));
+                        });
+
+                    // Add the valid part of the tile to Y.
+                    builder.emitLoopNest(
+                        {ic, ir, jc, jr}, {zero, zero},
+                        {{mrExpr, m - d0 * mc - d1 * mr},
+                         {nrExpr, n - d2 * nc - d3 * nr}},
+                        noSchedule, [&](ArrayRef<Value> ivs) {
+                          auto row = builder.emitIndex(
+                              d0 * mc + d1 * mr + d2, {ic, ir, ivs[0]});
+                          auto col = builder.emitIndex(
+                              d0 * nc + d1 * nr + d2, {jc, jr, ivs[1]});
+                          auto loadedAcc =
+                              rewriter.create<LoadOp>(loc, accumulator, ivs);
+                          accumulateY(row, col, loadedAcc);
+                        });
+                  });
+
+              rewriter.create<DeallocOp>(loc, packedA);
+            });
+
+        rewriter.create<DeallocOp>(loc, packedB);
+      });
+}
+
+// Accumulate alpha * op(A) * op(B) into Y, the matrices being the last two
+// dimensions of the memrefs.
+void emitPackedGemm(ConversionPatternRewriter &rewriter, Location loc,
+                    Value A, ArrayRef<Value> aIndices, bool isTransA, Value B,
+                    ArrayRef<Value> bIndices, bool isTransB, Value Y,
+                    ArrayRef<Value> yIndices, Value alpha) {
+  auto yType = Y.getType().cast<MemRefType>();
+  auto elementType = yType.getElementType();
+  auto aRank = A.getType().cast<MemRefType>().getRank();
+  auto bRank = B.getType().cast<MemRefType>().getRank();
+  auto yRank = yType.getRank();
+
+  // Sizes of the problem: Y is M x N, and K is the reduction dimension.
+  auto M = getGemmSize(rewriter, loc,
+                       {{Y, yRank - 2}, {A, aRank - (isTransA ? 1 : 2)}});
+  auto N = getGemmSize(rewriter, loc,
+                       {{Y, yRank - 1}, {B, bRank - (isTransB ? 2 : 1)}});
+  auto K = getGemmSize(rewriter, loc,
+                       {{A, aRank - (isTransA ? 2 : 1)},
+                        {B, bRank - (isTransB ? 1 : 2)}});
+
+  auto getIndices = [](ArrayRef<Value> prefix, Value row, Value column) {
+    SmallVector<Value, 4> indices(prefix.begin(), prefix.end());
+    indices.emplace_back(row);
+    indices.emplace_back(column);
+    return indices;
+  };
+  emitPackedGemm(
+      rewriter, loc, elementType, M, N, K,
+      [&](Value row, Value column) -> Value {
+        return rewriter.create<LoadOp>(
+            loc, A,
+            isTransA ? getIndices(aIndices, column, row)
+                     : getIndices(aIndices, row, column));
+      },
+      [&](Value row, Value column) -> Value {
+        return rewriter.create<LoadOp>(
+            loc, B,
+            isTransB ? getIndices(bIndices, column, row)
+                     : getIndices(bIndices, row, column));
+      },
+      [&](Value row, Value column, Value value) {
+        auto yIVs = getIndices(yIndices, row, column);
+        Value loadedY = rewriter.create<LoadOp>(loc, Y, yIVs);
+        Value sum;
+        if (elementType.isa<IntegerType>())
+          sum = rewriter.create<AddIOp>(loc, loadedY, value);
+        else
+          sum = rewriter.create<AddFOp>(loc, loadedY, value);
+        rewriter.create<StoreOp>(loc, sum, Y, yIVs);
+      },
+      alpha);
+}
+
 template <typename GemmOp>
 struct ONNXGemmOpLowering : public ConversionPattern {
   ONNXGemmOpLowering(MLIRContext *ctx)
@@ -67,57 +447,6 @@ struct ONNXGemmOpLowering : public ConversionPattern {
       }
     }
 
-    // Number of loops
-    auto memRefShape = memRefType.getShape();
-    int64_t numLoops = 3;
-
-    // Define loops.
-    std::vector<Value> originalLoops;
-    std::vector<Value> optimizedLoops;
-    Block *optimizationBlock =
-        defineLoops(rewriter, loc, originalLoops, optimizedLoops, numLoops);
-
-    // We have two Krnl loops:
-    // - Outer loop iterates over the output matrix dimensions, and
-    // - Reduction loop iterates over the reduction dimension.
-
-    // Outer loop
-    std::vector<Value> outerLoops, optimizedOuterLoops;
-    outerLoops.reserve(2);
-    optimizedOuterLoops.reserve(2);
-    for (int i = 0; i < 2; ++i) {
-      outerLoops.push_back(originalLoops[i]);
-      optimizedOuterLoops.push_back(optimizedLoops[i]);
-    }
-    KrnlIterateOperandPack outerPack(rewriter, outerLoops, optimizedOuterLoops);
-    // Induction variables for the outer loops
-    for (int i = 0; i < 2; ++i)
-      addDimensionToPack(rewriter, loc, outerPack, alloc, i);
-
-    // Reduction loop
-    std::vector<Value> reductionLoops, optimizedReductionLoops;
-    reductionLoops.reserve(1);
-    optimizedReductionLoops.reserve(1);
-    reductionLoops.push_back(originalLoops[2]);
-    optimizedReductionLoops.push_back(optimizedLoops[2]);
-    KrnlIterateOperandPack reductionPack(rewriter, reductionLoops,
-                                         optimizedReductionLoops);
-    // Induction variable for the reduction dimension
-    // Try to find and use a static value from A or B first.
-    // If it failed then use a dynamic value.
-    auto ATy = A.getType().cast<MemRefType>();
-    auto BTy = B.getType().cast<MemRefType>();
-    int64_t K_A_Idx = (isTransA) ? 0 : 1;
-    int64_t K_B_Idx = (isTransB) ? 1 : 0;
-    reductionPack.pushConstantBound(0);
-    if (ATy.getShape()[K_A_Idx] != -1)
-      reductionPack.pushConstantBound(ATy.getShape()[K_A_Idx]);
-    else if (BTy.getShape()[K_B_Idx] != -1)
-      reductionPack.pushConstantBound(BTy.getShape()[K_B_Idx]);
-    else
-      reductionPack.pushOperandBound(
-          rewriter.create<DimOp>(loc, B, K_B_Idx).getResult());
-
     // Get run-time dimension information for unknown dimensions used for
     // broadcasting.
     // GemmOp supports unidirectional broadcasting from C to A*B.
@@ -136,76 +465,41 @@ struct ONNXGemmOpLowering : public ConversionPattern {
       }
     }
 
-    auto outerIterateOp = rewriter.create<KrnlIterateOp>(loc, outerPack);
-
-    // Now perform the insertions into the body of the
-    // just generated instructions:
+    // Initialize the output with beta*C (unidirectional broadcasting), or
+    // with zeros when there is no bias.
+    std::vector<Value> originalLoops;
+    KrnlOptimizeLoopsOp optimizedLoopsOp;
+    KrnlIterateOp iterateOp;
+    emitKrnlLoopsAndIterationForOperand(rewriter, loc, alloc, originalLoops,
+                                        optimizedLoopsOp, iterateOp);
+    Block &optimizationBlock = optimizedLoopsOp.region().front();
+    Block &iterationBlock = iterateOp.bodyRegion().front();
 
-    // No optimization
-    rewriter.setInsertionPointToEnd(optimizationBlock);
+    rewriter.setInsertionPointToEnd(&optimizationBlock);
+    emitOutermostParallelLoop(rewriter, loc, originalLoops,
+                              memRefType.getShape());
+    emitInnermostVectorizedLoop(rewriter, loc, originalLoops, memRefType);
     rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
 
-    // Insert instructions inside the outer loop.
-    Block &outerIterationBlock = outerIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&outerIterationBlock);
-
-    // Induction variables
+    rewriter.setInsertionPointToStart(&iterationBlock);
     SmallVector<Value, 4> loopMNIVs;
-    for (auto arg : outerIterationBlock.getArguments()) {
+    for (auto arg : iterationBlock.getArguments())
       loopMNIVs.emplace_back(arg);
-    }
-
-    // Initialize the output of A*B
-    auto zero = emitConstantOp(rewriter, loc, memRefType.getElementType(), 0);
-    rewriter.create<StoreOp>(loc, zero, alloc, loopMNIVs);
-
-    // Compute A*B
-    auto matmulIterateOp = rewriter.create<KrnlIterateOp>(loc, reductionPack);
-
-    // Compute beta*C, and add up to alpha*A*B (unidirectional broadcasting)
-    auto loadedAB = rewriter.create<LoadOp>(loc, alloc, loopMNIVs);
-    auto alphaAB = rewriter.create<MulFOp>(loc, alpha, loadedAB);
     if (hasBias) {
       auto loopCIVs = getLoopIVsForBroadcasting(loc, rewriter, loopMNIVs, C,
                                                 broadcastedDimInfo);
       auto loadedC = rewriter.create<LoadOp>(loc, C, loopCIVs);
       auto betaC = rewriter.create<MulFOp>(loc, beta, loadedC);
-      auto Y = rewriter.create<AddFOp>(loc, alphaAB, betaC);
-      rewriter.create<StoreOp>(loc, Y, alloc, loopMNIVs);
-    } else {
-      rewriter.create<StoreOp>(loc, alphaAB, alloc, loopMNIVs);
-    }
-
-    // Insert instructions to do matrix multiplication: A*B
-    Block &matmulIterationBlock = matmulIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&matmulIterationBlock);
-
-    // Induction variables
-    SmallVector<Value, 4> loopKIVs, loopAIVs, loopBIVs;
-    for (auto arg : matmulIterationBlock.getArguments())
-      loopKIVs.emplace_back(arg);
-    if (isTransA) {
-      loopAIVs.emplace_back(loopKIVs[0]);
-      loopAIVs.emplace_back(loopMNIVs[0]);
-    } else {
-      loopAIVs.emplace_back(loopMNIVs[0]);
-      loopAIVs.emplace_back(loopKIVs[0]);
-    }
-    if (isTransB) {
-      loopBIVs.emplace_back(loopMNIVs[1]);
-      loopBIVs.emplace_back(loopKIVs[0]);
+      rewriter.create<StoreOp>(loc, betaC, alloc, loopMNIVs);
     } else {
-      loopBIVs.emplace_back(loopKIVs[0]);
-      loopBIVs.emplace_back(loopMNIVs[1]);
+      auto zero = emitConstantOp(rewriter, loc, memRefType.getElementType(), 0);
+      rewriter.create<StoreOp>(loc, zero, alloc, loopMNIVs);
     }
 
-    // Matmul computation
-    auto loadedA = rewriter.create<LoadOp>(loc, A, loopAIVs);
-    auto loadedB = rewriter.create<LoadOp>(loc, B, loopBIVs);
-    auto loadedY = rewriter.create<LoadOp>(loc, alloc, loopMNIVs);
-    auto AB = rewriter.create<MulFOp>(loc, loadedA, loadedB);
-    auto accumulated = rewriter.create<AddFOp>(loc, loadedY, AB);
-    rewriter.create<StoreOp>(loc, accumulated, alloc, loopMNIVs);
+    // Accumulate alpha*A*B into the output.
+    rewriter.setInsertionPointAfter(iterateOp);
+    emitPackedGemm(rewriter, loc, A, {}, isTransA, B, {}, isTransB, alloc, {},
+                   alpha);
 
     rewriter.replaceOp(op, alloc);
 
@@ -12,6 +12,160 @@
 
 using namespace mlir;
 
+// Lower the multiplication of N-D operands, N >= 2, as a batch of matrix
+// multiplications over the last two dimensions, the leading dimensions of
+// the operands being broadcast against each other:
+// (s1 x s2 x... x sK x M x K) MATMUL (t1 x t2 x... x tK x K x N)
+// =>
+// (u1 x u2 x... x uK x M x N)
+// Broadcast operands are not copied, their batch dimensions of size 1 being
+// indexed by 0. The batches are computed in parallel, each by the blocked
+// GEMM kernel.
+Value lowerBatchedMatMul(Operation *op, Value A, Value B,
+                         ConversionPatternRewriter &rewriter) {
+  auto loc = op->getLoc();
+  auto memRefType = convertToMemRefType(*op->result_type_begin());
+  auto elementType = memRefType.getElementType();
+  auto memRefShape = memRefType.getShape();
+  int64_t rank = memRefShape.size();
+  int64_t batchRank = rank - 2;
+  auto aRank = A.getType().cast<MemRefType>().getRank();
+  auto bRank = B.getType().cast<MemRefType>().getRank();
+
+  // Insert an allocation and deallocation for the result of this operation.
+  // A broadcast batch dimension unknown at compile time is the maximum of the
+  // dimensions of the operands.
+  Value alloc;
+  bool insertDealloc = checkInsertDealloc(op);
+  if (hasAllConstantDimensions(memRefType))
+    alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+  else {
+    SmallVector<Value, 4> allocOperands;
+    for (int i = 0; i < batchRank; ++i) {
+      if (memRefShape[i] >= 0)
+        continue;
+      Value maxDim = nullptr;
+      for (auto operand : {A, B}) {
+        auto operandShape = operand.getType().cast<MemRefType>().getShape();
+        int operandDimIdx = i - (rank - (int64_t)operandShape.size());
+        if (operandDimIdx < 0 || operandShape[operandDimIdx] == 1)
+          continue;
+        Value operandDim = rewriter.create<DimOp>(loc, operand, operandDimIdx);
+        if (maxDim) {
+          auto maxCondition = rewriter.create<CmpIOp>(
+              loc, CmpIPredicate::sgt, operandDim, maxDim);
+          maxDim =
+              rewriter.create<SelectOp>(loc, maxCondition, operandDim, maxDim);
+        } else {
+          maxDim = operandDim;
+        }
+      }
+      // Dimensions of size 1 in both operands broadcast to 1.
+      if (!maxDim)
+        maxDim = rewriter.create<ConstantIndexOp>(loc, 1);
+      allocOperands.emplace_back(maxDim);
+    }
+    if (memRefShape[rank - 2] < 0)
+      allocOperands.emplace_back(rewriter.create<DimOp>(loc, A, aRank - 2));
+    if (memRefShape[rank - 1] < 0)
+      allocOperands.emplace_back(rewriter.create<DimOp>(loc, B, bRank - 1));
+    alloc = rewriter.create<AllocOp>(loc, memRefType, allocOperands);
+    if (insertDealloc) {
+      auto *parentBlock = alloc.getDefiningOp()->getBlock();
+      auto dealloc = rewriter.create<DeallocOp>(loc, alloc);
+      dealloc.getOperation()->moveBefore(&parentBlock->back());
+    }
+  }
+
+  // Get run-time dimension information for the batch dimensions unknown at
+  // compile time, which are broadcast when their size is 1.
+  std::map<int, Value> aBroadcastedDims, bBroadcastedDims;
+  for (auto operandDims : {std::make_pair(A, &aBroadcastedDims),
+                           std::make_pair(B, &bBroadcastedDims)}) {
+    auto operand = operandDims.first;
+    auto operandShape = operand.getType().cast<MemRefType>().getShape();
+    for (int i = 0; i < (int)operandShape.size() - 2; ++i) {
+      if (operandShape[i] >= 0)
+        continue;
+      auto dim = rewriter.create<DimOp>(loc, operand, i);
+      auto one = rewriter.create<ConstantIndexOp>(loc, 1);
+      auto isBroadcasted =
+          rewriter.create<CmpIOp>(loc, CmpIPredicate::eq, dim, one);
+      operandDims.second->insert(std::make_pair(i, isBroadcasted));
+    }
+  }
+
+  // Iterate over the batches in parallel.
+  SmallVector<Value, 4> batchIVs;
+  if (batchRank > 0) {
+    std::vector<Value> batchLoops, optimizedBatchLoops;
+    Block *optimizationBlock = defineLoops(rewriter, loc, batchLoops,
+                                           optimizedBatchLoops, batchRank);
+    KrnlIterateOperandPack batchPack(rewriter, batchLoops,
+                                     optimizedBatchLoops);
+    for (int i = 0; i < batchRank; ++i)
+      addDimensionToPack(rewriter, loc, batchPack, alloc, i);
+    auto batchIterateOp = rewriter.create<KrnlIterateOp>(loc, batchPack);
+
+    rewriter.setInsertionPointToEnd(optimizationBlock);
+    emitOutermostParallelLoop(rewriter, loc, batchLoops,
+                              memRefShape.drop_back(2));
+    rewriter.create<KrnlReturnLoopsOp>(loc, batchLoops);
+
+    Block &batchIterationBlock = batchIterateOp.bodyRegion().front();
+    rewriter.setInsertionPointToStart(&batchIterationBlock);
+    for (auto arg : batchIterationBlock.getArguments())
+      batchIVs.emplace_back(arg);
+  }
+
+  // Get the batch indices of the operands. The last two induction variables
+  // given to getLoopIVsForBroadcasting only stand for the matrix dimensions.
+  SmallVector<Value, 4> aBatchIVs, bBatchIVs;
+  if (batchRank > 0) {
+    SmallVector<Value, 4> loopIVs(batchIVs.begin(), batchIVs.end());
+    Value zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+    loopIVs.append(2, zeroIndex);
+    auto aIVs =
+        getLoopIVsForBroadcasting(loc, rewriter, loopIVs, A, aBroadcastedDims);
+    auto bIVs =
+        getLoopIVsForBroadcasting(loc, rewriter, loopIVs, B, bBroadcastedDims);
+    aBatchIVs.append(aIVs.begin(), aIVs.end() - 2);
+    bBatchIVs.append(bIVs.begin(), bIVs.end() - 2);
+  }
+
+  // Fill the output matrix with value 0.
+  std::vector<Value> fillLoops, optimizedFillLoops;
+  Block *fillOptimizationBlock =
+      defineLoops(rewriter, loc, fillLoops, optimizedFillLoops, 2);
+  KrnlIterateOperandPack fillPack(rewriter, fillLoops, optimizedFillLoops);
+  addDimensionToPack(rewriter, loc, fillPack, alloc, rank - 2);
+  addDimensionToPack(rewriter, loc, fillPack, alloc, rank - 1);
+  auto fillIterateOp = rewriter.create<KrnlIterateOp>(loc, fillPack);
+  {
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToEnd(fillOptimizationBlock);
+    if (batchRank == 0)
+      emitOutermostParallelLoop(rewriter, loc, fillLoops, memRefShape);
+    emitInnermostVectorizedLoop(rewriter, loc, fillLoops, memRefType);
+    rewriter.create<KrnlReturnLoopsOp>(loc, fillLoops);
+
+    Block &fillIterationBlock = fillIterateOp.bodyRegion().front();
+    rewriter.setInsertionPointToStart(&fillIterationBlock);
+    SmallVector<Value, 4> loopBatchMNIVs(batchIVs.begin(), batchIVs.end());
+    for (auto arg : fillIterationBlock.getArguments())
+      loopBatchMNIVs.emplace_back(arg);
+    auto zero = emitConstantOp(rewriter, loc, elementType, 0);
+    rewriter.create<StoreOp>(loc, zero, alloc, loopBatchMNIVs);
+  }
+
+  // Accumulate the product of the matrices of the batch into the output.
+  emitPackedGemm(rewriter, loc, A, aBatchIVs, /*isTransA=*/false, B,
+                 bBatchIVs, /*isTransB=*/false, alloc, batchIVs,
+                 /*alpha=*/nullptr);
+
+  return alloc;
+}
+
 struct ONNXMatMulOpLowering : public ConversionPattern {
   ONNXMatMulOpLowering(MLIRContext *ctx)
       : ConversionPattern(mlir::ONNXMatMulOp::getOperationName(), 1, ctx) {}
@@ -30,6 +184,10 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
     // - Both arguments are N-D, N >= 2
     // - Either argument is 1-D, the other is N-D, N >= 2
     // - Both arguments are 1-D
+    if (AShape.size() >= 2 && BShape.size() >= 2) {
+      rewriter.replaceOp(op, lowerBatchedMatMul(op, A, B, rewriter));
+      return matchSuccess();
+    }
 
     // Result type
     auto memRefType = convertToMemRefType(*op->result_type_begin());
@@ -46,28 +204,7 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
     else {
       SmallVector<Value, 4> allocOperands;
-      if (AShape.size() >= 2 && BShape.size() >= 2) {
-        // Both arguments are N-D, N >= 2
-        // (s1 x s2 x... x sK x M x K) MATMUL (K x N)
-        // =>
-        // (s1 x s2 x... x sK x M x N)
-        for (int i = 0; i < memRefShape.size() - 2; ++i) {
-          if (memRefShape[i] < 0) {
-            if ((AShape.size() == 2) && (BShape.size() > 2))
-              allocOperands.emplace_back(rewriter.create<DimOp>(loc, B, i));
-            else if ((AShape.size() > 2) && (BShape.size() == 2))
-              allocOperands.emplace_back(rewriter.create<DimOp>(loc, A, i));
-          }
-        }
-        if (memRefShape[memRefShape.size() - 2] < 0) {
-          auto dim = rewriter.create<DimOp>(loc, A, memRefShape.size() - 2);
-          allocOperands.emplace_back(dim);
-        }
-        if (memRefShape[memRefShape.size() - 1] < 0) {
-          auto dim = rewriter.create<DimOp>(loc, B, memRefShape.size() - 1);
-          allocOperands.emplace_back(dim);
-        }
-      } else if (AShape.size() == 1 && BShape.size() >= 2) {
+      if (AShape.size() == 1 && BShape.size() >= 2) {
         // Either argument is 1-D
         // K MATMUL (s1 x s2 x... x sK x K x N)
         // =>
@@ -111,8 +248,7 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
     }
 
     if (AShape.size() >= 2 || BShape.size() >= 2) {
-      // Cases 1 and 2:
-      // - Both arguments are N-D, N >= 2
+      // Case 2:
       // - Either argument is 1-D, the other is N-D, N >= 2
 
       // Define loops for batch dimensions.
@@ -123,12 +259,9 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
 
       // Outer KrnlIterateOp
       SmallVector<Value, 4> loopBatchIVs;
-      bool hasBatchLoop = false;
       if (AShape.size() > 2 || BShape.size() > 2) {
         SmallVector<int, 4> batchAxes;
-        int matmulResultDims =
-            ((AShape.size() == 1 || BShape.size() == 1)) ? 1 : 2;
-        for (int i = 0; i < memRefShape.size() - matmulResultDims; ++i)
+        for (int i = 0; i < memRefShape.size() - 1; ++i)
           batchAxes.emplace_back(i);
 
         std::vector<Value> outerLoops, optimizedOuterLoops;
@@ -145,10 +278,6 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
         }
         auto outerIterateOp = rewriter.create<KrnlIterateOp>(loc, outerPack);
 
-        // No optimization
-        rewriter.setInsertionPointToEnd(optimizationBlock);
-        rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
-
         // Insert instructions into the outer KrnlIterateOp.
         Block &outerIterationBlock = outerIterateOp.bodyRegion().front();
         rewriter.setInsertionPointToStart(&outerIterationBlock);
@@ -157,50 +286,27 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
         for (auto arg : outerIterationBlock.getArguments()) {
           loopBatchIVs.emplace_back(arg);
         }
-
-        hasBatchLoop = true;
       }
 
       // Now, we define loops for matrix multiplication.
 
       // Create a KrnlIterateOp for matrix multiplication.
-      KrnlIterateOp matmulIterateOp;
+      // 1-D x 2-D, and vice versa. Result has one dimension.
       std::vector<Value> matmulLoops, optimizedMatmulLoops;
-      if (AShape.size() >= 2 && BShape.size() >= 2) {
-        // 2-D x 2-D. Result has two dimensions.
-        matmulLoops.reserve(2);
-        optimizedMatmulLoops.reserve(2);
-        for (int i = 2; i > 0; --i) {
-          matmulLoops.emplace_back(originalLoops[memRefShape.size() - i]);
-          optimizedMatmulLoops.emplace_back(
-              optimizedLoops[memRefShape.size() - i]);
-        }
-        KrnlIterateOperandPack matmulPack(rewriter, matmulLoops,
-                                          optimizedMatmulLoops);
-        for (int i = 2; i > 0; --i) {
-          addDimensionToPack(rewriter, loc, matmulPack, alloc,
-                             memRefShape.size() - i);
-        }
-        matmulIterateOp = rewriter.create<KrnlIterateOp>(loc, matmulPack);
-      } else {
-        // 1-D x 2-D, and vice versa. Result has one dimension.
-        matmulLoops.reserve(1);
-        optimizedMatmulLoops.reserve(1);
-        matmulLoops.emplace_back(originalLoops[memRefShape.size() - 1]);
-        optimizedMatmulLoops.emplace_back(
-            optimizedLoops[memRefShape.size() - 1]);
-        KrnlIterateOperandPack matmulPack(rewriter, matmulLoops,
-                                          optimizedMatmulLoops);
-        addDimensionToPack(rewriter, loc, matmulPack, alloc,
-                           memRefShape.size() - 1);
-        matmulIterateOp = rewriter.create<KrnlIterateOp>(loc, matmulPack);
-      }
-
-      if (!hasBatchLoop) {
-        // No optimization
-        rewriter.setInsertionPointToEnd(optimizationBlock);
-        rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
-      }
+      matmulLoops.emplace_back(originalLoops[memRefShape.size() - 1]);
+      optimizedMatmulLoops.emplace_back(optimizedLoops[memRefShape.size() - 1]);
+      KrnlIterateOperandPack matmulPack(rewriter, matmulLoops,
+                                        optimizedMatmulLoops);
+      addDimensionToPack(rewriter, loc, matmulPack, alloc,
+                         memRefShape.size() - 1);
+      auto matmulIterateOp = rewriter.create<KrnlIterateOp>(loc, matmulPack);
+
+      // Unroll and jam the innermost loop over the output, so that the
+      // reduction loop accumulates into several output elements at once.
+      rewriter.setInsertionPointToEnd(optimizationBlock);
+      rewriter.create<KrnlUnrollJamOp>(
+          loc, originalLoops[memRefShape.size() - 1], accumulatorUnrollFactor);
+      rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
 
       // Insert instructions into the matmul KrnlIterateOp.
       Block &matmulIterationBlock = matmulIterateOp.bodyRegion().front();
@@ -102,6 +102,355 @@ Value mapToLowerScalarOp<ONNXReduceMinOp>(Operation *op,
   }
 }
 
+namespace {
+
+// Reductions over the trailing dimensions of the input reduce contiguous runs
+// of elements. Each run is accumulated into one partial result per vector
+// lane along the innermost dimension, so that the accumulators stay in
+// vector registers, and the lanes are combined with a fixed tree once the run
+// is done. Runs are reduced in parallel when there are enough of them.
+// Otherwise, long runs are split into slices reduced in parallel into
+// partial results, which are then combined in order. The slices only depend
+// on the shape of the input, so that the order of the operations, hence the
+// result, does not depend on the number of threads.
+
+// Runs of at least minParallelReductionSize elements are split across
+// threads when there are fewer than minParallelReductionRuns of them.
+const int64_t minParallelReductionSize = 1 << 15;
+const int64_t minParallelReductionRuns = 16;
+
+// Number of elements of the slices of a run split along its innermost
+// dimension, a multiple of the vector width.
+const int64_t reductionChunkSize = 4096;
+
+// Size of a loop, known at compile time or computed at run time when
+// negative.
+using LoopSize = std::pair<int64_t, Value>;
+
+template <typename ONNXReductionOp>
+class RunReductionEmitter {
+public:
+  RunReductionEmitter(ConversionPatternRewriter &rewriter, Location loc,
+                      Operation *op, Value input)
+      : rewriter(rewriter), loc(loc), op(op), input(input) {
+    auto memRefType = input.getType().cast<MemRefType>();
+    shape = memRefType.getShape();
+    rank = shape.size();
+    elementType = memRefType.getElementType();
+    vectorWidth = std::max<int64_t>(
+        1, targetVectorSizeInBytes / getMemRefEltSizeInBytes(memRefType));
+  }
+
+  // Reduce the runs over the dimensions [firstReducedDim, rank) of the input
+  // into `alloc`, `outInDimMap` mapping the dimensions of the result to the
+  // ones of the input they are kept from. When some of the leading dimensions
+  // are reduced too, the runs are accumulated into `alloc`, which must have
+  // been initialized to the identity of the reduction.
+  void emit(Value alloc, int64_t firstReducedDim, ArrayRef<int64_t> axes,
+            std::map<int64_t, int64_t> &outInDimMap) {
+    auto isReduced = [&](int64_t dim) { return llvm::is_contained(axes, dim); };
+    bool isAccumulated = false;
+    int64_t numRuns = 1, runSize = 1;
+    for (int64_t i = 0; i < rank; ++i) {
+      if (i < firstReducedDim && isReduced(i)) {
+        isAccumulated = true;
+        continue;
+      }
+      int64_t &size = i < firstReducedDim ? numRuns : runSize;
+      size = (size < 0 || shape[i] < 0) ? -1 : size * shape[i];
+    }
+    // Dimension along which runs are split across threads, the first
+    // reduced one not known to be 1.
+    int64_t splitDim = -1;
+    if (numRuns >= 0 && numRuns < minParallelReductionRuns &&
+        (runSize < 0 || runSize >= minParallelReductionSize)) {
+      for (int64_t i = firstReducedDim; i < rank && splitDim < 0; ++i)
+        if (shape[i] != 1)
+          splitDim = i;
+    }
+
+    identity = getIdentityValue<ONNXReductionOp>(rewriter, loc, elementType);
+    zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+
+    // Iterate over the runs, in parallel unless the runs themselves are.
+    // Runs accumulated into the same element of the result are iterated over
+    // sequentially.
+    SmallVector<Value, 4> runIndices;
+    if (firstReducedDim > 0) {
+      BuildKrnlLoop runLoops(rewriter, loc, firstReducedDim);
+      runLoops.createDefineAndOptimizeOp();
+      for (int64_t i = 0; i < firstReducedDim; ++i)
+        runLoops.pushBounds(0, input, i);
+      for (int64_t i = 0; i < firstReducedDim && splitDim < 0; ++i) {
+        if (shape[i] != 1) {
+          if (!isReduced(i))
+            runLoops.parallel(i);
+          break;
+        }
+      }
+      runLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(runLoops.getIterateBlock());
+      for (auto arg : runLoops.getIterateBlock()->getArguments())
+        runIndices.emplace_back(arg);
+    }
+
+    SmallVector<Value, 1> sizeOperands;
+    auto innermostSize = getInnermostSizeExpr(sizeOperands);
+    // The lanes are a scratch buffer on the stack, private to the run.
+    auto lanesType = MemRefType::get({vectorWidth}, elementType);
+    Value lanes = rewriter.create<KrnlAllocaOp>(loc, lanesType);
+    if (splitDim < 0) {
+      // Accumulate the run into the lanes.
+      emitLanesInit(lanes, {});
+      emitLanesAccumulate(lanes, {}, runIndices, firstReducedDim,
+                          getAffineConstantExpr(0, rewriter.getContext()),
+                          innermostSize, sizeOperands);
+    } else {
+      // Split the run into slices along `splitDim`: one slice per index
+      // along it, or chunks of reductionChunkSize elements if it is the
+      // innermost dimension. The dimensions preceding it within the run are
+      // of size 1.
+      auto d0 = getAffineDimExpr(0, rewriter.getContext());
+      bool isInnermostSplit = splitDim == rank - 1;
+      SmallVector<Value, 4> slicePrefix(runIndices.begin(), runIndices.end());
+      slicePrefix.append(splitDim - firstReducedDim, zeroIndex);
+      LoopSize numSlices = getDimSize(splitDim);
+      if (isInnermostSplit)
+        numSlices =
+            getSize(innermostSize.floorDiv(reductionChunkSize), sizeOperands);
+
+      // 1. Accumulate the slices into partial results, in parallel.
+      SmallVector<Value, 1> partialsOperands;
+      if (numSlices.first < 0)
+        partialsOperands.emplace_back(numSlices.second);
+      Value partials = rewriter.create<AllocOp>(
+          loc, MemRefType::get({numSlices.first, vectorWidth}, elementType),
+          partialsOperands);
+      if (numSlices.first != 0) {
+        emitLoopNest({numSlices}, /*isParallel=*/true,
+                     /*isVectorized=*/false, [&](ArrayRef<Value> ivs) {
+                       emitLanesInit(partials, ivs[0]);
+                       if (isInnermostSplit) {
+                         emitLanesAccumulate(
+                             partials, ivs[0], slicePrefix, splitDim,
+                             d0 * reductionChunkSize,
+                             getAffineConstantExpr(reductionChunkSize,
+                                                   rewriter.getContext()),
+                             ivs[0]);
+                       } else {
+                         SmallVector<Value, 4> inputPrefix(slicePrefix);
+                         inputPrefix.emplace_back(ivs[0]);
+                         emitLanesAccumulate(
+                             partials, ivs[0], inputPrefix, splitDim + 1,
+                             getAffineConstantExpr(0, rewriter.getContext()),
+                             innermostSize, sizeOperands);
+                       }
+                     });
+      }
+
+      // 2. Combine the partial results in order.
+      emitLanesInit(lanes, {});
+      if (numSlices.first != 0) {
+        emitLoopNest({numSlices, {vectorWidth, nullptr}},
+                     /*isParallel=*/false, vectorWidth > 1,
+                     [&](ArrayRef<Value> ivs) {
+                       emitAccumulate(lanes, ivs[1],
+                                      rewriter.create<LoadOp>(loc, partials,
+                                                              ivs));
+                     });
+      }
+      rewriter.create<DeallocOp>(loc, partials);
+      // The elements following the last chunk are accumulated last.
+      if (isInnermostSplit) {
+        auto chunksEnd =
+            innermostSize.floorDiv(reductionChunkSize) * reductionChunkSize;
+        emitLanesAccumulate(lanes, {}, slicePrefix, splitDim, chunksEnd,
+                            innermostSize - chunksEnd, sizeOperands);
+      }
+    }
+
+    // Combine the lanes into the result.
+    Value result = emitLanesCombine(lanes);
+    SmallVector<Value, 4> outIndices;
+    int64_t outRank = alloc.getType().cast<MemRefType>().getRank();
+    for (int64_t i = 0; i < outRank; ++i) {
+      auto inDim = outInDimMap.find(i);
+      outIndices.emplace_back(
+          inDim != outInDimMap.end() ? runIndices[inDim->second] : zeroIndex);
+    }
+    if (isAccumulated) {
+      Value accumulated = rewriter.create<LoadOp>(loc, alloc, outIndices);
+      result = mapToLowerScalarOp<ONNXReductionOp>(
+          op, elementType, {accumulated, result}, rewriter);
+    }
+    rewriter.create<StoreOp>(loc, result, alloc, outIndices);
+  }
+
+private:
+  LoopSize getDimSize(int64_t dim) {
+    if (shape[dim] >= 0)
+      return {shape[dim], nullptr};
+    return {-1, rewriter.create<DimOp>(loc, input, dim)};
+  }
+
+  // Get the size of the innermost dimension as an affine expression of
+  // `operands`.
+  AffineExpr getInnermostSizeExpr(SmallVectorImpl<Value> &operands) {
+    if (shape.back() >= 0)
+      return getAffineConstantExpr(shape.back(), rewriter.getContext());
+    operands.emplace_back(rewriter.create<DimOp>(loc, input, rank - 1));
+    return getAffineDimExpr(operands.size() - 1, rewriter.getContext());
+  }
+
+  Value apply(AffineExpr expr, ArrayRef<Value> operands) {
+    return rewriter.create<AffineApplyOp>(
+        loc, AffineMap::get(operands.size(), 0, expr), operands);
+  }
+
+  LoopSize getSize(AffineExpr expr, ArrayRef<Value> operands) {
+    if (auto constantExpr = expr.dyn_cast<AffineConstantExpr>())
+      return {constantExpr.getValue(), nullptr};
+    return {-1, apply(expr, operands)};
+  }
+
+  // Emit a loop nest of the given sizes, the outermost loop being parallel
+  // and the innermost one vectorized if requested, and its body by
+  // `emitBody` given the induction variables. The insertion point is left
+  // after the loop nest.
+  void emitLoopNest(ArrayRef<LoopSize> sizes, bool isParallel,
+                    bool isVectorized,
+                    function_ref<void(ArrayRef<Value>)> emitBody) {
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    BuildKrnlLoop loops(rewriter, loc, sizes.size());
+    loops.createDefineAndOptimizeOp();
+    for (auto size : sizes) {
+      if (size.first >= 0)
+        loops.pushBounds(0, size.first);
+      else
+        loops.pushBounds(0, size.second);
+    }
+    if (isParallel)
+      loops.parallel(0);
+    if (isVectorized)
+      loops.vectorize(sizes.size() - 1, vectorWidth);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    SmallVector<Value, 4> ivs(loops.getIterateBlock()->getArguments().begin(),
+                              loops.getIterateBlock()->getArguments().end());
+    emitBody(ivs);
+  }
+
+  // Accumulate `next` into the lane of `lanes` at `laneIndices`.
+  void emitAccumulate(Value lanes, ArrayRef<Value> laneIndices, Value next) {
+    Value accumulated = rewriter.create<LoadOp>(loc, lanes, laneIndices);
+    accumulated = mapToLowerScalarOp<ONNXReductionOp>(
+        op, elementType, {accumulated, next}, rewriter);
+    rewriter.create<StoreOp>(loc, accumulated, lanes, laneIndices);
+  }
+
+  // Initialize the lanes at `prefix` to the identity of the reduction.
+  void emitLanesInit(Value lanes, ArrayRef<Value> prefix) {
+    emitLoopNest({{vectorWidth, nullptr}}, /*isParallel=*/false,
+                 vectorWidth > 1, [&](ArrayRef<Value> ivs) {
+                   SmallVector<Value, 2> indices(prefix.begin(), prefix.end());
+                   indices.emplace_back(ivs[0]);
+                   rewriter.create<StoreOp>(loc, identity, lanes, indices);
+                 });
+  }
+
+  // Accumulate the elements [start, start + size) of the innermost dimension
+  // of the input, `start` and `size` being affine functions of `operands`,
+  // into the lanes at `lanesPrefix`. The dimensions of the input preceding
+  // `firstDim` are indexed by `inputPrefix`, and the following ones,
+  // innermost excepted, are iterated over. The whole vectors of elements are
+  // accumulated in vectorized loops, and the remaining ones into the first
+  // lanes.
+  void emitLanesAccumulate(Value lanes, ArrayRef<Value> lanesPrefix,
+                           ArrayRef<Value> inputPrefix, int64_t firstDim,
+                           AffineExpr start, AffineExpr size,
+                           ArrayRef<Value> operands) {
+    auto context = rewriter.getContext();
+    int64_t numOperands = operands.size();
+    auto dn = getAffineDimExpr(numOperands, context);
+    auto dn1 = getAffineDimExpr(numOperands + 1, context);
+    SmallVector<LoopSize, 4> outerSizes;
+    for (int64_t i = firstDim; i < rank - 1; ++i)
+      outerSizes.emplace_back(getDimSize(i));
+    int64_t numOuterLoops = outerSizes.size();
+
+    // Emit the loop nest over the outer dimensions and the given innermost
+    // loops, accumulating the element at `index`, a function of `operands`
+    // and of the innermost induction variables, into the lane `lane` of
+    // them.
+    auto emitRunLoopNest = [&](ArrayRef<LoopSize> innermostSizes,
+                               bool isVectorized, AffineExpr index,
+                               int64_t lane) {
+      SmallVector<LoopSize, 4> sizes(outerSizes.begin(), outerSizes.end());
+      sizes.append(innermostSizes.begin(), innermostSizes.end());
+      emitLoopNest(sizes, /*isParallel=*/false, isVectorized,
+                   [&](ArrayRef<Value> ivs) {
+                     SmallVector<Value, 4> indices(inputPrefix.begin(),
+                                                   inputPrefix.end());
+                     indices.append(ivs.begin(), ivs.begin() + numOuterLoops);
+                     SmallVector<Value, 4> indexOperands(operands.begin(),
+                                                         operands.end());
+                     indexOperands.append(ivs.begin() + numOuterLoops,
+                                          ivs.end());
+                     indices.emplace_back(apply(index, indexOperands));
+                     SmallVector<Value, 2> laneIndices(lanesPrefix.begin(),
+                                                       lanesPrefix.end());
+                     laneIndices.emplace_back(ivs[numOuterLoops + lane]);
+                     emitAccumulate(lanes, laneIndices,
+                                    rewriter.create<LoadOp>(loc, input,
+                                                            indices));
+                   });
+    };
+
+    LoopSize numBlocks = getSize(size.floorDiv(vectorWidth), operands);
+    LoopSize tailSize = getSize(size % vectorWidth, operands);
+    if (numBlocks.first != 0)
+      emitRunLoopNest({numBlocks, {vectorWidth, nullptr}}, vectorWidth > 1,
+                      start + dn * vectorWidth + dn1, 1);
+    if (tailSize.first != 0)
+      emitRunLoopNest({tailSize}, /*isVectorized=*/false,
+                      start + size.floorDiv(vectorWidth) * vectorWidth + dn,
+                      0);
+  }
+
+  // Combine the lanes with a fixed tree, each level combining the lanes of
+  // the previous one pairwise.
+  Value emitLanesCombine(Value lanes) {
+    SmallVector<Value, 16> values;
+    for (int64_t l = 0; l < vectorWidth; ++l) {
+      Value lane = rewriter.create<ConstantIndexOp>(loc, l);
+      values.emplace_back(rewriter.create<LoadOp>(loc, lanes, lane));
+    }
+    while (values.size() > 1) {
+      SmallVector<Value, 16> combined;
+      for (int64_t l = 0; l + 1 < values.size(); l += 2)
+        combined.emplace_back(mapToLowerScalarOp<ONNXReductionOp>(
+            op, elementType, {values[l], values[l + 1]}, rewriter));
+      if (values.size() % 2 != 0)
+        combined.emplace_back(values.back());
+      values = combined;
+    }
+    return values[0];
+  }
+
+  ConversionPatternRewriter &rewriter;
+  Location loc;
+  Operation *op;
+  Value input;
+  ArrayRef<int64_t> shape;
+  int64_t rank;
+  Type elementType;
+  int64_t vectorWidth;
+  Value identity;
+  Value zeroIndex;
+};
+
+} // namespace
+
 template <typename ONNXReductionOp>
 struct ONNXReductionOpLowering : public ConversionPattern {
   ONNXReductionOpLowering(MLIRContext *ctx)
@@ -185,45 +534,71 @@ struct ONNXReductionOpLowering : public ConversionPattern {
       }
     }
 
-    // There are two Krnl loops:
-    // - One to initialize the result memref, and
-    // - One to do reduction
+    // The loops follow the layout of the input, so that the innermost loop
+    // walks its contiguous dimension. When it is reduced, the trailing
+    // reduced dimensions of the input form contiguous runs of elements
+    // reduced into vector lanes, see RunReductionEmitter. Otherwise, the
+    // elements are accumulated into the row of the result along the
+    // innermost dimension, which is vectorized.
+    auto isReduced = [&](int64_t dim) { return llvm::is_contained(axes, dim); };
+    int64_t firstReducedDim = inRank;
+    while (firstReducedDim > 0 && isReduced(firstReducedDim - 1))
+      --firstReducedDim;
+    bool isRunReduction = firstReducedDim < inRank &&
+                          elementOutType.isIntOrFloat() &&
+                          elementOutType.getIntOrFloatBitWidth() % 8 == 0;
+    bool isAccumulated = llvm::any_of(
+        axes, [&](int64_t axis) { return axis < firstReducedDim; });
 
-    // Define loops to initialize the result.
-    std::vector<Value> originalLoopsInit;
-    std::vector<Value> optimizedLoopsInit;
-    Block *optimizationBlockInit = defineLoops(rewriter, loc, originalLoopsInit,
-            optimizedLoopsInit, outRank);
+    // Initialize the result, unless the reduction of each run is stored
+    // into it.
+    if (!isRunReduction || isAccumulated) {
+      // Define loops to initialize the result.
+      std::vector<Value> originalLoopsInit;
+      std::vector<Value> optimizedLoopsInit;
+      Block *optimizationBlockInit = defineLoops(
+          rewriter, loc, originalLoopsInit, optimizedLoopsInit, outRank);
 
-    // Iteration information
-    KrnlIterateOperandPack packInit(rewriter, originalLoopsInit,
-        optimizedLoopsInit);
-    for (decltype(outRank) i = 0; i < outRank; ++i) {
-      addDimensionToPack(rewriter, loc, packInit, alloc, i);
-    }
-    auto iterateOpInit = rewriter.create<KrnlIterateOp>(loc, packInit);
-    Block &iterationBlockInit = iterateOpInit.bodyRegion().front();
+      // Iteration information
+      KrnlIterateOperandPack packInit(rewriter, originalLoopsInit,
+          optimizedLoopsInit);
+      for (decltype(outRank) i = 0; i < outRank; ++i) {
+        addDimensionToPack(rewriter, loc, packInit, alloc, i);
+      }
+      auto iterateOpInit = rewriter.create<KrnlIterateOp>(loc, packInit);
+      Block &iterationBlockInit = iterateOpInit.bodyRegion().front();
 
-    // Perform the insertions into the body of the initialization loop.
-    // No optimization
-    rewriter.setInsertionPointToEnd(optimizationBlockInit);
-    rewriter.create<KrnlReturnLoopsOp>(loc, originalLoopsInit);
+      // Perform the insertions into the body of the initialization loop.
+      rewriter.setInsertionPointToEnd(optimizationBlockInit);
+      emitOutermostParallelLoop(rewriter, loc, originalLoopsInit,
+                                memRefOutShape);
+      emitInnermostVectorizedLoop(rewriter, loc, originalLoopsInit,
+                                  memRefOutType);
+      rewriter.create<KrnlReturnLoopsOp>(loc, originalLoopsInit);
 
-    // Insert instructions inside the KernelIterateOp body.
-    rewriter.setInsertionPointToStart(&iterationBlockInit);
+      // Insert instructions inside the KernelIterateOp body.
+      rewriter.setInsertionPointToStart(&iterationBlockInit);
 
-    // Handle the operation:
-    SmallVector<Value, 4> loopIVs;
-    for (auto arg : iterationBlockInit.getArguments()) {
-      loopIVs.push_back(arg);
+      // Handle the operation:
+      SmallVector<Value, 4> loopIVs;
+      for (auto arg : iterationBlockInit.getArguments()) {
+        loopIVs.push_back(arg);
+      }
+
+      Value identity =
+          getIdentityValue<ONNXReductionOp>(rewriter, loc, elementOutType);
+      rewriter.create<StoreOp>(loc, identity, alloc, loopIVs);
+      rewriter.setInsertionPointAfter(iterateOpInit);
     }
 
-    Value identity =
-        getIdentityValue<ONNXReductionOp>(rewriter, loc, elementOutType);
-    rewriter.create<StoreOp>(loc, identity, alloc, loopIVs);
+    if (isRunReduction) {
+      RunReductionEmitter<ONNXReductionOp>(rewriter, loc, op, operands[0])
+          .emit(alloc, firstReducedDim, axes, outInDimMap);
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
 
     // Define an Krnl loop to do reduction.
-    rewriter.setInsertionPointAfter(iterateOpInit);
     std::vector<Value> originalLoops, optimizedLoops;
     Block *optimizationBlock = defineLoops(rewriter, loc, originalLoops,
             optimizedLoops, inRank);
@@ -235,9 +610,19 @@ struct ONNXReductionOpLowering : public ConversionPattern {
     auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
     Block &iterationBlock = iterateOp.bodyRegion().front();
 
-    // Perform the insertions into the body of the reduction loop.
-    // No optimization
+    // Perform the insertions into the body of the reduction loop. The
+    // outermost loop is executed in parallel if it is not reduced, the
+    // iterations then writing to different rows of the result.
     rewriter.setInsertionPointToEnd(optimizationBlock);
+    for (decltype(inRank) i = 0; i < inRank; ++i) {
+      if (memRefInShape[i] != 1) {
+        if (!isReduced(i))
+          rewriter.create<KrnlParallelOp>(loc, originalLoops[i]);
+        break;
+      }
+    }
+    if (!isReduced(inRank - 1))
+      emitInnermostVectorizedLoop(rewriter, loc, originalLoops, memRefInType);
     rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
 
     // Insert instructions inside the KernelIterateOp body.
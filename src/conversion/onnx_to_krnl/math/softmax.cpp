@@ -22,6 +22,24 @@ struct ONNXSoftmaxOpLowering : public ConversionPattern {
     //                let exp_x = exp(x - max_x) in
     //                  let sum = sum(exp_x) in
     //                    exp_x / sum
+    //
+    // The input is coerced into a 2-D tensor, `axis` being the coercing
+    // point. This coercing follows the softmax definition in ONNX:
+    // https://github.com/onnx/onnx/blob/master/docs/Operators.md#Softmax
+    // The rows of the 2-D tensor are independent and normalized in parallel,
+    // each in two passes over the input.
+    //
+    // The first pass computes the max and the sum at once with the online
+    // softmax recurrence: when the max m is replaced by m' = max(m, x), the
+    // sum s accumulated so far is rescaled,
+    //   s' = s * exp(m - m') + exp(x - m').
+    // One of the two exponentials is exp(0) = 1, so that a single one,
+    // e = exp(min(m, x) - max(m, x)), is computed per element:
+    //   s' = x > m ? s * e + 1 : s + e.
+    // Each lane of a vector along the innermost dimension accumulates its
+    // own max and sum, which are combined once the row is done.
+    //
+    // The second pass computes exp(x - max) * (1 / sum).
     auto memRefType = convertToMemRefType(*op->result_type_begin());
     int64_t rank = memRefType.getRank();
     int64_t axis = llvm::dyn_cast<ONNXSoftmaxOp>(op).axis().getSExtValue();
@@ -29,6 +47,8 @@ struct ONNXSoftmaxOpLowering : public ConversionPattern {
     assert(axis >= -rank && axis <= rank - 1);
 
     auto loc = op->getLoc();
+    auto context = rewriter.getContext();
+    Value input = operands[0];
 
     // Insert an allocation and deallocation for the result of this operation.
     auto elementType = memRefType.getElementType();
@@ -39,161 +59,208 @@ struct ONNXSoftmaxOpLowering : public ConversionPattern {
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
     else
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc,
-                                    operands[0]);
+                                    input);
 
     // Shape of the result
     auto memRefShape = memRefType.getShape();
+    int64_t vectorWidth = std::max<int64_t>(
+        1, targetVectorSizeInBytes / getMemRefEltSizeInBytes(memRefType));
 
-    // Insert allocations and deallocations for sum and max.
-    MemRefType scalarMemRefType = MemRefType::get({}, elementType, {}, 0);
-    Value sumOp = insertAllocAndDealloc(scalarMemRefType, loc, rewriter, true);
-    Value maxOp = insertAllocAndDealloc(scalarMemRefType, loc, rewriter, true);
-    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
-    Value negInfinity = rewriter.create<ConstantOp>(
-        loc,
-        FloatAttr::get(elementType, -std::numeric_limits<float>::infinity()));
-
-    // Define loops.
-    std::vector<Value> originalLoops;
-    std::vector<Value> optimizedLoops;
-    Block *optimizationBlock = defineLoops(rewriter, loc, originalLoops,
-            optimizedLoops, rank);
-
-    // Coerce the input into a 2-D tensor. `axis` will be the coercing point.
-    // This coercing follows the softmax definition in ONNX:
-    // https://github.com/onnx/onnx/blob/master/docs/Operators.md#Softmax
-    // Here, we create an outer loop and inner loop for handling the two
-    // dimensions. The outer loop is only created once `axis` is not zero.
-
-    // Define an outer loop with respect to axis.
-    std::vector<Value> outerLoops, optimizedOuterLoops;
-    outerLoops.reserve(axis);
-    optimizedOuterLoops.reserve(axis);
-    for (int i = 0; i < axis; ++i) {
-      outerLoops.push_back(originalLoops[i]);
-      optimizedOuterLoops.push_back(optimizedLoops[i]);
+    // Define an outer loop with respect to axis, whose iterations are
+    // executed in parallel.
+    SmallVector<Value, 4> outerIndices;
+    if (axis != 0) {
+      BuildKrnlLoop outerLoops(rewriter, loc, axis);
+      outerLoops.createDefineAndOptimizeOp();
+      for (int i = 0; i < axis; ++i)
+        outerLoops.pushBounds(0, input, i);
+      for (int i = 0; i < axis; ++i) {
+        if (memRefShape[i] != 1) {
+          outerLoops.parallel(i);
+          break;
+        }
+      }
+      outerLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+      for (auto arg : outerLoops.getIterateBlock()->getArguments())
+        outerIndices.emplace_back(arg);
     }
-    KrnlIterateOperandPack outerPack(rewriter, outerLoops, optimizedOuterLoops);
-    for (int i = 0; i < axis; ++i)
-      addDimensionToPack(rewriter, loc, outerPack, operands[0], i);
-
-    // Define an inner loop with respect to axis.
-    std::vector<Value> innerLoops, optimizedInnerLoops;
-    innerLoops.reserve(rank - axis);
-    optimizedInnerLoops.reserve(rank - axis);
-    for (int i = axis; i < rank; ++i) {
-      innerLoops.push_back(originalLoops[i]);
-      optimizedInnerLoops.push_back(optimizedLoops[i]);
+
+    // Emit a loop nest over the dimensions [axis, rank - 1) of the row
+    // followed by loops of the given sizes, known at compile time or
+    // computed at run time when negative, the last one being vectorized if
+    // requested. Its body is emitted by `emitBody` given the indices of the
+    // element in the leading rank - 1 dimensions and the induction variables
+    // of the trailing loops. The insertion point is left after the nest.
+    auto emitRowLoopNest =
+        [&](ArrayRef<std::pair<int64_t, Value>> sizes, bool isVectorized,
+            function_ref<void(ArrayRef<Value>, ArrayRef<Value>)> emitBody) {
+          PatternRewriter::InsertionGuard insertGuard(rewriter);
+          BuildKrnlLoop loops(rewriter, loc, rank - 1 - axis + sizes.size());
+          loops.createDefineAndOptimizeOp();
+          for (int i = axis; i < rank - 1; ++i)
+            loops.pushBounds(0, input, i);
+          for (auto size : sizes) {
+            if (size.first >= 0)
+              loops.pushBounds(0, size.first);
+            else
+              loops.pushBounds(0, size.second);
+          }
+          if (isVectorized)
+            loops.vectorize(rank - 2 - axis + sizes.size(), vectorWidth);
+          loops.createIterateOp();
+          rewriter.setInsertionPointToStart(loops.getIterateBlock());
+          auto ivs = loops.getIterateBlock()->getArguments();
+          SmallVector<Value, 4> indices(outerIndices.begin(),
+                                        outerIndices.end());
+          indices.append(ivs.begin(), ivs.begin() + rank - 1 - axis);
+          SmallVector<Value, 2> trailingIVs(ivs.begin() + rank - 1 - axis,
+                                            ivs.end());
+          emitBody(indices, trailingIVs);
+        };
+    auto apply = [&](AffineExpr expr, ArrayRef<Value> dims,
+                     ArrayRef<Value> symbols = {}) -> Value {
+      SmallVector<Value, 4> mapOperands(dims.begin(), dims.end());
+      mapOperands.append(symbols.begin(), symbols.end());
+      return rewriter.create<AffineApplyOp>(
+          loc, AffineMap::get(dims.size(), symbols.size(), expr),
+          mapOperands);
+    };
+    auto d0 = getAffineDimExpr(0, context);
+    auto d1 = getAffineDimExpr(1, context);
+    auto s0 = getAffineSymbolExpr(0, context);
+
+    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
+    Value one = emitConstantOp(rewriter, loc, elementType, 1);
+    // The max starts from the lowest finite value rather than -inf, so that
+    // the exponential of the difference with an element of -inf, e.g. a
+    // masked one, is 0 rather than NaN.
+    Value lowest = rewriter.create<ConstantOp>(
+        loc, rewriter.getFloatAttr(
+                 elementType,
+                 APFloat::getLargest(
+                     elementType.cast<FloatType>().getFloatSemantics(),
+                     /*Negative=*/true)));
+
+    // 1. Accumulate the max and the sum of the row per vector lane, in
+    // scratch buffers on the stack, private to the row.
+    auto laneMemRefType = MemRefType::get({vectorWidth}, elementType);
+    Value laneMax = rewriter.create<KrnlAllocaOp>(loc, laneMemRefType);
+    Value laneSum = rewriter.create<KrnlAllocaOp>(loc, laneMemRefType);
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      BuildKrnlLoop laneLoops(rewriter, loc, 1);
+      laneLoops.createDefineAndOptimizeOp();
+      int laneIndex = laneLoops.pushBounds(0, vectorWidth);
+      if (vectorWidth > 1)
+        laneLoops.vectorize(laneIndex, vectorWidth);
+      laneLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(laneLoops.getIterateBlock());
+      Value lane = laneLoops.getInductionVar(laneIndex);
+      rewriter.create<StoreOp>(loc, lowest, laneMax, lane);
+      rewriter.create<StoreOp>(loc, zero, laneSum, lane);
     }
-    KrnlIterateOperandPack innerPack(rewriter, innerLoops, optimizedInnerLoops);
-    for (int i = axis; i < rank; ++i)
-      addDimensionToPack(rewriter, loc, innerPack, operands[0], i);
 
-    KrnlIterateOp outerIterateOp, maxIterateOp, sumIterateOp, softmaxIterateOp;
-    SmallVector<Value, 4> outerLoopIVs;
-    if (axis != 0) {
-      outerIterateOp = rewriter.create<KrnlIterateOp>(loc, outerPack);
-
-      // No optimization
-      rewriter.setInsertionPointToEnd(optimizationBlock);
-      rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
-
-      // Insert instructions inside the outer loop.
-      Block &outerIterationBlock = outerIterateOp.bodyRegion().front();
-      rewriter.setInsertionPointToStart(&outerIterationBlock);
-      for (auto arg : outerIterationBlock.getArguments())
-        outerLoopIVs.push_back(arg);
-
-      // Reset accumulators.
-      rewriter.create<StoreOp>(loc, zero, sumOp);
-      rewriter.create<StoreOp>(loc, negInfinity, maxOp);
-
-      // Create an inner loop to compute max.
-      maxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute sum.
-      sumIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute softmax.
-      softmaxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
+    auto emitAccumulate = [&](ArrayRef<Value> indices, Value lane) {
+      Value next = rewriter.create<LoadOp>(loc, input, indices);
+      Value max = rewriter.create<LoadOp>(loc, laneMax, lane);
+      Value sum = rewriter.create<LoadOp>(loc, laneSum, lane);
+      Value isGreater =
+          rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, next, max);
+      Value newMax = rewriter.create<SelectOp>(loc, isGreater, next, max);
+      Value newMin = rewriter.create<SelectOp>(loc, isGreater, max, next);
+      Value sub = rewriter.create<SubFOp>(loc, newMin, newMax);
+      Value exp = emitExp(rewriter, loc, sub);
+      Value rescaledSum = rewriter.create<MulFOp>(loc, sum, exp);
+      rescaledSum = rewriter.create<AddFOp>(loc, rescaledSum, one);
+      Value increasedSum = rewriter.create<AddFOp>(loc, sum, exp);
+      Value newSum = rewriter.create<SelectOp>(loc, isGreater, rescaledSum,
+                                               increasedSum);
+      rewriter.create<StoreOp>(loc, newMax, laneMax, lane);
+      rewriter.create<StoreOp>(loc, newSum, laneSum, lane);
+    };
+
+    // The innermost dimension is split into blocks of vectorWidth elements,
+    // whose lanes are vectorized, and a tail of fewer elements accumulated
+    // into the first lanes.
+    int64_t innermostSize = memRefShape[rank - 1];
+    Value innermostDim;
+    std::pair<int64_t, Value> numBlocks, tailSize;
+    if (innermostSize >= 0) {
+      numBlocks = {innermostSize / vectorWidth, nullptr};
+      tailSize = {innermostSize % vectorWidth, nullptr};
     } else {
-      // Reset accumulators.
-      rewriter.create<StoreOp>(loc, zero, sumOp);
-      rewriter.create<StoreOp>(loc, negInfinity, maxOp);
-
-      // Create an inner loop to compute max.
-      maxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute sum.
-      sumIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute softmax.
-      softmaxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-
-      // No optimization
-      rewriter.setInsertionPointToEnd(optimizationBlock);
-      rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
+      innermostDim = rewriter.create<DimOp>(loc, input, rank - 1);
+      numBlocks = {-1, apply(s0.floorDiv(vectorWidth), {}, innermostDim)};
+      tailSize = {-1, apply(s0 % vectorWidth, {}, innermostDim)};
+    }
+    if (numBlocks.first != 0) {
+      emitRowLoopNest({numBlocks, {vectorWidth, nullptr}}, vectorWidth > 1,
+                      [&](ArrayRef<Value> indices, ArrayRef<Value> ivs) {
+                        SmallVector<Value, 4> inputIndices(indices.begin(),
+                                                           indices.end());
+                        inputIndices.emplace_back(
+                            apply(d0 * vectorWidth + d1, {ivs[0], ivs[1]}));
+                        emitAccumulate(inputIndices, ivs[1]);
+                      });
+    }
+    if (tailSize.first != 0) {
+      emitRowLoopNest(
+          {tailSize}, /*isVectorized=*/false,
+          [&](ArrayRef<Value> indices, ArrayRef<Value> ivs) {
+            SmallVector<Value, 4> inputIndices(indices.begin(), indices.end());
+            if (innermostDim)
+              inputIndices.emplace_back(apply(
+                  s0.floorDiv(vectorWidth) * vectorWidth + d0, ivs[0],
+                  innermostDim));
+            else
+              inputIndices.emplace_back(
+                  apply(d0 + numBlocks.first * vectorWidth, ivs[0]));
+            emitAccumulate(inputIndices, ivs[0]);
+          });
     }
 
-    // Insert instructions inside the max loop.
-    Block &maxIterationBlock = maxIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&maxIterationBlock);
-
-    // Get induction variables.
-    SmallVector<Value, 4> maxLoopIVs;
-    for (auto arg : outerLoopIVs)
-      maxLoopIVs.push_back(arg);
-    for (auto arg : maxIterationBlock.getArguments())
-      maxLoopIVs.push_back(arg);
-
-    // Compute the max value.
-    Value max = rewriter.create<LoadOp>(loc, maxOp);
-    Value nextMax = rewriter.create<LoadOp>(loc, operands[0], maxLoopIVs);
-    auto maxCond =
-        rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, max, nextMax);
-    max = rewriter.create<SelectOp>(loc, maxCond, max, nextMax);
-    rewriter.create<StoreOp>(loc, max, maxOp);
-
-    // Get the max.
-    rewriter.setInsertionPoint(sumIterateOp);
-    max = rewriter.create<LoadOp>(loc, maxOp);
-
-    // Insert instructions inside the sum loop.
-    Block &sumIterationBlock = sumIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&sumIterationBlock);
-
-    // Get induction variables.
-    SmallVector<Value, 4> sumLoopIVs;
-    for (auto arg : outerLoopIVs)
-      sumLoopIVs.push_back(arg);
-    for (auto arg : sumIterationBlock.getArguments())
-      sumLoopIVs.push_back(arg);
-
-    // Sum up values.
-    Value sum = rewriter.create<LoadOp>(loc, sumOp);
-    Value next = rewriter.create<LoadOp>(loc, operands[0], sumLoopIVs);
-    Value sub = rewriter.create<SubFOp>(loc, next, max);
-    Value exp = rewriter.create<ExpOp>(loc, sub);
-    sum = rewriter.create<AddFOp>(loc, sum, exp);
-    rewriter.create<StoreOp>(loc, sum, sumOp);
-    // Store intermediate values in the result to avoid recomputation.
-    rewriter.create<StoreOp>(loc, exp, alloc, sumLoopIVs);
-
-    // Get the sum.
-    rewriter.setInsertionPoint(softmaxIterateOp);
-    sum = rewriter.create<LoadOp>(loc, sumOp);
-
-    // Insert instructions inside the softmax loop.
-    Block &softmaxIterationBlock = softmaxIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&softmaxIterationBlock);
-
-    // Get induction variables.
-    SmallVector<Value, 4> softmaxLoopIVs;
-    for (auto arg : outerLoopIVs)
-      softmaxLoopIVs.push_back(arg);
-    for (auto arg : softmaxIterationBlock.getArguments())
-      softmaxLoopIVs.push_back(arg);
-
-    // Compute softmax.
-    Value expLoadedVal = rewriter.create<LoadOp>(loc, alloc, softmaxLoopIVs);
-    Value result = rewriter.create<DivFOp>(loc, expLoadedVal, sum);
-    rewriter.create<StoreOp>(loc, result, alloc, softmaxLoopIVs);
+    // Combine the lanes, in registers: the max is the max of the lanes, and
+    // the sum of each lane is rescaled to it.
+    SmallVector<Value, 16> laneMaxes, laneSums;
+    for (int64_t l = 0; l < vectorWidth; ++l) {
+      Value lane = rewriter.create<ConstantIndexOp>(loc, l);
+      laneMaxes.emplace_back(rewriter.create<LoadOp>(loc, laneMax, lane));
+      laneSums.emplace_back(rewriter.create<LoadOp>(loc, laneSum, lane));
+    }
+    Value max = laneMaxes[0];
+    for (int64_t l = 1; l < vectorWidth; ++l) {
+      auto isGreater = rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT,
+                                               laneMaxes[l], max);
+      max = rewriter.create<SelectOp>(loc, isGreater, laneMaxes[l], max);
+    }
+    Value sum;
+    for (int64_t l = 0; l < vectorWidth; ++l) {
+      Value sub = rewriter.create<SubFOp>(loc, laneMaxes[l], max);
+      Value exp = emitExp(rewriter, loc, sub);
+      Value rescaledSum = rewriter.create<MulFOp>(loc, laneSums[l], exp);
+      sum = sum ? rewriter.create<AddFOp>(loc, sum, rescaledSum).getResult()
+                : rescaledSum;
+    }
+    Value reciprocal = rewriter.create<DivFOp>(loc, one, sum);
+
+    // 2. Compute softmax, vectorized along the innermost dimension.
+    bool isVectorized = vectorWidth > 1 &&
+                        (innermostSize < 0 || innermostSize >= vectorWidth);
+    emitRowLoopNest({{innermostSize, innermostDim}}, isVectorized,
+                    [&](ArrayRef<Value> indices, ArrayRef<Value> ivs) {
+                      SmallVector<Value, 4> inputIndices(indices.begin(),
+                                                         indices.end());
+                      inputIndices.emplace_back(ivs[0]);
+                      Value next =
+                          rewriter.create<LoadOp>(loc, input, inputIndices);
+                      Value sub = rewriter.create<SubFOp>(loc, next, max);
+                      Value exp = emitExp(rewriter, loc, sub);
+                      Value result =
+                          rewriter.create<MulFOp>(loc, exp, reciprocal);
+                      rewriter.create<StoreOp>(loc, result, alloc,
+                                               inputIndices);
+                    });
 
     rewriter.replaceOp(op, alloc);
 
@@ -0,0 +1,281 @@
+//===----- transcendental.cpp - Transcendental Functions ------------------===//
+//
+// Copyright 2019 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file emits the transcendental functions used when lowering ONNX
+// operators, either as calls to the math library or as polynomial
+// approximations made of arithmetic, comparison and select operations only.
+// The latter are executed on vectors when the loops computing them are
+// vectorized, whereas the calls to the math library are executed one element
+// at a time.
+//
+//===----------------------------------------------------------------------===//
+
+#include <cmath>
+#include <limits>
+
+#include "llvm/Support/CommandLine.h"
+
+#include "src/conversion/onnx_to_krnl/onnx_to_krnl_common.hpp"
+
+using namespace mlir;
+
+static llvm::cl::opt<unsigned> mathMaxUlps("math-max-ulps",
+    llvm::cl::desc("Maximum error, in units in the last place, of the "
+                   "polynomial approximations of exp, log and tanh on f32 "
+                   "(0 calls the math library instead)"),
+    llvm::cl::init(2));
+
+namespace {
+
+// Coefficients of a polynomial approximation, highest degree first, and the
+// maximum error in units in the last place of the function computed with it,
+// as measured on f32 over the whole range of the function.
+struct Approximation {
+  unsigned maxUlps;
+  ArrayRef<double> coefficients;
+};
+
+// exp(r) = 1 + r + r^2 * P(r) for |r| <= ln(2) / 2, P fitted for the minimax
+// relative error.
+const double expCoefficients4[] = {1.3814611593e-3, 8.3687100559e-3,
+    4.1668388993e-2, 1.6666521132e-1, 4.9999994040e-1};
+const double expCoefficients3[] = {
+    8.3125270903e-3, 4.1890114546e-2, 1.6667114198e-1, 4.9999231100e-1};
+const Approximation expApproximations[] = {
+    {2, expCoefficients4}, {3, expCoefficients3}};
+
+// log(1 + f) = f - f^2 / 2 + f^3 * P(f) for sqrt(1/2) - 1 <= f < sqrt(2) - 1,
+// P fitted for the minimax relative error.
+const double logCoefficients7[] = {-7.6344236732e-2, 1.2761548162e-1,
+    -1.3160195947e-1, 1.4201763272e-1, -1.6623356938e-1, 2.0001226664e-1,
+    -2.5000822544e-1, 3.3333331347e-1};
+const double logCoefficients6[] = {8.7003596127e-2, -1.4267475903e-1,
+    1.4914786816e-1, -1.6577586532e-1, 1.9963061810e-1, -2.5001338124e-1,
+    3.3333909512e-1};
+const double logCoefficients5[] = {-1.0191646218e-1, 1.6024357080e-1,
+    -1.7137140036e-1, 1.9924506545e-1, -2.4983265996e-1, 3.3334246278e-1};
+const Approximation logApproximations[] = {
+    {1, logCoefficients7}, {2, logCoefficients6}, {5, logCoefficients5}};
+
+// tanh(x) = x + x^3 * P(x^2) for |x| < 0.625 (Cephes), tanh being computed
+// from exp(2|x|) otherwise. The error is that of the exp approximation used.
+const double tanhCoefficients[] = {-5.70498872745e-3, 2.06390887954e-2,
+    -5.37397155531e-2, 1.33314422036e-1, -3.33332819422e-1};
+const double tanhPolynomialBound = 0.625;
+
+// Split of ln(2) into a part exactly multiplied by small integers and the
+// rest, for the range reductions.
+const double ln2High = 0.693359375;
+const double ln2Low = -2.12194440e-4;
+
+// Adding then subtracting 1.5 * 2^23 rounds an f32 of magnitude below 2^22 to
+// the nearest integer.
+const double roundingMagic = 12582912.0;
+
+// Return the cheapest approximation whose error does not exceed the
+// selected bound, or nullptr if the math library must be called.
+const Approximation *selectApproximation(
+    Type type, ArrayRef<Approximation> approximations) {
+  if (mathMaxUlps == 0 || !type.isF32())
+    return nullptr;
+  const Approximation *selected = nullptr;
+  for (auto &approximation : approximations)
+    if (approximation.maxUlps <= mathMaxUlps)
+      selected = &approximation;
+  return selected;
+}
+
+class ApproximationBuilder {
+public:
+  ApproximationBuilder(
+      ConversionPatternRewriter &rewriter, Location loc, Type type)
+      : rewriter(rewriter), loc(loc), type(type) {}
+
+  Value constant(double value) {
+    return emitConstantOp(rewriter, loc, type, value);
+  }
+  Value add(Value lhs, Value rhs) {
+    return rewriter.create<AddFOp>(loc, lhs, rhs);
+  }
+  Value sub(Value lhs, Value rhs) {
+    return rewriter.create<SubFOp>(loc, lhs, rhs);
+  }
+  Value mul(Value lhs, Value rhs) {
+    return rewriter.create<MulFOp>(loc, lhs, rhs);
+  }
+  Value cmp(CmpFPredicate predicate, Value lhs, Value rhs) {
+    return rewriter.create<CmpFOp>(loc, predicate, lhs, rhs);
+  }
+  Value select(Value condition, Value trueValue, Value falseValue) {
+    return rewriter.create<SelectOp>(loc, condition, trueValue, falseValue);
+  }
+
+  // Evaluate the polynomial of the given coefficients at x with Horner's
+  // scheme.
+  Value polynomial(ArrayRef<double> coefficients, Value x) {
+    Value result = constant(coefficients.front());
+    for (auto coefficient : coefficients.drop_front()) {
+      auto product = mul(result, x);
+      result = add(product, constant(coefficient));
+    }
+    return result;
+  }
+
+  // Compute exp(x) as 2^n * exp(r), with n = round(x / ln(2)) and
+  // r = x - n * ln(2). Since the bits of the floating point numbers cannot be
+  // manipulated, 2^n is applied as the product of the powers 2^(2^k) selected
+  // by the bits of |n|, in increasing order so that no intermediate result
+  // overflows or underflows before the final one does.
+  Value exp(Value x, const Approximation &approximation) {
+    // Clamp x so that |n| <= 150, the results out of this range rounding to
+    // 0 and infinity. A NaN is kept and propagated.
+    auto high = constant(88.72283935546875);
+    auto low = constant(-104.0);
+    x = select(cmp(CmpFPredicate::OGT, x, high), high, x);
+    x = select(cmp(CmpFPredicate::OLT, x, low), low, x);
+
+    auto magic = constant(roundingMagic);
+    auto n = sub(add(mul(x, constant(1.44269504088896341)), magic), magic);
+    auto r = sub(x, mul(n, constant(ln2High)));
+    r = sub(r, mul(n, constant(ln2Low)));
+    auto one = constant(1);
+    auto p = polynomial(approximation.coefficients, r);
+    auto highTerms = mul(mul(r, r), p);
+    Value result = add(highTerms, add(r, one));
+
+    auto zero = constant(0);
+    auto isNegative = cmp(CmpFPredicate::OLT, n, zero);
+    Value remainder = rewriter.create<AbsFOp>(loc, n);
+    SmallVector<Value, 8> factors(8);
+    for (int k = 7; k >= 0; --k) {
+      auto bit = constant(1 << k);
+      auto isSet = cmp(CmpFPredicate::OGE, remainder, bit);
+      remainder = sub(remainder, select(isSet, bit, zero));
+      // 2^128 is not an f32 and is applied as 2^64 twice.
+      auto exponent = std::min(1 << k, 64);
+      auto negativeFactor = constant(std::ldexp(1.0, -exponent));
+      auto positiveFactor = constant(std::ldexp(1.0, exponent));
+      auto factor = select(isNegative, negativeFactor, positiveFactor);
+      factors[k] = select(isSet, factor, one);
+    }
+    for (int k = 0; k < 8; ++k)
+      result = mul(result, factors[k]);
+    return mul(result, factors[7]);
+  }
+
+  // Compute log(x) as e * ln(2) + log(m), with x = 2^e * m and
+  // sqrt(1/2) <= m < sqrt(2). e and m are found by dividing or multiplying x
+  // by the powers 2^(2^k) in decreasing order.
+  Value log(Value x, const Approximation &approximation) {
+    auto zero = constant(0);
+    Value m = x;
+    Value e = zero;
+    auto scale = [&](Value isGreater, Value isLess, Value factor,
+                     Value inverseFactor, double exponent) {
+      auto one = constant(1);
+      Value mFactor = select(isLess, factor, one);
+      Value eDelta = select(isLess, constant(-exponent), zero);
+      if (isGreater) {
+        mFactor = select(isGreater, inverseFactor, mFactor);
+        eDelta = select(isGreater, constant(exponent), eDelta);
+      }
+      m = mul(m, mFactor);
+      e = add(e, eDelta);
+      return mFactor;
+    };
+    for (int k = 7; k >= 0; --k) {
+      auto exponent = 1 << k;
+      auto isLess = cmp(CmpFPredicate::OLT, m,
+                        constant(std::ldexp(1.0, -exponent)));
+      if (k == 7) {
+        // Only subnormal numbers are below 2^-128 and no f32 reaches 2^128,
+        // which is applied as 2^64 twice.
+        auto factor = scale(nullptr, isLess, constant(std::ldexp(1.0, 64)),
+                            nullptr, exponent);
+        m = mul(m, factor);
+        continue;
+      }
+      auto factor = constant(std::ldexp(1.0, exponent));
+      auto inverseFactor = constant(std::ldexp(1.0, -exponent));
+      auto isGreater = cmp(CmpFPredicate::OGE, m, factor);
+      scale(isGreater, isLess, factor, inverseFactor, exponent);
+    }
+    auto isGreater = cmp(CmpFPredicate::OGE, m, constant(1.41421356237309505));
+    auto isLess = cmp(CmpFPredicate::OLT, m, constant(0.70710678118654752));
+    auto two = constant(2);
+    auto half = constant(0.5);
+    scale(isGreater, isLess, two, half, 1);
+
+    auto f = sub(m, constant(1));
+    auto f2 = mul(f, f);
+    auto f3 = mul(f, f2);
+    Value y = mul(f3, polynomial(approximation.coefficients, f));
+    y = add(y, mul(e, constant(ln2Low)));
+    y = sub(y, mul(f2, half));
+    Value result = add(f, y);
+    result = add(result, mul(e, constant(ln2High)));
+
+    // log(0) = -inf, log(inf) = inf and log(x) = NaN for x < 0. A NaN is
+    // propagated.
+    auto infinity = emitPositiveInfinityConstantOp(rewriter, loc, type);
+    result = select(cmp(CmpFPredicate::OEQ, x, infinity), infinity, result);
+    auto negativeInfinity =
+        emitNegativeInfinityConstantOp(rewriter, loc, type);
+    result = select(cmp(CmpFPredicate::OEQ, x, zero), negativeInfinity, result);
+    auto nan = constant(std::numeric_limits<double>::quiet_NaN());
+    return select(cmp(CmpFPredicate::OLT, x, zero), nan, result);
+  }
+
+  // Compute tanh(x) with a polynomial for small |x|, and as
+  // sign(x) * (1 - 2 / (exp(2|x|) + 1)) otherwise.
+  Value tanh(Value x, const Approximation &expApproximation) {
+    auto one = constant(1);
+    auto absX = rewriter.create<AbsFOp>(loc, x);
+    auto x2 = mul(x, x);
+    auto x3 = mul(x, x2);
+    auto small = add(x, mul(x3, polynomial(tanhCoefficients, x2)));
+    auto exp2X = exp(add(absX, absX), expApproximation);
+    auto two = constant(2);
+    auto quotient = rewriter.create<DivFOp>(loc, two, add(exp2X, one));
+    auto large = sub(one, quotient);
+    auto zero = constant(0);
+    auto isNegative = cmp(CmpFPredicate::OLT, x, zero);
+    auto signedLarge = select(isNegative, sub(zero, large), large);
+    return select(cmp(CmpFPredicate::OLT, absX, constant(tanhPolynomialBound)),
+                  small, signedLarge);
+  }
+
+private:
+  ConversionPatternRewriter &rewriter;
+  Location loc;
+  Type type;
+};
+
+} // namespace
+
+Value emitExp(ConversionPatternRewriter &rewriter, Location loc, Value x) {
+  auto type = x.getType();
+  auto approximation = selectApproximation(type, expApproximations);
+  if (!approximation)
+    return rewriter.create<ExpOp>(loc, x);
+  return ApproximationBuilder(rewriter, loc, type).exp(x, *approximation);
+}
+
+Value emitLog(ConversionPatternRewriter &rewriter, Location loc, Value x) {
+  auto type = x.getType();
+  auto approximation = selectApproximation(type, logApproximations);
+  if (!approximation)
+    return rewriter.create<LogOp>(loc, x);
+  return ApproximationBuilder(rewriter, loc, type).log(x, *approximation);
+}
+
+Value emitTanh(ConversionPatternRewriter &rewriter, Location loc, Value x) {
+  auto type = x.getType();
+  auto approximation = selectApproximation(type, expApproximations);
+  if (!approximation)
+    return rewriter.create<TanhOp>(loc, x);
+  return ApproximationBuilder(rewriter, loc, type).tanh(x, *approximation);
+}
@@ -12,18 +12,1137 @@
 
 using namespace mlir;
 
-struct ONNXConvNoBiasOpLowering : public ConversionPattern {
-  ONNXConvNoBiasOpLowering(MLIRContext *ctx)
-      : ConversionPattern(mlir::ONNXConvNoBiasOp::getOperationName(), 1, ctx) {}
+// Minimum number of multiply-adds of the matrix multiplication computing the
+// convolution of one image by the kernels of one group, below which packing
+// the operands of the matrix multiplication does not pay off.
+const int64_t minConvGemmWork = 4096;
+
+// Emit a loop nest iterating over the elements of `memRef`, whose outermost
+// loop running more than one iteration is parallel and whose innermost loop
+// is vectorized, and set the insertion point in its body. Return its
+// induction variables.
+SmallVector<Value, 4> emitElementLoopNest(
+    ConversionPatternRewriter &rewriter, Location loc, Value memRef) {
+  auto memRefType = memRef.getType().cast<MemRefType>();
+  std::vector<Value> loops;
+  KrnlOptimizeLoopsOp optimizedLoopsOp;
+  KrnlIterateOp iterateOp;
+  emitKrnlLoopsAndIterationForOperand(
+      rewriter, loc, memRef, loops, optimizedLoopsOp, iterateOp);
+  rewriter.setInsertionPointToEnd(&optimizedLoopsOp.region().front());
+  emitOutermostParallelLoop(rewriter, loc, loops, memRefType.getShape());
+  emitInnermostVectorizedLoop(rewriter, loc, loops, memRefType);
+  rewriter.create<KrnlReturnLoopsOp>(loc, loops);
+
+  Block &iterationBlock = iterateOp.bodyRegion().front();
+  rewriter.setInsertionPointToStart(&iterationBlock);
+  SmallVector<Value, 4> indices(iterationBlock.getArguments().begin(),
+      iterationBlock.getArguments().end());
+  return indices;
+}
+
+// Copy the elements of `from` into `to`, shifted by the given offsets in each
+// dimension of `to`, or fill `to` with zeros if `from` is null. The copy
+// iterates over the dimensions of the smaller of the two memrefs, which must
+// then have a static shape.
+void emitCopyOrZeroFill(ConversionPatternRewriter &rewriter, Location loc,
+    Value from, Value to, ArrayRef<int64_t> offsets = {}) {
+  PatternRewriter::InsertionGuard insertGuard(rewriter);
+  auto memRefType = to.getType().cast<MemRefType>();
+  Value bounds = to;
+  if (from && from.getType().cast<MemRefType>().getNumElements() <
+                  memRefType.getNumElements())
+    bounds = from;
+  auto indices = emitElementLoopNest(rewriter, loc, bounds);
+  if (!from) {
+    auto zero = emitConstantOp(rewriter, loc, memRefType.getElementType(), 0);
+    rewriter.create<StoreOp>(loc, zero, to, indices);
+    return;
+  }
+  auto value = rewriter.create<LoadOp>(loc, from, indices);
+  auto d0 = getAffineDimExpr(0, rewriter.getContext());
+  for (auto offset : llvm::enumerate(offsets)) {
+    if (offset.value() == 0)
+      continue;
+    indices[offset.index()] = rewriter.create<AffineApplyOp>(loc,
+        AffineMap::get(1, 0, d0 + offset.value()), indices[offset.index()]);
+  }
+  rewriter.create<StoreOp>(loc, value, to, indices);
+}
+
+void emitZeroFill(
+    ConversionPatternRewriter &rewriter, Location loc, Value memRef) {
+  emitCopyOrZeroFill(rewriter, loc, nullptr, memRef);
+}
+
+// Epilogue of a convolution, applied to each element of its output once
+// computed: the bias of its output channel is added to it, then the
+// activation function of onnx.ConvActivation is applied to it. A null bias
+// and an empty activation stand for none.
+struct ConvEpilogue {
+  Value bias;
+  StringRef activation;
+  float alpha = 0;
+  float beta = 0;
+};
+
+ConvEpilogue getConvEpilogue(
+    ONNXConvNoBiasOp convOp, ArrayRef<Value> operands) {
+  return {};
+}
+
+ConvEpilogue getConvEpilogue(ONNXConvOp convOp, ArrayRef<Value> operands) {
+  ConvEpilogue epilogue;
+  if (!operands[2].getType().isa<NoneType>())
+    epilogue.bias = operands[2];
+  return epilogue;
+}
+
+ConvEpilogue getConvEpilogue(
+    ONNXConvActivationOp convOp, ArrayRef<Value> operands) {
+  ConvEpilogue epilogue;
+  if (!operands[2].getType().isa<NoneType>())
+    epilogue.bias = operands[2];
+  epilogue.activation = convOp.activation();
+  epilogue.alpha = convOp.activation_alpha().convertToFloat();
+  epilogue.beta = convOp.activation_beta().convertToFloat();
+  return epilogue;
+}
+
+bool isSupportedActivation(StringRef activation) {
+  return activation.empty() || activation == "Relu" ||
+         activation == "LeakyRelu" || activation == "Sigmoid" ||
+         activation == "Clip";
+}
+
+// Emit the activation function of the epilogue applied to `value`, as the
+// elementwise lowering of the corresponding ONNX operation does.
+Value emitConvActivation(ConversionPatternRewriter &rewriter, Location loc,
+    const ConvEpilogue &epilogue, Value value) {
+  auto elementType = value.getType();
+  auto activation = epilogue.activation;
+  if (activation == "Relu" || activation == "LeakyRelu") {
+    auto zero = emitConstantOp(rewriter, loc, elementType, 0);
+    auto lessThanZero =
+        rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, value, zero);
+    Value negativeValue = zero;
+    if (activation == "LeakyRelu") {
+      auto alpha = emitConstantOp(rewriter, loc, elementType, epilogue.alpha);
+      negativeValue = rewriter.create<MulFOp>(loc, alpha, value);
+    }
+    return rewriter.create<SelectOp>(loc, lessThanZero, negativeValue, value);
+  }
+  if (activation == "Sigmoid") {
+    auto zero = emitConstantOp(rewriter, loc, elementType, 0);
+    auto one = emitConstantOp(rewriter, loc, elementType, 1);
+    auto neg = rewriter.create<SubFOp>(loc, zero, value);
+    auto negExp = emitExp(rewriter, loc, neg);
+    auto onePlusNegExp = rewriter.create<AddFOp>(loc, one, negExp);
+    return rewriter.create<DivFOp>(loc, one, onePlusNegExp);
+  }
+  if (activation == "Clip") {
+    auto min = emitConstantOp(rewriter, loc, elementType, epilogue.alpha);
+    auto max = emitConstantOp(rewriter, loc, elementType, epilogue.beta);
+    auto lessThanMin =
+        rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, value, min);
+    Value result = rewriter.create<SelectOp>(loc, lessThanMin, min, value);
+    auto greaterThanMax =
+        rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, result, max);
+    return rewriter.create<SelectOp>(loc, greaterThanMax, max, result);
+  }
+  return value;
+}
+
+// Fill the N x M x R1 x ... x Rdim output of a convolution with the bias of
+// each output channel: R[n][m][r1]...[rdim] = B[m].
+void emitBiasFill(ConversionPatternRewriter &rewriter, Location loc,
+    Value bias, Value memRef) {
+  PatternRewriter::InsertionGuard insertGuard(rewriter);
+  auto indices = emitElementLoopNest(rewriter, loc, memRef);
+  auto value =
+      rewriter.create<LoadOp>(loc, bias, ArrayRef<Value>{indices[1]});
+  rewriter.create<StoreOp>(loc, value, memRef, indices);
+}
+
+// Apply the activation function of the epilogue to each element of the
+// output of a convolution, in place.
+void emitConvActivationInPlace(ConversionPatternRewriter &rewriter,
+    Location loc, const ConvEpilogue &epilogue, Value memRef) {
+  PatternRewriter::InsertionGuard insertGuard(rewriter);
+  auto indices = emitElementLoopNest(rewriter, loc, memRef);
+  auto value = rewriter.create<LoadOp>(loc, memRef, indices);
+  auto result = emitConvActivation(rewriter, loc, epilogue, value);
+  rewriter.create<StoreOp>(loc, result, memRef, indices);
+}
+
+// Check whether a convolution is better computed as the product of the
+// kernels of each group, seen as a (M/group) x (C/group * K1 * ... * Kdim)
+// matrix, by the im2col matrix of each image, a
+// (C/group * K1 * ... * Kdim) x (R1 * ... * Rdim) matrix gathering the
+// input elements covered by the kernel at each output position. These sizes
+// must be known at compile time. The direct loop nest is kept when the
+// product is too small to amortize the packing of its operands, or too thin
+// to fill the register tiles of the GEMM kernel.
+bool isConvProfitableAsGemm(ArrayRef<int64_t> kernelShape,
+    ArrayRef<int64_t> resultShape, int64_t group, Type elementType) {
+  for (auto dim : kernelShape)
+    if (dim < 0)
+      return false;
+  for (int i = 2; i < resultShape.size(); ++i)
+    if (resultShape[i] < 0)
+      return false;
+
+  int64_t gemmM = kernelShape[0] / group;
+  int64_t gemmK = 1;
+  for (int i = 1; i < kernelShape.size(); ++i)
+    gemmK *= kernelShape[i];
+  int64_t gemmN = 1;
+  for (int i = 2; i < resultShape.size(); ++i)
+    gemmN *= resultShape[i];
+  int64_t vectorWidth =
+      targetVectorSizeInBytes * 8 / elementType.getIntOrFloatBitWidth();
+  return gemmM >= registerTileRows && gemmN >= vectorWidth &&
+         gemmM * gemmN * gemmK >= minConvGemmWork;
+}
+
+// Emit R = Conv(D, K) as one matrix multiplication per image and group, see
+// isConvProfitableAsGemm:
+//
+// for n = 0 .. N:
+//   for g = 0 .. group:
+//     R[n][g * M/group : (g + 1) * M/group] =
+//         K[g * M/group : (g + 1) * M/group] x im2col(D[n], g)
+//
+// The im2col matrix is not materialized: its panels are gathered from D
+// while being packed by the GEMM kernel, where
+//   im2col(D[n], g)[c * K1 * ... * Kdim + k1 * K2 * ... * Kdim + ... + kdim]
+//                  [r1 * R2 * ... * Rdim + ... + rdim] =
+//     D[n][g * C/group + c][s1 * r1 + d1 * k1 - p1]...
+//         [sdim * rdim + ddim * kdim - pdim]
+// with strides s, dilations d and leading pads p, the elements gathered from
+// the padding being zeros. These bounds checks are only run while packing,
+// once per element of a panel reused by the whole kernel, so the gather is
+// not split into border and interior regions as the direct loop nest is.
+//
+// The output is filled with the bias before being accumulated into. When
+// the reduction fits in a single tile of the GEMM kernel, each element of
+// the output is accumulated into once, and the activation is applied before
+// this store. Otherwise it is applied by a last pass over the output.
+template <typename ConvOp>
+void emitConvAsGemm(ConversionPatternRewriter &rewriter, Location loc,
+    ConvOp convOp, const ConvEpilogue &epilogue, Value inputOperand,
+    Value kernelOperand, Value alloc, int64_t group) {
+  auto context = rewriter.getContext();
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto resultShape = memRefType.getShape();
+  auto inputShape = inputOperand.getType().cast<MemRefType>().getShape();
+  auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+  int64_t nSpatialDims = kernelShape.size() - 2;
+  int64_t kernelsPerGroup = kernelShape[0] / group;
+  int64_t subchannels = kernelShape[1];
+
+  // Strides and dilations of the convolution, and strides of the flattened
+  // kernel and output spatial dimensions.
+  SmallVector<int64_t, 4> strides(nSpatialDims, 1);
+  if (auto stridesAttribute = convOp.stridesAttr())
+    for (auto stride : llvm::enumerate(stridesAttribute.getValue()))
+      strides[stride.index()] = stride.value().cast<IntegerAttr>().getInt();
+  SmallVector<int64_t, 4> dilations(nSpatialDims, 1);
+  if (auto dilationsAttribute = convOp.dilationsAttr())
+    for (auto dilation : llvm::enumerate(dilationsAttribute.getValue()))
+      dilations[dilation.index()] =
+          dilation.value().cast<IntegerAttr>().getInt();
+  SmallVector<int64_t, 4> pads(2 * nSpatialDims, 0);
+  if (auto padsAttribute = convOp.padsAttr())
+    for (auto pad : llvm::enumerate(padsAttribute.getValue()))
+      pads[pad.index()] = pad.value().cast<IntegerAttr>().getInt();
+  SmallVector<bool, 4> isChecked(2, false);
+  for (int i = 0; i < nSpatialDims; ++i)
+    isChecked.emplace_back(pads[i] != 0 || pads[i + nSpatialDims] != 0);
+  SmallVector<int64_t, 4> kernelStrides(nSpatialDims, 1);
+  SmallVector<int64_t, 4> resultStrides(nSpatialDims, 1);
+  for (int i = nSpatialDims - 2; i >= 0; --i) {
+    kernelStrides[i] = kernelStrides[i + 1] * kernelShape[i + 3];
+    resultStrides[i] = resultStrides[i + 1] * resultShape[i + 3];
+  }
+  int64_t kernelSize = kernelStrides[0] * kernelShape[2];
+  int64_t outputSize = resultStrides[0] * resultShape[2];
+  bool isSingleReductionTile = subchannels * kernelSize <= l1TileReduction;
+
+  auto apply = [&](AffineExpr expr, ArrayRef<Value> operands) -> Value {
+    return rewriter.create<AffineApplyOp>(
+        loc, AffineMap::get(operands.size(), 0, expr), operands);
+  };
+  auto d0 = getAffineDimExpr(0, context);
+  auto d1 = getAffineDimExpr(1, context);
+
+  // 1. Fill the output with the bias, or with zeros.
+  if (epilogue.bias)
+    emitBiasFill(rewriter, loc, epilogue.bias, alloc);
+  else
+    emitZeroFill(rewriter, loc, alloc);
+
+  // 2. Iterate over the images and the groups. The outermost of these loops
+  // running more than one iteration is parallel, otherwise the GEMM kernel
+  // parallelizes over the output channels.
+  int64_t nOuterLoops = (group > 1) ? 2 : 1;
+  BuildKrnlLoop outerLoops(rewriter, loc, nOuterLoops);
+  outerLoops.createDefineAndOptimizeOp();
+  int nIndex = outerLoops.pushBounds(0, inputOperand, 0);
+  int gIndex = -1;
+  if (group > 1)
+    gIndex = outerLoops.pushBounds(0, group);
+  if (inputShape[0] != 1)
+    outerLoops.parallel(nIndex);
+  else if (group > 1)
+    outerLoops.parallel(gIndex);
+  outerLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+
+  // 3. Emit the matrix multiplication of the image and the group.
+  Value n = outerLoops.getInductionVar(nIndex);
+  Value g = group > 1 ? outerLoops.getInductionVar(gIndex) : nullptr;
+  Value zero;
+  if (llvm::is_contained(isChecked, true))
+    zero = emitConstantOp(rewriter, loc, elementType, 0);
+  // Index of the kernel: g * M/group + m.
+  auto getKernel = [&](Value m) -> Value {
+    if (!g)
+      return m;
+    return apply(d0 * kernelsPerGroup + d1, {g, m});
+  };
+  // Index of the kernel spatial dimension i in a row of im2col.
+  auto getKernelIndex = [&](Value q, int i) {
+    return apply(d0.floorDiv(kernelStrides[i]) % kernelShape[i + 2], q);
+  };
+  // Index of the output spatial dimension i in a column of im2col.
+  auto getResultIndex = [&](Value p, int i) {
+    return apply(d0.floorDiv(resultStrides[i]) % resultShape[i + 2], p);
+  };
+
+  emitPackedGemm(rewriter, loc, elementType, {kernelsPerGroup, nullptr},
+      {outputSize, nullptr}, {subchannels * kernelSize, nullptr},
+      [&](Value m, Value q) -> Value {
+        // K[g * M/group + m][c][k1]...[kdim]
+        SmallVector<Value, 4> kernelIndices;
+        kernelIndices.emplace_back(getKernel(m));
+        kernelIndices.emplace_back(apply(d0.floorDiv(kernelSize), q));
+        for (int i = 0; i < nSpatialDims; ++i)
+          kernelIndices.emplace_back(getKernelIndex(q, i));
+        return rewriter.create<LoadOp>(loc, kernelOperand, kernelIndices);
+      },
+      [&](Value q, Value p) -> Value {
+        // D[n][g * C/group + c][s1 * r1 + d1 * k1 - p1]...
+        SmallVector<Value, 4> dataIndices;
+        dataIndices.emplace_back(n);
+        auto c = d0.floorDiv(kernelSize);
+        dataIndices.emplace_back(
+            g ? apply(d1 * subchannels + c, {q, g}) : apply(c, q));
+        for (int i = 0; i < nSpatialDims; ++i) {
+          auto r = d0.floorDiv(resultStrides[i]) % resultShape[i + 2];
+          auto k = d1.floorDiv(kernelStrides[i]) % kernelShape[i + 2];
+          dataIndices.emplace_back(
+              apply(r * strides[i] + k * dilations[i] - pads[i], {p, q}));
+        }
+        return emitLoadOrPadding(
+            rewriter, loc, inputOperand, dataIndices, isChecked, zero);
+      },
+      [&](Value m, Value p, Value value) {
+        // R[n][g * M/group + m][r1]...[rdim] += value
+        SmallVector<Value, 4> resultIndices;
+        resultIndices.emplace_back(n);
+        resultIndices.emplace_back(getKernel(m));
+        for (int i = 0; i < nSpatialDims; ++i)
+          resultIndices.emplace_back(getResultIndex(p, i));
+        auto loadPartialSum =
+            rewriter.create<LoadOp>(loc, alloc, resultIndices);
+        Value result = rewriter.create<AddFOp>(loc, loadPartialSum, value);
+        if (isSingleReductionTile)
+          result = emitConvActivation(rewriter, loc, epilogue, result);
+        rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+      },
+      /*alpha=*/nullptr);
+
+  // 4. Apply the activation once the output is accumulated.
+  if (!isSingleReductionTile && !epilogue.activation.empty()) {
+    rewriter.setInsertionPointAfter(
+        outerLoops.getIterateBlock()->getParentOp());
+    emitConvActivationInPlace(rewriter, loc, epilogue, alloc);
+  }
+}
+
+// Check whether a convolution is pointwise, i.e. has a single group, kernels
+// of spatial size 1 x ... x 1, unit strides and no padding, and is better
+// computed as a single matrix multiplication over the whole batch, see
+// emitConvAsPointwiseGemm. The sizes other than the batch size must be known
+// at compile time.
+template <typename ConvOp>
+bool isConvProfitableAsPointwiseGemm(ConvOp convOp,
+    ArrayRef<int64_t> kernelShape, ArrayRef<int64_t> resultShape,
+    int64_t group, Type elementType) {
+  if (group != 1)
+    return false;
+  for (auto dim : kernelShape)
+    if (dim < 0)
+      return false;
+  for (int i = 2; i < kernelShape.size(); ++i)
+    if (kernelShape[i] != 1)
+      return false;
+  for (int i = 1; i < resultShape.size(); ++i)
+    if (resultShape[i] < 0)
+      return false;
+  if (auto stridesAttribute = convOp.stridesAttr())
+    for (auto stride : stridesAttribute.getValue())
+      if (stride.cast<IntegerAttr>().getInt() != 1)
+        return false;
+  if (auto padsAttribute = convOp.padsAttr())
+    for (auto pad : padsAttribute.getValue())
+      if (pad.cast<IntegerAttr>().getInt() != 0)
+        return false;
+
+  int64_t gemmM = kernelShape[0];
+  int64_t gemmK = kernelShape[1];
+  int64_t gemmN = std::max<int64_t>(resultShape[0], 1);
+  for (int i = 2; i < resultShape.size(); ++i)
+    gemmN *= resultShape[i];
+  int64_t vectorWidth =
+      targetVectorSizeInBytes * 8 / elementType.getIntOrFloatBitWidth();
+  return gemmM >= registerTileRows && gemmN >= vectorWidth &&
+         gemmM * gemmN * gemmK >= minConvGemmWork;
+}
+
+// Emit R = Conv(D, K) for a pointwise convolution, see
+// isConvProfitableAsPointwiseGemm. Each output element is the dot product of
+// a kernel with the channels of the input element at the same position, so
+// that the convolution of the whole batch is a single matrix multiplication:
+//
+// R'[m][n * R1 * ... * Rdim + p] =
+//     sum_c K[m][c][0]...[0] * D'[c][n * R1 * ... * Rdim + p]
+//
+// where D' and R' are C x (N * R1 * ... * Rdim) and M x (N * R1 * ... * Rdim)
+// views of the input and of the output, whose columns are the positions of
+// all the images of the batch. The views are read and written in place: no
+// im2col matrix is gathered and no bounds are checked. Folding the images
+// into the columns gives the GEMM kernel larger matrices than one
+// multiplication per image would, which matters for the small images of the
+// last layers of a network. The epilogue is applied as in emitConvAsGemm.
+void emitConvAsPointwiseGemm(ConversionPatternRewriter &rewriter,
+    Location loc, const ConvEpilogue &epilogue, Value inputOperand,
+    Value kernelOperand, Value alloc) {
+  auto context = rewriter.getContext();
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto resultShape = memRefType.getShape();
+  auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+  int64_t nSpatialDims = kernelShape.size() - 2;
+  int64_t kernels = kernelShape[0];
+  int64_t channels = kernelShape[1];
+  bool isSingleReductionTile = channels <= l1TileReduction;
+
+  // Strides of the flattened output spatial dimensions.
+  SmallVector<int64_t, 4> resultStrides(nSpatialDims, 1);
+  for (int i = nSpatialDims - 2; i >= 0; --i)
+    resultStrides[i] = resultStrides[i + 1] * resultShape[i + 3];
+  int64_t imageSize = resultStrides[0] * resultShape[2];
+
+  auto apply = [&](AffineExpr expr, ArrayRef<Value> operands) -> Value {
+    return rewriter.create<AffineApplyOp>(
+        loc, AffineMap::get(operands.size(), 0, expr), operands);
+  };
+  auto d0 = getAffineDimExpr(0, context);
+  // Indices of the element of the input or of the output at the given
+  // channel, in the column p of its view.
+  auto getViewIndices = [&](Value channel, Value p) {
+    SmallVector<Value, 4> indices;
+    indices.emplace_back(apply(d0.floorDiv(imageSize), p));
+    indices.emplace_back(channel);
+    for (int i = 0; i < nSpatialDims; ++i)
+      indices.emplace_back(
+          apply(d0.floorDiv(resultStrides[i]) % resultShape[i + 2], p));
+    return indices;
+  };
+
+  // 1. Fill the output with the bias, or with zeros.
+  if (epilogue.bias)
+    emitBiasFill(rewriter, loc, epilogue.bias, alloc);
+  else
+    emitZeroFill(rewriter, loc, alloc);
+
+  // 2. Emit the matrix multiplication over the whole batch.
+  GemmSize columns = {resultShape[0] * imageSize, nullptr};
+  if (resultShape[0] < 0) {
+    auto batchSize = rewriter.create<DimOp>(loc, alloc, 0);
+    auto imageSizeValue = rewriter.create<ConstantIndexOp>(loc, imageSize);
+    columns = {-1, rewriter.create<MulIOp>(loc, batchSize, imageSizeValue)};
+  }
+  Value zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+  emitPackedGemm(rewriter, loc, elementType, {kernels, nullptr}, columns,
+      {channels, nullptr},
+      [&](Value m, Value c) -> Value {
+        // K[m][c][0]...[0]
+        SmallVector<Value, 4> kernelIndices = {m, c};
+        kernelIndices.append(nSpatialDims, zeroIndex);
+        return rewriter.create<LoadOp>(loc, kernelOperand, kernelIndices);
+      },
+      [&](Value c, Value p) -> Value {
+        // D[n][c][r1]...[rdim]
+        return rewriter.create<LoadOp>(
+            loc, inputOperand, getViewIndices(c, p));
+      },
+      [&](Value m, Value p, Value value) {
+        // R[n][m][r1]...[rdim] += value
+        auto resultIndices = getViewIndices(m, p);
+        auto loadPartialSum =
+            rewriter.create<LoadOp>(loc, alloc, resultIndices);
+        Value result = rewriter.create<AddFOp>(loc, loadPartialSum, value);
+        if (isSingleReductionTile)
+          result = emitConvActivation(rewriter, loc, epilogue, result);
+        rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+      },
+      /*alpha=*/nullptr);
+
+  // 3. Apply the activation once the output is accumulated.
+  if (!isSingleReductionTile && !epilogue.activation.empty())
+    emitConvActivationInPlace(rewriter, loc, epilogue, alloc);
+}
+
+// Maximum number of input channels per group of a convolution computed by
+// the depthwise kernel, see isConvProfitableAsDepthwise.
+const int64_t maxDepthwiseSubchannels = 4;
+
+// Check whether a grouped convolution is better computed by the depthwise
+// kernel, see emitConvAsDepthwise. With few input channels per group, e.g.
+// a single one for depthwise convolutions, the reduction computing each
+// output element is too short to be vectorized or to amortize the packing of
+// a matrix multiplication. The depthwise kernel vectorizes along the rows of
+// the output instead, which requires a unit stride along the innermost
+// spatial dimension and rows filling at least one vector. The shapes of the
+// kernel and of the output must be known at compile time.
+template <typename ConvOp>
+bool isConvProfitableAsDepthwise(ConvOp convOp,
+    ArrayRef<int64_t> kernelShape, ArrayRef<int64_t> resultShape,
+    int64_t group, Type elementType) {
+  if (group == 1 || kernelShape[1] > maxDepthwiseSubchannels)
+    return false;
+  for (auto dim : kernelShape)
+    if (dim < 0)
+      return false;
+  for (int i = 2; i < resultShape.size(); ++i)
+    if (resultShape[i] < 0)
+      return false;
+  if (auto stridesAttribute = convOp.stridesAttr()) {
+    auto strides = stridesAttribute.getValue();
+    if (strides.back().cast<IntegerAttr>().getInt() != 1)
+      return false;
+  }
+  int64_t vectorWidth =
+      targetVectorSizeInBytes * 8 / elementType.getIntOrFloatBitWidth();
+  return resultShape.back() >= vectorWidth;
+}
+
+// Emit R = Conv(D, K) for a grouped convolution with few input channels per
+// group, see isConvProfitableAsDepthwise. In two dimensions:
+//
+// for n = 0 .. N:
+//   for g = 0 .. group:
+//     for m = 0 .. M/group:
+//       kernel = g * M/group + m
+//       for r1 = 0 .. R1:
+//         for r2 = 0 .. R2:
+//           R[n][kernel][r1][r2] = B[kernel]
+//         for c = 0 .. C/group:
+//           for k1 = 0 .. K1:
+//             for k2 = 0 .. K2:
+//               for r2 = 0 .. R2:
+//                 R[n][kernel][r1][r2] +=
+//                     D[n][g * C/group + c][s1 * r1 + d1 * k1 - p1]
+//                      [r2 + d2 * k2 - p2] * K[kernel][c][k1][k2]
+//         for r2 = 0 .. R2:
+//           R[n][kernel][r1][r2] = activation(R[n][kernel][r1][r2])
+//
+// The innermost loops run along a row of the output and a row of the input,
+// and are vectorized, the weight being broadcast. Each row of the output is
+// initialized, accumulated into and activated while it stays in the cache.
+// As in the direct loop nest, the rows are split into border regions, whose
+// accesses to the data are bounds checked and left scalar, and an interior
+// region.
+template <typename ConvOp>
+void emitConvAsDepthwise(ConversionPatternRewriter &rewriter, Location loc,
+    ConvOp convOp, const ConvEpilogue &epilogue, Value inputOperand,
+    Value kernelOperand, Value alloc, int64_t group) {
+  auto context = rewriter.getContext();
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto resultShape = memRefType.getShape();
+  auto inputShape = inputOperand.getType().cast<MemRefType>().getShape();
+  auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+  int64_t nSpatialDims = kernelShape.size() - 2;
+  int64_t kernelsPerGroup = kernelShape[0] / group;
+  int64_t subchannels = kernelShape[1];
+  int64_t vectorWidth =
+      targetVectorSizeInBytes * 8 / elementType.getIntOrFloatBitWidth();
+
+  // Strides, dilations and pads of the convolution, and the regions of the
+  // output whose accesses to the data must be bounds checked.
+  SmallVector<int64_t, 4> strides(nSpatialDims, 1);
+  if (auto stridesAttribute = convOp.stridesAttr())
+    for (auto stride : llvm::enumerate(stridesAttribute.getValue()))
+      strides[stride.index()] = stride.value().cast<IntegerAttr>().getInt();
+  SmallVector<int64_t, 4> dilations(nSpatialDims, 1);
+  if (auto dilationsAttribute = convOp.dilationsAttr())
+    for (auto dilation : llvm::enumerate(dilationsAttribute.getValue()))
+      dilations[dilation.index()] =
+          dilation.value().cast<IntegerAttr>().getInt();
+  SmallVector<int64_t, 4> pads(2 * nSpatialDims, 0);
+  if (auto padsAttribute = convOp.padsAttr())
+    for (auto pad : llvm::enumerate(padsAttribute.getValue()))
+      pads[pad.index()] = pad.value().cast<IntegerAttr>().getInt();
+  auto regions = getSlidingWindowRegions(inputShape.drop_front(2),
+      resultShape.drop_front(2), kernelShape.drop_front(2), pads, strides,
+      dilations);
+
+  auto apply = [&](AffineExpr expr, ArrayRef<Value> operands) -> Value {
+    return rewriter.create<AffineApplyOp>(
+        loc, AffineMap::get(operands.size(), 0, expr), operands);
+  };
+  auto d0 = getAffineDimExpr(0, context);
+  auto d1 = getAffineDimExpr(1, context);
+
+  // 1. Iterate over the images and the kernels. The outermost of these loops
+  // running more than one iteration is parallel.
+  BuildKrnlLoop outerLoops(rewriter, loc, 3);
+  outerLoops.createDefineAndOptimizeOp();
+  int nIndex = outerLoops.pushBounds(0, inputOperand, 0);
+  int gIndex = outerLoops.pushBounds(0, group);
+  int mIndex = outerLoops.pushBounds(0, kernelsPerGroup);
+  if (inputShape[0] != 1)
+    outerLoops.parallel(nIndex);
+  else
+    outerLoops.parallel(gIndex);
+  outerLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+
+  Value n = outerLoops.getInductionVar(nIndex);
+  Value g = outerLoops.getInductionVar(gIndex);
+  Value kernel = g;
+  if (kernelsPerGroup != 1)
+    kernel = apply(d0 * kernelsPerGroup + d1,
+        {g, outerLoops.getInductionVar(mIndex)});
+  // The output is initialized with the bias of the kernel, if any.
+  auto zero = emitConstantOp(rewriter, loc, elementType, 0);
+  Value initialValue = zero;
+  if (epilogue.bias)
+    initialValue =
+        rewriter.create<LoadOp>(loc, epilogue.bias, ArrayRef<Value>{kernel});
+
+  // 2. Emit the rows of each region of the output.
+  for (auto &region : regions) {
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    bool isInterior = !llvm::is_contained(region.isBorder, true);
+
+    // 2.1 Iterate over the rows of the region: r1 .. r(dim - 1).
+    SmallVector<Value, 4> rowIndices = {n, kernel};
+    if (nSpatialDims > 1) {
+      BuildKrnlLoop rowLoops(rewriter, loc, nSpatialDims - 1);
+      rowLoops.createDefineAndOptimizeOp();
+      for (int i = 0; i < nSpatialDims - 1; ++i) {
+        if (region.upperBounds[i] < 0)
+          rowLoops.pushBounds(0, alloc, i + 2);
+        else
+          rowLoops.pushBounds(region.lowerBounds[i], region.upperBounds[i]);
+      }
+      rowLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(rowLoops.getIterateBlock());
+      for (auto arg : rowLoops.getIterateBlock()->getArguments())
+        rowIndices.emplace_back(arg);
+    }
+
+    // Emit a loop nest over the given sizes, then along the row of the
+    // region, and set the insertion point in its body. Return its induction
+    // variables.
+    auto emitRowLoopNest = [&](ArrayRef<int64_t> sizes, bool isVectorized) {
+      BuildKrnlLoop loops(rewriter, loc, sizes.size() + 1);
+      loops.createDefineAndOptimizeOp();
+      for (auto size : sizes)
+        loops.pushBounds(0, size);
+      int rIndex;
+      if (region.upperBounds.back() < 0)
+        rIndex = loops.pushBounds(0, alloc, nSpatialDims + 1);
+      else
+        rIndex = loops.pushBounds(
+            region.lowerBounds.back(), region.upperBounds.back());
+      if (isVectorized)
+        loops.vectorize(rIndex, vectorWidth);
+      loops.createIterateOp();
+      rewriter.setInsertionPointToStart(loops.getIterateBlock());
+      auto arguments = loops.getIterateBlock()->getArguments();
+      return SmallVector<Value, 4>(arguments.begin(), arguments.end());
+    };
+
+    // 2.2 Initialize the row: R[n][kernel][r1][r2] = B[kernel].
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      auto ivs = emitRowLoopNest({}, /*isVectorized=*/true);
+      SmallVector<Value, 4> resultIndices(rowIndices);
+      resultIndices.emplace_back(ivs[0]);
+      rewriter.create<StoreOp>(loc, initialValue, alloc, resultIndices);
+    }
+
+    // 2.3 Accumulate the products of the rows of the data by each weight of
+    // the kernel.
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      SmallVector<int64_t, 4> sizes = {subchannels};
+      sizes.append(kernelShape.begin() + 2, kernelShape.end());
+      auto ivs = emitRowLoopNest(sizes, isInterior);
+      SmallVector<Value, 4> resultIndices(rowIndices);
+      resultIndices.emplace_back(ivs.back());
+
+      // D[n][g * C/group + c][s1 * r1 + d1 * k1 - p1]...
+      SmallVector<Value, 4> dataIndices;
+      SmallVector<bool, 4> isChecked(2, false);
+      dataIndices.emplace_back(n);
+      if (subchannels == 1)
+        dataIndices.emplace_back(g);
+      else
+        dataIndices.emplace_back(apply(d0 * subchannels + d1, {g, ivs[0]}));
+      for (int i = 0; i < nSpatialDims; ++i) {
+        dataIndices.emplace_back(emitSlidingWindowIndex(rewriter, loc,
+            resultIndices[i + 2], ivs[i + 1], strides[i], dilations[i],
+            pads[i]));
+        isChecked.emplace_back(region.isBorder[i]);
+      }
+      // K[kernel][c][k1]...[kdim]
+      SmallVector<Value, 4> kernelIndices = {kernel};
+      kernelIndices.append(ivs.begin(), ivs.end() - 1);
+
+      auto loadData = emitLoadOrPadding(
+          rewriter, loc, inputOperand, dataIndices, isChecked, zero);
+      auto loadKernel =
+          rewriter.create<LoadOp>(loc, kernelOperand, kernelIndices);
+      auto loadPartialSum = rewriter.create<LoadOp>(loc, alloc, resultIndices);
+      Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+          rewriter.create<MulFOp>(loc, loadData, loadKernel));
+      rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+    }
+
+    // 2.4 Apply the activation to the row once it is accumulated.
+    if (!epilogue.activation.empty()) {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      auto ivs = emitRowLoopNest({}, /*isVectorized=*/true);
+      SmallVector<Value, 4> resultIndices(rowIndices);
+      resultIndices.emplace_back(ivs[0]);
+      auto loadResult = rewriter.create<LoadOp>(loc, alloc, resultIndices);
+      auto activation = emitConvActivation(rewriter, loc, epilogue, loadResult);
+      rewriter.create<StoreOp>(loc, activation, alloc, resultIndices);
+    }
+  }
+}
+
+// Minimum number of input and output channels of a convolution computed with
+// the Winograd algorithm. Its transforms cost a number of operations
+// proportional to the number of channels, while the multiplications it saves
+// are proportional to the product of the numbers of input and output channels.
+const int64_t minWinogradChannels = 16;
+
+// Check whether a convolution is better computed with the Winograd algorithm,
+// see emitConvAsWinograd. It applies to 2-D convolutions with 3x3 kernels,
+// unit strides and dilations and a single group, whose shapes are known at
+// compile time.
+template <typename ConvOp>
+bool isConvProfitableAsWinograd(ConvOp convOp,
+    ArrayRef<int64_t> inputShape, ArrayRef<int64_t> kernelShape,
+    ArrayRef<int64_t> resultShape, int64_t group, Type elementType) {
+  if (!elementType.isa<FloatType>() || group != 1 || kernelShape.size() != 4)
+    return false;
+  for (auto shape : {inputShape, kernelShape, resultShape})
+    for (auto dim : shape)
+      if (dim < 0)
+        return false;
+  if (kernelShape[2] != 3 || kernelShape[3] != 3)
+    return false;
+  for (auto attribute : {convOp.stridesAttr(), convOp.dilationsAttr()})
+    if (attribute)
+      for (auto value : attribute.getValue())
+        if (value.cast<IntegerAttr>().getInt() != 1)
+          return false;
+  return kernelShape[0] >= minWinogradChannels &&
+         kernelShape[1] >= minWinogradChannels;
+}
+
+// Transforms of the Winograd minimal filtering algorithm F(m x m, 3 x 3),
+// which computes a m x m tile of the output from a (m + 2) x (m + 2) tile of
+// the input, see Lavin & Gray, "Fast Algorithms for Convolutional Neural
+// Networks". The matrices are stored row-major:
+//   G:  (m + 2) x 3, transforming the kernels,
+//   BT: (m + 2) x (m + 2), transforming the tiles of the input,
+//   AT: m x (m + 2), transforming the products into tiles of the output.
+struct WinogradTransforms {
+  int64_t tileSize;
+  ArrayRef<double> G;
+  ArrayRef<double> BT;
+  ArrayRef<double> AT;
+};
+
+// Get the transforms of F(2x2, 3x3) or F(4x4, 3x3). The latter saves 4x the
+// multiplications of the direct convolution instead of 2.25x, but wastes more
+// work on partial tiles of small outputs, and its larger coefficients lose
+// too much precision on half-precision floats.
+WinogradTransforms getWinogradTransforms(
+    ArrayRef<int64_t> resultShape, Type elementType) {
+  static const double f2x2G[] = {
+      1, 0, 0,
+      0.5, 0.5, 0.5,
+      0.5, -0.5, 0.5,
+      0, 0, 1};
+  static const double f2x2BT[] = {
+      1, 0, -1, 0,
+      0, 1, 1, 0,
+      0, -1, 1, 0,
+      0, 1, 0, -1};
+  static const double f2x2AT[] = {
+      1, 1, 1, 0,
+      0, 1, -1, -1};
+  static const double f4x4G[] = {
+      1.0 / 4, 0, 0,
+      -1.0 / 6, -1.0 / 6, -1.0 / 6,
+      -1.0 / 6, 1.0 / 6, -1.0 / 6,
+      1.0 / 24, 1.0 / 12, 1.0 / 6,
+      1.0 / 24, -1.0 / 12, 1.0 / 6,
+      0, 0, 1};
+  static const double f4x4BT[] = {
+      4, 0, -5, 0, 1, 0,
+      0, -4, -4, 1, 1, 0,
+      0, 4, -4, -1, 1, 0,
+      0, -2, -1, 2, 1, 0,
+      0, 2, -1, -2, 1, 0,
+      0, 4, 0, -5, 0, 1};
+  static const double f4x4AT[] = {
+      1, 1, 1, 1, 1, 0,
+      0, 1, -1, 2, -2, 0,
+      0, 1, 1, 4, 4, 0,
+      0, 1, -1, 8, -8, 1};
+
+  if (elementType.getIntOrFloatBitWidth() >= 32 && resultShape[2] >= 8 &&
+      resultShape[3] >= 8)
+    return {4, f4x4G, f4x4BT, f4x4AT};
+  return {2, f2x2G, f2x2BT, f2x2AT};
+}
+
+// Emit the p x p matrix L X LT, where L is a p x q matrix of constant
+// coefficients and X a q x q matrix of values, both stored row-major.
+// Products by 0, 1 and -1 are folded.
+SmallVector<Value, 36> emitWinogradTransform(
+    ConversionPatternRewriter &rewriter, Location loc, ArrayRef<double> L,
+    int64_t p, int64_t q, ArrayRef<Value> X) {
+  auto elementType = X.front().getType();
+  std::map<double, Value> constants;
+  auto emitLinearCombination = [&](ArrayRef<double> coefficients,
+                                   ArrayRef<Value> values) -> Value {
+    Value sum;
+    for (int k = 0; k < coefficients.size(); ++k) {
+      double coefficient = coefficients[k];
+      if (coefficient == 0)
+        continue;
+      Value term = values[k];
+      if (sum && coefficient == 1) {
+        sum = rewriter.create<AddFOp>(loc, sum, term);
+        continue;
+      }
+      if (sum && coefficient == -1) {
+        sum = rewriter.create<SubFOp>(loc, sum, term);
+        continue;
+      }
+      if (coefficient != 1) {
+        Value &constant = constants[coefficient];
+        if (!constant)
+          constant = emitConstantOp(rewriter, loc, elementType, coefficient);
+        term = rewriter.create<MulFOp>(loc, constant, term);
+      }
+      if (sum)
+        sum = rewriter.create<AddFOp>(loc, sum, term);
+      else
+        sum = term;
+    }
+    return sum;
+  };
+
+  // LX = L X, of size p x q.
+  SmallVector<Value, 36> LX;
+  for (int i = 0; i < p; ++i)
+    for (int j = 0; j < q; ++j) {
+      SmallVector<Value, 6> column;
+      for (int k = 0; k < q; ++k)
+        column.emplace_back(X[k * q + j]);
+      LX.emplace_back(emitLinearCombination(L.slice(i * q, q), column));
+    }
+  // LX LT, of size p x p.
+  SmallVector<Value, 36> result;
+  for (int i = 0; i < p; ++i)
+    for (int j = 0; j < p; ++j)
+      result.emplace_back(emitLinearCombination(
+          L.slice(j * q, q), llvm::makeArrayRef(LX).slice(i * q, q)));
+  return result;
+}
+
+// Compute the p x p matrix L X LT at compile time, see emitWinogradTransform.
+SmallVector<double, 36> computeWinogradTransform(
+    ArrayRef<double> L, int64_t p, int64_t q, ArrayRef<double> X) {
+  // LX = L X, of size p x q.
+  SmallVector<double, 36> LX(p * q, 0);
+  for (int i = 0; i < p; ++i)
+    for (int j = 0; j < q; ++j)
+      for (int k = 0; k < q; ++k)
+        LX[i * q + j] += L[i * q + k] * X[k * q + j];
+  // LX LT, of size p x p.
+  SmallVector<double, 36> result(p * p, 0);
+  for (int i = 0; i < p; ++i)
+    for (int j = 0; j < p; ++j)
+      for (int k = 0; k < q; ++k)
+        result[i * p + j] += L[j * q + k] * LX[i * q + k];
+  return result;
+}
+
+// Emit R = Conv(D, K) with the Winograd algorithm F(m x m, 3 x 3), see
+// isConvProfitableAsWinograd. With a = m + 2, the output of each image is
+// split into T tiles of m x m elements, the tile t being computed from the
+// a x a tile D[n][c](t) of the input it covers:
+//
+// U[xi][k][c] = (G K[k][c] GT)[xi]                for xi = 0 .. a * a
+// V[xi][c][n * T + t] = (BT D[n][c](t) B)[xi]
+// P[xi] = U[xi] x V[xi]
+// R[n][k](t) = AT P[.][k][n * T + t] A
+//
+// The multiplications of the convolution are then those of a * a matrix
+// multiplications of M x C by C x (N * T) matrices computed by the GEMM
+// kernel, i.e. a * a multiply-adds per tile instead of 9 * m * m. The kernels
+// are transformed at compile time into a global buffer when they are an
+// onnx.Constant, and otherwise once per execution of the convolution, which
+// is amortized over all the tiles of the batch. The input is copied into a
+// zero-padded buffer when the convolution is padded or when the output is not
+// made of whole tiles, in which case the output is also computed into a
+// padded buffer and copied back. The epilogue is applied to the tiles of the
+// output as they are transformed.
+template <typename ConvOp>
+void emitConvAsWinograd(ConversionPatternRewriter &rewriter, Location loc,
+    ConvOp convOp, const ConvEpilogue &epilogue, Value inputOperand,
+    Value kernelOperand, Value alloc) {
+  auto context = rewriter.getContext();
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto resultShape = memRefType.getShape();
+  auto inputShape = inputOperand.getType().cast<MemRefType>().getShape();
+  auto kernelShape = kernelOperand.getType().cast<ShapedType>().getShape();
+  auto transforms = getWinogradTransforms(resultShape, elementType);
+  int64_t m = transforms.tileSize;
+  int64_t a = m + 2;
+  int64_t batchSize = inputShape[0];
+  int64_t kernels = kernelShape[0];
+  int64_t channels = kernelShape[1];
+  int64_t tileRows = (resultShape[2] + m - 1) / m;
+  int64_t tileColumns = (resultShape[3] + m - 1) / m;
+  int64_t tiles = batchSize * tileRows * tileColumns;
+
+  // Pads of the convolution: [x1_begin, x2_begin, x1_end, x2_end].
+  SmallVector<int64_t, 4> pads(4, 0);
+  if (auto padsAttribute = convOp.padsAttr())
+    for (auto pad : llvm::enumerate(padsAttribute.getValue()))
+      pads[pad.index()] = pad.value().cast<IntegerAttr>().getInt();
+  bool isPartialTile = tileRows * m != resultShape[2] ||
+                       tileColumns * m != resultShape[3];
+  bool isPadded = llvm::any_of(pads, [](int64_t pad) { return pad != 0; });
+
+  auto apply = [&](AffineExpr expr, ArrayRef<Value> operands) -> Value {
+    return rewriter.create<AffineApplyOp>(
+        loc, AffineMap::get(operands.size(), 0, expr), operands);
+  };
+  auto allocBuffer = [&](ArrayRef<int64_t> shape) -> Value {
+    return rewriter.create<AllocOp>(loc, MemRefType::get(shape, elementType));
+  };
+  auto d0 = getAffineDimExpr(0, context);
+  auto d1 = getAffineDimExpr(1, context);
+  auto d2 = getAffineDimExpr(2, context);
+  SmallVector<Value, 36> positions;
+  for (int xi = 0; xi < a * a; ++xi)
+    positions.emplace_back(rewriter.create<ConstantIndexOp>(loc, xi));
+
+  // Emit a loop nest with the given sizes, the outermost of them running more
+  // than one iteration being parallel, and set the insertion point in its
+  // body. Return its induction variables.
+  auto emitLoopNest = [&](ArrayRef<int64_t> sizes) {
+    BuildKrnlLoop loops(rewriter, loc, sizes.size());
+    loops.createDefineAndOptimizeOp();
+    for (auto size : sizes)
+      loops.pushBounds(0, size);
+    for (int i = 0; i < sizes.size(); ++i)
+      if (sizes[i] != 1) {
+        loops.parallel(i);
+        break;
+      }
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    auto arguments = loops.getIterateBlock()->getArguments();
+    return SmallVector<Value, 4>(arguments.begin(), arguments.end());
+  };
+  // Indices t * m + 0 .. t * m + size - 1 of the rows or columns covered by
+  // the tile t.
+  auto getTileIndices = [&](Value t, int64_t size) {
+    SmallVector<Value, 6> indices;
+    for (int i = 0; i < size; ++i)
+      indices.emplace_back(apply(d0 * m + i, t));
+    return indices;
+  };
+
+  // 1. Transform the kernels: U[xi][k][c] = (G K[k][c] GT)[xi].
+  Value transformedKernels;
+  SmallVector<double, 16> kernelElements;
+  bool isConstantKernel =
+      getONNXConstantElements(convOp.W(), kernelElements);
+  if (isConstantKernel) {
+    SmallVector<Attribute, 16> transformedKernelElements(
+        a * a * kernels * channels);
+    for (int k = 0; k < kernels; ++k)
+      for (int c = 0; c < channels; ++c) {
+        auto kernel = llvm::makeArrayRef(kernelElements)
+                          .slice((k * channels + c) * 9, 9);
+        auto transformed =
+            computeWinogradTransform(transforms.G, a, 3, kernel);
+        for (int xi = 0; xi < a * a; ++xi)
+          transformedKernelElements[(xi * kernels + k) * channels + c] =
+              FloatAttr::get(elementType, transformed[xi]);
+      }
+    SmallVector<int64_t, 3> transformedKernelShape = {
+        a * a, kernels, channels};
+    transformedKernels = rewriter.create<KrnlGlobalOp>(loc,
+        MemRefType::get(transformedKernelShape, elementType),
+        DenseElementsAttr::get(
+            RankedTensorType::get(transformedKernelShape, elementType),
+            transformedKernelElements));
+  } else {
+    transformedKernels = allocBuffer({a * a, kernels, channels});
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    auto ivs = emitLoopNest({kernels, channels});
+    SmallVector<Value, 9> kernel;
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j)
+        kernel.emplace_back(rewriter.create<LoadOp>(loc, kernelOperand,
+            ArrayRef<Value>{ivs[0], ivs[1], positions[i], positions[j]}));
+    auto transformed =
+        emitWinogradTransform(rewriter, loc, transforms.G, a, 3, kernel);
+    for (int xi = 0; xi < a * a; ++xi)
+      rewriter.create<StoreOp>(loc, transformed[xi], transformedKernels,
+          ArrayRef<Value>{positions[xi], ivs[0], ivs[1]});
+  }
+
+  // 2. Transform the input: V[xi][c][n * T + t] = (BT D[n][c](t) B)[xi].
+  Value data = inputOperand;
+  if (isPadded || isPartialTile) {
+    data = allocBuffer(
+        {batchSize, channels, tileRows * m + 2, tileColumns * m + 2});
+    emitZeroFill(rewriter, loc, data);
+    emitCopyOrZeroFill(
+        rewriter, loc, inputOperand, data, {0, 0, pads[0], pads[1]});
+  }
+  Value transformedData = allocBuffer({a * a, channels, tiles});
+  {
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    auto ivs = emitLoopNest({batchSize, channels, tileRows, tileColumns});
+    auto tile = apply(d0 * (tileRows * tileColumns) + d1 * tileColumns + d2,
+        {ivs[0], ivs[2], ivs[3]});
+    auto rows = getTileIndices(ivs[2], a);
+    auto columns = getTileIndices(ivs[3], a);
+    SmallVector<Value, 36> input;
+    for (int i = 0; i < a; ++i)
+      for (int j = 0; j < a; ++j)
+        input.emplace_back(rewriter.create<LoadOp>(
+            loc, data, ArrayRef<Value>{ivs[0], ivs[1], rows[i], columns[j]}));
+    auto transformed =
+        emitWinogradTransform(rewriter, loc, transforms.BT, a, a, input);
+    for (int xi = 0; xi < a * a; ++xi)
+      rewriter.create<StoreOp>(loc, transformed[xi], transformedData,
+          ArrayRef<Value>{positions[xi], ivs[1], tile});
+  }
+  if (data != inputOperand)
+    rewriter.create<DeallocOp>(loc, data);
+
+  // 3. Multiply the transforms: P[xi] = U[xi] x V[xi].
+  Value products = allocBuffer({a * a, kernels, tiles});
+  emitZeroFill(rewriter, loc, products);
+  {
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    BuildKrnlLoop positionLoop(rewriter, loc, 1);
+    positionLoop.createDefineAndOptimizeOp();
+    positionLoop.pushBounds(0, a * a);
+    positionLoop.createIterateOp();
+    rewriter.setInsertionPointToStart(positionLoop.getIterateBlock());
+    Value xi = positionLoop.getInductionVar(0);
+    emitPackedGemm(rewriter, loc, transformedKernels, xi,
+        /*isTransA=*/false, transformedData, xi, /*isTransB=*/false, products,
+        xi, /*alpha=*/nullptr);
+  }
+  rewriter.create<DeallocOp>(loc, transformedData);
+  if (!isConstantKernel)
+    rewriter.create<DeallocOp>(loc, transformedKernels);
+
+  // 4. Transform the products: R[n][k](t) = AT P[.][k][n * T + t] A.
+  Value result = alloc;
+  if (isPartialTile)
+    result = allocBuffer({batchSize, kernels, tileRows * m, tileColumns * m});
+  {
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    auto ivs = emitLoopNest({batchSize, kernels, tileRows, tileColumns});
+    auto tile = apply(d0 * (tileRows * tileColumns) + d1 * tileColumns + d2,
+        {ivs[0], ivs[2], ivs[3]});
+    SmallVector<Value, 36> product;
+    for (int xi = 0; xi < a * a; ++xi)
+      product.emplace_back(rewriter.create<LoadOp>(
+          loc, products, ArrayRef<Value>{positions[xi], ivs[1], tile}));
+    auto transformed =
+        emitWinogradTransform(rewriter, loc, transforms.AT, m, a, product);
+    Value bias;
+    if (epilogue.bias)
+      bias = rewriter.create<LoadOp>(
+          loc, epilogue.bias, ArrayRef<Value>{ivs[1]});
+    auto rows = getTileIndices(ivs[2], m);
+    auto columns = getTileIndices(ivs[3], m);
+    for (int i = 0; i < m; ++i)
+      for (int j = 0; j < m; ++j) {
+        Value value = transformed[i * m + j];
+        if (bias)
+          value = rewriter.create<AddFOp>(loc, value, bias);
+        value = emitConvActivation(rewriter, loc, epilogue, value);
+        rewriter.create<StoreOp>(loc, value, result,
+            ArrayRef<Value>{ivs[0], ivs[1], rows[i], columns[j]});
+      }
+  }
+  rewriter.create<DeallocOp>(loc, products);
+  if (result != alloc) {
+    emitCopyOrZeroFill(rewriter, loc, result, alloc);
+    rewriter.create<DeallocOp>(loc, result);
+  }
+}
+
+// Lower onnx.ConvNoBias, onnx.Conv and onnx.ConvActivation, the latter two
+// applying their epilogue to the output, see ConvEpilogue.
+template <typename ConvOp>
+struct ONNXConvOpLowering : public ConversionPattern {
+  ONNXConvOpLowering(MLIRContext *ctx)
+      : ConversionPattern(ConvOp::getOperationName(), 1, ctx) {}
 
   PatternMatchResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
     auto loc = op->getLoc();
+    ConvOp convOp = llvm::dyn_cast<ConvOp>(op);
+    auto epilogue = getConvEpilogue(convOp, operands);
+    if (!isSupportedActivation(epilogue.activation)) {
+      emitError(loc, "unsupported activation: ") << epilogue.activation;
+      return matchFailure();
+    }
     // Insert an allocation and deallocation for the result of this operation.
     auto memRefType = convertToMemRefType(*op->result_type_begin());
     Value alloc;
     bool insertDealloc = checkInsertDealloc(op);
-    ONNXConvNoBiasOp convOp = llvm::dyn_cast<ONNXConvNoBiasOp>(op);
 
     if (hasAllConstantDimensions(memRefType))
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
@@ -35,13 +1154,15 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
     auto &inputOperand = operands[0];
     auto inputShape = inputOperand.getType().cast<MemRefType>().getShape();
     auto &kernelOperand = operands[1];
-    auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+    // Constant kernels transformed at compile time are not read from a
+    // buffer, and may be left as a tensor.
+    auto kernelShape = kernelOperand.getType().cast<ShapedType>().getShape();
 
-    // R = ConvNoBias(D, K)
+    // R = Conv(D, K, B)
     //
     // The input/output shapes will look like this:
     //
-    // D (NxCxHxW) x K (MxC/groupxKHxKW) -> R (NxMxRHxRW)
+    // D (NxCxHxW) x K (MxC/groupxKHxKW) x B (M) -> R (NxMxRHxRW)
     //
     // M is a multiple of the number of groups:
     //   M = group * kernelsPerGroup
@@ -57,20 +1178,28 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
     //       kernel = g * kernelsPerGroup + m;
     //       for r1 = 0 .. RH:
     //         for r2 = 0 .. RW:
-    //           R[n][kernel][r1][r2] = 0;
+    //           R[n][kernel][r1][r2] = B[kernel];
     //           for c = 0 .. C/group:
     //             for k1 = 0 .. KH:
     //               for k2 = 0 .. KW:
-    //                 R[n][kernel][r1][r2] =
+    //                 R[n][kernel][r1][r2] +=
     //                   D[n][g * (C / group) + c][s1 * r1 + k1][s2 * r2 + k2] *
     //                   K[kernel][c][k1][k2];
+    //           R[n][kernel][r1][r2] = activation(R[n][kernel][r1][r2]);
+    //
+    // The bias is zero for onnx.ConvNoBias and the activation is the
+    // identity unless the operation is onnx.ConvActivation.
     //
     // Naming:
     //   n, g, m: outer loop nest indices
     //   r1, r2: spatial loop nest indices
     //   c, k1, k2: inner loop nest indices
     //
-    // TODO: handle padding.
+    // With dilations [d1, d2] and pads [p1_begin, p2_begin, ...], the data
+    // is accessed at D[...][s1 * r1 + d1 * k1 - p1_begin][...], the elements
+    // out of the bounds of D reading as zeros. The spatial loop nest is then
+    // split into border regions, where these accesses are bounds checked, and
+    // an interior region free of checks, see getSlidingWindowRegions.
     //
     // In the general case:
     //
@@ -90,6 +1219,34 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
     // Compute the number of unsplit kernels. The number of kernels
     // must be a multiple of the number of groups.
     int64_t kernelsPerGroup = floor(kernelShape[0] / group);
+    if (isConvProfitableAsWinograd(convOp, inputShape, kernelShape,
+            resultShape, group, memRefType.getElementType())) {
+      emitConvAsWinograd(rewriter, loc, convOp, epilogue, inputOperand,
+          kernelOperand, alloc);
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
+    if (isConvProfitableAsDepthwise(convOp, kernelShape, resultShape, group,
+            memRefType.getElementType())) {
+      emitConvAsDepthwise(rewriter, loc, convOp, epilogue, inputOperand,
+          kernelOperand, alloc, group);
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
+    if (isConvProfitableAsPointwiseGemm(convOp, kernelShape, resultShape,
+            group, memRefType.getElementType())) {
+      emitConvAsPointwiseGemm(
+          rewriter, loc, epilogue, inputOperand, kernelOperand, alloc);
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
+    if (isConvProfitableAsGemm(kernelShape, resultShape, group,
+            memRefType.getElementType())) {
+      emitConvAsGemm(rewriter, loc, convOp, epilogue, inputOperand,
+          kernelOperand, alloc, group);
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
     auto kernelsPerGroupValue =
         rewriter.create<ConstantIndexOp>(loc, kernelsPerGroup);
     auto zero = emitConstantOp(rewriter, loc, memRefType.getElementType(), 0);
@@ -100,6 +1257,26 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
       subchannels = rewriter.create<ConstantIndexOp>(loc, kernelShape[1]);
     }
 
+    // Strides, dilations and pads of the convolution, and the regions of the
+    // output whose accesses to the data must be bounds checked.
+    int64_t nSpatialDims = kernelShape.size() - 2;
+    SmallVector<int64_t, 4> strides(nSpatialDims, 1);
+    if (auto stridesAttribute = convOp.stridesAttr())
+      for (auto stride : llvm::enumerate(stridesAttribute.getValue()))
+        strides[stride.index()] = stride.value().cast<IntegerAttr>().getInt();
+    SmallVector<int64_t, 4> dilations(nSpatialDims, 1);
+    if (auto dilationsAttribute = convOp.dilationsAttr())
+      for (auto dilation : llvm::enumerate(dilationsAttribute.getValue()))
+        dilations[dilation.index()] =
+            dilation.value().cast<IntegerAttr>().getInt();
+    SmallVector<int64_t, 4> pads(2 * nSpatialDims, 0);
+    if (auto padsAttribute = convOp.padsAttr())
+      for (auto pad : llvm::enumerate(padsAttribute.getValue()))
+        pads[pad.index()] = pad.value().cast<IntegerAttr>().getInt();
+    auto regions = getSlidingWindowRegions(inputShape.drop_front(2),
+        resultShape.drop_front(2), kernelShape.drop_front(2), pads, strides,
+        dilations);
+
     // 1. Define outer loops and emit empty optimization block:
     int64_t nOuterLoops = (group > 1) ? 3 : 2;
     BuildKrnlLoop outerLoops(rewriter, loc, nOuterLoops);
@@ -112,6 +1289,17 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
       gIndex = outerLoops.pushBounds(0, group);
     //   for m = 0 .. kernelsPerGroup:
     int mIndex = outerLoops.pushBounds(0, kernelsPerGroup);
+    // Unroll and jam the loop over the kernels, so that the innermost loop
+    // accumulates into several output channels while reusing the same data.
+    outerLoops.unrollJam(mIndex, accumulatorUnrollFactor);
+    // Compute the outermost of these loops that runs more than one iteration
+    // in parallel.
+    if (inputShape[0] != 1)
+      outerLoops.parallel(nIndex);
+    else if (group > 1)
+      outerLoops.parallel(gIndex);
+    else if (kernelsPerGroup != 1)
+      outerLoops.parallel(mIndex);
     // Outer loop iteration
     outerLoops.createIterateOp();
     rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
@@ -130,22 +1318,32 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
         kernel = rewriter.create<AddIOp>(
             loc, kernelsOffset, outerLoops.getInductionVar(mIndex));
       }
+      // The output is initialized with the bias of the kernel, if any.
+      Value initialValue = zero;
+      if (epilogue.bias)
+        initialValue = rewriter.create<LoadOp>(
+            loc, epilogue.bias, ArrayRef<Value>{kernel});
 
-      // 2.2 Define spatial loops
-      int64_t nSpatialLoops = resultShape.size() - 2;
-      BuildKrnlLoop spatialLoops(rewriter, loc, nSpatialLoops);
-      spatialLoops.createDefineAndOptimizeOp();
-      for (int i = 2; i < resultShape.size(); ++i)
-        spatialLoops.pushBounds(0, alloc, i);
+      // 2.2 Emit one spatial loop nest per region of the output.
+      for (auto &region : regions) {
+        PatternRewriter::InsertionGuard insertGuard(rewriter);
+        BuildKrnlLoop spatialLoops(rewriter, loc, nSpatialDims);
+        spatialLoops.createDefineAndOptimizeOp();
+        for (int i = 0; i < nSpatialDims; ++i) {
+          if (region.upperBounds[i] < 0)
+            spatialLoops.pushBounds(0, alloc, i + 2);
+          else
+            spatialLoops.pushBounds(
+                region.lowerBounds[i], region.upperBounds[i]);
+        }
 
-      // 2.4 Emit loop nest over output spatial dimensions.
-      //   for rX = 0 .. RX
-      spatialLoops.createIterateOp();
-      rewriter.setInsertionPointToStart(spatialLoops.getIterateBlock());
+        // 2.3 Emit loop nest over output spatial dimensions.
+        //   for rX = 0 .. RX
+        spatialLoops.createIterateOp();
+        rewriter.setInsertionPointToStart(spatialLoops.getIterateBlock());
 
-      {
         // 3. Emit the body of the spatial loop nest.
-        // 3.1 Emit: R[n][kernel][r1][r2] = 0;
+        // 3.1 Emit: R[n][kernel][r1][r2] = B[kernel];
         SmallVector<Value, 4> resultIndices;
         // n
         resultIndices.emplace_back(outerLoops.getInductionVar(nIndex));
@@ -155,10 +1353,10 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
         for (auto arg : spatialLoops.getIterateBlock()->getArguments())
           resultIndices.emplace_back(arg);
         // Store initializer value into output location.
-        rewriter.create<StoreOp>(loc, zero, alloc, resultIndices);
+        rewriter.create<StoreOp>(loc, initialValue, alloc, resultIndices);
 
         // 3.2 Define inner loops.
-        int64_t nInnerLoops = 1 + (kernelShape.size() - 2);
+        int64_t nInnerLoops = 1 + nSpatialDims;
         BuildKrnlLoop innerLoops(rewriter, loc, nInnerLoops);
         innerLoops.createDefineAndOptimizeOp();
         //   for c = 0 .. C/group
@@ -167,66 +1365,68 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
         for (int i = 2; i < kernelShape.size(); ++i)
           innerLoops.pushBounds(0, kernelOperand, i);
 
-        // 3.4 Emit inner loop nest.
+        // 3.3 Emit inner loop nest.
         innerLoops.createIterateOp();
         rewriter.setInsertionPointToStart(innerLoops.getIterateBlock());
 
-        {
-          // 4. Emit inner loop body
-          // R[n][kernel][r1][r2] =
-          //   D[n][g * (C / group) + c][s1 * r1 + k1][s2 * r2 + k2] *
-          //   K[kernel][c][k1][k2];
-
-          // 4.1 Prepare indices for accesing the data tensor.
-          SmallVector<Value, 4> dataIndices;
-          // n
-          dataIndices.emplace_back(outerLoops.getInductionVar(nIndex));
-          // g * (C / group) + c
-          Value channelDepth = innerLoops.getInductionVar(cIndex);
-          if (group > 1)
-            channelDepth = rewriter.create<AddIOp>(loc, channelDepth,
-                rewriter.create<MulIOp>(
-                    loc, subchannels, outerLoops.getInductionVar(gIndex)));
-          dataIndices.emplace_back(channelDepth);
-          // sX * rX + kX
-          auto stridesAttribute = convOp.stridesAttr();
-          // Read strides attribute
-          SmallVector<int, 4> strides;
-          if (stridesAttribute)
-            for (auto stride : stridesAttribute.getValue())
-              strides.emplace_back(stride.cast<IntegerAttr>().getInt());
-          for (int i = 0; i < kernelShape.size() - 2; ++i) {
-            Value spatialIndex = spatialLoops.getInductionVar(i);
-            // If strides are present then emit the correct access index.
-            if (stridesAttribute && strides[i] > 1)
-              spatialIndex = rewriter.create<MulIOp>(loc,
-                  rewriter.create<ConstantIndexOp>(loc, strides[i]),
-                  spatialLoops.getInductionVar(i));
-            dataIndices.emplace_back(rewriter.create<AddIOp>(
-                loc, spatialIndex, innerLoops.getInductionVar(i + 1)));
-          }
-
-          // 4.2 Prepare indices for accessing the kernel tensor.
-          SmallVector<Value, 4> kernelIndices;
-          // kernel
-          kernelIndices.emplace_back(kernel);
-          // c
-          kernelIndices.emplace_back(innerLoops.getInductionVar(cIndex));
-          // kX
-          for (int i = 0; i < kernelShape.size() - 2; ++i)
-            kernelIndices.emplace_back(innerLoops.getInductionVar(i + 1));
-
-          // 4.3 Compute convolution.
-          auto loadData =
-              rewriter.create<LoadOp>(loc, inputOperand, dataIndices);
-          auto loadKernel =
-              rewriter.create<LoadOp>(loc, kernelOperand, kernelIndices);
-          auto loadPartialSum =
-              rewriter.create<LoadOp>(loc, alloc, resultIndices);
-          Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
-              rewriter.create<MulFOp>(loc, loadData, loadKernel));
-          // 4.4 Store computed value into output location.
-          rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+        // 4. Emit inner loop body
+        // R[n][kernel][r1][r2] =
+        //   D[n][g * (C / group) + c][s1 * r1 + k1][s2 * r2 + k2] *
+        //   K[kernel][c][k1][k2];
+
+        // 4.1 Prepare indices for accesing the data tensor.
+        SmallVector<Value, 4> dataIndices;
+        SmallVector<bool, 4> isChecked;
+        // n
+        dataIndices.emplace_back(outerLoops.getInductionVar(nIndex));
+        isChecked.emplace_back(false);
+        // g * (C / group) + c
+        Value channelDepth = innerLoops.getInductionVar(cIndex);
+        if (group > 1)
+          channelDepth = rewriter.create<AddIOp>(loc, channelDepth,
+              rewriter.create<MulIOp>(
+                  loc, subchannels, outerLoops.getInductionVar(gIndex)));
+        dataIndices.emplace_back(channelDepth);
+        isChecked.emplace_back(false);
+        // sX * rX + dX * kX - pX_begin
+        for (int i = 0; i < nSpatialDims; ++i) {
+          dataIndices.emplace_back(emitSlidingWindowIndex(rewriter, loc,
+              spatialLoops.getInductionVar(i),
+              innerLoops.getInductionVar(i + 1), strides[i], dilations[i],
+              pads[i]));
+          isChecked.emplace_back(region.isBorder[i]);
+        }
+
+        // 4.2 Prepare indices for accessing the kernel tensor.
+        SmallVector<Value, 4> kernelIndices;
+        // kernel
+        kernelIndices.emplace_back(kernel);
+        // c
+        kernelIndices.emplace_back(innerLoops.getInductionVar(cIndex));
+        // kX
+        for (int i = 0; i < nSpatialDims; ++i)
+          kernelIndices.emplace_back(innerLoops.getInductionVar(i + 1));
+
+        // 4.3 Compute convolution.
+        auto loadData = emitLoadOrPadding(
+            rewriter, loc, inputOperand, dataIndices, isChecked, zero);
+        auto loadKernel =
+            rewriter.create<LoadOp>(loc, kernelOperand, kernelIndices);
+        auto loadPartialSum =
+            rewriter.create<LoadOp>(loc, alloc, resultIndices);
+        Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+            rewriter.create<MulFOp>(loc, loadData, loadKernel));
+        // 4.4 Store computed value into output location.
+        rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+
+        // 5. Apply the activation once the output element is accumulated.
+        if (!epilogue.activation.empty()) {
+          rewriter.setInsertionPointAfter(
+              innerLoops.getIterateBlock()->getParentOp());
+          auto loadResult = rewriter.create<LoadOp>(loc, alloc, resultIndices);
+          auto activation =
+              emitConvActivation(rewriter, loc, epilogue, loadResult);
+          rewriter.create<StoreOp>(loc, activation, alloc, resultIndices);
         }
       }
     }
@@ -236,7 +1436,120 @@ struct ONNXConvNoBiasOpLowering : public ConversionPattern {
   }
 };
 
+struct ONNXConvNoBiasNCHWcOpLowering : public ConversionPattern {
+  ONNXConvNoBiasNCHWcOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXConvNoBiasNCHWcOp::getOperationName(), 1, ctx) {}
+
+  PatternMatchResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    auto convOp = llvm::dyn_cast<ONNXConvNoBiasNCHWcOp>(op);
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    // The blocked layouts are only introduced for tensors of known shapes.
+    if (!hasAllConstantDimensions(memRefType))
+      return matchFailure();
+
+    // Insert an allocation and deallocation for the result of this operation.
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    auto resultShape = memRefType.getShape();
+    auto &inputOperand = operands[0];
+    auto &kernelOperand = operands[1];
+    int64_t block = resultShape[4];
+
+    // R = ConvNoBiasNCHWc(D, K)
+    //
+    // The input/output shapes will look like this, with b channels per block:
+    //
+    // D (NxC/bxHxWxb) x K (M/bxC/bxKHxKWxbxb) -> R (NxM/bxRHxRWxb)
+    //
+    // The loop nest will look as follows:
+    //
+    // strides = [s1, s2], dilations = [d1, d2]
+    //
+    // for n = 0 .. N:
+    //   for mb = 0 .. M/b:
+    //     for r1 = 0 .. RH:
+    //       for r2 = 0 .. RW:
+    //         for cb = 0 .. C/b:
+    //           for k1 = 0 .. KH:
+    //             for k2 = 0 .. KW:
+    //               for ci = 0 .. b:
+    //                 for mo = 0 .. b:
+    //                   R[n][mb][r1][r2][mo] +=
+    //                     D[n][cb][s1 * r1 + d1 * k1][s2 * r2 + d2 * k2][ci] *
+    //                     K[mb][cb][k1][k2][ci][mo];
+    //
+    // The innermost loop is executed on vectors: each input element is
+    // broadcast and multiplied by the contiguous weights of the b output
+    // channels of the block, accumulating into a vector of outputs. The loop
+    // over r2 is unrolled and jammed so that several vectors of outputs are
+    // accumulated at once.
+    SmallVector<int64_t, 2> strides(2, 1);
+    if (auto stridesAttribute = convOp.stridesAttr())
+      for (auto stride : llvm::enumerate(stridesAttribute.getValue()))
+        strides[stride.index()] = stride.value().cast<IntegerAttr>().getInt();
+    SmallVector<int64_t, 2> dilations(2, 1);
+    if (auto dilationsAttribute = convOp.dilationsAttr())
+      for (auto dilation : llvm::enumerate(dilationsAttribute.getValue()))
+        dilations[dilation.index()] =
+            dilation.value().cast<IntegerAttr>().getInt();
+
+    emitZeroFill(rewriter, loc, alloc);
+
+    BuildKrnlLoop loops(rewriter, loc, 9);
+    loops.createDefineAndOptimizeOp();
+    //   for n, mb, r1, r2
+    for (int i = 0; i < 4; ++i)
+      loops.pushBounds(0, alloc, i);
+    //   for cb, k1, k2, ci, mo
+    for (int i = 1; i < 6; ++i)
+      loops.pushBounds(0, kernelOperand, i);
+    for (int i = 0; i < 4; ++i)
+      if (resultShape[i] != 1) {
+        loops.parallel(i);
+        break;
+      }
+    loops.unrollJam(3, accumulatorUnrollFactor);
+    loops.vectorize(8, block);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+
+    auto arguments = loops.getIterateBlock()->getArguments();
+    SmallVector<Value, 9> ivs(arguments.begin(), arguments.end());
+    Value n = ivs[0], mb = ivs[1], r1 = ivs[2], r2 = ivs[3], cb = ivs[4],
+          k1 = ivs[5], k2 = ivs[6], ci = ivs[7], mo = ivs[8];
+    auto d0 = getAffineDimExpr(0, rewriter.getContext());
+    auto d1 = getAffineDimExpr(1, rewriter.getContext());
+    SmallVector<Value, 2> spatialIndices;
+    for (int i = 0; i < 2; ++i)
+      spatialIndices.emplace_back(rewriter.create<AffineApplyOp>(loc,
+          AffineMap::get(2, 0, d0 * strides[i] + d1 * dilations[i]),
+          ArrayRef<Value>{i == 0 ? r1 : r2, i == 0 ? k1 : k2}));
+
+    auto loadData = rewriter.create<LoadOp>(loc, inputOperand,
+        ArrayRef<Value>{n, cb, spatialIndices[0], spatialIndices[1], ci});
+    auto loadKernel = rewriter.create<LoadOp>(
+        loc, kernelOperand, ArrayRef<Value>{mb, cb, k1, k2, ci, mo});
+    SmallVector<Value, 5> resultIndices = {n, mb, r1, r2, mo};
+    auto loadPartialSum = rewriter.create<LoadOp>(loc, alloc, resultIndices);
+    Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+        rewriter.create<MulFOp>(loc, loadData, loadKernel));
+    rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+
+    rewriter.replaceOp(op, alloc);
+
+    return matchSuccess();
+  }
+};
+
 void populateLoweringONNXConvOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXConvNoBiasOpLowering>(ctx);
+  patterns.insert<ONNXConvOpLowering<mlir::ONNXConvNoBiasOp>>(ctx);
+  patterns.insert<ONNXConvOpLowering<mlir::ONNXConvOp>>(ctx);
+  patterns.insert<ONNXConvOpLowering<mlir::ONNXConvActivationOp>>(ctx);
+  patterns.insert<ONNXConvNoBiasNCHWcOpLowering>(ctx);
 }
@@ -100,8 +100,20 @@ struct ONNXBatchNormalizationTestModeOpLowering : public ConversionPattern {
     }
     auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
 
-    // No optimization
+    // Normalize the channels in parallel. Loops are listed from the outermost
+    // one, so that another loop is used when there is a single channel.
     rewriter.setInsertionPointToEnd(optimizationBlock);
+    std::vector<Value> nestLoops;
+    SmallVector<int64_t, 4> nestLoopSizes;
+    if (rank > 1) {
+      nestLoops.emplace_back(originalLoops[1]);
+      nestLoopSizes.emplace_back(memRefType.getShape()[1]);
+    }
+    for (auto axis : axes) {
+      nestLoops.emplace_back(originalLoops[axis]);
+      nestLoopSizes.emplace_back(memRefType.getShape()[axis]);
+    }
+    emitOutermostParallelLoop(rewriter, loc, nestLoops, nestLoopSizes);
     rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
 
     Block &iterationBlock = iterateOp.bodyRegion().front();
@@ -137,7 +149,119 @@ struct ONNXBatchNormalizationTestModeOpLowering : public ConversionPattern {
   }
 };
 
+struct ONNXBatchNormalizationTestModeNCHWcOpLowering
+    : public ConversionPattern {
+  ONNXBatchNormalizationTestModeNCHWcOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXBatchNormalizationTestModeNCHWcOp::getOperationName(),
+            1, ctx) {}
+  PatternMatchResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    // batchnorm{epsilon}(x, scale, bias, mean, variance) =
+    //      x * multiplier + shift
+    // with
+    //      multiplier = scale / sqrt(variance + epsilon)
+    //      shift = bias - mean * multiplier
+    auto loc = op->getLoc();
+
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    // The blocked layouts are only introduced for tensors of known shapes.
+    if (!hasAllConstantDimensions(memRefType))
+      return matchFailure();
+    auto elementType = memRefType.getElementType();
+    auto epsilonAttr = FloatAttr::get(elementType,
+        llvm::dyn_cast<ONNXBatchNormalizationTestModeNCHWcOp>(op)
+            .epsilon()
+            .convertToFloat());
+    auto epsilon = rewriter.create<ConstantOp>(loc, epsilonAttr);
+
+    auto operand = operands[0];
+    auto scale = operands[1];
+    auto bias = operands[2];
+    auto mean = operands[3];
+    auto variance = operands[4];
+
+    // Insert an allocation and deallocation for the result of this operation.
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    // The operand is N x C/b x H x W x b, while the scale, bias, mean and
+    // variance are indexed by the channels c = cb * b + ci. The multiplier
+    // and shift of each channel are first computed into C/b x b buffers, so
+    // that the loop over the channels of a block reads them contiguously and
+    // can be executed on vectors.
+    auto shape = memRefType.getShape();
+    int64_t block = shape[4];
+    auto coefficientType = MemRefType::get({shape[1], block}, elementType);
+    Value multipliers = rewriter.create<AllocOp>(loc, coefficientType);
+    Value shifts = rewriter.create<AllocOp>(loc, coefficientType);
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      BuildKrnlLoop channelLoops(rewriter, loc, 2);
+      channelLoops.createDefineOptimizeAndIterateOp(multipliers);
+      rewriter.setInsertionPointToStart(channelLoops.getIterateBlock());
+      Value cb = channelLoops.getInductionVar(0);
+      Value ci = channelLoops.getInductionVar(1);
+      auto d0 = getAffineDimExpr(0, rewriter.getContext());
+      auto d1 = getAffineDimExpr(1, rewriter.getContext());
+      Value channel = rewriter.create<AffineApplyOp>(loc,
+          AffineMap::get(2, 0, d0 * block + d1), ArrayRef<Value>{cb, ci});
+
+      auto scaleVal = rewriter.create<LoadOp>(loc, scale, ArrayRef<Value>{channel});
+      auto biasVal = rewriter.create<LoadOp>(loc, bias, ArrayRef<Value>{channel});
+      auto meanVal = rewriter.create<LoadOp>(loc, mean, ArrayRef<Value>{channel});
+      auto varianceVal = rewriter.create<LoadOp>(loc, variance, ArrayRef<Value>{channel});
+      auto adjustedVarianceVal =
+          rewriter.create<AddFOp>(loc, varianceVal, epsilon);
+      auto divisor = rewriter.create<SqrtOp>(loc, adjustedVarianceVal);
+      auto multiplierVal = rewriter.create<DivFOp>(loc, scaleVal, divisor);
+      auto shiftVal = rewriter.create<SubFOp>(loc, biasVal,
+          rewriter.create<MulFOp>(loc, meanVal, multiplierVal));
+      rewriter.create<StoreOp>(
+          loc, multiplierVal, multipliers, ArrayRef<Value>{cb, ci});
+      rewriter.create<StoreOp>(loc, shiftVal, shifts, ArrayRef<Value>{cb, ci});
+    }
+
+    // Normalize the elements, the loop over the channels of a block being
+    // executed on vectors.
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      BuildKrnlLoop loops(rewriter, loc, 5);
+      loops.createDefineAndOptimizeOp();
+      for (int i = 0; i < 5; ++i)
+        loops.pushBounds(0, alloc, i);
+      for (int i = 0; i < 4; ++i)
+        if (shape[i] != 1) {
+          loops.parallel(i);
+          break;
+        }
+      loops.vectorize(4, block);
+      loops.createIterateOp();
+      rewriter.setInsertionPointToStart(loops.getIterateBlock());
+
+      auto arguments = loops.getIterateBlock()->getArguments();
+      SmallVector<Value, 5> loopIVs(arguments.begin(), arguments.end());
+      SmallVector<Value, 2> coefficientIVs = {loopIVs[1], loopIVs[4]};
+      auto xVal = rewriter.create<LoadOp>(loc, operand, loopIVs);
+      auto multiplierVal =
+          rewriter.create<LoadOp>(loc, multipliers, coefficientIVs);
+      auto shiftVal = rewriter.create<LoadOp>(loc, shifts, coefficientIVs);
+      auto scaledVal = rewriter.create<MulFOp>(loc, xVal, multiplierVal);
+      auto shiftScaledVal = rewriter.create<AddFOp>(loc, scaledVal, shiftVal);
+      rewriter.create<StoreOp>(loc, shiftScaledVal, alloc, loopIVs);
+    }
+    rewriter.create<DeallocOp>(loc, shifts);
+    rewriter.create<DeallocOp>(loc, multipliers);
+
+    rewriter.replaceOp(op, alloc);
+
+    return matchSuccess();
+  }
+};
+
 void populateLoweringONNXNormalizationOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx) {
   patterns.insert<ONNXBatchNormalizationTestModeOpLowering>(ctx);
+  patterns.insert<ONNXBatchNormalizationTestModeNCHWcOpLowering>(ctx);
 }
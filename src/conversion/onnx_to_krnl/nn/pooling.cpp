@@ -44,13 +44,13 @@ struct ONNXMaxPoolSingleOutOpLowering : public ConversionPattern {
     ONNXMaxPoolSingleOutOp poolOp = llvm::dyn_cast<ONNXMaxPoolSingleOutOp>(op);
 
     // Read kernel_shape attribute
-    SmallVector<int, 4> kernelShape;
+    SmallVector<int64_t, 4> kernelShape;
     auto kernelShapeAttribute = poolOp.kernel_shapeAttr();
     for (auto dim : kernelShapeAttribute.getValue())
       kernelShape.emplace_back(dim.cast<IntegerAttr>().getInt());
 
     // Read strides attribute
-    SmallVector<int, 4> strides;
+    SmallVector<int64_t, 4> strides;
     auto stridesAttribute = poolOp.stridesAttr();
     for (auto stride : stridesAttribute.getValue())
       strides.emplace_back(stride.cast<IntegerAttr>().getInt());
@@ -59,13 +59,13 @@ struct ONNXMaxPoolSingleOutOpLowering : public ConversionPattern {
     auto ceilMode = poolOp.ceil_mode().getSExtValue();
 
     // Read pads attribute
-    SmallVector<int, 4> pads;
+    SmallVector<int64_t, 4> pads;
     auto padsAttribute = poolOp.padsAttr();
     for (auto pad : padsAttribute.getValue())
       pads.emplace_back(pad.cast<IntegerAttr>().getInt());
 
     // Read dilations attribute
-    SmallVector<int, 4> dilations;
+    SmallVector<int64_t, 4> dilations;
     auto dilationsAttribute = poolOp.dilationsAttr();
     for (auto dilation : dilationsAttribute.getValue())
       dilations.emplace_back(dilation.cast<IntegerAttr>().getInt());
@@ -184,16 +184,36 @@ struct ONNXMaxPoolSingleOutOpLowering : public ConversionPattern {
     //   n, c, r1, r2: outer loop nest indices
     //   k1, k2: inner loop nest indices
     //
-    // TODO: handle padding.
+    // With dilations [d1, d2] and pads [p1_begin, p2_begin, ...], the data
+    // is accessed at D[n][c][s1 * r1 + d1 * k1 - p1_begin][...], the elements
+    // out of the bounds of D being ignored. The outer loop nest is then split
+    // into border regions, where these accesses are bounds checked, and an
+    // interior region free of checks, see getSlidingWindowRegions.
     //
 
-    // 1. Define outer loops and emit empty optimization block.
-    auto nOuterLoops = resultShape.size();
-    BuildKrnlLoop outerLoops(rewriter, loc, nOuterLoops);
-    outerLoops.createDefineOptimizeAndIterateOp(alloc);
+    int nOuterLoops = resultShape.size();
+    int spatialRank = nOuterLoops - batchRank;
+    auto regions = getSlidingWindowRegions(inputShape.drop_front(batchRank),
+        resultShape.drop_front(batchRank), kernelShape, pads, strides,
+        dilations);
+
+    for (auto &region : regions) {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+
+      // 1. Define outer loops and emit empty optimization block.
+      BuildKrnlLoop outerLoops(rewriter, loc, nOuterLoops);
+      outerLoops.createDefineAndOptimizeOp();
+      for (int i = 0; i < nOuterLoops; ++i) {
+        int spatialIndex = i - batchRank;
+        if (i < batchRank || region.upperBounds[spatialIndex] < 0)
+          outerLoops.pushBounds(0, alloc, i);
+        else
+          outerLoops.pushBounds(region.lowerBounds[spatialIndex],
+              region.upperBounds[spatialIndex]);
+      }
+      outerLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
 
-    rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
-    {
       // 2. Emit the body of the outer loop nest.
       SmallVector<Value, 4> resultIndices;
       for (int i = 0; i < nOuterLoops; ++i)
@@ -215,59 +235,189 @@ struct ONNXMaxPoolSingleOutOpLowering : public ConversionPattern {
       // 2.3 Emit inner loop nest.
       innerLoops.createIterateOp();
       rewriter.setInsertionPointToStart(innerLoops.getIterateBlock());
-      {
-        // 3. Emit inner loop body
-        // t = D[n][c][s1 * r1 + k1][s2 * r2 + k2];
-        // R[n][c][r1][r2] = max(R[n][c][r1][r2], t);
-
-        // 3.1 Prepare indices for accesing the data tensor.
-        SmallVector<Value, 4> dataIndices;
-        // Batch indices: n, c
-        for (int i = 0; i < batchRank; ++i)
-          dataIndices.emplace_back(outerLoops.getInductionVar(i));
-        // Spatial indices: sX * rX + kX
-        for (int i = batchRank; i < nOuterLoops; ++i) {
-          Value spatialIndex = outerLoops.getInductionVar(i);
-          // If strides are present then emit the correct access index.
-          if (stridesAttribute && strides[i - batchRank] > 1) {
-            spatialIndex = rewriter.create<MulIOp>(loc,
-                rewriter.create<ConstantIndexOp>(loc, strides[i - batchRank]),
-                outerLoops.getInductionVar(i));
-          }
-          spatialIndex = rewriter.create<AddIOp>(
-              loc, spatialIndex, innerLoops.getInductionVar(i - batchRank));
-          // If ceil mode is enabled, then the calculated access index may
-          // exceed its dimension. In such a case, we will use the maximum
-          // index, which causes multiple visits to the element of the
-          // maximum index.
-          // TODO: Avoid multiple visits.
-          if (ceilMode) {
-            Value inputIndex;
-            if (inputShape[i] < 0) {
-              Value inputDim = rewriter.create<DimOp>(loc, inputOperand, i);
-              Value one = rewriter.create<ConstantIndexOp>(loc, 1);
-              inputIndex = rewriter.create<SubIOp>(loc, inputDim, one);
-            } else {
-              inputIndex =
-                  rewriter.create<ConstantIndexOp>(loc, inputShape[i] - 1);
-            }
-            auto greaterCondition = rewriter.create<CmpIOp>(
-                loc, CmpIPredicate::sgt, spatialIndex, inputIndex);
-            spatialIndex = rewriter.create<SelectOp>(
-                loc, greaterCondition, inputIndex, spatialIndex);
+
+      // 3. Emit inner loop body
+      // t = D[n][c][s1 * r1 + k1][s2 * r2 + k2];
+      // R[n][c][r1][r2] = max(R[n][c][r1][r2], t);
+
+      // 3.1 Prepare indices for accesing the data tensor.
+      SmallVector<Value, 4> dataIndices;
+      SmallVector<bool, 4> isChecked;
+      // Batch indices: n, c
+      for (int i = 0; i < batchRank; ++i) {
+        dataIndices.emplace_back(outerLoops.getInductionVar(i));
+        isChecked.emplace_back(false);
+      }
+      // Spatial indices: sX * rX + dX * kX - pX_begin
+      for (int i = batchRank; i < nOuterLoops; ++i) {
+        int spatialIndex = i - batchRank;
+        bool isPadded = pads[spatialIndex] != 0 ||
+                        pads[spatialIndex + spatialRank] != 0;
+        Value index = emitSlidingWindowIndex(rewriter, loc,
+            outerLoops.getInductionVar(i),
+            innerLoops.getInductionVar(spatialIndex),
+            strides[spatialIndex], dilations[spatialIndex],
+            pads[spatialIndex]);
+        // If ceil mode is enabled, then the calculated access index may
+        // exceed its dimension. In such a case, we will use the maximum
+        // index, which causes multiple visits to the element of the
+        // maximum index. In padded dimensions, such accesses are bounds
+        // checked as those reaching into the padding.
+        // TODO: Avoid multiple visits.
+        if (ceilMode && !isPadded) {
+          Value inputIndex;
+          if (inputShape[i] < 0) {
+            Value inputDim = rewriter.create<DimOp>(loc, inputOperand, i);
+            Value one = rewriter.create<ConstantIndexOp>(loc, 1);
+            inputIndex = rewriter.create<SubIOp>(loc, inputDim, one);
+          } else {
+            inputIndex =
+                rewriter.create<ConstantIndexOp>(loc, inputShape[i] - 1);
           }
-          dataIndices.emplace_back(spatialIndex);
+          auto greaterCondition = rewriter.create<CmpIOp>(
+              loc, CmpIPredicate::sgt, index, inputIndex);
+          index = rewriter.create<SelectOp>(
+              loc, greaterCondition, inputIndex, index);
         }
-
-        // 3.2 Do pooling.
-        auto loadData = rewriter.create<LoadOp>(loc, inputOperand, dataIndices);
-        auto loadPartialResult =
-            rewriter.create<LoadOp>(loc, alloc, resultIndices);
-        Value result = mapToLowerScalarOp<ONNXMaxPoolSingleOutOp>(
-            op, resultElementType, {loadPartialResult, loadData}, rewriter);
-        rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+        dataIndices.emplace_back(index);
+        isChecked.emplace_back(region.isBorder[spatialIndex]);
       }
+
+      // 3.2 Do pooling.
+      auto loadData = emitLoadOrPadding(
+          rewriter, loc, inputOperand, dataIndices, isChecked, identity);
+      auto loadPartialResult =
+          rewriter.create<LoadOp>(loc, alloc, resultIndices);
+      Value result = mapToLowerScalarOp<ONNXMaxPoolSingleOutOp>(
+          op, resultElementType, {loadPartialResult, loadData}, rewriter);
+      rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+    }
+    rewriter.replaceOp(op, alloc);
+
+    return matchSuccess();
+  }
+};
+
+struct ONNXMaxPoolSingleOutNCHWcOpLowering : public ConversionPattern {
+  ONNXMaxPoolSingleOutNCHWcOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXMaxPoolSingleOutNCHWcOp::getOperationName(), 1, ctx) {}
+
+  PatternMatchResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    auto poolOp = llvm::dyn_cast<ONNXMaxPoolSingleOutNCHWcOp>(op);
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    // The blocked layouts are only introduced for tensors of known shapes.
+    if (!hasAllConstantDimensions(memRefType))
+      return matchFailure();
+
+    // Insert an allocation and deallocation for the result of this operation.
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    auto &inputOperand = operands[0];
+    auto resultShape = memRefType.getShape();
+    auto resultElementType = memRefType.getElementType();
+    int64_t block = resultShape[4];
+
+    // R = MaxPoolNCHWc(D)
+    //
+    // The input/output shapes will look like this, with b channels per block:
+    //
+    // D (NxC/bxHxWxb) -> R (NxC/bxRHxRWxb)
+    //
+    // The loop nest will look as follows:
+    //
+    // strides = [s1, s2], dilations = [d1, d2]
+    //
+    // R = negative_infinity;
+    // for n = 0 .. N:
+    //   for cb = 0 .. C/b:
+    //     for r1 = 0 .. RH:
+    //       for r2 = 0 .. RW:
+    //         for k1 = 0 .. KH:
+    //           for k2 = 0 .. KW:
+    //             for ci = 0 .. b:
+    //               t = D[n][cb][s1 * r1 + d1 * k1][s2 * r2 + d2 * k2][ci];
+    //               R[n][cb][r1][r2][ci] = max(R[n][cb][r1][r2][ci], t);
+    //
+    // The innermost loop over the channels of a block is executed on vectors.
+    SmallVector<int64_t, 2> kernelShape;
+    for (auto dim : poolOp.kernel_shapeAttr().getValue())
+      kernelShape.emplace_back(dim.cast<IntegerAttr>().getInt());
+    SmallVector<int64_t, 2> strides(2, 1);
+    if (auto stridesAttribute = poolOp.stridesAttr())
+      for (auto stride : llvm::enumerate(stridesAttribute.getValue()))
+        strides[stride.index()] = stride.value().cast<IntegerAttr>().getInt();
+    SmallVector<int64_t, 2> dilations(2, 1);
+    if (auto dilationsAttribute = poolOp.dilationsAttr())
+      for (auto dilation : llvm::enumerate(dilationsAttribute.getValue()))
+        dilations[dilation.index()] =
+            dilation.value().cast<IntegerAttr>().getInt();
+
+    // Schedule the outermost of the loops over the dimensions of the result
+    // running more than one iteration in parallel, and the loop over the
+    // channels of a block on vectors.
+    auto scheduleLoops = [&](BuildKrnlLoop &loops) {
+      for (int i = 0; i < 4; ++i)
+        if (resultShape[i] != 1) {
+          loops.parallel(i);
+          break;
+        }
+      loops.vectorize(loops.getOriginalLoops().size() - 1, block);
+    };
+
+    // 1. Emit: R = negative_infinity;
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      BuildKrnlLoop fillLoops(rewriter, loc, 5);
+      fillLoops.createDefineAndOptimizeOp();
+      for (int i = 0; i < 5; ++i)
+        fillLoops.pushBounds(0, alloc, i);
+      scheduleLoops(fillLoops);
+      fillLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(fillLoops.getIterateBlock());
+      auto arguments = fillLoops.getIterateBlock()->getArguments();
+      SmallVector<Value, 5> resultIndices(arguments.begin(), arguments.end());
+      Value identity = getIdentityValue<ONNXMaxPoolSingleOutOp>(
+          rewriter, loc, resultElementType);
+      rewriter.create<StoreOp>(loc, identity, alloc, resultIndices);
     }
+
+    // 2. Emit the pooling loop nest: n, cb, r1, r2, k1, k2, ci.
+    BuildKrnlLoop loops(rewriter, loc, 7);
+    loops.createDefineAndOptimizeOp();
+    for (int i = 0; i < 4; ++i)
+      loops.pushBounds(0, alloc, i);
+    for (int i = 0; i < 2; ++i)
+      loops.pushBounds(0, kernelShape[i]);
+    loops.pushBounds(0, alloc, 4);
+    scheduleLoops(loops);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+
+    auto arguments = loops.getIterateBlock()->getArguments();
+    SmallVector<Value, 7> ivs(arguments.begin(), arguments.end());
+    auto d0 = getAffineDimExpr(0, rewriter.getContext());
+    auto d1 = getAffineDimExpr(1, rewriter.getContext());
+    SmallVector<Value, 5> dataIndices = {ivs[0], ivs[1]};
+    for (int i = 0; i < 2; ++i)
+      dataIndices.emplace_back(rewriter.create<AffineApplyOp>(loc,
+          AffineMap::get(2, 0, d0 * strides[i] + d1 * dilations[i]),
+          ArrayRef<Value>{ivs[2 + i], ivs[4 + i]}));
+    dataIndices.emplace_back(ivs[6]);
+    SmallVector<Value, 5> resultIndices = {
+        ivs[0], ivs[1], ivs[2], ivs[3], ivs[6]};
+
+    auto loadData = rewriter.create<LoadOp>(loc, inputOperand, dataIndices);
+    auto loadPartialResult =
+        rewriter.create<LoadOp>(loc, alloc, resultIndices);
+    Value result = mapToLowerScalarOp<ONNXMaxPoolSingleOutOp>(
+        op, resultElementType, {loadPartialResult, loadData}, rewriter);
+    rewriter.create<StoreOp>(loc, result, alloc, resultIndices);
+
     rewriter.replaceOp(op, alloc);
 
     return matchSuccess();
@@ -277,4 +427,5 @@ struct ONNXMaxPoolSingleOutOpLowering : public ConversionPattern {
 void populateLoweringONNXPoolingOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx) {
   patterns.insert<ONNXMaxPoolSingleOutOpLowering>(ctx);
+  patterns.insert<ONNXMaxPoolSingleOutNCHWcOpLowering>(ctx);
 }
@@ -9,6 +9,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Support/MathExtras.h"
+
 #include "src/conversion/onnx_to_krnl/onnx_to_krnl_common.hpp"
 
 /// Check is all dimensions are known at compile time.
@@ -121,6 +123,108 @@ bool checkInsertDealloc(Operation *currentOp) {
   return insertDealloc;
 }
 
+// Get the allocation of the buffer `memRef`, the lowering of the operand
+// `tensor` of `op`, when `op` is the last operation accessing the buffer.
+AllocOp getBufferDyingAt(Operation *op, Value tensor, Value memRef) {
+  // The buffer must be allocated by the function, and aliased by no other
+  // tensor used after `op`. The latter is ensured by requiring that every
+  // tensor `tensor` is derived from, through views, has no other use.
+  if (llvm::any_of(tensor.getUsers(),
+                   [op](Operation *user) { return user != op; }))
+    return nullptr;
+  while (auto *defOp = tensor.getDefiningOp()) {
+    if (!(isa<ONNXReshapeOp>(defOp) || isa<ONNXUnsqueezeOp>(defOp) ||
+          isa<ONNXIdentityOp>(defOp) || isa<ONNXTransposeOp>(defOp)))
+      break;
+    tensor = defOp->getOperand(0);
+    if (!tensor.hasOneUse())
+      return nullptr;
+  }
+  Value buffer = memRef;
+  while (auto viewOp = dyn_cast_or_null<KrnlReshapeOp>(buffer.getDefiningOp()))
+    buffer = viewOp.src();
+  return dyn_cast_or_null<AllocOp>(buffer.getDefiningOp());
+}
+
+// Get the deallocation of the buffer allocated by `allocOp`, or nullptr.
+static Operation *getDealloc(AllocOp allocOp) {
+  for (auto *user : allocOp.getResult().getUsers())
+    if (isa<DeallocOp>(user))
+      return user;
+  return nullptr;
+}
+
+// Emit a view of a buffer as the result of a view operation.
+Value emitMemRefView(ConversionPatternRewriter &rewriter, Location loc,
+                     Operation *op, Value memRef, MemRefType memRefType,
+                     ArrayRef<Value> dimSizes) {
+  auto srcType = memRef.getType().cast<MemRefType>();
+  if (!srcType.getAffineMaps().empty() ||
+      !memRefType.getAffineMaps().empty() ||
+      srcType.getElementType() != memRefType.getElementType())
+    return nullptr;
+
+  // A view returned by the function must own the buffer it aliases, unless
+  // the buffer is an argument of the function, which the caller owns. Other
+  // buffers must be allocated by the function and aliased by no other
+  // returned value.
+  Value buffer = memRef;
+  while (auto viewOp = dyn_cast_or_null<KrnlReshapeOp>(buffer.getDefiningOp()))
+    buffer = viewOp.src();
+  if (!checkInsertDealloc(op) && !buffer.isa<BlockArgument>()) {
+    auto allocOp = getBufferDyingAt(op, op->getOperand(0), memRef);
+    Operation *dealloc = allocOp ? getDealloc(allocOp) : nullptr;
+    if (!dealloc)
+      return nullptr;
+    rewriter.eraseOp(dealloc);
+  }
+
+  if (srcType == memRefType)
+    return memRef;
+  return rewriter.create<KrnlReshapeOp>(loc, memRefType, memRef, dimSizes);
+}
+
+// Get the lowered operand of an elementwise operation the result can be
+// written into.
+Value getReusableOperandBuffer(ConversionPatternRewriter &rewriter,
+                               Operation *op, ArrayRef<Value> operands,
+                               MemRefType memRefType) {
+  for (int i = 0; i < operands.size(); ++i) {
+    if (operands[i].getType() != memRefType)
+      continue;
+    auto allocOp = getBufferDyingAt(op, op->getOperand(i), operands[i]);
+    Operation *dealloc = allocOp ? getDealloc(allocOp) : nullptr;
+    if (!dealloc)
+      continue;
+    // The buffer is owned by the returned result.
+    if (!checkInsertDealloc(op))
+      rewriter.eraseOp(dealloc);
+    return operands[i];
+  }
+  return nullptr;
+}
+
+// Emit the size in bytes of the elements of a memref.
+Value emitMemRefSizeInBytes(ConversionPatternRewriter &rewriter, Location loc,
+                            Value memRef) {
+  auto memRefType = memRef.getType().cast<MemRefType>();
+  auto shape = memRefType.getShape();
+  auto int64Type = rewriter.getIntegerType(64);
+  Value size = emitConstantOp(
+      rewriter, loc, int64Type, getMemRefEltSizeInBytes(memRefType));
+  for (int i = 0; i < shape.size(); ++i) {
+    Value dimVal;
+    if (shape[i] < 0) {
+      Value dim = rewriter.create<DimOp>(loc, memRef, i);
+      dimVal = rewriter.create<IndexCastOp>(loc, dim, int64Type);
+    } else {
+      dimVal = emitConstantOp(rewriter, loc, int64Type, shape[i]);
+    }
+    size = rewriter.create<MulIOp>(loc, size, dimVal);
+  }
+  return size;
+}
+
 // Create a mapping from result type's dimensions to input type's dimensions,
 // given that the result type is the result of a reduction op over the input
 // type.
@@ -226,6 +330,35 @@ void emitKrnlLoopsAndIterationForOperand(
   iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
 }
 
+// Schedule the outermost of the given loops as parallel, skipping the loops
+// known to run a single iteration. `loopSizes` holds the static number of
+// iterations of the leading loops, -1 if unknown.
+void emitOutermostParallelLoop(ConversionPatternRewriter &rewriter,
+                               Location loc, ArrayRef<Value> loops,
+                               ArrayRef<int64_t> loopSizes) {
+  for (size_t i = 0; i < loops.size(); ++i) {
+    if (i < loopSizes.size() && loopSizes[i] == 1)
+      continue;
+    rewriter.create<KrnlParallelOp>(loc, loops[i]);
+    return;
+  }
+}
+
+// Schedule the innermost of the given loops to be vectorized, unless its
+// number of iterations is statically known to be lower than the vector
+// width.
+void emitInnermostVectorizedLoop(ConversionPatternRewriter &rewriter,
+                                 Location loc, ArrayRef<Value> loops,
+                                 MemRefType memRefType) {
+  if (loops.empty() || memRefType.getRank() == 0)
+    return;
+  int64_t width = targetVectorSizeInBytes / getMemRefEltSizeInBytes(memRefType);
+  auto innermostSize = memRefType.getShape().back();
+  if (width < 2 || (innermostSize >= 0 && innermostSize < width))
+    return;
+  rewriter.create<KrnlVectorizeOp>(loc, loops.back(), width);
+}
+
 unsigned getMemRefEltSizeInBytes(MemRefType memRefType) {
   auto elementType = memRefType.getElementType();
 
@@ -311,9 +444,10 @@ getLoopIVsForBroadcasting(Location loc, ConversionPatternRewriter &rewriter,
       // Unknown dimension, it can have a value of 1 or N (N > 1).
       // If its value is 1, it is broadcasted dimension.
       // Otherwise, non-broadcasted dimension.
-      auto zero = rewriter.create<ConstantIndexOp>(loc, 0);
-      auto idx = rewriter.create<SelectOp>(loc, broadcastedDims[dimIdx], zero,
-                                           loopIVs[loopIdx]);
+      Value idx = rewriter.create<ConstantIndexOp>(loc, 0);
+      if (auto isBroadcasted = broadcastedDims[dimIdx])
+        idx = rewriter.create<SelectOp>(loc, isBroadcasted, idx,
+                                        loopIVs[loopIdx]);
       newLoopIVs.insert(newLoopIVs.begin(), idx);
     } else {
       // Non-broadcasted dimension
@@ -485,3 +619,141 @@ Value emitNegativeInfinityConstantOp(
 
   return rewriter.create<ConstantOp>(loc, constantAttr);
 }
+
+std::vector<SlidingWindowRegion> getSlidingWindowRegions(
+    ArrayRef<int64_t> inputShape, ArrayRef<int64_t> resultShape,
+    ArrayRef<int64_t> kernelShape, ArrayRef<int64_t> pads,
+    ArrayRef<int64_t> strides, ArrayRef<int64_t> dilations) {
+  int64_t rank = resultShape.size();
+  // Bounds of the interior of each dimension, i.e. of the output positions
+  // whose windows lie within the input:
+  //   s * r - pad_begin >= 0
+  //   s * r - pad_begin + d * (K - 1) <= H - 1
+  // The interior of a padded dimension of unknown size is left empty, the
+  // whole dimension being checked.
+  SmallVector<int64_t, 4> interiorLower(rank, 0);
+  SmallVector<int64_t, 4> interiorUpper(rank, -1);
+  SmallVector<bool, 4> isPadded(rank, false);
+  auto isKnown = [&](int i) {
+    return inputShape[i] >= 0 && resultShape[i] >= 0 && kernelShape[i] >= 0;
+  };
+  for (int i = 0; i < rank; ++i) {
+    isPadded[i] = pads[i] != 0 || pads[i + rank] != 0;
+    if (!isPadded[i])
+      continue;
+    if (!isKnown(i)) {
+      interiorUpper[i] = 0;
+      continue;
+    }
+    int64_t lower = std::min(ceilDiv(pads[i], strides[i]), resultShape[i]);
+    int64_t upper = floorDiv(inputShape[i] - 1 + pads[i] -
+                                 dilations[i] * (kernelShape[i] - 1),
+                        strides[i]) +
+                    1;
+    interiorLower[i] = lower;
+    interiorUpper[i] = std::max(lower, std::min(upper, resultShape[i]));
+  }
+  auto isInteriorEmpty = [&](int i) {
+    return interiorUpper[i] >= 0 && interiorUpper[i] <= interiorLower[i];
+  };
+
+  // The border of the dimension i is peeled off the interior of the
+  // dimensions before it, and spans the whole dimensions after it.
+  std::vector<SlidingWindowRegion> regions;
+  for (int i = 0; i < rank; ++i) {
+    if (!isPadded[i])
+      continue;
+    SmallVector<std::pair<int64_t, int64_t>, 2> borders;
+    if (!isKnown(i)) {
+      borders.emplace_back(0, -1);
+    } else {
+      if (interiorLower[i] > 0)
+        borders.emplace_back(0, interiorLower[i]);
+      if (interiorUpper[i] < resultShape[i])
+        borders.emplace_back(interiorUpper[i], resultShape[i]);
+    }
+    for (auto border : borders) {
+      SlidingWindowRegion region;
+      for (int j = 0; j < rank; ++j) {
+        if (j < i) {
+          region.lowerBounds.emplace_back(interiorLower[j]);
+          region.upperBounds.emplace_back(interiorUpper[j]);
+          region.isBorder.emplace_back(false);
+        } else if (j == i) {
+          region.lowerBounds.emplace_back(border.first);
+          region.upperBounds.emplace_back(border.second);
+          region.isBorder.emplace_back(true);
+        } else {
+          region.lowerBounds.emplace_back(0);
+          region.upperBounds.emplace_back(-1);
+          region.isBorder.emplace_back(isPadded[j]);
+        }
+      }
+      regions.emplace_back(region);
+    }
+    // The regions of the following dimensions are empty if this interior is.
+    if (isInteriorEmpty(i))
+      return regions;
+  }
+
+  SlidingWindowRegion interior;
+  interior.lowerBounds = interiorLower;
+  interior.upperBounds = interiorUpper;
+  interior.isBorder.assign(rank, false);
+  regions.emplace_back(interior);
+  return regions;
+}
+
+Value emitSlidingWindowIndex(ConversionPatternRewriter &rewriter,
+    Location loc, Value r, Value k, int64_t stride, int64_t dilation,
+    int64_t pad) {
+  Value index = r;
+  if (stride > 1)
+    index = rewriter.create<MulIOp>(
+        loc, rewriter.create<ConstantIndexOp>(loc, stride), r);
+  Value offset = k;
+  if (dilation > 1)
+    offset = rewriter.create<MulIOp>(
+        loc, rewriter.create<ConstantIndexOp>(loc, dilation), k);
+  index = rewriter.create<AddIOp>(loc, index, offset);
+  if (pad != 0)
+    index = rewriter.create<SubIOp>(
+        loc, index, rewriter.create<ConstantIndexOp>(loc, pad));
+  return index;
+}
+
+Value emitLoadOrPadding(ConversionPatternRewriter &rewriter, Location loc,
+    Value memRef, ArrayRef<Value> indices, ArrayRef<bool> isChecked,
+    Value padding) {
+  auto shape = memRef.getType().cast<MemRefType>().getShape();
+  SmallVector<Value, 4> clampedIndices(indices.begin(), indices.end());
+  Value zero, isInBounds;
+  for (int i = 0; i < indices.size(); ++i) {
+    if (!isChecked[i])
+      continue;
+    if (!zero)
+      zero = rewriter.create<ConstantIndexOp>(loc, 0);
+    Value dim;
+    if (shape[i] < 0)
+      dim = rewriter.create<DimOp>(loc, memRef, i);
+    else
+      dim = rewriter.create<ConstantIndexOp>(loc, shape[i]);
+    // 0 <= index < dim, the index being clamped to 0 otherwise.
+    auto isNonNegative =
+        rewriter.create<CmpIOp>(loc, CmpIPredicate::sge, indices[i], zero);
+    auto isBelowDim =
+        rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, indices[i], dim);
+    Value isIndexInBounds =
+        rewriter.create<AndOp>(loc, isNonNegative, isBelowDim);
+    clampedIndices[i] =
+        rewriter.create<SelectOp>(loc, isIndexInBounds, indices[i], zero);
+    if (isInBounds)
+      isInBounds = rewriter.create<AndOp>(loc, isInBounds, isIndexInBounds);
+    else
+      isInBounds = isIndexInBounds;
+  }
+  Value value = rewriter.create<LoadOp>(loc, memRef, clampedIndices);
+  if (!isInBounds)
+    return value;
+  return rewriter.create<SelectOp>(loc, isInBounds, value, padding);
+}
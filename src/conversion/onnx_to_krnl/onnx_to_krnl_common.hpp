@@ -14,6 +14,7 @@
 #include <map>
 
 #include "mlir/Dialect/AffineOps/AffineOps.h"
+#include "mlir/Dialect/LoopOps/LoopOps.h"
 #include "mlir/Dialect/StandardOps/Ops.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
@@ -28,6 +29,30 @@
 
 using namespace mlir;
 
+// Unroll factor applied to the loops iterating over independent outputs of a
+// reduction, i.e. the number of independent accumulation chains in the
+// innermost loop body.
+const int64_t accumulatorUnrollFactor = 4;
+
+// Size in bytes of the vector registers of the target, used to choose the
+// width of vectorized loops: 32 for AVX2, 64 for AVX-512.
+const int64_t targetVectorSizeInBytes = 32;
+
+// Maximum number of versions of the loop nest of an elementwise operation
+// specialized for whether the dynamic dimensions of its operands are
+// broadcasted.
+const int64_t maxBroadcastVersions = 8;
+
+// Tiling of the matrix multiplication kernel. A tile of registerTileRows rows
+// of the output, one vector wide, is accumulated in registers. The packed
+// panels of the left operand (l2TileRows x l1TileReduction) and of the right
+// operand (l1TileReduction x l3TileColumns) respectively fit in the L2 and L3
+// caches, and a slice of the latter (l1TileReduction x one vector) in L1.
+const int64_t registerTileRows = 4;
+const int64_t l1TileReduction = 256;
+const int64_t l2TileRows = 128;
+const int64_t l3TileColumns = 1024;
+
 //===----------------------------------------------------------------------===//
 // Common functions used when lowering the ONNX frontend dialect to KRNL.
 //===----------------------------------------------------------------------===//
@@ -49,6 +74,36 @@ Value insertAllocAndDealloc(MemRefType type, Location loc,
 // inserted.
 bool checkInsertDealloc(Operation *currentOp);
 
+// Get the allocation of the buffer `memRef`, the lowering of the operand
+// `tensor` of `op`, if `op` is the last operation accessing it: the buffer is
+// allocated by the function, `tensor` is only used by `op`, and the tensors
+// `tensor` is a view of have no other use. Return nullptr otherwise.
+AllocOp getBufferDyingAt(Operation *op, Value tensor, Value memRef);
+
+// Emit a view of the contiguous buffer `memRef` with the row-major layout of
+// `memRefType`, the sizes of its dynamic dimensions being `dimSizes`, as the
+// result of `op`, which must be a view of its first operand. A view does not
+// own the buffer it aliases. When the result of `op` is returned, the
+// ownership of a buffer allocated by the function is transferred to the view
+// by removing its deallocation. Return nullptr if no view can be emitted,
+// e.g. if the buffer is already returned, in which case it must be copied.
+Value emitMemRefView(ConversionPatternRewriter &rewriter, Location loc,
+                     Operation *op, Value memRef, MemRefType memRefType,
+                     ArrayRef<Value> dimSizes);
+
+// Get a lowered operand among `operands` of the elementwise operation `op`,
+// of the type `memRefType` of its result, whose buffer is no longer accessed
+// after `op`, so that the result can be written into it. When the result of
+// `op` is returned, the ownership of the buffer is transferred to it by
+// removing its deallocation. Return nullptr if there is no such operand.
+Value getReusableOperandBuffer(ConversionPatternRewriter &rewriter,
+                               Operation *op, ArrayRef<Value> operands,
+                               MemRefType memRefType);
+
+// Emit the size in bytes of the elements of a memref, as an i64 value.
+Value emitMemRefSizeInBytes(ConversionPatternRewriter &rewriter, Location loc,
+                            Value memRef);
+
 // Create a mapping from result type's dimensions to input type's dimensions,
 // given that the result type is the result of a reduction op over the input
 // type.
@@ -83,8 +138,93 @@ void emitKrnlLoopsAndIterationForOperand(
     std::vector<Value> &originalLoops, KrnlOptimizeLoopsOp &optimizedLoopsOp,
     KrnlIterateOp &iterateOp);
 
+// Schedule the outermost of the given loops as parallel, skipping the loops
+// known to run a single iteration. This must be called with the insertion
+// point in the optimization block of the loops.
+void emitOutermostParallelLoop(ConversionPatternRewriter &rewriter,
+                               Location loc, ArrayRef<Value> loops,
+                               ArrayRef<int64_t> loopSizes);
+
+// Schedule the innermost of the given loops, iterating over the last
+// dimension of `memRefType`, to be vectorized with the widest vectors of the
+// target holding its elements. This must be called with the insertion point
+// in the optimization block of the loops.
+void emitInnermostVectorizedLoop(ConversionPatternRewriter &rewriter,
+                                 Location loc, ArrayRef<Value> loops,
+                                 MemRefType memRefType);
+
 unsigned getMemRefEltSizeInBytes(MemRefType memRefType);
 
+// Size of a dimension of a matrix multiplication, either known at compile
+// time or given by a value computed at run time (constant is then -1).
+struct GemmSize {
+  int64_t constant;
+  Value value;
+};
+
+// Emit the load of the element (row, column) of an operand of a matrix
+// multiplication.
+using GemmLoadFn = llvm::function_ref<Value(Value, Value)>;
+
+// Emit the accumulation of a value into the element (row, column) of the
+// result of a matrix multiplication.
+using GemmAccumulateFn = llvm::function_ref<void(Value, Value, Value)>;
+
+// Accumulate alpha * A * B into Y, of size M x N, with a cache-blocked kernel
+// packing its operands into contiguous buffers. The elements of the operands
+// and of the result are accessed through the given functions, so that the
+// matrices can be views of higher-rank memrefs. A null alpha stands for 1.
+void emitPackedGemm(ConversionPatternRewriter &rewriter, Location loc,
+                    Type elementType, GemmSize M, GemmSize N, GemmSize K,
+                    GemmLoadFn loadA, GemmLoadFn loadB,
+                    GemmAccumulateFn accumulateY, Value alpha);
+
+// Accumulate alpha * op(A) * op(B) into Y with the cache-blocked kernel,
+// op(X) being X or its transpose. The matrices are the last two dimensions
+// of the memrefs, indexed by the given values in their leading dimensions.
+// A null alpha stands for 1.
+void emitPackedGemm(ConversionPatternRewriter &rewriter, Location loc,
+                    Value A, ArrayRef<Value> aIndices, bool isTransA, Value B,
+                    ArrayRef<Value> bIndices, bool isTransB, Value Y,
+                    ArrayRef<Value> yIndices, Value alpha);
+
+// Region of the output positions of a sliding window operation, e.g. a
+// convolution or a pooling, spanning [lowerBounds[i], upperBounds[i]) in each
+// spatial dimension i, an upper bound of -1 standing for the whole dimension.
+// The windows of the positions of the region reach into the padding of the
+// input only in the dimensions i such that isBorder[i] is set, the accesses
+// to the input along these dimensions then having to be bounds checked.
+struct SlidingWindowRegion {
+  SmallVector<int64_t, 4> lowerBounds;
+  SmallVector<int64_t, 4> upperBounds;
+  SmallVector<bool, 4> isBorder;
+};
+
+// Split the output positions of a sliding window operation into regions, so
+// that the padding is only checked for in the border regions. The interior
+// region, whose windows lie within the input, is last. The shapes, strides
+// and dilations are those of the spatial dimensions, and the pads are given
+// as [x1_begin, x2_begin, ..., x1_end, x2_end, ...]. A single unchecked
+// region is returned when there is no padding.
+std::vector<SlidingWindowRegion> getSlidingWindowRegions(
+    ArrayRef<int64_t> inputShape, ArrayRef<int64_t> resultShape,
+    ArrayRef<int64_t> kernelShape, ArrayRef<int64_t> pads,
+    ArrayRef<int64_t> strides, ArrayRef<int64_t> dilations);
+
+// Emit the index s * r + d * k - pad of the input element covered by the
+// offset k of the window at the output position r along a spatial dimension.
+Value emitSlidingWindowIndex(ConversionPatternRewriter &rewriter,
+                             Location loc, Value r, Value k, int64_t stride,
+                             int64_t dilation, int64_t pad);
+
+// Emit the load of memRef[indices], the indices i such that isChecked[i] is
+// set possibly falling out of the bounds of the memref, in which case
+// `padding` is returned instead. The load itself is always in bounds, so that
+// this is branch free.
+Value emitLoadOrPadding(ConversionPatternRewriter &rewriter, Location loc,
+                        Value memRef, ArrayRef<Value> indices,
+                        ArrayRef<bool> isChecked, Value padding);
+
 // Get run-time dimension information for unknown dimensions used for
 // broadcasting.
 std::map<int, std::map<int, Value>>
@@ -92,7 +232,9 @@ getBroadcastedDimInfo(Location loc, ConversionPatternRewriter &rewriter,
                       MemRefType memRefType, ArrayRef<Value> operands);
 
 // Extract induction variables that are used for broadcasting values of a
-// given operand.
+// given operand. `broadcastedDims` maps the dynamic dimensions that may be
+// broadcasted to whether they are at run time, a null value standing for a
+// dimension known to be broadcasted.
 std::vector<Value>
 getLoopIVsForBroadcasting(Location loc, ConversionPatternRewriter &rewriter,
                           ArrayRef<Value> loopIVs, Value operand,
@@ -117,6 +259,14 @@ Value emitPositiveInfinityConstantOp(
 Value emitNegativeInfinityConstantOp(
     ConversionPatternRewriter &rewriter, Location loc, Type type);
 
+// Emit exp(x), log(x) and tanh(x). On f32, these are polynomial approximations
+// which can be executed on vectors, whose maximum error in units in the last
+// place is selected with --math-max-ulps. Otherwise, or if no approximation
+// is accurate enough, the math library is called.
+Value emitExp(ConversionPatternRewriter &rewriter, Location loc, Value x);
+Value emitLog(ConversionPatternRewriter &rewriter, Location loc, Value x);
+Value emitTanh(ConversionPatternRewriter &rewriter, Location loc, Value x);
+
 //===----------------------------------------------------------------------===//
 // This is to get a scalar operation of a given type for a specific operation.
 //===----------------------------------------------------------------------===//
@@ -242,3 +392,9 @@ void populateLoweringONNXReshapeOpPattern(
 
 void populateLoweringONNXIdentityOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
+
+void populateLoweringONNXConstantOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
+void populateLoweringONNXLayoutTransformOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
@@ -0,0 +1,85 @@
+//===----- constant.cpp - Lowering Constant Op ----------------------------===//
+//
+// Copyright 2019 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX Constant Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/conversion/onnx_to_krnl/onnx_to_krnl_common.hpp"
+
+using namespace mlir;
+
+struct ONNXConstantOpLowering : public ConversionPattern {
+  ONNXConstantOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXConstantOp::getOperationName(), 1, ctx) {}
+
+  PatternMatchResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    auto constantOp = llvm::dyn_cast<ONNXConstantOp>(op);
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    // Only dense constants of known shapes are supported.
+    if (!hasAllConstantDimensions(memRefType))
+      return matchFailure();
+    auto value = getDenseElements(constantOp, memRefType);
+    if (!value)
+      return matchFailure();
+
+    // The elements are emitted into the data of the compiled module, and read
+    // in place rather than stored into a buffer on every execution.
+    Value global = rewriter.create<KrnlGlobalOp>(loc, memRefType, value);
+
+    // A buffer returned from the function is owned by the caller, so a
+    // returned constant is copied out of the read-only global.
+    if (checkInsertDealloc(op)) {
+      rewriter.replaceOp(op, global);
+      return matchSuccess();
+    }
+    Value alloc = insertAllocAndDealloc(
+        memRefType, loc, rewriter, /*insertDealloc=*/false);
+    Value size = emitConstantOp(rewriter, loc, rewriter.getIntegerType(64),
+        getMemRefEltSizeInBytes(memRefType) * memRefType.getNumElements());
+    rewriter.create<KrnlMemcpyOp>(loc, alloc, global, size);
+    rewriter.replaceOp(op, alloc);
+
+    return matchSuccess();
+  }
+
+private:
+  // Get the elements of the constant as dense elements of the type of the
+  // memref, or null if they are not given as numbers. The elements are given
+  // either as an array attribute or as dense elements, as imported from the
+  // initializers of a model.
+  static DenseElementsAttr getDenseElements(
+      ONNXConstantOp constantOp, MemRefType memRefType) {
+    auto elementType = memRefType.getElementType();
+    auto type = RankedTensorType::get(memRefType.getShape(), elementType);
+    auto denseAttribute =
+        constantOp.valueAttr().dyn_cast_or_null<DenseElementsAttr>();
+    if (denseAttribute && denseAttribute.getType() == type)
+      return denseAttribute;
+
+    SmallVector<double, 16> values;
+    if (!getONNXConstantElements(constantOp.getResult(), values) ||
+        (int64_t)values.size() != type.getNumElements())
+      return nullptr;
+    SmallVector<Attribute, 16> elements;
+    for (auto value : values) {
+      if (elementType.isa<FloatType>())
+        elements.emplace_back(FloatAttr::get(elementType, value));
+      else if (elementType.isa<IntegerType>())
+        elements.emplace_back(IntegerAttr::get(elementType, (int64_t)value));
+      else
+        return nullptr;
+    }
+    return DenseElementsAttr::get(type, elements);
+  }
+};
+
+void populateLoweringONNXConstantOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXConstantOpLowering>(ctx);
+}
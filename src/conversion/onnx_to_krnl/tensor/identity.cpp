@@ -19,7 +19,25 @@ struct ONNXIdentityOpLowering : public ConversionPattern {
   PatternMatchResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const final {
-    rewriter.replaceOp(op, operands[0]);
+    auto loc = op->getLoc();
+    auto memRefType = operands[0].getType().cast<MemRefType>();
+    // The result is the operand itself, unless it cannot own its buffer.
+    if (auto view =
+            emitMemRefView(rewriter, loc, op, operands[0], memRefType, {})) {
+      rewriter.replaceOp(op, view);
+      return matchSuccess();
+    }
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc;
+    if (hasAllConstantDimensions(memRefType))
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    else
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc,
+                                    {operands[0]});
+    Value tensorSize = emitMemRefSizeInBytes(rewriter, loc, operands[0]);
+    rewriter.create<KrnlMemcpyOp>(loc, alloc, operands[0], tensorSize);
+    rewriter.replaceOp(op, alloc);
     return matchSuccess();
   }
 };
@@ -0,0 +1,93 @@
+//===----- layout_transform.cpp - Lowering LayoutTransform Op -------------===//
+//
+// Copyright 2019 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX LayoutTransform Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/conversion/onnx_to_krnl/onnx_to_krnl_common.hpp"
+
+using namespace mlir;
+
+struct ONNXLayoutTransformOpLowering : public ConversionPattern {
+  ONNXLayoutTransformOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXLayoutTransformOp::getOperationName(), 1, ctx) {}
+
+  PatternMatchResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    auto layoutOp = llvm::dyn_cast<ONNXLayoutTransformOp>(op);
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto targetLayout = layoutOp.target_layout();
+    // The blocked layouts are only introduced for tensors of known shapes.
+    if (!hasAllConstantDimensions(memRefType))
+      return matchFailure();
+    if (targetLayout != "NCHWc" && targetLayout != "NCHW" &&
+        targetLayout != "OIHWio") {
+      emitError(loc, "unsupported target layout: ") << targetLayout;
+      return matchFailure();
+    }
+
+    // Insert an allocation and deallocation for the result of this operation.
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    // Iterate over the elements of the result, with b channels per block:
+    //
+    // NCHWc:  R[n][cb][h][w][ci] = X[n][cb * b + ci][h][w]
+    // NCHW:   R[n][c][h][w] = X[n][c floordiv b][h][w][c mod b]
+    // OIHWio: R[mb][cb][kh][kw][ci][mo] = X[mb * b + mo][cb * b + ci][kh][kw]
+    auto resultShape = memRefType.getShape();
+    int64_t rank = resultShape.size();
+    BuildKrnlLoop loops(rewriter, loc, rank);
+    loops.createDefineAndOptimizeOp();
+    for (int i = 0; i < rank; ++i)
+      loops.pushBounds(0, alloc, i);
+    for (int i = 0; i < rank; ++i)
+      if (resultShape[i] != 1) {
+        loops.parallel(i);
+        break;
+      }
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+
+    auto arguments = loops.getIterateBlock()->getArguments();
+    SmallVector<Value, 6> ivs(arguments.begin(), arguments.end());
+    int64_t block = layoutOp.channel_block().getSExtValue();
+    auto d0 = getAffineDimExpr(0, rewriter.getContext());
+    auto d1 = getAffineDimExpr(1, rewriter.getContext());
+    auto apply = [&](AffineExpr expr, ArrayRef<Value> operands) -> Value {
+      return rewriter.create<AffineApplyOp>(
+          loc, AffineMap::get(operands.size(), 0, expr), operands);
+    };
+
+    SmallVector<Value, 5> dataIndices;
+    if (targetLayout == "NCHWc") {
+      dataIndices = {ivs[0], apply(d0 * block + d1, {ivs[1], ivs[4]}), ivs[2],
+          ivs[3]};
+    } else if (targetLayout == "NCHW") {
+      dataIndices = {ivs[0], apply(d0.floorDiv(block), ivs[1]), ivs[2],
+          ivs[3], apply(d0 % block, ivs[1])};
+    } else {
+      dataIndices = {apply(d0 * block + d1, {ivs[0], ivs[5]}),
+          apply(d0 * block + d1, {ivs[1], ivs[4]}), ivs[2], ivs[3]};
+    }
+
+    auto value = rewriter.create<LoadOp>(loc, operands[0], dataIndices);
+    rewriter.create<StoreOp>(loc, value, alloc, ivs);
+
+    rewriter.replaceOp(op, alloc);
+
+    return matchSuccess();
+  }
+};
+
+void populateLoweringONNXLayoutTransformOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXLayoutTransformOpLowering>(ctx);
+}
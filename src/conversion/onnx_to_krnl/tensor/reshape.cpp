@@ -27,26 +27,15 @@ struct ONNXReshapeOpLowering : public ConversionPattern {
     auto memRefShape = memRefType.getShape();
     Value alloc;
 
-    // Compute size in bytes using the input tensor.
-    Value tensorSize = emitConstantOp(rewriter, loc,
-        rewriter.getIntegerType(64), getMemRefEltSizeInBytes(memRefType));
-    for (int i = 0; i < inputShape.size(); ++i) {
-      Value dimVal;
-      if (inputShape[i] < 0) {
-        Value dim = rewriter.create<DimOp>(loc, operands[0], i);
-        dimVal =
-            rewriter.create<IndexCastOp>(loc, dim, rewriter.getIntegerType(64));
-      } else {
-        dimVal = emitConstantOp(
-            rewriter, loc, rewriter.getIntegerType(64), inputShape[i]);
-      }
-      tensorSize = rewriter.create<MulIOp>(loc, tensorSize, dimVal);
-    }
+    // Compute size in bytes using the input tensor. It is needed to copy the
+    // input, or to compute the dimensions of the result given as -1.
+    Value tensorSize;
+    if (!hasAllConstantDimensions(memRefType))
+      tensorSize = emitMemRefSizeInBytes(rewriter, loc, operands[0]);
 
-    bool insertDealloc = checkInsertDealloc(op);
-    if (hasAllConstantDimensions(memRefType)) {
-      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
-    } else {
+    // Sizes of the dynamic dimensions of the result.
+    SmallVector<Value, 4> dimSizes;
+    if (!hasAllConstantDimensions(memRefType)) {
       // If a dimension is zero, the actual dimension value is taken from the
       // input tensor.
       //
@@ -104,12 +93,11 @@ struct ONNXReshapeOpLowering : public ConversionPattern {
       tensorSizeFromShape =
           rewriter.create<SubIOp>(loc, zero, tensorSizeFromShape);
 
-      // Obtain operands for AllocOp.
-      SmallVector<Value, 4> allocOperands;
       auto negOne =
           emitConstantOp(rewriter, loc, rewriter.getIntegerType(64), -1);
-
       for (int i = 0; i < memRefShape.size(); ++i) {
+        if (memRefShape[i] >= 0)
+          continue;
         auto dimVal = DimInfo[i];
         auto isNegOne =
             rewriter.create<CmpIOp>(loc, CmpIPredicate::eq, dimVal, negOne);
@@ -119,11 +107,25 @@ struct ONNXReshapeOpLowering : public ConversionPattern {
             rewriter.create<SignedDivIOp>(loc, tensorSize, tensorSizeFromShape);
         auto loadedVal =
             rewriter.create<SelectOp>(loc, isNegOne, actualDimVal, dimVal);
-        allocOperands.push_back(rewriter.create<IndexCastOp>(
+        dimSizes.push_back(rewriter.create<IndexCastOp>(
             loc, loadedVal, rewriter.getIndexType()));
       }
+    }
+
+    // The input is contiguous: the result is a view of it, unless it cannot
+    // own its buffer.
+    if (auto view = emitMemRefView(
+            rewriter, loc, op, operands[0], memRefType, dimSizes)) {
+      rewriter.replaceOp(op, view);
+      return matchSuccess();
+    }
+
+    bool insertDealloc = checkInsertDealloc(op);
+    if (hasAllConstantDimensions(memRefType)) {
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    } else {
       AllocOp allocateMemref =
-          rewriter.create<AllocOp>(loc, memRefType, allocOperands);
+          rewriter.create<AllocOp>(loc, memRefType, dimSizes);
 
       // Make sure to allocate at the beginning of the block if
       // all dimensions are known.
@@ -136,6 +138,8 @@ struct ONNXReshapeOpLowering : public ConversionPattern {
       alloc = allocateMemref;
     }
 
+    if (!tensorSize)
+      tensorSize = emitMemRefSizeInBytes(rewriter, loc, operands[0]);
     rewriter.create<KrnlMemcpyOp>(loc, alloc, operands[0], tensorSize);
     rewriter.replaceOp(op, alloc);
 
@@ -12,6 +12,64 @@
 
 using namespace mlir;
 
+namespace {
+
+// Width in bytes of the strips of columns of the input transposed at once:
+// every row of a strip is a cache line.
+const int64_t transposeStripSizeInBytes = 64;
+
+// Emit a loop nest where the i-th loop iterates from `lbs[i]` to `ubs[i]`,
+// these expressions being functions of the sizes of the problem unknown at
+// compile time passed as `symbols`. The schedule of the loops is emitted by
+// `emitSchedule`, and the loop body by `emitBody` given the induction
+// variables. The insertion point is left after the loop nest.
+void emitTransposeLoopNest(ConversionPatternRewriter &rewriter, Location loc,
+                           ArrayRef<AffineExpr> lbs, ArrayRef<AffineExpr> ubs,
+                           ArrayRef<Value> symbols,
+                           function_ref<void(ArrayRef<Value>)> emitSchedule,
+                           function_ref<void(ArrayRef<Value>)> emitBody) {
+  std::vector<Value> loops, optimizedLoops;
+  Block *optimizationBlock =
+      defineLoops(rewriter, loc, loops, optimizedLoops, lbs.size());
+  KrnlIterateOperandPack pack(rewriter, loops, optimizedLoops);
+  auto pushBound = [&](AffineExpr expr) {
+    if (auto constantExpr = expr.dyn_cast<AffineConstantExpr>())
+      return pack.pushConstantBound(constantExpr.getValue());
+    pack.pushAffineMapBound(AffineMap::get(0, symbols.size(), expr), symbols);
+  };
+  for (int i = 0; i < lbs.size(); ++i) {
+    pushBound(lbs[i]);
+    pushBound(ubs[i]);
+  }
+  auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
+
+  PatternRewriter::InsertionGuard insertGuard(rewriter);
+  rewriter.setInsertionPointToEnd(optimizationBlock);
+  emitSchedule(loops);
+  rewriter.create<KrnlReturnLoopsOp>(loc, loops);
+  Block &iterationBlock = iterateOp.bodyRegion().front();
+  rewriter.setInsertionPointToStart(&iterationBlock);
+  SmallVector<Value, 4> ivs(iterationBlock.getArguments().begin(),
+                            iterationBlock.getArguments().end());
+  emitBody(ivs);
+}
+
+} // namespace
+
+// The transpose is lowered according to how it moves the elements in memory.
+// Dimensions of size 1 do not take part in the layout, and runs of adjacent
+// dimensions of the input that stay adjacent in the result are moved as a
+// whole, like a single collapsed dimension:
+//
+// - Permutations only moving dimensions of size 1 keep the layout of the
+//   data: the result is a view of the input.
+// - When the innermost dimension of the input stays innermost, contiguous
+//   runs of elements are copied, with vectors.
+// - Otherwise, the innermost dimensions of the input and of the result form a
+//   2-D transpose, performed by strips of one cache line of each row of the
+//   input. The loop over the columns of a strip is unrolled: the row of the
+//   strip is loaded at once and its elements stored to as many rows of the
+//   result, which are all written sequentially.
 struct ONNXTransposeOpLowering : public ConversionPattern {
   ONNXTransposeOpLowering(MLIRContext *ctx)
       : ConversionPattern(mlir::ONNXTransposeOp::getOperationName(), 1, ctx) {}
@@ -20,8 +78,52 @@ struct ONNXTransposeOpLowering : public ConversionPattern {
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
                   ConversionPatternRewriter &rewriter) const final {
     auto loc = op->getLoc();
-    // Insert an allocation and deallocation for the result of this operation.
     auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto input = operands[0];
+    auto inputShape = input.getType().cast<MemRefType>().getShape();
+    int64_t rank = inputShape.size();
+
+    // Read perm attribute.
+    SmallVector<int64_t, 4> perm;
+    auto permAttribute = llvm::dyn_cast<ONNXTransposeOp>(op).permAttr();
+    if (permAttribute) {
+      for (auto permVal : permAttribute.getValue())
+        perm.emplace_back(permVal.cast<IntegerAttr>().getInt());
+    } else {
+      // TODO: Remove when perm is guaranteed to be present (even for
+      // the default case). This means that perm was added by shape
+      // inference or another pass to contain the values corresponding
+      // to the default behavior of Transpose.
+      for (int i = rank - 1; i >= 0; i--)
+        perm.emplace_back(i);
+    }
+
+    // The dimensions of the input not of size 1, in the order of the input
+    // and in the order of the result.
+    SmallVector<int64_t, 4> inputDims, resultDims;
+    for (int i = 0; i < rank; ++i) {
+      if (inputShape[i] != 1)
+        inputDims.emplace_back(i);
+      if (inputShape[perm[i]] != 1)
+        resultDims.emplace_back(perm[i]);
+    }
+
+    // The layout is kept: the result is a view of the input, unless it cannot
+    // own its buffer, in which case the data is copied.
+    bool isLayoutKept = inputDims == resultDims;
+    if (isLayoutKept) {
+      SmallVector<Value, 4> dimSizes;
+      for (int i = 0; i < rank; ++i)
+        if (memRefType.getShape()[i] < 0)
+          dimSizes.emplace_back(rewriter.create<DimOp>(loc, input, perm[i]));
+      if (auto view = emitMemRefView(
+              rewriter, loc, op, input, memRefType, dimSizes)) {
+        rewriter.replaceOp(op, view);
+        return matchSuccess();
+      }
+    }
+
+    // Insert an allocation and deallocation for the result of this operation.
     Value alloc;
     bool insertDealloc = checkInsertDealloc(op);
 
@@ -31,64 +133,178 @@ struct ONNXTransposeOpLowering : public ConversionPattern {
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc,
                                     {operands[0]});
 
-    // Number of loops
-    auto memRefShape = memRefType.getShape();
-    int64_t rank = memRefShape.size();
-
-    // Define loops.
-    std::vector<Value> originalLoops;
-    std::vector<Value> optimizedLoops;
-    Block *optimizationBlock = defineLoops(rewriter, loc, originalLoops,
-        optimizedLoops, rank);
-
-    KrnlIterateOperandPack pack(rewriter, originalLoops, optimizedLoops);
-    // Iterate over the loop nest using the input shape.
-    for (int i = 0; i < rank; ++i)
-      addDimensionToPack(rewriter, loc, pack, operands[0], i);
-
-    auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
-    Block &iterationBlock = iterateOp.bodyRegion().front();
-
-    // Now perform the insertions into the body of the
-    // just generated instructions:
+    if (isLayoutKept) {
+      Value tensorSize = emitMemRefSizeInBytes(rewriter, loc, input);
+      rewriter.create<KrnlMemcpyOp>(loc, alloc, input, tensorSize);
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
 
-    // 1. Insert any optimizations in the KrnlOptimizeLoopsOp body.
-    rewriter.setInsertionPointToEnd(optimizationBlock);
-    // Return from KrnlOptimizeLoopsOp body.
-    // When no optimizations are present we just return the loops
-    // unchaged.
-    rewriter.create<KrnlReturnLoopsOp>(loc, originalLoops);
+    // Sizes of the dimensions of the input, the ones unknown at compile time
+    // being symbols.
+    SmallVector<Value, 4> symbols;
+    auto getSize = [&](int64_t dim) -> AffineExpr {
+      if (inputShape[dim] >= 0)
+        return rewriter.getAffineConstantExpr(inputShape[dim]);
+      symbols.emplace_back(rewriter.create<DimOp>(loc, input, dim));
+      return rewriter.getAffineSymbolExpr(symbols.size() - 1);
+    };
+    auto zero = rewriter.getAffineConstantExpr(0);
+    auto d0 = rewriter.getAffineDimExpr(0);
+    auto d1 = rewriter.getAffineDimExpr(1);
+    auto emitStore = [&](ArrayRef<Value> inputIndices) {
+      SmallVector<Value, 4> resultIndices;
+      for (int i = 0; i < rank; ++i)
+        resultIndices.emplace_back(inputIndices[perm[i]]);
+      auto inVal = rewriter.create<LoadOp>(loc, input, inputIndices);
+      rewriter.create<StoreOp>(loc, inVal, alloc, resultIndices);
+    };
 
-    // 2. Insert instructions inside the KernelIterateOp body.
-    rewriter.setInsertionPointToStart(&iterationBlock);
+    // The innermost dimension of the input stays innermost: iterate over the
+    // result, the innermost loop copying contiguous elements.
+    if (resultDims.back() == inputDims.back()) {
+      SmallVector<AffineExpr, 4> lbs(rank, zero), ubs;
+      for (int i = 0; i < rank; ++i)
+        ubs.emplace_back(getSize(perm[i]));
+      emitTransposeLoopNest(rewriter, loc, lbs, ubs, symbols,
+          [&](ArrayRef<Value> loops) {
+            emitOutermostParallelLoop(
+                rewriter, loc, loops, memRefType.getShape());
+            emitInnermostVectorizedLoop(rewriter, loc, loops, memRefType);
+          },
+          [&](ArrayRef<Value> ivs) {
+            SmallVector<Value, 4> inputIndices(rank);
+            for (int i = 0; i < rank; ++i)
+              inputIndices[perm[i]] = ivs[i];
+            emitStore(inputIndices);
+          });
+      rewriter.replaceOp(op, alloc);
+      return matchSuccess();
+    }
 
-    // Handle the operation.
+    // Collapse the innermost dimensions of the input staying adjacent in the
+    // result, and the innermost dimensions of the result adjacent in the
+    // input. The indices of collapsed dimensions are computed with affine
+    // maps, so all but the outermost of them must be of known size.
+    auto resultPosition = [&](int64_t dim) {
+      return llvm::find(resultDims, dim) - resultDims.begin();
+    };
+    auto inputPosition = [&](int64_t dim) {
+      return llvm::find(inputDims, dim) - inputDims.begin();
+    };
+    SmallVector<int64_t, 4> columnDims = {inputDims.back()};
+    for (int i = inputDims.size() - 1; i > 0; --i) {
+      int64_t dim = inputDims[i - 1];
+      if (inputShape[columnDims.front()] < 0 ||
+          resultPosition(dim) + 1 != resultPosition(columnDims.front()))
+        break;
+      columnDims.insert(columnDims.begin(), dim);
+    }
+    SmallVector<int64_t, 4> rowDims = {resultDims.back()};
+    for (int i = resultDims.size() - 1; i > 0; --i) {
+      int64_t dim = resultDims[i - 1];
+      if (inputShape[rowDims.front()] < 0 ||
+          inputPosition(dim) + 1 != inputPosition(rowDims.front()))
+        break;
+      rowDims.insert(rowDims.begin(), dim);
+    }
 
-    // Read perm attribute.
-    SmallVector<int, 4> perm;
-    auto permAttribute = llvm::dyn_cast<ONNXTransposeOp>(op).permAttr();
-    if (permAttribute) {
-      for (auto permVal : permAttribute.getValue())
-        perm.emplace_back(permVal.cast<IntegerAttr>().getInt());
-    } else {
-      // TODO: Remove when perm is guaranteed to be present (even for
-      // the default case). This means that perm was added by shape
-      // inference or another pass to contain the values corresponding
-      // to the default behavior of Transpose. 
-      for (int i = iterationBlock.getArguments().size()-1; i >= 0; i--)
-        perm.emplace_back(i);
+    // Sizes of the collapsed dimensions, and of the other dimensions iterated
+    // over in the order of the result.
+    auto getCollapsedSize = [&](ArrayRef<int64_t> dims) {
+      auto size = getSize(dims[0]);
+      for (auto dim : dims.drop_front())
+        size = size * inputShape[dim];
+      return size;
+    };
+    auto columns = getCollapsedSize(columnDims);
+    auto rows = getCollapsedSize(rowDims);
+    SmallVector<int64_t, 4> outerDims;
+    SmallVector<AffineExpr, 4> outerSizes;
+    SmallVector<int64_t, 4> outerLoopSizes;
+    for (int i = 0; i < rank; ++i) {
+      if (llvm::is_contained(columnDims, perm[i]) ||
+          llvm::is_contained(rowDims, perm[i]))
+        continue;
+      outerDims.emplace_back(perm[i]);
+      outerSizes.emplace_back(getSize(perm[i]));
+      outerLoopSizes.emplace_back(inputShape[perm[i]]);
     }
+    int64_t numOuterLoops = outerDims.size();
 
-    SmallVector<Value, 4> inLoopIVs;
-    for (auto arg : iterationBlock.getArguments())
-      inLoopIVs.emplace_back(arg);
+    // Compute the indices of collapsed dimensions from the index of the
+    // collapsed dimension, `expr` of the induction variables `ivs`.
+    auto setCollapsedIndices = [&](ArrayRef<int64_t> dims, AffineExpr expr,
+                                   ArrayRef<Value> ivs,
+                                   SmallVectorImpl<Value> &inputIndices) {
+      if (dims.size() == 1 && expr.isa<AffineDimExpr>()) {
+        inputIndices[dims[0]] =
+            ivs[expr.cast<AffineDimExpr>().getPosition()];
+        return;
+      }
+      int64_t innerSize = 1;
+      for (int i = dims.size() - 1; i >= 0; --i) {
+        auto indexExpr = expr.floorDiv(innerSize);
+        if (i != 0)
+          indexExpr = indexExpr % inputShape[dims[i]];
+        inputIndices[dims[i]] = rewriter.create<AffineApplyOp>(
+            loc, AffineMap::get(ivs.size(), 0, indexExpr), ivs);
+        innerSize *= inputShape[dims[i]];
+      }
+    };
+    auto emitCollapsedStore = [&](ArrayRef<Value> ivs, AffineExpr column,
+                                  ArrayRef<Value> columnIVs, Value row) {
+      SmallVector<Value, 4> inputIndices(rank);
+      for (int i = 0; i < numOuterLoops; ++i)
+        inputIndices[outerDims[i]] = ivs[i];
+      setCollapsedIndices(columnDims, column, columnIVs, inputIndices);
+      setCollapsedIndices(rowDims, d0, row, inputIndices);
+      emitStore(inputIndices);
+    };
 
-    SmallVector<Value, 4> outLoopIVs;
-    for (int i=0; i<iterationBlock.getArguments().size(); ++i)
-      outLoopIVs.emplace_back(iterationBlock.getArguments()[perm[i]]);
+    // Transpose the strips of columns: strip, row, and column in the strip.
+    int64_t stripWidth = std::max<int64_t>(
+        1, transposeStripSizeInBytes / getMemRefEltSizeInBytes(memRefType));
+    int64_t numColumns = -1;
+    if (auto constantExpr = columns.dyn_cast<AffineConstantExpr>())
+      numColumns = constantExpr.getValue();
+    if (numColumns < 0 || numColumns >= stripWidth) {
+      SmallVector<AffineExpr, 4> lbs(numOuterLoops + 3, zero);
+      SmallVector<AffineExpr, 4> ubs(outerSizes);
+      ubs.append({columns.floorDiv(stripWidth), rows,
+                  rewriter.getAffineConstantExpr(stripWidth)});
+      SmallVector<int64_t, 4> loopSizes(outerLoopSizes);
+      loopSizes.emplace_back(numColumns < 0 ? -1 : numColumns / stripWidth);
+      emitTransposeLoopNest(rewriter, loc, lbs, ubs, symbols,
+          [&](ArrayRef<Value> loops) {
+            emitOutermostParallelLoop(rewriter, loc, loops, loopSizes);
+            rewriter.create<KrnlUnrollOp>(loc, loops.back(), stripWidth);
+          },
+          [&](ArrayRef<Value> ivs) {
+            Value strip = ivs[numOuterLoops];
+            Value row = ivs[numOuterLoops + 1];
+            Value column = ivs[numOuterLoops + 2];
+            emitCollapsedStore(ivs, d0 * stripWidth + d1, {strip, column},
+                               row);
+          });
+    }
 
-    auto inVal = rewriter.create<LoadOp>(loc, operands[0], inLoopIVs);
-    rewriter.create<StoreOp>(loc, inVal, alloc, outLoopIVs);
+    // Transpose the columns following the last whole strip.
+    if (numColumns < 0 || numColumns % stripWidth != 0) {
+      SmallVector<AffineExpr, 4> lbs(numOuterLoops + 2, zero);
+      lbs.back() = columns.floorDiv(stripWidth) * stripWidth;
+      SmallVector<AffineExpr, 4> ubs(outerSizes);
+      ubs.append({rows, columns});
+      emitTransposeLoopNest(rewriter, loc, lbs, ubs, symbols,
+          [&](ArrayRef<Value> loops) {
+            emitOutermostParallelLoop(rewriter, loc, loops, outerLoopSizes);
+          },
+          [&](ArrayRef<Value> ivs) {
+            Value row = ivs[numOuterLoops];
+            Value column = ivs[numOuterLoops + 1];
+            emitCollapsedStore(ivs, d0, column, row);
+          });
+    }
 
     rewriter.replaceOp(op, alloc);
 
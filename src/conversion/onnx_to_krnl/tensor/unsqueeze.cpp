@@ -33,47 +33,39 @@ struct ONNXUnsqueezeOpLowering : public ConversionPattern {
       axes.emplace_back(axis);
     }
 
-    // Insert an allocation and deallocation for the result of this operation.
-    Value alloc;
+    // Sizes of the dynamic dimensions of the result, which are always the
+    // operand's dimensions.
+    auto memRefShape = memRefType.getShape();
+    SmallVector<Value, 4> dimSizes;
+    for (int outIdx = 0, inIdx = 0; outIdx < memRefShape.size(); ++outIdx) {
+      if (memRefShape[outIdx] < 0)
+        dimSizes.emplace_back(rewriter.create<DimOp>(loc, operands[0], inIdx));
+      if (std::find(axes.begin(), axes.end(), outIdx) == axes.end())
+        inIdx++;
+    }
 
-    // Compute size in bytes.
-    Value tensorSize = emitConstantOp(rewriter, loc,
-        rewriter.getIntegerType(64), getMemRefEltSizeInBytes(memRefType));
+    // Inserting dimensions of size 1 keeps the layout of the data: the result
+    // is a view of the operand, unless it cannot own its buffer.
+    if (auto view = emitMemRefView(
+            rewriter, loc, op, operands[0], memRefType, dimSizes)) {
+      rewriter.replaceOp(op, view);
+      return matchSuccess();
+    }
 
+    // Insert an allocation and deallocation for the result of this operation.
+    Value alloc;
     bool insertDealloc = checkInsertDealloc(op);
-    auto memRefShape = memRefType.getShape();
     if (hasAllConstantDimensions(memRefType)) {
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
-      for (int i = 0; i < memRefShape.size(); ++i) {
-        Value dimVal = emitConstantOp(
-            rewriter, loc, rewriter.getIntegerType(64), memRefShape[i]);
-        tensorSize = rewriter.create<MulIOp>(loc, tensorSize, dimVal);
-      }
     } else {
-      // Unknown dimensions are always the operand's dimensions.
-      SmallVector<Value, 4> allocOperands;
-      for (int outIdx = 0, inIdx = 0; outIdx < memRefShape.size(); ++outIdx) {
-        Value dimVal = nullptr;
-        if (memRefShape[outIdx] < 0) {
-          Value index = rewriter.create<DimOp>(loc, operands[0], inIdx);
-          dimVal = rewriter.create<IndexCastOp>(
-              loc, index, rewriter.getIntegerType(64));
-          allocOperands.emplace_back(index);
-        } else {
-          dimVal = emitConstantOp(
-              rewriter, loc, rewriter.getIntegerType(64), memRefShape[outIdx]);
-        }
-        tensorSize = rewriter.create<MulIOp>(loc, tensorSize, dimVal);
-        if (std::find(axes.begin(), axes.end(), outIdx) == axes.end())
-          inIdx++;
-      }
-      alloc = rewriter.create<AllocOp>(loc, memRefType, allocOperands);
+      alloc = rewriter.create<AllocOp>(loc, memRefType, dimSizes);
       auto *parentBlock = alloc.getDefiningOp()->getBlock();
       if (insertDealloc) {
         auto dealloc = rewriter.create<DeallocOp>(loc, alloc);
         dealloc.getOperation()->moveBefore(&parentBlock->back());
       }
     }
+    Value tensorSize = emitMemRefSizeInBytes(rewriter, loc, operands[0]);
     rewriter.create<KrnlMemcpyOp>(loc, alloc, operands[0], tensorSize);
     rewriter.replaceOp(op, alloc);
     return matchSuccess();
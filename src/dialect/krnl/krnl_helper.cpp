@@ -139,6 +139,14 @@ void KrnlIterateOperandPack::pushOperandBound(Value operand) {
   _operands.emplace_back(operand);
 }
 
+void KrnlIterateOperandPack::pushAffineMapBound(
+    AffineMap map, ArrayRef<Value> operands) {
+  if (boundMaps.size() % 2 == 0)
+    _operands.emplace_back(inputLoops[boundMaps.size() / 2]);
+  boundMaps.emplace_back(AffineMapAttr::get(map));
+  _operands.append(operands.begin(), operands.end());
+}
+
 BuildKrnlLoop::BuildKrnlLoop(
     ConversionPatternRewriter &rewriter, Location loc, int loopNum)
     : rewriter(rewriter), loc(loc), originalLoopNum(loopNum), pack(NULL),
@@ -225,6 +233,44 @@ int BuildKrnlLoop::pushBounds(Value lowerBound, Value upperBound) {
   return pushCount++;
 }
 
+void BuildKrnlLoop::unrollJam(int originalLoopIndex, int64_t factor) {
+  // Loop optimization operation is mandatory.
+  if (!createdOptimizeOp)
+    emitError(loc, "Must create optimize op before scheduling loops.");
+
+  // Schedule directives go before the krnl.return_loops terminator.
+  auto ip = rewriter.saveInsertionPoint();
+  rewriter.setInsertionPoint(optBlock->getTerminator());
+  rewriter.create<KrnlUnrollJamOp>(
+      loc, originalLoops[originalLoopIndex], factor);
+  rewriter.restoreInsertionPoint(ip);
+}
+
+void BuildKrnlLoop::parallel(int originalLoopIndex) {
+  // Loop optimization operation is mandatory.
+  if (!createdOptimizeOp)
+    emitError(loc, "Must create optimize op before scheduling loops.");
+
+  // Schedule directives go before the krnl.return_loops terminator.
+  auto ip = rewriter.saveInsertionPoint();
+  rewriter.setInsertionPoint(optBlock->getTerminator());
+  rewriter.create<KrnlParallelOp>(loc, originalLoops[originalLoopIndex]);
+  rewriter.restoreInsertionPoint(ip);
+}
+
+void BuildKrnlLoop::vectorize(int originalLoopIndex, int64_t width) {
+  // Loop optimization operation is mandatory.
+  if (!createdOptimizeOp)
+    emitError(loc, "Must create optimize op before scheduling loops.");
+
+  // Schedule directives go before the krnl.return_loops terminator.
+  auto ip = rewriter.saveInsertionPoint();
+  rewriter.setInsertionPoint(optBlock->getTerminator());
+  rewriter.create<KrnlVectorizeOp>(
+      loc, originalLoops[originalLoopIndex], width);
+  rewriter.restoreInsertionPoint(ip);
+}
+
 void BuildKrnlLoop::createIterateOp() {
   // Loop definition operation is mandatory.
   if (!createdDefineOp)
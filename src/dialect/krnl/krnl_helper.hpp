@@ -77,6 +77,12 @@ struct KrnlIterateOperandPack {
 
   void pushOperandBound(mlir::Value operand);
 
+  // Push a bound given by an affine map applied to the given dimension and
+  // symbol operands. An upper (lower) bound map with several results is the
+  // min (max) of its results.
+  void pushAffineMapBound(
+      mlir::AffineMap map, llvm::ArrayRef<mlir::Value> operands);
+
   llvm::SmallVector<mlir::Value, 8> getOperands() const { return _operands; }
 
   mlir::ArrayAttr getAttributes() const {
@@ -153,6 +159,20 @@ public:
   int pushBounds(int64_t lowerBound, Value upperBoundMemRefOperand,
       int upperBoundMemRefIndex, bool upperBoundMustBeConstant = false);
 
+  // Unroll the original loop with the given index by the given factor and
+  // jam the copies of the loops nested inside of it. The optimization
+  // operation must have been emitted with an empty optimization.
+  void unrollJam(int originalLoopIndex, int64_t factor);
+
+  // Execute the iterations of the original loop with the given index in
+  // parallel. The optimization operation must have been emitted.
+  void parallel(int originalLoopIndex);
+
+  // Execute the given number of consecutive iterations of the innermost
+  // original loop with the given index at once on vectors. The optimization
+  // operation must have been emitted.
+  void vectorize(int originalLoopIndex, int64_t width);
+
   // Create the KrnlIterateOp assiciated with this loop nest. The loops
   // iteration will be created if the definition and the optimization
   // operations associated with this loop nest have been emitted already.
@@ -364,6 +364,255 @@ ParseResult parseKrnlReturnLoopsOp(OpAsmParser &parser,
   return success();
 }
 
+//===----------------------------------------------------------------------===//
+// KrnlBlockOp
+//===----------------------------------------------------------------------===//
+
+void KrnlBlockOp::build(Builder *builder, OperationState &result, Value loop,
+                        int64_t tile_size) {
+  auto loopType = LoopType::get(builder->getContext());
+  result.addOperands(loop);
+  result.addAttribute(getTileSizeAttrName(),
+                      builder->getI64IntegerAttr(tile_size));
+  // The loop iterating over the tiles comes first, followed by the loop
+  // iterating within a tile.
+  result.types.append(2, loopType);
+}
+
+void print(OpAsmPrinter &p, KrnlBlockOp &op) {
+  p << "krnl.block ";
+  p.printOperand(op.getOperand());
+  p << " " << op.getTileSize();
+}
+
+// Parse a loop followed by an integer attribute, as used by the schedule
+// operations taking a single loop.
+static ParseResult parseLoopAndFactor(OpAsmParser &parser,
+                                      OperationState &result,
+                                      StringRef factorAttrName) {
+  auto &builder = parser.getBuilder();
+  OpAsmParser::OperandType loop;
+  IntegerAttr factor;
+  return failure(
+      parser.parseOperand(loop) ||
+      parser.resolveOperand(loop, LoopType::get(builder.getContext()),
+                            result.operands) ||
+      parser.parseAttribute(factor, builder.getIntegerType(64),
+                            factorAttrName, result.attributes));
+}
+
+ParseResult parseKrnlBlockOp(OpAsmParser &parser, OperationState &result) {
+  // Parse the loop being blocked, followed by the tile size.
+  if (parseLoopAndFactor(parser, result, KrnlBlockOp::getTileSizeAttrName()))
+    return failure();
+
+  auto loopTypes = llvm::SmallVector<Type, 2>(
+      2, LoopType::get(parser.getBuilder().getContext()));
+  return parser.addTypesToList(loopTypes, result.types);
+}
+
+static LogicalResult verify(KrnlBlockOp op) {
+  if (op.getTileSize() < 1)
+    return op.emitOpError("tile size must be positive");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlPermuteOp
+//===----------------------------------------------------------------------===//
+
+void KrnlPermuteOp::build(Builder *builder, OperationState &result,
+                          ArrayRef<Value> loops, ArrayRef<int64_t> map) {
+  result.addOperands(loops);
+  result.addAttribute(getMapAttrName(), builder->getI64ArrayAttr(map));
+  result.types.append(loops.size(), LoopType::get(builder->getContext()));
+}
+
+void print(OpAsmPrinter &p, KrnlPermuteOp &op) {
+  p << "krnl.permute(";
+  p.printOperands(op.operand_begin(), op.operand_end());
+  p << ") " << op.getAttr(KrnlPermuteOp::getMapAttrName());
+}
+
+ParseResult parseKrnlPermuteOp(OpAsmParser &parser, OperationState &result) {
+  auto loopType = LoopType::get(parser.getBuilder().getContext());
+
+  // Parse the loops being permuted, followed by the permutation map.
+  SmallVector<OpAsmParser::OperandType, 4> loops;
+  ArrayAttr map;
+  if (parser.parseOperandList(loops, OpAsmParser::Delimiter::Paren) ||
+      parser.resolveOperands(loops, loopType, result.operands) ||
+      parser.parseAttribute(map, KrnlPermuteOp::getMapAttrName(),
+                            result.attributes))
+    return failure();
+
+  auto loopTypes = llvm::SmallVector<Type, 4>(loops.size(), loopType);
+  return parser.addTypesToList(loopTypes, result.types);
+}
+
+static LogicalResult verify(KrnlPermuteOp op) {
+  auto map = op.getMap();
+  if (map.size() != op.getNumOperands())
+    return op.emitOpError("expected one map entry per permuted loop");
+
+  // Every position in the new loop order must be taken exactly once.
+  llvm::SmallBitVector seen(map.size());
+  for (auto position : map) {
+    if (position < 0 || position >= (int64_t)map.size() || seen[position])
+      return op.emitOpError("map must be a permutation of the loop positions");
+    seen.set(position);
+  }
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlUnrollOp
+//===----------------------------------------------------------------------===//
+
+void KrnlUnrollOp::build(Builder *builder, OperationState &result, Value loop,
+                         int64_t factor) {
+  result.addOperands(loop);
+  result.addAttribute(getFactorAttrName(), builder->getI64IntegerAttr(factor));
+}
+
+void print(OpAsmPrinter &p, KrnlUnrollOp &op) {
+  p << "krnl.unroll ";
+  p.printOperand(op.getOperand());
+  p << " " << op.getFactor();
+}
+
+ParseResult parseKrnlUnrollOp(OpAsmParser &parser, OperationState &result) {
+  return parseLoopAndFactor(parser, result, KrnlUnrollOp::getFactorAttrName());
+}
+
+static LogicalResult verify(KrnlUnrollOp op) {
+  if (op.getFactor() < 1)
+    return op.emitOpError("unroll factor must be positive");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlUnrollJamOp
+//===----------------------------------------------------------------------===//
+
+void KrnlUnrollJamOp::build(Builder *builder, OperationState &result,
+                            Value loop, int64_t factor) {
+  result.addOperands(loop);
+  result.addAttribute(getFactorAttrName(), builder->getI64IntegerAttr(factor));
+}
+
+void print(OpAsmPrinter &p, KrnlUnrollJamOp &op) {
+  p << "krnl.unroll_jam ";
+  p.printOperand(op.getOperand());
+  p << " " << op.getFactor();
+}
+
+ParseResult parseKrnlUnrollJamOp(OpAsmParser &parser,
+                                 OperationState &result) {
+  return parseLoopAndFactor(parser, result,
+                            KrnlUnrollJamOp::getFactorAttrName());
+}
+
+static LogicalResult verify(KrnlUnrollJamOp op) {
+  if (op.getFactor() < 1)
+    return op.emitOpError("unroll factor must be positive");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlParallelOp
+//===----------------------------------------------------------------------===//
+
+void KrnlParallelOp::build(Builder *builder, OperationState &result,
+                           Value loop) {
+  result.addOperands(loop);
+}
+
+void print(OpAsmPrinter &p, KrnlParallelOp &op) {
+  p << "krnl.parallel ";
+  p.printOperand(op.getOperand());
+}
+
+ParseResult parseKrnlParallelOp(OpAsmParser &parser, OperationState &result) {
+  OpAsmParser::OperandType loop;
+  return failure(parser.parseOperand(loop) ||
+                 parser.resolveOperand(
+                     loop, LoopType::get(parser.getBuilder().getContext()),
+                     result.operands));
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlVectorizeOp
+//===----------------------------------------------------------------------===//
+
+void KrnlVectorizeOp::build(Builder *builder, OperationState &result,
+                            Value loop, int64_t width) {
+  result.addOperands(loop);
+  result.addAttribute(getWidthAttrName(), builder->getI64IntegerAttr(width));
+}
+
+void print(OpAsmPrinter &p, KrnlVectorizeOp &op) {
+  p << "krnl.vectorize ";
+  p.printOperand(op.getOperand());
+  p << " " << op.getWidth();
+}
+
+ParseResult parseKrnlVectorizeOp(OpAsmParser &parser,
+                                 OperationState &result) {
+  return parseLoopAndFactor(parser, result,
+                            KrnlVectorizeOp::getWidthAttrName());
+}
+
+static LogicalResult verify(KrnlVectorizeOp op) {
+  if (op.getWidth() < 1)
+    return op.emitOpError("vector width must be positive");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlAllocaOp
+//===----------------------------------------------------------------------===//
+
+static LogicalResult verify(KrnlAllocaOp op) {
+  if (!op.getType().cast<MemRefType>().hasStaticShape())
+    return op.emitOpError("expects a memref of static shape");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlGlobalOp
+//===----------------------------------------------------------------------===//
+
+static LogicalResult verify(KrnlGlobalOp op) {
+  auto memRefType = op.getType().cast<MemRefType>();
+  auto valueType = op.value().getType();
+  if (!memRefType.hasStaticShape() ||
+      memRefType.getShape() != valueType.getShape() ||
+      memRefType.getElementType() != valueType.getElementType())
+    return op.emitOpError("expects a memref of the shape and element type of "
+                          "its value");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlReshapeOp
+//===----------------------------------------------------------------------===//
+
+static LogicalResult verify(KrnlReshapeOp op) {
+  auto srcType = op.src().getType().cast<MemRefType>();
+  auto resultType = op.getResult().getType().cast<MemRefType>();
+  if (!srcType.getAffineMaps().empty() || !resultType.getAffineMaps().empty())
+    return op.emitOpError("expected memrefs with the row-major layout");
+  if (srcType.getElementType() != resultType.getElementType())
+    return op.emitOpError("expected the same element type for the view");
+  if (srcType.hasStaticShape() && resultType.hasStaticShape() &&
+      srcType.getNumElements() != resultType.getNumElements())
+    return op.emitOpError("expected the same number of elements for the view");
+  if (llvm::size(op.sizes()) != resultType.getNumDynamicDims())
+    return op.emitOpError("expected one size per dynamic dimension");
+  return success();
+}
+
 void KrnlEntryPointOp::build(mlir::Builder *builder, OperationState &state,
                              SymbolRefAttr funcAttr, IntegerAttr numInputs,
                              IntegerAttr numOutputs) {
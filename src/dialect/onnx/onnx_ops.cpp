@@ -42,6 +42,39 @@ static int64_t ArrayAttrIntVal(Optional<ArrayAttr> a, int i) {
   return (a.getValue().getValue()[i]).cast<IntegerAttr>().getInt();
 }
 
+bool mlir::getONNXConstantElements(
+    Value value, SmallVectorImpl<double> &elements) {
+  auto constantOp = dyn_cast_or_null<ONNXConstantOp>(value.getDefiningOp());
+  auto type = value.getType().dyn_cast<RankedTensorType>();
+  if (!constantOp || !constantOp.valueAttr() || !type ||
+      !type.hasStaticShape())
+    return false;
+  // The elements are given either as an array attribute or as dense elements,
+  // as imported from the initializers of a model.
+  auto valueAttribute = constantOp.valueAttr();
+  SmallVector<Attribute, 16> attributes;
+  if (auto arrayAttribute = valueAttribute.dyn_cast<ArrayAttr>()) {
+    attributes.append(
+        arrayAttribute.getValue().begin(), arrayAttribute.getValue().end());
+  } else if (auto denseAttribute =
+                 valueAttribute.dyn_cast<DenseElementsAttr>()) {
+    auto values = denseAttribute.getAttributeValues();
+    attributes.append(values.begin(), values.end());
+  } else {
+    return false;
+  }
+  elements.clear();
+  for (auto attribute : attributes) {
+    if (auto floatAttribute = attribute.dyn_cast<FloatAttr>())
+      elements.emplace_back(floatAttribute.getValueAsDouble());
+    else if (auto integerAttribute = attribute.dyn_cast<IntegerAttr>())
+      elements.emplace_back(integerAttribute.getInt());
+    else
+      return false;
+  }
+  return (int64_t)elements.size() == type.getNumElements();
+}
+
 //===----------------------------------------------------------------------===//
 // Get reduction type
 //===----------------------------------------------------------------------===//
@@ -665,17 +698,16 @@ void ONNXReshapeOp::inferShapes() {
       dyn_cast_or_null<mlir::ONNXConstantOp>(secondArgDefiningOp);
 
   SmallVector<int64_t, 2> dims(outputRank, -1);
+  SmallVector<double, 4> shape;
   if (constantOp) {
-    ArrayAttr valueAttribute = constantOp.valueAttr().dyn_cast<ArrayAttr>();
+    if (!getONNXConstantElements(constantOp.getResult(), shape))
+      emitError("Constant value of static shape expected");
 
-    if (!valueAttribute)
-      emitError("ArrayAttr expected");
-
-    if (valueAttribute.getValue().size() != outputRank)
+    if (shape.size() != outputRank)
       emitError("Constant value must have same rank as output");
-
-    for (int i=0; i<outputRank; ++i)
-      dims[i] = valueAttribute.getValue()[i].cast<IntegerAttr>().getInt();
+    else
+      for (int i=0; i<outputRank; ++i)
+        dims[i] = shape[i];
   }
 
   getResult().setType(
@@ -909,35 +941,36 @@ static void processConvTypeParams(T *op, Value inputOperand) {
 //   -  kernelShape: inferred from weight matrix if not defined by user;
 //   -  pads: set to proper value, 0 if not defined by user.
 
-void ONNXConvNoBiasOp::inferShapes() {
+template <class T>
+static void inferConvShapes(T *op) {
   // Generic shape for data input X and weight tensor W:
   // X: (N x C x D1 x D2 ... x Dn)
   // W: (M x C/group x k1 x k2 x ... x kn)
 
   // Cannot infer shape if no shape exists.
-  if (!X().getType().isa<RankedTensorType>() ||
-      !W().getType().isa<RankedTensorType>())
+  if (!op->X().getType().isa<RankedTensorType>() ||
+      !op->W().getType().isa<RankedTensorType>())
     return;
 
-  auto xTy = X().getType().cast<RankedTensorType>();
+  auto xTy = op->X().getType().cast<RankedTensorType>();
   auto xShape = xTy.getShape();
-  auto weightTy = W().getType().cast<RankedTensorType>();
+  auto weightTy = op->W().getType().cast<RankedTensorType>();
   auto weightShape = weightTy.getShape();
 
   // Lowest supported convolution is a one dimensional convolution.
   if (xShape.size() < 3)
-    emitError("Data input shape must be at least (NxCxD1)");
+    op->emitError("Data input shape must be at least (NxCxD1)");
 
   // Check that shape of weight and data have same length.
   if (xShape.size() != weightShape.size())
-    emitError("Weight size not compatible with data size");
+    op->emitError("Weight size not compatible with data size");
 
   // Group is a required attribute and should have default value of 1.
-  int64_t group = ONNXConvNoBiasOp::group().getSExtValue();
+  int64_t group = op->group().getSExtValue();
   // Check that the X.shape[1] == (W.shape[1] * group) == C condition holds.
   if (xShape[1] != -1 && weightShape[1] != -1 &&
       xShape[1] != (weightShape[1] * group))
-    emitError("Channel dimension mismatch");
+    op->emitError("Channel dimension mismatch");
 
   // Note: the value of the group attribut only impacts the way the
   // computation is carried out and not the actual output size.
@@ -948,14 +981,15 @@ void ONNXConvNoBiasOp::inferShapes() {
 
   // Use kernel_shape attribute if present otherwise use size from weight
   // argument.
-  auto kernelShape = kernel_shape();
+  auto kernelShape = op->kernel_shape();
   if (kernelShape.hasValue()) {
     if (ArrayAttrSize(kernelShape) != spatialRank)
-      emitError("kernel_shape length incompatible with spatial dimensions");
+      op->emitError(
+          "kernel_shape length incompatible with spatial dimensions");
     // Have the right number of values, check them.
     for (int i = 0; i < spatialRank; ++i)
       if (ArrayAttrIntVal(kernelShape, i) < 1)
-        emitError("bad kernel_shape value");
+        op->emitError("bad kernel_shape value");
   } else {
     // Deduce shape from weight input.
     SmallVector<int64_t, 2> defaultVals;
@@ -963,16 +997,16 @@ void ONNXConvNoBiasOp::inferShapes() {
       defaultVals.emplace_back(weightShape[spatialOffset + i]);
     // Convert to ArrayRef, then build attribute, then store attribute.
     ArrayRef<int64_t> defaultRefs(defaultVals);
-    auto builder = mlir::Builder(getContext());
-    kernel_shapeAttr(builder.getI64ArrayAttr(defaultRefs));
-    kernelShape = kernel_shape();
+    auto builder = mlir::Builder(op->getContext());
+    op->kernel_shapeAttr(builder.getI64ArrayAttr(defaultRefs));
+    kernelShape = op->kernel_shape();
   }
 
   // Process strides, dilations, and pads.
-  processConvTypeParams<>(this, X());
-  auto dilationsOpt = dilations();
-  auto stridesOpt = strides();
-  auto padsOpt = pads();
+  processConvTypeParams<>(op, op->X());
+  auto dilationsOpt = op->dilations();
+  auto stridesOpt = op->strides();
+  auto padsOpt = op->pads();
 
   // First two output dimensions consist of the number of batches and the
   // number of kernels being applied.
@@ -998,9 +1032,16 @@ void ONNXConvNoBiasOp::inferShapes() {
     double denominator = strideVal;
     outputDims.emplace_back(floor(numerator / denominator) + 1);
   }
-  getResult().setType(RankedTensorType::get(outputDims, xTy.getElementType()));
+  op->getResult().setType(
+      RankedTensorType::get(outputDims, xTy.getElementType()));
 }
 
+void ONNXConvOp::inferShapes() { inferConvShapes(this); }
+
+void ONNXConvNoBiasOp::inferShapes() { inferConvShapes(this); }
+
+void ONNXConvActivationOp::inferShapes() { inferConvShapes(this); }
+
 //===----------------------------------------------------------------------===//
 
 // MaxPoolSingleOut
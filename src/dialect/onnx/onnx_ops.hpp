@@ -34,6 +34,11 @@ class ONNXOpsDialect : public Dialect {
 #define GET_OP_CLASSES
 #include "src/onnx.hpp.inc"
 
+/// Get the elements of the tensor of static shape held by the onnx.Constant
+/// operation defining `value`, in row-major order. Return false if `value` is
+/// not defined by such a constant.
+bool getONNXConstantElements(Value value, SmallVectorImpl<double> &elements);
+
 }  // end namespace mlir
 
 namespace onnf {}
@@ -74,6 +74,7 @@ int main(int argc, char *argv[]) {
   mlir::registerDialect<mlir::LLVM::LLVMDialect>();
   mlir::registerDialect<mlir::loop::LoopOpsDialect>();
   mlir::registerDialect<mlir::StandardOpsDialect>();
+  mlir::registerDialect<mlir::vector::VectorOpsDialect>();
   mlir::registerDialect<mlir::ONNXOpsDialect>();
   mlir::registerDialect<mlir::KrnlOpsDialect>();
 
@@ -128,12 +129,16 @@ int main(int argc, char *argv[]) {
   pm.addPass(mlir::createShapeInferencePass());
 
   if (emissionTarget >= EmitMLIR) {
+    pm.addPass(mlir::createNCHWcLayoutPass());
+    pm.addPass(mlir::createElementwiseFusionPass());
     pm.addPass(mlir::createLowerToKrnlPass());
     // An additional pass of canonicalization is helpful because lowering
     // from ONNX dialect to Standard dialect exposes additional canonicalization
     // oppertunities.
     pm.addPass(mlir::createCanonicalizerPass());
+    pm.addPass(mlir::createKrnlLoopFusionPass());
     pm.addPass(mlir::createLowerKrnlPass());
+    pm.addPass(mlir::createLowerKrnlParallelPass());
   }
 
   if (emissionTarget >= EmitLLVMIR) {
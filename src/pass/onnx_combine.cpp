@@ -12,14 +12,234 @@
 #include "mlir/IR/Matchers.h"
 #include "mlir/IR/PatternMatch.h"
 
+#include <cmath>
 #include <numeric>
 #include "src/dialect/onnx/onnx_ops.hpp"
 
 using namespace mlir;
 
 namespace {
+/// Get the pads held by the value of an onnx.Constant as an array attribute.
+ArrayAttr getPadsArrayAttr(Builder& builder, Attribute value) {
+  auto elements = value.dyn_cast<DenseIntElementsAttr>();
+  if (!elements)
+    return value.cast<ArrayAttr>();
+  SmallVector<int64_t, 8> pads;
+  for (auto pad : elements.getIntValues())
+    pads.emplace_back(pad.getSExtValue());
+  return builder.getI64ArrayAttr(pads);
+}
+
 /// Include the patterns defined in the Declarative Rewrite framework.
 #include "src/onnx_combine.inc"
+
+/// Create an onnx.Constant operation holding a tensor of floats.
+Value createFloatConstant(PatternRewriter& rewriter, Location loc,
+    ArrayRef<int64_t> shape, Type elementType, ArrayRef<double> elements) {
+  auto type = RankedTensorType::get(shape, elementType);
+  SmallVector<Attribute, 256> attributes;
+  for (auto element : elements)
+    attributes.emplace_back(FloatAttr::get(elementType, element));
+  return rewriter.create<ONNXConstantOp>(loc, type, /*sparse_value=*/nullptr,
+      DenseElementsAttr::get(type, attributes));
+}
+
+/// onnx.LayoutTransform(onnx.Constant) = onnx.Constant
+/// for the kernels of a convolution converted to the OIHWio layout at compile
+/// time, with b channels per block:
+/// R[mb][cb][kh][kw][ci][mo] = X[mb * b + mo][cb * b + ci][kh][kw].
+struct FoldConstantKernelLayoutTransform
+    : public OpRewritePattern<ONNXLayoutTransformOp> {
+  using OpRewritePattern<ONNXLayoutTransformOp>::OpRewritePattern;
+
+  PatternMatchResult matchAndRewrite(ONNXLayoutTransformOp layoutOp,
+      PatternRewriter& rewriter) const override {
+    if (layoutOp.target_layout() != "OIHWio")
+      return matchFailure();
+    SmallVector<double, 256> kernels;
+    if (!getONNXConstantElements(layoutOp.data(), kernels))
+      return matchFailure();
+    auto resultType =
+        layoutOp.getResult().getType().dyn_cast<RankedTensorType>();
+    auto kernelShape =
+        layoutOp.data().getType().cast<ShapedType>().getShape();
+    if (!resultType || !resultType.hasStaticShape() ||
+        !resultType.getElementType().isa<FloatType>() ||
+        resultType.getRank() != 6 || kernelShape.size() != 4)
+      return matchFailure();
+    auto shape = resultType.getShape();
+    int64_t block = layoutOp.channel_block().getSExtValue();
+    if (shape[0] * block != kernelShape[0] ||
+        shape[1] * block != kernelShape[1] || shape[2] != kernelShape[2] ||
+        shape[3] != kernelShape[3])
+      return matchFailure();
+
+    int64_t channels = kernelShape[1];
+    int64_t kernelSize = kernelShape[2] * kernelShape[3];
+    SmallVector<double, 256> relaidKernels;
+    for (int64_t mb = 0; mb < shape[0]; ++mb)
+      for (int64_t cb = 0; cb < shape[1]; ++cb)
+        for (int64_t k = 0; k < kernelSize; ++k)
+          for (int64_t ci = 0; ci < block; ++ci)
+            for (int64_t mo = 0; mo < block; ++mo) {
+              int64_t m = mb * block + mo;
+              int64_t c = cb * block + ci;
+              relaidKernels.emplace_back(
+                  kernels[(m * channels + c) * kernelSize + k]);
+            }
+    rewriter.replaceOp(layoutOp,
+        createFloatConstant(rewriter, layoutOp.getLoc(), shape,
+            resultType.getElementType(), relaidKernels));
+    return matchSuccess();
+  }
+};
+
+/// Parameters of an onnx.BatchNormalizationTestMode operation of constant
+/// parameters over C channels, folded into the affine function
+/// y = x * multiplier[c] + (shift[c] - mean[c] * multiplier[c])
+/// of each channel c, where multiplier[c] = scale[c] / sqrt(var[c] + epsilon)
+/// and shift[c] is the bias of the channel.
+struct BatchNormalizationFactors {
+  SmallVector<double, 16> multiplier;
+  SmallVector<double, 16> shift;
+  SmallVector<double, 16> mean;
+
+  bool get(ONNXBatchNormalizationTestModeOp bnOp, int64_t channels) {
+    SmallVector<double, 16> scale, variance;
+    if (!getONNXConstantElements(bnOp.scale(), scale) ||
+        !getONNXConstantElements(bnOp.B(), shift) ||
+        !getONNXConstantElements(bnOp.mean(), mean) ||
+        !getONNXConstantElements(bnOp.var(), variance) ||
+        scale.size() != channels || shift.size() != channels ||
+        mean.size() != channels || variance.size() != channels)
+      return false;
+    double epsilon = bnOp.epsilon().convertToFloat();
+    for (int64_t c = 0; c < channels; ++c)
+      multiplier.emplace_back(scale[c] / std::sqrt(variance[c] + epsilon));
+    return true;
+  }
+
+  /// Get the new bias of channel c, given its bias before the normalization.
+  double getBias(int64_t c, double bias) const {
+    return (bias - mean[c]) * multiplier[c] + shift[c];
+  }
+};
+
+Value getConvBias(ONNXConvOp convOp) { return convOp.B(); }
+
+Value getConvBias(ONNXConvNoBiasOp convOp) { return nullptr; }
+
+/// onnx.BatchNormalizationTestMode(onnx.Conv(%X, %W, %B))
+///   = onnx.Conv(%X, %W', %B')
+/// where the kernels and the bias of each output channel are rescaled and
+/// shifted at compile time, see BatchNormalizationFactors. The kernels, the
+/// bias if any and the parameters of the normalization must be constants.
+template <typename ConvOp>
+struct FuseConvBatchNormalization
+    : public OpRewritePattern<ONNXBatchNormalizationTestModeOp> {
+  using OpRewritePattern<ONNXBatchNormalizationTestModeOp>::OpRewritePattern;
+
+  PatternMatchResult matchAndRewrite(ONNXBatchNormalizationTestModeOp bnOp,
+      PatternRewriter& rewriter) const override {
+    auto convOp = dyn_cast_or_null<ConvOp>(bnOp.X().getDefiningOp());
+    if (!convOp || !convOp.getResult().hasOneUse())
+      return matchFailure();
+    auto kernelType = convOp.W().getType().template cast<ShapedType>();
+    auto elementType = kernelType.getElementType();
+    SmallVector<double, 256> kernels;
+    if (!elementType.template isa<FloatType>() ||
+        !getONNXConstantElements(convOp.W(), kernels))
+      return matchFailure();
+    auto kernelShape = kernelType.getShape();
+    int64_t channels = kernelShape[0];
+    SmallVector<double, 16> bias(channels, 0);
+    auto convBias = getConvBias(convOp);
+    if (convBias && !convBias.getType().template isa<NoneType>() &&
+        !getONNXConstantElements(convBias, bias))
+      return matchFailure();
+    BatchNormalizationFactors factors;
+    if (bias.size() != channels || !factors.get(bnOp, channels))
+      return matchFailure();
+
+    int64_t kernelSize = kernels.size() / channels;
+    for (int64_t m = 0; m < channels; ++m) {
+      for (int64_t i = 0; i < kernelSize; ++i)
+        kernels[m * kernelSize + i] *= factors.multiplier[m];
+      bias[m] = factors.getBias(m, bias[m]);
+    }
+    auto loc = bnOp.getLoc();
+    auto newKernels =
+        createFloatConstant(rewriter, loc, kernelShape, elementType, kernels);
+    auto newBias =
+        createFloatConstant(rewriter, loc, {channels}, elementType, bias);
+    rewriter.replaceOpWithNewOp<ONNXConvOp>(bnOp, bnOp.getResult().getType(),
+        convOp.X(), newKernels, newBias, convOp.auto_padAttr(),
+        convOp.dilationsAttr(), convOp.groupAttr(), convOp.kernel_shapeAttr(),
+        convOp.padsAttr(), convOp.stridesAttr());
+    return matchSuccess();
+  }
+};
+
+/// onnx.BatchNormalizationTestMode(onnx.Gemm(%A, %B, %C))
+///   = onnx.Gemm(%A, %B', %C')
+/// with alpha = beta = 1, where the columns of op(B) and of C are rescaled
+/// and shifted at compile time, see BatchNormalizationFactors. B, C if any
+/// and the parameters of the normalization must be constants, C holding one
+/// element per column.
+struct FuseGemmBatchNormalization
+    : public OpRewritePattern<ONNXBatchNormalizationTestModeOp> {
+  using OpRewritePattern<ONNXBatchNormalizationTestModeOp>::OpRewritePattern;
+
+  PatternMatchResult matchAndRewrite(ONNXBatchNormalizationTestModeOp bnOp,
+      PatternRewriter& rewriter) const override {
+    auto gemmOp = dyn_cast_or_null<ONNXGemmOp>(bnOp.X().getDefiningOp());
+    if (!gemmOp || !gemmOp.getResult().hasOneUse())
+      return matchFailure();
+    auto matrixType = gemmOp.B().getType().cast<ShapedType>();
+    auto elementType = matrixType.getElementType();
+    SmallVector<double, 256> matrix;
+    if (!elementType.isa<FloatType>() ||
+        !getONNXConstantElements(gemmOp.B(), matrix))
+      return matchFailure();
+    auto matrixShape = matrixType.getShape();
+    if (matrixShape.size() != 2)
+      return matchFailure();
+    bool isTransB = gemmOp.transB().getSExtValue() != 0;
+    int64_t columns = isTransB ? matrixShape[0] : matrixShape[1];
+    SmallVector<double, 16> bias(columns, 0);
+    Type biasType = RankedTensorType::get({columns}, elementType);
+    if (!gemmOp.C().getType().isa<NoneType>()) {
+      biasType = gemmOp.C().getType();
+      if (!getONNXConstantElements(gemmOp.C(), bias))
+        return matchFailure();
+      auto biasShape = biasType.cast<ShapedType>().getShape();
+      if (biasShape.empty() || biasShape.back() != columns)
+        return matchFailure();
+    }
+    BatchNormalizationFactors factors;
+    if (bias.size() != columns || !factors.get(bnOp, columns))
+      return matchFailure();
+
+    double alpha = gemmOp.alpha().convertToFloat();
+    double beta = gemmOp.beta().convertToFloat();
+    for (int64_t i = 0; i < matrix.size(); ++i) {
+      int64_t j = isTransB ? i / matrixShape[1] : i % matrixShape[1];
+      matrix[i] *= alpha * factors.multiplier[j];
+    }
+    for (int64_t j = 0; j < columns; ++j)
+      bias[j] = factors.getBias(j, beta * bias[j]);
+    auto loc = bnOp.getLoc();
+    auto newMatrix =
+        createFloatConstant(rewriter, loc, matrixShape, elementType, matrix);
+    auto newBias = createFloatConstant(rewriter, loc,
+        biasType.cast<ShapedType>().getShape(), elementType, bias);
+    rewriter.replaceOpWithNewOp<ONNXGemmOp>(bnOp, bnOp.getResult().getType(),
+        gemmOp.A(), newMatrix, newBias, rewriter.getF32FloatAttr(1),
+        rewriter.getF32FloatAttr(1), gemmOp.transAAttr(),
+        gemmOp.transBAttr());
+    return matchSuccess();
+  }
+};
 }  // end anonymous namespace
 
 /// Register optimization patterns as "canonicalization" patterns
@@ -44,3 +264,39 @@ void ONNXPadConstantValueOp::getCanonicalizationPatterns(
     OwningRewritePatternList& result, MLIRContext* context) {
   result.insert<ConstantPadPattern>(context);
 }
+
+/// on the activation operations following a convolution.
+void ONNXReluOp::getCanonicalizationPatterns(
+    OwningRewritePatternList& results, MLIRContext* context) {
+  results.insert<FuseConvRelu, FuseConvNoBiasRelu>(context);
+}
+
+void ONNXLeakyReluOp::getCanonicalizationPatterns(
+    OwningRewritePatternList& results, MLIRContext* context) {
+  results.insert<FuseConvLeakyRelu, FuseConvNoBiasLeakyRelu>(context);
+}
+
+void ONNXSigmoidOp::getCanonicalizationPatterns(
+    OwningRewritePatternList& results, MLIRContext* context) {
+  results.insert<FuseConvSigmoid, FuseConvNoBiasSigmoid>(context);
+}
+
+void ONNXClipOp::getCanonicalizationPatterns(
+    OwningRewritePatternList& results, MLIRContext* context) {
+  results.insert<FuseConvClip, FuseConvNoBiasClip>(context);
+}
+
+/// on the ONNXBatchNormalizationTestModeOp.
+void ONNXBatchNormalizationTestModeOp::getCanonicalizationPatterns(
+    OwningRewritePatternList& results, MLIRContext* context) {
+  results.insert<FuseConvBatchNormalization<ONNXConvOp>,
+      FuseConvBatchNormalization<ONNXConvNoBiasOp>,
+      FuseGemmBatchNormalization>(context);
+}
+
+/// on the ONNXLayoutTransformOp.
+void ONNXLayoutTransformOp::getCanonicalizationPatterns(
+    OwningRewritePatternList& results, MLIRContext* context) {
+  results.insert<LayoutTransformEliminationPattern,
+      FoldConstantKernelLayoutTransform>(context);
+}
@@ -0,0 +1,212 @@
+//===- onnx_elementwise_fusion.cpp - Elementwise operation fusion ---------===//
+//
+// Copyright 2019 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file implements a pass fusing graphs of elementwise operations into
+// onnx.FusedElementwise operations, which are lowered to a single loop nest
+// computing each element of the result from the elements of the inputs of the
+// graph, instead of a loop nest and an intermediate tensor per operation.
+//
+// Starting from the last operation of a block, the producers of the operands
+// of a graph are fused into it as long as their result has the type of the
+// result of the graph and is used by the graph only. The inputs of the graph
+// must have the type of its result or a static shape broadcastable to it.
+// Inputs of the type of a result with dynamic dimensions may still be
+// broadcasted to one another at runtime, so a graph with such a result has at
+// most one of them.
+//
+// This pass is applied after shape inference: only ranked tensors are fused.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/dialect/onnx/onnx_ops.hpp"
+#include "src/pass/passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+// Check that `op` is an elementwise operation the fused operation can be
+// lowered with.
+bool isFusableOp(Operation *op) {
+  if (op->getNumResults() != 1 ||
+      !op->getResult(0).getType().isa<RankedTensorType>())
+    return false;
+  return isa<ONNXAddOp>(op) || isa<ONNXAndOp>(op) || isa<ONNXCosOp>(op) ||
+         isa<ONNXCoshOp>(op) || isa<ONNXDivOp>(op) || isa<ONNXEluOp>(op) ||
+         isa<ONNXExpOp>(op) || isa<ONNXHardSigmoidOp>(op) ||
+         isa<ONNXLeakyReluOp>(op) || isa<ONNXLogOp>(op) ||
+         isa<ONNXMaxOp>(op) || isa<ONNXMinOp>(op) || isa<ONNXMulOp>(op) ||
+         isa<ONNXOrOp>(op) || isa<ONNXReciprocalOp>(op) ||
+         isa<ONNXReluOp>(op) || isa<ONNXSeluOp>(op) ||
+         isa<ONNXSigmoidOp>(op) || isa<ONNXSignOp>(op) ||
+         isa<ONNXSinhOp>(op) || isa<ONNXSoftplusOp>(op) ||
+         isa<ONNXSoftsignOp>(op) || isa<ONNXSqrtOp>(op) ||
+         isa<ONNXSubOp>(op) || isa<ONNXSumOp>(op) || isa<ONNXTanhOp>(op) ||
+         isa<ONNXXorOp>(op);
+}
+
+// Check that an input of type `type` can be broadcasted to `resultType`
+// without checking its dimensions at runtime.
+bool isBroadcastableTo(Type type, RankedTensorType resultType) {
+  if (type == resultType)
+    return true;
+  auto tensorType = type.dyn_cast<RankedTensorType>();
+  if (!tensorType || !tensorType.hasStaticShape() ||
+      tensorType.getRank() > resultType.getRank())
+    return false;
+  auto shape = tensorType.getShape();
+  auto resultShape = resultType.getShape();
+  int64_t offset = resultShape.size() - shape.size();
+  for (int64_t i = 0; i < shape.size(); ++i)
+    if (shape[i] != 1 && shape[i] != resultShape[offset + i])
+      return false;
+  return true;
+}
+
+// Check that `op` can be fused into a graph computing a result of type
+// `resultType`: the operands of `op` must be broadcastable to it, those
+// produced by the graph having that type.
+bool isFusableInto(Operation *op, RankedTensorType resultType) {
+  return isFusableOp(op) &&
+         llvm::all_of(op->getOperandTypes(), [&](Type type) {
+           return isBroadcastableTo(type, resultType);
+         });
+}
+
+// Get the values used by the operations of `graph` but not produced by them.
+llvm::SetVector<Value> getInputs(const llvm::SetVector<Operation *> &graph) {
+  llvm::SetVector<Value> inputs;
+  for (auto *op : graph)
+    for (auto operand : op->getOperands())
+      if (!graph.count(operand.getDefiningOp()))
+        inputs.insert(operand);
+  return inputs;
+}
+
+// Check that the inputs of `graph` are not broadcasted to one another at
+// runtime, i.e. that at most one of them has dynamic dimensions.
+bool hasStaticBroadcasting(const llvm::SetVector<Operation *> &graph) {
+  return llvm::count_if(getInputs(graph), [](Value input) {
+           return !input.getType().cast<RankedTensorType>().hasStaticShape();
+         }) <= 1;
+}
+
+// Collect the graph of elementwise operations computing the result of
+// `root`, in the order of the block.
+llvm::SetVector<Operation *> collectGraph(Operation *root) {
+  auto resultType = root->getResult(0).getType().cast<RankedTensorType>();
+  llvm::SetVector<Operation *> graph;
+  if (!isFusableInto(root, resultType))
+    return graph;
+  graph.insert(root);
+  if (!hasStaticBroadcasting(graph))
+    return {};
+
+  // A producer is fused once all its users are, which may only happen after
+  // other producers are fused.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (unsigned i = 0; i < graph.size(); ++i) {
+      for (auto operand : graph[i]->getOperands()) {
+        auto *producer = operand.getDefiningOp();
+        if (!producer || graph.count(producer) ||
+            producer->getBlock() != root->getBlock() ||
+            operand.getType() != resultType ||
+            !isFusableInto(producer, resultType) ||
+            !llvm::all_of(operand.getUsers(), [&](Operation *user) {
+              return graph.count(user);
+            }))
+          continue;
+        graph.insert(producer);
+        if (!hasStaticBroadcasting(graph)) {
+          graph.pop_back();
+          continue;
+        }
+        changed = true;
+      }
+    }
+  }
+
+  SmallVector<Operation *, 8> ops(graph.begin(), graph.end());
+  llvm::sort(ops, [](Operation *lhs, Operation *rhs) {
+    return lhs->isBeforeInBlock(rhs);
+  });
+  return llvm::SetVector<Operation *>(ops.begin(), ops.end());
+}
+
+// Replace the operations of `graph`, the last one computing its result, by a
+// fused operation.
+void fuseGraph(const llvm::SetVector<Operation *> &graph) {
+  auto *root = graph.back();
+  OpBuilder builder(root);
+
+  // The values used by the graph but not produced by it are the inputs of
+  // the fused operation, and the arguments of its body.
+  auto inputs = getInputs(graph);
+  auto fusedOp = builder.create<ONNXFusedElementwiseOp>(root->getLoc(),
+      root->getResult(0).getType(), inputs.getArrayRef());
+  auto *body = new Block();
+  fusedOp.body().push_back(body);
+  BlockAndValueMapping mapping;
+  for (auto input : inputs)
+    mapping.map(input, body->addArgument(input.getType()));
+
+  builder.setInsertionPointToStart(body);
+  for (auto *op : graph)
+    builder.clone(*op, mapping);
+  builder.create<ONNXYieldOp>(
+      root->getLoc(), mapping.lookup(root->getResult(0)));
+
+  root->getResult(0).replaceAllUsesWith(fusedOp.getResult());
+  for (auto *op : llvm::reverse(graph))
+    op->erase();
+}
+
+struct ElementwiseFusionPass : public FunctionPass<ElementwiseFusionPass> {
+  void runOnFunction() final;
+};
+} // end anonymous namespace.
+
+void ElementwiseFusionPass::runOnFunction() {
+  auto function = getFunction();
+
+  for (auto &block : function) {
+    // The graphs are collected from the last operation of the block, so that
+    // each graph is collected from the operation computing its result.
+    SmallVector<Operation *, 16> roots;
+    for (auto &op : llvm::reverse(block))
+      if (isFusableOp(&op))
+        roots.push_back(&op);
+    llvm::SmallPtrSet<Operation *, 16> fused;
+    for (auto *root : roots) {
+      if (fused.count(root))
+        continue;
+      auto graph = collectGraph(root);
+      if (graph.size() < 2)
+        continue;
+      fused.insert(graph.begin(), graph.end());
+      fuseGraph(graph);
+    }
+  }
+}
+
+/*!
+ * Create an elementwise fusion pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createElementwiseFusionPass() {
+  return std::make_unique<ElementwiseFusionPass>();
+}
+
+static PassRegistration<ElementwiseFusionPass> pass("fuse-elementwise",
+    "Fuse graphs of elementwise operations into onnx.FusedElementwise "
+    "operations.");
@@ -0,0 +1,275 @@
+//===- onnx_nchwc_layout.cpp - Blocked NCHWc data layout ------------------===//
+//
+// Copyright 2019 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file implements a pass converting convolutions, and the pooling,
+// normalization and elementwise operations between them, to the blocked NCHWc
+// data layout, in which the channels of a tensor are split into blocks of as
+// many channels as a vector register holds, stored innermost. The innermost
+// loops of these operations then iterate over the contiguous channels of a
+// block and are executed on vectors.
+//
+// Each converted operation is surrounded by onnx.LayoutTransform operations
+// converting its operands to the NCHWc layout and its result back to the
+// NCHW layout. The transforms converting back and forth between two converted
+// operations are then removed, so that the data is only converted at the
+// boundaries of chains of converted operations.
+//
+// This pass is applied after shape inference: only tensors of known shapes
+// are converted.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/conversion/onnx_to_krnl/onnx_to_krnl_common.hpp"
+#include "src/dialect/onnx/onnx_ops.hpp"
+#include "src/pass/passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+// Number of channels of a block, i.e. the number of elements of the given
+// type held by a vector register.
+int64_t getChannelBlock(Type elementType) {
+  return targetVectorSizeInBytes * 8 / elementType.getIntOrFloatBitWidth();
+}
+
+// Get the type of the given N x C x H x W tensor type in the NCHWc layout.
+// Return a null type if the tensor cannot be converted, i.e. if its shape is
+// not known or if its channels cannot be split into whole blocks.
+RankedTensorType getNCHWcType(Type type) {
+  auto tensorType = type.dyn_cast<RankedTensorType>();
+  if (!tensorType || !tensorType.hasStaticShape() ||
+      tensorType.getRank() != 4 ||
+      !tensorType.getElementType().isa<FloatType>())
+    return {};
+  auto shape = tensorType.getShape();
+  int64_t block = getChannelBlock(tensorType.getElementType());
+  if (shape[1] % block != 0)
+    return {};
+  return RankedTensorType::get(
+      {shape[0], shape[1] / block, shape[2], shape[3], block},
+      tensorType.getElementType());
+}
+
+Value createLayoutTransform(PatternRewriter &rewriter, Location loc,
+    Value value, Type type, StringRef targetLayout) {
+  auto elementType = type.cast<ShapedType>().getElementType();
+  return rewriter.create<ONNXLayoutTransformOp>(loc, type, value,
+      rewriter.getStringAttr(targetLayout),
+      rewriter.getI64IntegerAttr(getChannelBlock(elementType)));
+}
+
+// Get the NCHWc tensor converted to the NCHW layout to produce `value`, or a
+// null value if `value` is not produced by a converted operation.
+Value getNCHWcSource(Value value) {
+  auto layoutOp =
+      dyn_cast_or_null<ONNXLayoutTransformOp>(value.getDefiningOp());
+  if (!layoutOp || layoutOp.target_layout() != "NCHW")
+    return nullptr;
+  return layoutOp.data();
+}
+
+// Get `value` in the NCHWc layout.
+Value getNCHWcValue(PatternRewriter &rewriter, Location loc, Value value) {
+  if (auto source = getNCHWcSource(value))
+    return source;
+  return createLayoutTransform(
+      rewriter, loc, value, getNCHWcType(value.getType()), "NCHWc");
+}
+
+// Replace `op` by the NCHWc operation `nchwcOp`, converted back to the NCHW
+// layout.
+void replaceByNCHWcOp(
+    PatternRewriter &rewriter, Operation *op, Operation *nchwcOp) {
+  auto result = createLayoutTransform(rewriter, op->getLoc(),
+      nchwcOp->getResult(0), op->getResult(0).getType(), "NCHW");
+  rewriter.replaceOp(op, result);
+}
+
+// Check that the pads of a convolution or pooling operation are all zeros.
+template <typename Op>
+bool hasNoPadding(Op op) {
+  if (op.auto_pad() != "NOTSET" && op.auto_pad() != "VALID")
+    return false;
+  if (auto padsAttribute = op.padsAttr())
+    for (auto pad : padsAttribute.getValue())
+      if (pad.template cast<IntegerAttr>().getInt() != 0)
+        return false;
+  return true;
+}
+
+// Check that all the elements of an optional integer array attribute are 1.
+bool isAllOnes(ArrayAttr attribute) {
+  return !attribute ||
+         llvm::all_of(attribute.getValue(), [](Attribute value) {
+           return value.cast<IntegerAttr>().getInt() == 1;
+         });
+}
+
+// Convert a convolution with a single group and no padding whose input and
+// output channels can be split into blocks. The kernels are converted to the
+// OIHWio layout, the input channels of a block being followed by its output
+// channels. Constant kernels are converted at compile time by the
+// canonicalization of onnx.LayoutTransform. Padded convolutions keep the NCHW
+// lowering, as the NCHWc kernel does not pad its input.
+struct ConvNoBiasToNCHWcPattern : public OpRewritePattern<ONNXConvNoBiasOp> {
+  using OpRewritePattern<ONNXConvNoBiasOp>::OpRewritePattern;
+
+  PatternMatchResult matchAndRewrite(
+      ONNXConvNoBiasOp convOp, PatternRewriter &rewriter) const override {
+    auto resultType = getNCHWcType(convOp.getResult().getType());
+    auto inputType = getNCHWcType(convOp.X().getType());
+    auto kernelType = convOp.W().getType().dyn_cast<RankedTensorType>();
+    if (!resultType || !inputType || !kernelType ||
+        !kernelType.hasStaticShape() ||
+        convOp.group().getSExtValue() != 1 || !hasNoPadding(convOp))
+      return matchFailure();
+    // 3x3 convolutions with unit strides are left to the Winograd lowering,
+    // which performs fewer multiplications.
+    auto kernelShape = kernelType.getShape();
+    if (kernelShape[2] == 3 && kernelShape[3] == 3 &&
+        isAllOnes(convOp.stridesAttr()) && isAllOnes(convOp.dilationsAttr()))
+      return matchFailure();
+
+    auto loc = convOp.getLoc();
+    int64_t block = resultType.getShape()[4];
+    auto nchwcKernelType = RankedTensorType::get(
+        {kernelShape[0] / block, kernelShape[1] / block, kernelShape[2],
+            kernelShape[3], block, block},
+        kernelType.getElementType());
+    auto input = getNCHWcValue(rewriter, loc, convOp.X());
+    auto kernel = createLayoutTransform(
+        rewriter, loc, convOp.W(), nchwcKernelType, "OIHWio");
+    auto nchwcOp = rewriter.create<ONNXConvNoBiasNCHWcOp>(loc, resultType,
+        input, kernel, convOp.dilationsAttr(), convOp.stridesAttr());
+    replaceByNCHWcOp(rewriter, convOp, nchwcOp);
+    return matchSuccess();
+  }
+};
+
+// Convert a max pooling with no padding and no ceil mode whose input is
+// produced by a converted operation.
+struct MaxPoolSingleOutToNCHWcPattern
+    : public OpRewritePattern<ONNXMaxPoolSingleOutOp> {
+  using OpRewritePattern<ONNXMaxPoolSingleOutOp>::OpRewritePattern;
+
+  PatternMatchResult matchAndRewrite(ONNXMaxPoolSingleOutOp poolOp,
+      PatternRewriter &rewriter) const override {
+    auto resultType = getNCHWcType(poolOp.getResult().getType());
+    if (!resultType || !getNCHWcSource(poolOp.X()) ||
+        poolOp.ceil_mode().getSExtValue() != 0 ||
+        poolOp.storage_order().getSExtValue() != 0 || !hasNoPadding(poolOp))
+      return matchFailure();
+
+    auto loc = poolOp.getLoc();
+    auto nchwcOp = rewriter.create<ONNXMaxPoolSingleOutNCHWcOp>(loc,
+        resultType, getNCHWcValue(rewriter, loc, poolOp.X()),
+        poolOp.kernel_shapeAttr(), poolOp.dilationsAttr(),
+        poolOp.stridesAttr());
+    replaceByNCHWcOp(rewriter, poolOp, nchwcOp);
+    return matchSuccess();
+  }
+};
+
+// Convert a batch normalization whose input is produced by a converted
+// operation.
+struct BatchNormalizationTestModeToNCHWcPattern
+    : public OpRewritePattern<ONNXBatchNormalizationTestModeOp> {
+  using OpRewritePattern<ONNXBatchNormalizationTestModeOp>::OpRewritePattern;
+
+  PatternMatchResult matchAndRewrite(ONNXBatchNormalizationTestModeOp bnOp,
+      PatternRewriter &rewriter) const override {
+    auto resultType = getNCHWcType(bnOp.getResult().getType());
+    if (!resultType || !getNCHWcSource(bnOp.X()))
+      return matchFailure();
+
+    auto loc = bnOp.getLoc();
+    auto nchwcOp = rewriter.create<ONNXBatchNormalizationTestModeNCHWcOp>(
+        loc, resultType, getNCHWcValue(rewriter, loc, bnOp.X()), bnOp.scale(),
+        bnOp.B(), bnOp.mean(), bnOp.var(), bnOp.epsilonAttr());
+    replaceByNCHWcOp(rewriter, bnOp, nchwcOp);
+    return matchSuccess();
+  }
+};
+
+// Convert an elementwise operation whose operands all have the type of its
+// result, one of them at least being produced by a converted operation. The
+// operation is recreated as is on the NCHWc operands, elementwise operations
+// being oblivious to the layout.
+template <typename Op>
+struct ElementwiseToNCHWcPattern : public OpRewritePattern<Op> {
+  using OpRewritePattern<Op>::OpRewritePattern;
+
+  PatternMatchResult matchAndRewrite(
+      Op elementwiseOp, PatternRewriter &rewriter) const override {
+    auto *op = elementwiseOp.getOperation();
+    auto resultType = getNCHWcType(op->getResult(0).getType());
+    if (!resultType ||
+        llvm::any_of(op->getOperands(),
+            [&](Value operand) {
+              return operand.getType() != op->getResult(0).getType();
+            }) ||
+        llvm::none_of(op->getOperands(),
+            [](Value operand) { return getNCHWcSource(operand) != nullptr; }))
+      return this->matchFailure();
+
+    auto loc = op->getLoc();
+    OperationState state(loc, op->getName());
+    for (auto operand : op->getOperands())
+      state.addOperands(getNCHWcValue(rewriter, loc, operand));
+    state.addTypes(resultType);
+    state.addAttributes(op->getAttrs());
+    replaceByNCHWcOp(rewriter, op, rewriter.createOperation(state));
+    return this->matchSuccess();
+  }
+};
+
+struct NCHWcLayoutPass : public FunctionPass<NCHWcLayoutPass> {
+  void runOnFunction() final;
+};
+} // end anonymous namespace.
+
+void NCHWcLayoutPass::runOnFunction() {
+  auto function = getFunction();
+  MLIRContext *context = &getContext();
+
+  OwningRewritePatternList patterns;
+  patterns.insert<ConvNoBiasToNCHWcPattern, MaxPoolSingleOutToNCHWcPattern,
+      BatchNormalizationTestModeToNCHWcPattern,
+      ElementwiseToNCHWcPattern<ONNXAddOp>,
+      ElementwiseToNCHWcPattern<ONNXDivOp>,
+      ElementwiseToNCHWcPattern<ONNXEluOp>,
+      ElementwiseToNCHWcPattern<ONNXHardSigmoidOp>,
+      ElementwiseToNCHWcPattern<ONNXLeakyReluOp>,
+      ElementwiseToNCHWcPattern<ONNXMaxOp>,
+      ElementwiseToNCHWcPattern<ONNXMinOp>,
+      ElementwiseToNCHWcPattern<ONNXMulOp>,
+      ElementwiseToNCHWcPattern<ONNXReluOp>,
+      ElementwiseToNCHWcPattern<ONNXSeluOp>,
+      ElementwiseToNCHWcPattern<ONNXSigmoidOp>,
+      ElementwiseToNCHWcPattern<ONNXSubOp>,
+      ElementwiseToNCHWcPattern<ONNXSumOp>,
+      ElementwiseToNCHWcPattern<ONNXTanhOp>>(context);
+  // Remove the transforms converting back and forth between two converted
+  // operations, and fold those of constant kernels.
+  ONNXLayoutTransformOp::getCanonicalizationPatterns(patterns, context);
+
+  applyPatternsGreedily(function, patterns);
+}
+
+/*!
+ * Create a NCHWcLayout pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createNCHWcLayoutPass() {
+  return std::make_unique<NCHWcLayoutPass>();
+}
+
+static PassRegistration<NCHWcLayoutPass> pass("nchwc-layout",
+    "Convert convolutions and the operations between them to the blocked "
+    "NCHWc data layout.");
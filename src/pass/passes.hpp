@@ -20,12 +20,24 @@ std::unique_ptr<Pass> createDecomposeONNXToONNXPass();
 
 std::unique_ptr<Pass> createShapeInferencePass();
 
+/// Pass for converting convolutions to the blocked NCHWc data layout.
+std::unique_ptr<Pass> createNCHWcLayoutPass();
+
+/// Pass for fusing graphs of elementwise operations.
+std::unique_ptr<Pass> createElementwiseFusionPass();
+
 /// Add pass for lowering to Krnl IR.
 std::unique_ptr<Pass> createLowerToKrnlPass();
 
+/// Pass for fusing producer/consumer Krnl loop nests.
+std::unique_ptr<Pass> createKrnlLoopFusionPass();
+
 /// Pass for lowering frontend dialects to Krnl IR dialect.
 std::unique_ptr<Pass> createLowerKrnlPass();
 
+/// Pass for executing parallel Krnl loops on the runtime thread pool.
+std::unique_ptr<Pass> createLowerKrnlParallelPass();
+
 /// Pass for lowering Krnl dialect to LLVM dialect.
 std::unique_ptr<Pass> createKrnlLowerToLLVMPass();
 
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+namespace {
+
+// Number of chunks each thread gets on average, so that threads finishing
+// early can pick up work from slower ones.
+const int64_t chunksPerThread = 4;
+
+// Set on the threads currently executing the body of a parallel loop: a
+// parallel loop started from such a thread runs sequentially.
+thread_local bool inParallelLoop = false;
+
+struct ParallelLoop {
+  int64_t tripCount;
+  int64_t chunkSize;
+  void (*body)(int64_t, int64_t, void *);
+  void *context;
+  std::atomic<int64_t> nextIteration;
+};
+
+// Execute chunks of iterations of `loop` until all of them have been taken.
+void runChunks(ParallelLoop &loop) {
+  inParallelLoop = true;
+  while (true) {
+    int64_t begin = loop.nextIteration.fetch_add(loop.chunkSize);
+    if (begin >= loop.tripCount)
+      break;
+    loop.body(begin, std::min(begin + loop.chunkSize, loop.tripCount),
+              loop.context);
+  }
+  inParallelLoop = false;
+}
+
+class ThreadPool {
+public:
+  explicit ThreadPool(int numThreads) {
+    for (int i = 1; i < numThreads; ++i)
+      workers.emplace_back([this] { work(); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    wakeup.notify_all();
+    for (auto &worker : workers)
+      worker.join();
+  }
+
+  // Number of threads executing a parallel loop, including the caller.
+  int64_t size() const { return workers.size() + 1; }
+
+  // Execute `loop` on the workers and the calling thread. Return once all
+  // the iterations of the loop are done.
+  void run(ParallelLoop &loop) {
+    // Loops started by different threads of the application are executed one
+    // after the other.
+    std::lock_guard<std::mutex> runLock(runMutex);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      currentLoop = &loop;
+      pendingWorkers = workers.size();
+      ++generation;
+    }
+    wakeup.notify_all();
+    runChunks(loop);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pendingWorkers == 0; });
+    currentLoop = nullptr;
+  }
+
+private:
+  void work() {
+    uint64_t seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wakeup.wait(lock,
+                  [&] { return stop || generation != seenGeneration; });
+      if (stop)
+        return;
+      seenGeneration = generation;
+      auto *loop = currentLoop;
+      lock.unlock();
+      runChunks(*loop);
+      lock.lock();
+      if (--pendingWorkers == 0)
+        done.notify_one();
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex runMutex;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::condition_variable done;
+  ParallelLoop *currentLoop = nullptr;
+  uint64_t generation = 0;
+  size_t pendingWorkers = 0;
+  bool stop = false;
+};
+
+int getNumThreads() {
+  if (const char *numThreads = std::getenv("ONNF_NUM_THREADS"))
+    return std::max(std::atoi(numThreads), 1);
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+ThreadPool &getThreadPool() {
+  static ThreadPool threadPool(getNumThreads());
+  return threadPool;
+}
+
+} // namespace
+
+void krnlParallelFor(int64_t tripCount,
+                     void (*body)(int64_t begin, int64_t end, void *context),
+                     void *context) {
+  if (tripCount <= 0)
+    return;
+
+  auto &threadPool = getThreadPool();
+  if (tripCount == 1 || threadPool.size() == 1 || inParallelLoop) {
+    body(0, tripCount, context);
+    return;
+  }
+
+  ParallelLoop loop;
+  loop.tripCount = tripCount;
+  loop.chunkSize = std::max(
+      (int64_t)1, tripCount / (threadPool.size() * chunksPerThread));
+  loop.body = body;
+  loop.context = context;
+  loop.nextIteration = 0;
+  threadPool.run(loop);
+}
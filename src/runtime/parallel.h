@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+
+// Execute iterations [0, tripCount) of a parallel loop on the thread pool.
+// The iterations are split into ranges [begin, end), each of which is
+// executed by a call to body(begin, end, context). The number of threads of
+// the pool is read from the ONNF_NUM_THREADS environment variable, and
+// defaults to the number of hardware threads.
+void krnlParallelFor(int64_t tripCount,
+                     void (*body)(int64_t begin, int64_t end, void *context),
+                     void *context);
+}
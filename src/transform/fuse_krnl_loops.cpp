@@ -0,0 +1,376 @@
+//===------- fuse_krnl_loops.cpp - Producer/consumer Krnl loop fusion -----===//
+//
+// Copyright 2019 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file implements a pass fusing a krnl.iterate operation computing each
+// element of a buffer into the krnl.iterate operation that follows it and
+// reads the buffer at the same indices. The value stored by the producer is
+// used in place of the loads of the consumer, and the buffer, which is no
+// longer accessed, is removed along with its deallocation. When the consumer
+// writes its result into the buffer, as done for elementwise operations
+// executed in place, the buffer is kept and the store of the producer, which
+// the consumer overwrites, is removed.
+//
+// The fusion is restricted to loop nests with the same iteration space, in
+// which the producer stores the buffer at its induction variables and the
+// consumer loads it at its own, directly or through views of the same type.
+// The schedule of the consumer is kept for the fused loop nest.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/Ops.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/SetVector.h"
+
+#include "src/dialect/krnl/krnl_ops.hpp"
+#include "src/pass/passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// Helpers to compare values and buffers.
+//===----------------------------------------------------------------------===//
+
+// Resolve the size of a dynamic dimension of an allocated buffer to the
+// operand of the allocation giving it.
+Value resolveDimSize(Value value) {
+  while (auto dimOp = dyn_cast_or_null<DimOp>(value.getDefiningOp())) {
+    auto allocOp = dyn_cast_or_null<AllocOp>(dimOp.getOperand().getDefiningOp());
+    if (!allocOp)
+      break;
+    auto shape = allocOp.getType().getShape();
+    unsigned index = dimOp.getIndex();
+    if (shape[index] >= 0)
+      break;
+    unsigned dynIndex = llvm::count_if(shape.take_front(index),
+        [](int64_t dim) { return dim < 0; });
+    value = allocOp.getOperand(dynIndex);
+  }
+  return value;
+}
+
+// Check that `lhs` and `rhs` are equal, or computed by identical side effect
+// free operations from equal operands.
+bool areEquivalent(Value lhs, Value rhs) {
+  lhs = resolveDimSize(lhs);
+  rhs = resolveDimSize(rhs);
+  if (lhs == rhs)
+    return true;
+  auto *lhsOp = lhs.getDefiningOp();
+  auto *rhsOp = rhs.getDefiningOp();
+  if (!lhsOp || !rhsOp || lhsOp->getName() != rhsOp->getName() ||
+      !lhsOp->hasNoSideEffect() || lhsOp->getNumRegions() != 0 ||
+      lhsOp->getNumResults() != 1 || lhs.getType() != rhs.getType() ||
+      lhsOp->getAttrs() != rhsOp->getAttrs() ||
+      lhsOp->getNumOperands() != rhsOp->getNumOperands())
+    return false;
+  for (unsigned i = 0; i < lhsOp->getNumOperands(); ++i)
+    if (!areEquivalent(lhsOp->getOperand(i), rhsOp->getOperand(i)))
+      return false;
+  return true;
+}
+
+// Follow views back to the buffer they are views of.
+Value getBuffer(Value memRef) {
+  while (auto reshapeOp =
+             dyn_cast_or_null<KrnlReshapeOp>(memRef.getDefiningOp()))
+    memRef = reshapeOp.src();
+  return memRef;
+}
+
+// Check that buffers `lhs` and `rhs` may overlap. Buffers are distinct when
+// one of them is allocated in the function.
+bool mayAlias(Value lhs, Value rhs) {
+  lhs = getBuffer(lhs);
+  rhs = getBuffer(rhs);
+  return lhs == rhs || (!isa_and_nonnull<AllocOp>(lhs.getDefiningOp()) &&
+                           !isa_and_nonnull<AllocOp>(rhs.getDefiningOp()));
+}
+
+// Check that `indices` are the induction variables of `iterateOp`, in order.
+bool isIndexedByInductionVars(
+    KrnlIterateOp iterateOp, Operation::operand_range indices) {
+  auto inductionVars = iterateOp.bodyRegion().front().getArguments();
+  return llvm::size(indices) == inductionVars.size() &&
+         std::equal(indices.begin(), indices.end(), inductionVars.begin());
+}
+
+// Check that `lhs` and `rhs` have the same iteration space.
+bool haveSameBounds(KrnlIterateOp lhs, KrnlIterateOp rhs) {
+  auto boundsAttrName = KrnlIterateOp::getBoundsAttrName();
+  auto lhsBounds = lhs.getAttrOfType<ArrayAttr>(boundsAttrName);
+  auto rhsBounds = rhs.getAttrOfType<ArrayAttr>(boundsAttrName);
+  if (lhsBounds != rhsBounds ||
+      lhs.getNumOptimizedLoops() != rhs.getNumOptimizedLoops() ||
+      lhs.getNumOperands() != rhs.getNumOperands())
+    return false;
+
+  // The operands following the optimized loops are the input loops and the
+  // operands of their bounds.
+  for (unsigned i = lhs.getNumOptimizedLoops(); i < lhs.getNumOperands(); ++i) {
+    auto lhsOperand = lhs.getOperand(i);
+    auto rhsOperand = rhs.getOperand(i);
+    if (!lhsOperand.getType().isa<LoopType>() &&
+        !areEquivalent(lhsOperand, rhsOperand))
+      return false;
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Fusion of a producer loop nest into a consumer loop nest.
+//===----------------------------------------------------------------------===//
+
+struct LoopFusion {
+  KrnlIterateOp producer, consumer;
+
+  // The single store of the producer and the loads and stores of the
+  // consumer accessing the intermediate buffer.
+  StoreOp store;
+  SmallVector<LoadOp, 4> loads;
+  SmallVector<StoreOp, 1> overwrites;
+
+  LoopFusion(KrnlIterateOp producer, KrnlIterateOp consumer)
+      : producer(producer), consumer(consumer) {}
+
+  bool isLegal();
+  void fuse();
+
+private:
+  bool checkProducer();
+  bool checkConsumer();
+  bool checkBufferUses(Value memRef);
+};
+
+// The producer must write a single buffer, at each of its iterations.
+bool LoopFusion::checkProducer() {
+  for (auto &op : producer.bodyRegion().front()) {
+    if (auto storeOp = dyn_cast<StoreOp>(op)) {
+      if (store)
+        return false;
+      store = storeOp;
+    } else if (!isa<LoadOp>(op) && !op.isKnownTerminator() &&
+               (!op.hasNoSideEffect() || op.getNumRegions() != 0)) {
+      return false;
+    }
+  }
+  return store && isIndexedByInductionVars(producer, store.getIndices()) &&
+         isa_and_nonnull<AllocOp>(getBuffer(store.getMemRef()).getDefiningOp());
+}
+
+// The consumer must not write the buffers read by the producer, and must only
+// access the buffer written by the producer at the elements computed by the
+// same iteration. The consumer may overwrite these elements once it has read
+// them.
+bool LoopFusion::checkConsumer() {
+  auto memRef = store.getMemRef();
+  auto buffer = getBuffer(memRef);
+  SmallVector<Value, 4> producerReads;
+  bool readsOtherElements = false;
+  producer.walk([&](LoadOp loadOp) {
+    producerReads.push_back(loadOp.getMemRef());
+    if (getBuffer(loadOp.getMemRef()) == buffer &&
+        !isIndexedByInductionVars(producer, loadOp.getIndices()))
+      readsOtherElements = true;
+  });
+  if (readsOtherElements)
+    return false;
+
+  auto result = consumer.walk([&](Operation *op) -> WalkResult {
+    if (auto loadOp = dyn_cast<LoadOp>(op)) {
+      if (getBuffer(loadOp.getMemRef()) != buffer)
+        return WalkResult::advance();
+      if (!areEquivalent(loadOp.getMemRef(), memRef) ||
+          !isIndexedByInductionVars(consumer, loadOp.getIndices()))
+        return WalkResult::interrupt();
+      loads.push_back(loadOp);
+    } else if (auto storeOp = dyn_cast<StoreOp>(op)) {
+      if (getBuffer(storeOp.getMemRef()) == buffer) {
+        if (!areEquivalent(storeOp.getMemRef(), memRef) ||
+            !isIndexedByInductionVars(consumer, storeOp.getIndices()) ||
+            storeOp.getOperation()->getBlock() !=
+                &consumer.bodyRegion().front())
+          return WalkResult::interrupt();
+        overwrites.push_back(storeOp);
+      } else if (llvm::any_of(producerReads, [&](Value read) {
+                   return mayAlias(storeOp.getMemRef(), read);
+                 })) {
+        return WalkResult::interrupt();
+      }
+    } else if (op != consumer.getOperation() && !op->isKnownTerminator() &&
+               !op->hasNoSideEffect()) {
+      return WalkResult::interrupt();
+    }
+    return WalkResult::advance();
+  });
+  if (result.wasInterrupted() || loads.empty())
+    return false;
+  return llvm::all_of(overwrites, [&](StoreOp storeOp) {
+    return llvm::all_of(loads, [&](LoadOp loadOp) {
+      return loadOp.getOperation()->getBlock() ==
+                 storeOp.getOperation()->getBlock() &&
+             loadOp.getOperation()->isBeforeInBlock(storeOp);
+    });
+  });
+}
+
+// Check that the buffer, or view, `memRef` is only accessed by the store of
+// the producer and the loads of the consumer. The sizes of the buffer may
+// also be taken, and the buffer deallocated.
+bool LoopFusion::checkBufferUses(Value memRef) {
+  bool isBuffer = memRef == getBuffer(memRef);
+  for (auto *user : memRef.getUsers()) {
+    if (auto reshapeOp = dyn_cast<KrnlReshapeOp>(user)) {
+      if (reshapeOp.src() != memRef || !checkBufferUses(reshapeOp.getResult()))
+        return false;
+    } else if (auto storeOp = dyn_cast<StoreOp>(user)) {
+      if (storeOp != store || storeOp.getValueToStore() == memRef)
+        return false;
+    } else if (auto loadOp = dyn_cast<LoadOp>(user)) {
+      if (llvm::find(loads, loadOp) == loads.end())
+        return false;
+    } else if (!isBuffer || !(isa<DimOp>(user) || isa<DeallocOp>(user))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LoopFusion::isLegal() {
+  if (producer.getOperation()->getBlock() !=
+          consumer.getOperation()->getBlock() ||
+      !haveSameBounds(producer, consumer) || !checkProducer() ||
+      !checkConsumer() ||
+      (overwrites.empty() && !checkBufferUses(getBuffer(store.getMemRef()))))
+    return false;
+
+  // The operations between the loop nests must not access memory, as the
+  // producer is executed after them once fused into the consumer.
+  for (auto *op = producer.getOperation()->getNextNode();
+       op != consumer.getOperation(); op = op->getNextNode())
+    if (!isa<AllocOp>(op) && !isa<KrnlDefineLoopsOp>(op) &&
+        !isa<KrnlOptimizeLoopsOp>(op) && !op->hasNoSideEffect())
+      return false;
+  return true;
+}
+
+// Remove the view defined by `op`, which is no longer accessed, and the views
+// of it.
+void eraseView(Operation *op) {
+  for (auto *user : llvm::make_early_inc_range(op->getResult(0).getUsers()))
+    eraseView(user);
+  op->erase();
+}
+
+void LoopFusion::fuse() {
+  // Move the body of the producer at the beginning of the body of the
+  // consumer.
+  auto &producerBody = producer.bodyRegion().front();
+  auto &consumerBody = consumer.bodyRegion().front();
+  for (auto it : llvm::zip(
+           producerBody.getArguments(), consumerBody.getArguments()))
+    std::get<0>(it).replaceAllUsesWith(std::get<1>(it));
+  consumerBody.getOperations().splice(consumerBody.begin(),
+      producerBody.getOperations(), producerBody.begin(),
+      std::prev(producerBody.end()));
+
+  // Forward the stored value to the loads of the buffer.
+  auto buffer = getBuffer(store.getMemRef());
+  llvm::SetVector<Operation *> viewOps;
+  if (auto *viewOp = store.getMemRef().getDefiningOp())
+    viewOps.insert(viewOp);
+  for (auto loadOp : loads) {
+    if (auto *viewOp = loadOp.getMemRef().getDefiningOp())
+      viewOps.insert(viewOp);
+    loadOp.replaceAllUsesWith(store.getValueToStore());
+    loadOp.erase();
+  }
+  store.erase();
+
+  // Remove the loop nest of the producer, and the loops it iterates over.
+  SmallVector<Operation *, 2> loopOps;
+  for (auto operand : producer.getOperands())
+    if (auto *loopOp = operand.getDefiningOp())
+      if (isa<KrnlOptimizeLoopsOp>(loopOp) || isa<KrnlDefineLoopsOp>(loopOp))
+        if (llvm::find(loopOps, loopOp) == loopOps.end())
+          loopOps.push_back(loopOp);
+  producer.erase();
+  llvm::sort(loopOps,
+      [](Operation *lhs, Operation *rhs) { return rhs->isBeforeInBlock(lhs); });
+  for (auto *loopOp : loopOps)
+    if (loopOp->use_empty())
+      loopOp->erase();
+
+  // The buffer remains in use when the consumer writes into it.
+  if (!overwrites.empty()) {
+    for (auto *viewOp : viewOps)
+      if (isa<KrnlReshapeOp>(viewOp) && viewOp->use_empty())
+        viewOp->erase();
+    return;
+  }
+
+  // Remove the buffer and its views. Its sizes are those given to the
+  // allocation.
+  auto allocOp = cast<AllocOp>(buffer.getDefiningOp());
+  for (auto *user : llvm::make_early_inc_range(buffer.getUsers())) {
+    if (isa<KrnlReshapeOp>(user)) {
+      eraseView(user);
+      continue;
+    }
+    if (auto dimOp = dyn_cast<DimOp>(user)) {
+      OpBuilder builder(dimOp);
+      auto size = resolveDimSize(dimOp.getResult());
+      if (size == dimOp.getResult())
+        size = builder.create<ConstantIndexOp>(dimOp.getLoc(),
+            allocOp.getType().getDimSize(dimOp.getIndex()));
+      dimOp.replaceAllUsesWith(size);
+    }
+    user->erase();
+  }
+  allocOp.erase();
+}
+
+struct KrnlLoopFusionPass : public FunctionPass<KrnlLoopFusionPass> {
+  void runOnFunction() final;
+};
+} // end anonymous namespace.
+
+void KrnlLoopFusionPass::runOnFunction() {
+  SmallVector<Block *, 4> blocks;
+  getFunction().walk([&](Operation *op) {
+    for (auto &region : op->getRegions())
+      for (auto &block : region)
+        blocks.push_back(&block);
+  });
+
+  for (auto *block : blocks) {
+    // Each loop nest is fused into the next one in the block when legal, the
+    // fused loop nest becoming the producer of the loop nest following it.
+    SmallVector<KrnlIterateOp, 8> iterateOps;
+    for (auto &op : *block)
+      if (auto iterateOp = dyn_cast<KrnlIterateOp>(op))
+        iterateOps.push_back(iterateOp);
+
+    KrnlIterateOp producer;
+    for (auto iterateOp : iterateOps) {
+      if (producer) {
+        LoopFusion fusion(producer, iterateOp);
+        if (fusion.isLegal())
+          fusion.fuse();
+      }
+      producer = iterateOp;
+    }
+  }
+}
+
+std::unique_ptr<Pass> mlir::createKrnlLoopFusionPass() {
+  return std::make_unique<KrnlLoopFusionPass>();
+}
+
+static PassRegistration<KrnlLoopFusionPass> pass("fuse-krnl-loops",
+    "Fuse Krnl loop nests computing the elements of a buffer into the loop "
+    "nests reading them.");
@@ -1,7 +1,17 @@
+#include "mlir/Analysis/AffineAnalysis.h"
+#include "mlir/Analysis/AffineStructures.h"
+#include "mlir/Analysis/Utils.h"
 #include "mlir/Dialect/AffineOps/AffineOps.h"
+#include "mlir/Dialect/LoopOps/LoopOps.h"
 #include "mlir/Dialect/StandardOps/Ops.h"
+#include "mlir/Dialect/VectorOps/VectorOps.h"
+#include "mlir/IR/BlockAndValueMapping.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
+#include "mlir/Transforms/LoopUtils.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 #include "src/dialect/krnl/krnl_ops.hpp"
 #include "src/pass/passes.hpp"
@@ -10,6 +20,560 @@ using namespace mlir;
 
 namespace {
 
+// Attributes recording the unrolling and vectorization directives of a
+// schedule on the affine.for operations they apply to.
+const StringRef unrollFactorAttrName = "krnl.unroll_factor";
+const StringRef unrollJamFactorAttrName = "krnl.unroll_jam_factor";
+const StringRef vectorWidthAttrName = "krnl.vector_width";
+
+//===----------------------------------------------------------------------===//
+// Helpers to interpret the schedule of a krnl.iterate operation.
+//===----------------------------------------------------------------------===//
+
+// Bound of an affine.for operation under construction. A lower (upper) bound
+// with several expressions is the max (min) of those expressions. Dimension
+// and symbol operands are kept apart so that they retain their affine
+// classification when the bounds of several loops are combined.
+struct LoopBound {
+  SmallVector<AffineExpr, 2> exprs;
+  SmallVector<Value, 4> dimOperands;
+  SmallVector<Value, 4> symOperands;
+
+  // Append the results of `map` applied to `operands` to this bound.
+  void append(AffineMap map, ArrayRef<Value> operands) {
+    auto context = map.getContext();
+    SmallVector<AffineExpr, 4> dimReplacements, symReplacements;
+    for (unsigned i = 0; i < map.getNumDims(); ++i) {
+      dimReplacements.emplace_back(
+          getAffineDimExpr(dimOperands.size(), context));
+      dimOperands.emplace_back(operands[i]);
+    }
+    for (unsigned i = 0; i < map.getNumSymbols(); ++i) {
+      symReplacements.emplace_back(
+          getAffineSymbolExpr(symOperands.size(), context));
+      symOperands.emplace_back(operands[map.getNumDims() + i]);
+    }
+    for (auto expr : map.getResults())
+      exprs.emplace_back(
+          expr.replaceDimsAndSymbols(dimReplacements, symReplacements));
+  }
+
+  void append(const LoopBound &other) {
+    append(other.getMap(), other.getOperands());
+  }
+
+  AffineMap getMap() const {
+    return AffineMap::get(dimOperands.size(), symOperands.size(), exprs);
+  }
+
+  SmallVector<Value, 4> getOperands() const {
+    SmallVector<Value, 4> operands(dimOperands.begin(), dimOperands.end());
+    operands.append(symOperands.begin(), symOperands.end());
+    return operands;
+  }
+};
+
+// Follow an optimized loop back to the loop it stands for: either a loop
+// defined by krnl.define_loops or one of the loops produced by krnl.block.
+// Returning loops from krnl.optimize_loops and permuting them with
+// krnl.permute only changes the order of the loop nest and is looked through.
+Value resolveScheduledLoop(Value loop) {
+  while (auto *op = loop.getDefiningOp()) {
+    if (auto optimizeOp = dyn_cast<KrnlOptimizeLoopsOp>(op)) {
+      auto returnOp = cast<KrnlReturnLoopsOp>(
+          optimizeOp.region().front().getTerminator());
+      loop = returnOp.getOperand(loop.cast<OpResult>().getResultNumber());
+    } else if (auto permuteOp = dyn_cast<KrnlPermuteOp>(op)) {
+      auto map = permuteOp.getMap();
+      auto position = loop.cast<OpResult>().getResultNumber();
+      auto it = std::find(map.begin(), map.end(), position);
+      loop = permuteOp.getOperand(std::distance(map.begin(), it));
+    } else {
+      break;
+    }
+  }
+  return loop;
+}
+
+// Get the input loop a scheduled loop is derived from. `isElementLoop` is set
+// when the scheduled loop iterates over the values of the input loop itself,
+// i.e. it is either the input loop or the innermost tile of it.
+Value getInputLoop(Value loop, bool &isElementLoop) {
+  isElementLoop = true;
+  while (auto blockOp = dyn_cast_or_null<KrnlBlockOp>(loop.getDefiningOp())) {
+    if (loop == blockOp.getResult(0))
+      isElementLoop = false;
+    loop = blockOp.getOperand();
+  }
+  return loop;
+}
+
+//===----------------------------------------------------------------------===//
+// Helpers to check that the iterations of a loop are independent.
+//===----------------------------------------------------------------------===//
+
+// Express `index` as an affine function of valid affine dimension values,
+// which are appended to `dimOperands` as needed. Return None if `index` is
+// not an affine function of such values.
+Optional<AffineExpr> getAffineIndexExpr(Value index,
+                                        SmallVectorImpl<Value> &dimOperands) {
+  auto context = index.getContext();
+  auto *defOp = index.getDefiningOp();
+  if (auto constantOp = dyn_cast_or_null<ConstantIndexOp>(defOp))
+    return getAffineConstantExpr(constantOp.getValue(), context);
+
+  // Compose the map of an affine.apply operation with the expressions of its
+  // operands, so that the induction variables it is computed from appear in
+  // the access map.
+  if (auto applyOp = dyn_cast_or_null<AffineApplyOp>(defOp)) {
+    SmallVector<AffineExpr, 4> operandExprs;
+    for (auto operand : applyOp.getMapOperands()) {
+      auto expr = getAffineIndexExpr(operand, dimOperands);
+      if (!expr)
+        break;
+      operandExprs.emplace_back(*expr);
+    }
+    auto map = applyOp.getAffineMap();
+    if (operandExprs.size() == map.getNumInputs()) {
+      ArrayRef<AffineExpr> exprs(operandExprs);
+      return map.getResult(0).replaceDimsAndSymbols(
+          exprs.take_front(map.getNumDims()),
+          exprs.drop_front(map.getNumDims()));
+    }
+  }
+
+  if (isValidDim(index)) {
+    auto position = llvm::find(dimOperands, index) - dimOperands.begin();
+    if (position == (int64_t)dimOperands.size())
+      dimOperands.emplace_back(index);
+    return getAffineDimExpr(position, context);
+  }
+
+  if (!defOp || !(isa<AddIOp>(defOp) || isa<SubIOp>(defOp) ||
+                  isa<MulIOp>(defOp)))
+    return llvm::None;
+  auto lhs = getAffineIndexExpr(defOp->getOperand(0), dimOperands);
+  auto rhs = getAffineIndexExpr(defOp->getOperand(1), dimOperands);
+  if (!lhs || !rhs)
+    return llvm::None;
+  if (isa<AddIOp>(defOp))
+    return *lhs + *rhs;
+  if (isa<SubIOp>(defOp))
+    return *lhs - *rhs;
+  // A product is affine only if one of its factors is a constant.
+  if (!lhs->isa<AffineConstantExpr>() && !rhs->isa<AffineConstantExpr>())
+    return llvm::None;
+  return *lhs * *rhs;
+}
+
+// Replace the standard loads and stores nested in `root` by their affine
+// counterparts when their indices are affine functions of the enclosing loop
+// induction variables, so that dependence analysis can reason about them.
+// The index computations folded into the access maps are erased once unused,
+// as the vectorizer cannot compute indices on vectors.
+void promoteToAffineAccesses(Operation *root) {
+  SmallVector<Operation *, 8> accesses;
+  root->walk([&](Operation *op) {
+    if (isa<LoadOp>(op) || isa<StoreOp>(op))
+      accesses.emplace_back(op);
+  });
+
+  llvm::SmallPtrSet<Operation *, 16> indexOps;
+  for (auto *op : accesses) {
+    auto loadOp = dyn_cast<LoadOp>(op);
+    auto indices =
+        loadOp ? loadOp.getIndices() : cast<StoreOp>(op).getIndices();
+    SmallVector<Value, 4> dimOperands;
+    SmallVector<AffineExpr, 4> exprs;
+    for (auto index : indices) {
+      auto expr = getAffineIndexExpr(index, dimOperands);
+      if (!expr)
+        break;
+      exprs.emplace_back(*expr);
+    }
+    if (exprs.size() != llvm::size(indices))
+      continue;
+
+    auto map = exprs.empty()
+                   ? AffineMap::get(op->getContext())
+                   : AffineMap::get(dimOperands.size(), 0, exprs);
+    for (auto index : indices)
+      if (auto *defOp = index.getDefiningOp())
+        indexOps.insert(defOp);
+    OpBuilder builder(op);
+    if (loadOp) {
+      auto affineLoadOp = builder.create<AffineLoadOp>(
+          op->getLoc(), loadOp.getMemRef(), map, dimOperands);
+      loadOp.getResult().replaceAllUsesWith(affineLoadOp.getResult());
+    } else {
+      auto storeOp = cast<StoreOp>(op);
+      builder.create<AffineStoreOp>(op->getLoc(), storeOp.getValueToStore(),
+                                    storeOp.getMemRef(), map, dimOperands);
+    }
+    op->erase();
+  }
+
+  // Visit the operations in reverse order, so that the uses of a value are
+  // visited before its definition.
+  SmallVector<Operation *, 32> ops;
+  root->walk([&](Operation *op) { ops.emplace_back(op); });
+  for (auto *op : llvm::reverse(ops)) {
+    if (!indexOps.count(op) || !op->use_empty() || !op->hasNoSideEffect())
+      continue;
+    for (auto operand : op->getOperands())
+      if (auto *defOp = operand.getDefiningOp())
+        indexOps.insert(defOp);
+    op->erase();
+  }
+}
+
+// Check that the iterations of `forOp` can be executed in any order. Memory
+// written by the loop must only be accessed through affine loads and stores,
+// and no location written by one iteration may be accessed by another one.
+// Buffers allocated in the loop body are private to each iteration.
+bool isParallelLoop(AffineForOp forOp) {
+  DenseSet<Value> privateMemRefs;
+  DenseSet<Value> nonAffineMemRefs;
+  llvm::SetVector<Value> writtenMemRefs;
+  DenseMap<Value, SmallVector<Operation *, 4>> affineAccesses;
+  SmallVector<Value, 4> deallocatedMemRefs;
+
+  auto walkResult = forOp.walk([&](Operation *op) -> WalkResult {
+    if (auto allocOp = dyn_cast<AllocOp>(op)) {
+      privateMemRefs.insert(allocOp.getResult());
+    } else if (auto allocaOp = dyn_cast<KrnlAllocaOp>(op)) {
+      privateMemRefs.insert(allocaOp.getResult());
+    } else if (auto deallocOp = dyn_cast<DeallocOp>(op)) {
+      deallocatedMemRefs.emplace_back(deallocOp.memref());
+    } else if (auto loadOp = dyn_cast<AffineLoadOp>(op)) {
+      affineAccesses[loadOp.getMemRef()].emplace_back(op);
+    } else if (auto storeOp = dyn_cast<AffineStoreOp>(op)) {
+      affineAccesses[storeOp.getMemRef()].emplace_back(op);
+      writtenMemRefs.insert(storeOp.getMemRef());
+    } else if (auto loadOp = dyn_cast<LoadOp>(op)) {
+      nonAffineMemRefs.insert(loadOp.getMemRef());
+    } else if (auto storeOp = dyn_cast<StoreOp>(op)) {
+      nonAffineMemRefs.insert(storeOp.getMemRef());
+      writtenMemRefs.insert(storeOp.getMemRef());
+    } else if (!isa<AffineForOp>(op) && !isa<AffineIfOp>(op) &&
+               !isa<AffineTerminatorOp>(op) && !op->hasNoSideEffect()) {
+      // Operations with unknown side effects, e.g. calls, are not analyzed.
+      return WalkResult::interrupt();
+    }
+    return WalkResult::advance();
+  });
+  if (walkResult.wasInterrupted())
+    return false;
+
+  for (auto memRef : deallocatedMemRefs)
+    if (!privateMemRefs.count(memRef))
+      return false;
+
+  // Look for dependences carried by `forOp` between pairs of accesses to
+  // each buffer written by the loop.
+  unsigned loopDepth = getNestingDepth(*forOp.getOperation()) + 1;
+  for (auto memRef : writtenMemRefs) {
+    if (privateMemRefs.count(memRef))
+      continue;
+    if (nonAffineMemRefs.count(memRef))
+      return false;
+    auto &accesses = affineAccesses[memRef];
+    for (auto *srcOp : accesses) {
+      for (auto *dstOp : accesses) {
+        if (!isa<AffineStoreOp>(srcOp) && !isa<AffineStoreOp>(dstOp))
+          continue;
+        MemRefAccess srcAccess(srcOp);
+        MemRefAccess dstAccess(dstOp);
+        FlatAffineConstraints dependenceConstraints;
+        auto result = checkMemrefAccessDependence(
+            srcAccess, dstAccess, loopDepth, &dependenceConstraints,
+            /*dependenceComponents=*/nullptr);
+        if (result.value != DependenceResult::NoDependence)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Vectorization of innermost loops.
+//===----------------------------------------------------------------------===//
+
+// Check that consecutive iterations of a loop of induction variable `iv`
+// access consecutive elements of memory through the affine access given by
+// `map` and `operands`: only the last index may depend on `iv`, with a unit
+// coefficient. `isInvariant` is set when no index depends on `iv`.
+bool isContiguousAccess(AffineMap map, ArrayRef<Value> operands, Value iv,
+                        const llvm::DenseSet<Value> &varyingValues,
+                        bool &isInvariant) {
+  SmallVector<unsigned, 2> ivDims;
+  for (auto operand : llvm::enumerate(operands)) {
+    if (operand.value() == iv) {
+      if (operand.index() >= map.getNumDims())
+        return false;
+      ivDims.emplace_back(operand.index());
+    } else if (varyingValues.count(operand.value())) {
+      // Indices computed from the induction variable outside of the map.
+      return false;
+    }
+  }
+
+  isInvariant = true;
+  for (auto result : llvm::enumerate(map.getResults())) {
+    auto expr = result.value();
+    if (llvm::none_of(ivDims,
+                      [&](unsigned dim) { return expr.isFunctionOfDim(dim); }))
+      continue;
+    isInvariant = false;
+    if (result.index() != map.getNumResults() - 1)
+      return false;
+    SmallVector<int64_t, 8> flattenedExpr;
+    if (failed(getFlattenedAffineExpr(expr, map.getNumDims(),
+                                      map.getNumSymbols(), &flattenedExpr)) ||
+        flattenedExpr.size() != map.getNumInputs() + 1)
+      return false;
+    int64_t coefficient = 0;
+    for (auto dim : ivDims)
+      coefficient += flattenedExpr[dim];
+    if (coefficient != 1)
+      return false;
+  }
+  return true;
+}
+
+// Operations computing elementwise on their operands, which are executed on
+// vectors by recreating them with vector types.
+bool isElementwiseOp(Operation *op) {
+  return isa<AddFOp>(op) || isa<SubFOp>(op) || isa<MulFOp>(op) ||
+         isa<DivFOp>(op) || isa<AddIOp>(op) || isa<SubIOp>(op) ||
+         isa<MulIOp>(op) || isa<SignedDivIOp>(op) || isa<AndOp>(op) ||
+         isa<OrOp>(op) || isa<XOrOp>(op) || isa<CmpFOp>(op) ||
+         isa<CmpIOp>(op) || isa<SelectOp>(op) || isa<AbsFOp>(op) ||
+         isa<ExpOp>(op) || isa<LogOp>(op) || isa<CosOp>(op) ||
+         isa<SqrtOp>(op);
+}
+
+// Execute `width` consecutive iterations of the innermost loop `forOp` at
+// once on vectors. The loop body is rewritten into a loop stepping by
+// `width`: loads and stores varying with the induction variable become
+// vector transfers and the computations using them are executed on vectors,
+// while the values that do not vary are broadcast. The iterations remaining
+// past the last multiple of `width` are executed by the original loop.
+// Return failure, leaving the loop untouched, when it cannot be vectorized.
+LogicalResult vectorizeLoop(AffineForOp forOp, int64_t width) {
+  if (forOp.getStep() != 1 || forOp.getLowerBoundMap().getNumResults() != 1 ||
+      forOp.getUpperBoundMap().getNumResults() != 1)
+    return failure();
+
+  // Find the values varying from one iteration to the next and check that
+  // they can be computed on vectors.
+  auto iv = forOp.getInductionVar();
+  llvm::DenseSet<Value> varyingValues;
+  varyingValues.insert(iv);
+  auto isVectorElementType = [](Type type) {
+    return (type.isa<FloatType>() || type.isa<IntegerType>()) &&
+           type.getIntOrFloatBitWidth() % 8 == 0;
+  };
+  DenseMap<Value, SmallVector<Operation *, 2>> loadsOf, storesOf;
+  for (auto &op : forOp.getBody()->without_terminator()) {
+    if (op.getNumRegions() != 0)
+      return failure();
+    bool isVarying = llvm::any_of(op.getOperands(), [&](Value operand) {
+      return varyingValues.count(operand) != 0;
+    });
+    if (auto loadOp = dyn_cast<AffineLoadOp>(op)) {
+      SmallVector<Value, 4> operands(loadOp.getMapOperands());
+      bool isInvariant;
+      if (!isContiguousAccess(loadOp.getAffineMap(), operands, iv,
+                              varyingValues, isInvariant))
+        return failure();
+      isVarying = !isInvariant;
+      if (isVarying &&
+          !isVectorElementType(loadOp.getMemRefType().getElementType()))
+        return failure();
+      loadsOf[loadOp.getMemRef()].emplace_back(&op);
+    } else if (auto storeOp = dyn_cast<AffineStoreOp>(op)) {
+      // Every iteration must write a different element.
+      SmallVector<Value, 4> operands(storeOp.getMapOperands());
+      bool isInvariant;
+      if (!isContiguousAccess(storeOp.getAffineMap(), operands, iv,
+                              varyingValues, isInvariant) ||
+          isInvariant ||
+          !isVectorElementType(storeOp.getValueToStore().getType()))
+        return failure();
+      storesOf[storeOp.getMemRef()].emplace_back(&op);
+      continue;
+    } else if (auto loadOp = dyn_cast<LoadOp>(op)) {
+      if (isVarying)
+        return failure();
+      loadsOf[loadOp.getMemRef()].emplace_back(&op);
+    } else if (isVarying) {
+      // The induction variable itself cannot be used as a vector.
+      if (!isElementwiseOp(&op) ||
+          llvm::any_of(op.getOperandTypes(),
+                       [](Type type) { return type.isIndex(); }))
+        return failure();
+    } else if (!op.hasNoSideEffect()) {
+      return failure();
+    }
+    if (!isVarying)
+      continue;
+    for (auto result : op.getResults()) {
+      if (!isVectorElementType(result.getType()) &&
+          !result.getType().isInteger(1))
+        return failure();
+      varyingValues.insert(result);
+    }
+  }
+
+  // Executing iterations at once reorders the accesses of different
+  // iterations. This is only safe if no iteration reads an element written by
+  // another one, i.e. every access to a buffer written by the loop accesses
+  // the element written by the current iteration.
+  auto getAccess = [](Operation *op, SmallVectorImpl<Value> &operands) {
+    if (auto loadOp = dyn_cast<AffineLoadOp>(op)) {
+      operands.assign(loadOp.getMapOperands().begin(),
+                      loadOp.getMapOperands().end());
+      return loadOp.getAffineMap();
+    }
+    auto storeOp = cast<AffineStoreOp>(op);
+    operands.assign(storeOp.getMapOperands().begin(),
+                    storeOp.getMapOperands().end());
+    return storeOp.getAffineMap();
+  };
+  auto isSameAccess = [&](Operation *op, Operation *otherOp) {
+    if (!isa<AffineLoadOp>(otherOp) && !isa<AffineStoreOp>(otherOp))
+      return false;
+    SmallVector<Value, 4> operands, otherOperands;
+    return getAccess(op, operands) == getAccess(otherOp, otherOperands) &&
+           operands == otherOperands;
+  };
+  for (auto &memRefStores : storesOf) {
+    auto *storeOp = memRefStores.second.front();
+    for (auto *otherOp : memRefStores.second)
+      if (!isSameAccess(storeOp, otherOp))
+        return failure();
+    for (auto *otherOp : loadsOf.lookup(memRefStores.first))
+      if (!isSameAccess(storeOp, otherOp))
+        return failure();
+  }
+
+  // Compute the bounds of the vector loop, which stops at the last multiple
+  // of the vector width.
+  auto loc = forOp.getLoc();
+  auto context = forOp.getContext();
+  OpBuilder builder(forOp);
+  AffineMap vectorUbMap;
+  SmallVector<Value, 2> vectorUbOperands;
+  bool hasRemainder = true;
+  if (forOp.hasConstantBounds()) {
+    auto lb = forOp.getConstantLowerBound();
+    auto ub = forOp.getConstantUpperBound();
+    auto vectorUb = lb + (ub - lb) / width * width;
+    if (vectorUb <= lb)
+      return failure();
+    hasRemainder = vectorUb != ub;
+    vectorUbMap = builder.getConstantAffineMap(vectorUb);
+  } else {
+    auto d0 = getAffineDimExpr(0, context);
+    auto d1 = getAffineDimExpr(1, context);
+    vectorUbMap = AffineMap::get(2, 0, d0 + (d1 - d0).floorDiv(width) * width);
+    vectorUbOperands.emplace_back(builder.create<AffineApplyOp>(
+        loc, forOp.getLowerBoundMap(), forOp.getLowerBoundOperands()));
+    vectorUbOperands.emplace_back(builder.create<AffineApplyOp>(
+        loc, forOp.getUpperBoundMap(), forOp.getUpperBoundOperands()));
+  }
+  SmallVector<Value, 4> lbOperands(forOp.getLowerBoundOperands());
+  auto vectorLoop =
+      builder.create<AffineForOp>(loc, lbOperands, forOp.getLowerBoundMap(),
+                                  vectorUbOperands, vectorUbMap, width);
+  auto parallelAttrName = KrnlParallelOp::getParallelLoopAttrName();
+  if (forOp.getAttr(parallelAttrName)) {
+    vectorLoop.setAttr(parallelAttrName, builder.getUnitAttr());
+    forOp.removeAttr(parallelAttrName);
+  }
+
+  // Emit the body of the vector loop. Values that do not vary are computed
+  // as in the original loop, and broadcast to vectors when used by a vector
+  // computation.
+  auto bodyBuilder = OpBuilder::atBlockTerminator(vectorLoop.getBody());
+  BlockAndValueMapping scalarMapper;
+  scalarMapper.map(iv, vectorLoop.getInductionVar());
+  DenseMap<Value, Value> vectorValues;
+  auto getVectorType = [&](Type elementType) {
+    return VectorType::get({width}, elementType);
+  };
+  auto getVector = [&](Value value) {
+    auto &vector = vectorValues[value];
+    if (!vector)
+      vector = bodyBuilder.create<vector::BroadcastOp>(
+          loc, getVectorType(value.getType()),
+          scalarMapper.lookupOrDefault(value));
+    return vector;
+  };
+  // Vector transfers access the elements along the innermost dimension of
+  // the buffer, starting at the indices computed for the first iteration.
+  auto getTransferIndices = [&](AffineMap map, ValueRange operands,
+                                SmallVectorImpl<Value> &indices) {
+    SmallVector<Value, 4> mappedOperands;
+    for (auto operand : operands)
+      mappedOperands.emplace_back(scalarMapper.lookupOrDefault(operand));
+    for (auto expr : map.getResults())
+      indices.emplace_back(bodyBuilder.create<AffineApplyOp>(
+          loc, AffineMap::get(map.getNumDims(), map.getNumSymbols(), expr),
+          mappedOperands));
+    return AffineMapAttr::get(AffineMap::get(
+        map.getNumResults(), 0,
+        getAffineDimExpr(map.getNumResults() - 1, context)));
+  };
+
+  for (auto &op : forOp.getBody()->without_terminator()) {
+    if (auto storeOp = dyn_cast<AffineStoreOp>(op)) {
+      SmallVector<Value, 4> indices;
+      auto permutationMap = getTransferIndices(
+          storeOp.getAffineMap(), storeOp.getMapOperands(), indices);
+      bodyBuilder.create<vector::TransferWriteOp>(
+          loc, getVector(storeOp.getValueToStore()), storeOp.getMemRef(),
+          indices, permutationMap);
+    } else if (!op.getNumResults() || !varyingValues.count(op.getResult(0))) {
+      bodyBuilder.clone(op, scalarMapper);
+    } else if (auto loadOp = dyn_cast<AffineLoadOp>(op)) {
+      auto elementType = loadOp.getMemRefType().getElementType();
+      Value padding = bodyBuilder.create<ConstantOp>(
+          loc, elementType, bodyBuilder.getZeroAttr(elementType));
+      SmallVector<Value, 4> indices;
+      auto permutationMap = getTransferIndices(
+          loadOp.getAffineMap(), loadOp.getMapOperands(), indices);
+      vectorValues[loadOp.getResult()] =
+          bodyBuilder.create<vector::TransferReadOp>(
+              loc, getVectorType(elementType), loadOp.getMemRef(), indices,
+              permutationMap, padding);
+    } else {
+      OperationState state(op.getLoc(), op.getName());
+      for (auto operand : op.getOperands())
+        state.operands.emplace_back(getVector(operand));
+      for (auto result : op.getResults())
+        state.types.emplace_back(getVectorType(result.getType()));
+      state.addAttributes(op.getAttrs());
+      auto *vectorOp = bodyBuilder.createOperation(state);
+      for (auto result : llvm::zip(op.getResults(), vectorOp->getResults()))
+        vectorValues[std::get<0>(result)] = std::get<1>(result);
+    }
+  }
+
+  // The original loop executes the remaining iterations, if any.
+  if (!hasRemainder) {
+    forOp.erase();
+    return success();
+  }
+  if (vectorUbOperands.empty())
+    forOp.setConstantLowerBound(vectorUbMap.getSingleConstantResult());
+  else
+    forOp.setLowerBound(vectorUbOperands, vectorUbMap);
+  return success();
+}
+
 //===----------------------------------------------------------------------===//
 // Krnl to Affine Rewrite Patterns: KrnlIterate operation.
 //===----------------------------------------------------------------------===//
@@ -24,46 +588,134 @@ struct KrnlIterateOpLowering : public OpRewritePattern<KrnlIterateOp> {
             .getValue();
     auto operandItr =
         iterateOp.operand_begin() + iterateOp.getNumOptimizedLoops();
-    SmallVector<AffineForOp, 4> nestedForOps;
+
+    // Collect the input loops and their bounds.
+    llvm::DenseMap<Value, int64_t> inputLoopIdx;
+    SmallVector<LoopBound, 4> inputLbs, inputUbs;
     for (size_t boundIdx = 0; boundIdx < boundMapAttrs.size(); boundIdx += 2) {
-      // Consume input loop operand, currently do not do anything with it.
-      operandItr++;
+      inputLoopIdx[*operandItr++] = boundIdx / 2;
 
       // Organize operands into lower/upper bounds in affine.for ready formats.
-      SmallVector<Value, 4> lbOperands, ubOperands;
-      AffineMap lbMap, ubMap;
       for (int boundType = 0; boundType < 2; boundType++) {
-        auto &operands = boundType == 0 ? lbOperands : ubOperands;
-        auto &map = boundType == 0 ? lbMap : ubMap;
-        map = boundMapAttrs[boundIdx + boundType]
-                  .cast<AffineMapAttr>()
-                  .getValue();
-        operands.insert(operands.end(), operandItr,
-                        operandItr + map.getNumInputs());
+        auto map = boundMapAttrs[boundIdx + boundType]
+                       .cast<AffineMapAttr>()
+                       .getValue();
+        SmallVector<Value, 4> operands(operandItr,
+                                       operandItr + map.getNumInputs());
         std::advance(operandItr, map.getNumInputs());
+        auto &bound = boundType == 0 ? inputLbs : inputUbs;
+        bound.emplace_back();
+        bound.back().append(map, operands);
       }
+    }
+
+    // Resolve the loop nest to emit from the optimized loops and check that
+    // it is a valid schedule of the input loops.
+    SmallVector<Value, 4> scheduledLoops;
+    llvm::SetVector<Operation *> optimizeOps;
+    llvm::DenseMap<Value, size_t> nestPosition;
+    SmallVector<int64_t, 4> elementLoopPosition(inputLbs.size(), -1);
+    for (auto optimizedLoop : llvm::make_range(
+             iterateOp.operand_begin(),
+             iterateOp.operand_begin() + iterateOp.getNumOptimizedLoops())) {
+      if (auto *optimizeOp = optimizedLoop.getDefiningOp())
+        if (isa<KrnlOptimizeLoopsOp>(optimizeOp))
+          optimizeOps.insert(optimizeOp);
+      auto loop = resolveScheduledLoop(optimizedLoop);
+      bool isElementLoop;
+      auto inputLoop = getInputLoop(loop, isElementLoop);
+      if (!inputLoopIdx.count(inputLoop) || nestPosition.count(loop)) {
+        iterateOp.emitError("optimized loops must be a schedule of the input "
+                            "loops, each scheduled loop being used once");
+        return matchFailure();
+      }
+
+      // A loop iterating within a tile depends on the loop iterating over
+      // the tiles and must be nested inside of it.
+      if (auto blockOp = dyn_cast<KrnlBlockOp>(loop.getDefiningOp())) {
+        if (loop == blockOp.getResult(1) &&
+            !nestPosition.count(blockOp.getResult(0))) {
+          iterateOp.emitError("a blocked loop must be nested inside the loop "
+                              "iterating over its tiles");
+          return matchFailure();
+        }
+      }
+
+      nestPosition[loop] = scheduledLoops.size();
+      if (isElementLoop)
+        elementLoopPosition[inputLoopIdx[inputLoop]] = scheduledLoops.size();
+      scheduledLoops.emplace_back(loop);
+    }
+    if (llvm::is_contained(elementLoopPosition, -1)) {
+      iterateOp.emitError("every input loop must be iterated over");
+      return matchFailure();
+    }
 
+    // Emit the loop nest, outermost loop first.
+    SmallVector<AffineForOp, 4> nestedForOps;
+    for (auto loop : scheduledLoops) {
+      LoopBound lb, ub;
+      int64_t step;
+      getBounds(loop, inputLoopIdx, inputLbs, inputUbs, nestPosition,
+                nestedForOps, lb, ub, step);
       nestedForOps.emplace_back(rewriter.create<AffineForOp>(
-          iterateOp.getLoc(), lbOperands, lbMap, ubOperands, ubMap));
+          iterateOp.getLoc(), lb.getOperands(), lb.getMap(), ub.getOperands(),
+          ub.getMap(), step));
       rewriter.setInsertionPoint(nestedForOps.back().getBody(),
                                  nestedForOps.back().getBody()->begin());
     }
 
+    // Record the unrolling, vectorization and parallelization directives of
+    // the schedule on the loops they apply to. They are applied once the
+    // whole function has been lowered to affine loops.
+    for (auto *optimizeOp : optimizeOps) {
+      optimizeOp->walk([&](Operation *scheduleOp) {
+        Value loop;
+        StringRef attrName;
+        Attribute attr;
+        if (auto unrollOp = dyn_cast<KrnlUnrollOp>(scheduleOp)) {
+          loop = unrollOp.getOperand();
+          attrName = unrollFactorAttrName;
+          attr = rewriter.getI64IntegerAttr(unrollOp.getFactor());
+        } else if (auto unrollJamOp = dyn_cast<KrnlUnrollJamOp>(scheduleOp)) {
+          loop = unrollJamOp.getOperand();
+          attrName = unrollJamFactorAttrName;
+          attr = rewriter.getI64IntegerAttr(unrollJamOp.getFactor());
+        } else if (auto vectorizeOp = dyn_cast<KrnlVectorizeOp>(scheduleOp)) {
+          loop = vectorizeOp.getOperand();
+          attrName = vectorWidthAttrName;
+          attr = rewriter.getI64IntegerAttr(vectorizeOp.getWidth());
+        } else if (auto parallelOp = dyn_cast<KrnlParallelOp>(scheduleOp)) {
+          loop = parallelOp.getOperand();
+          attrName = KrnlParallelOp::getParallelLoopAttrName();
+          attr = rewriter.getUnitAttr();
+        } else {
+          return;
+        }
+        auto position = nestPosition.find(resolveScheduledLoop(loop));
+        if (position != nestPosition.end())
+          nestedForOps[position->second].setAttr(attrName, attr);
+      });
+    }
+
     // Replace induction variable references from those introduced by a
     // single krnl.iterate to those introduced by multiple affine.for
-    // operations.
-    for (size_t i = 0; i < nestedForOps.size() - 1; i++) {
-      auto iterateIV = iterateOp.bodyRegion().front().getArgument(0);
-      auto forIV = nestedForOps[i].getBody()->getArgument(0);
-      iterateIV.replaceAllUsesWith(forIV);
-      iterateOp.bodyRegion().front().eraseArgument(0);
+    // operations. The innermost loop of a valid schedule always iterates over
+    // the values of an input loop; its induction variable is kept for
+    // convenience (it'll be taken care of by region inlining).
+    auto &iterateBlock = iterateOp.bodyRegion().front();
+    int64_t innermostInputLoop = std::distance(
+        elementLoopPosition.begin(),
+        llvm::find(elementLoopPosition, (int64_t)nestedForOps.size() - 1));
+    for (int64_t i = iterateBlock.getNumArguments() - 1; i >= 0; --i) {
+      if (i == innermostInputLoop)
+        continue;
+      auto forIV =
+          nestedForOps[elementLoopPosition[i]].getBody()->getArgument(0);
+      iterateBlock.getArgument(i).replaceAllUsesWith(forIV);
+      iterateBlock.eraseArgument(i);
     }
 
-    // Pop krnl.iterate body region block arguments, leave the last one
-    // for convenience (it'll be taken care of by region inlining).
-    while (iterateOp.bodyRegion().front().getNumArguments() > 1)
-      iterateOp.bodyRegion().front().eraseArgument(0);
-
     // Transfer krnl.iterate region to innermost for op.
     auto innermostForOp = nestedForOps.back();
     innermostForOp.region().getBlocks().clear();
@@ -73,6 +725,53 @@ struct KrnlIterateOpLowering : public OpRewritePattern<KrnlIterateOp> {
     rewriter.eraseOp(iterateOp);
     return matchSuccess();
   }
+
+private:
+  // Compute the bounds and step of a scheduled loop. The loops it depends on
+  // must have been emitted already.
+  static void getBounds(Value loop,
+                        llvm::DenseMap<Value, int64_t> &inputLoopIdx,
+                        ArrayRef<LoopBound> inputLbs,
+                        ArrayRef<LoopBound> inputUbs,
+                        llvm::DenseMap<Value, size_t> &nestPosition,
+                        ArrayRef<AffineForOp> nestedForOps, LoopBound &lb,
+                        LoopBound &ub, int64_t &step) {
+    auto blockOp = dyn_cast_or_null<KrnlBlockOp>(loop.getDefiningOp());
+    if (!blockOp) {
+      // Input loop.
+      auto idx = inputLoopIdx[loop];
+      lb = inputLbs[idx];
+      ub = inputUbs[idx];
+      step = 1;
+      return;
+    }
+
+    // Get the bounds of the loop being blocked.
+    getBounds(blockOp.getOperand(), inputLoopIdx, inputLbs, inputUbs,
+              nestPosition, nestedForOps, lb, ub, step);
+    auto tileSize = blockOp.getTileSize() * step;
+    if (loop == blockOp.getResult(0)) {
+      // The loop over the tiles has the bounds of the blocked loop and steps
+      // over a whole tile at a time.
+      step = tileSize;
+      return;
+    }
+
+    // The loop within a tile starts at the current tile and ends at the next
+    // one, or at the upper bound of the blocked loop for a partial tile.
+    auto context = loop.getContext();
+    auto tileIV = nestedForOps[nestPosition[blockOp.getResult(0)]]
+                      .getInductionVar();
+    auto tileMap = AffineMap::get(1, 0, getAffineDimExpr(0, context));
+    auto nextTileMap =
+        AffineMap::get(1, 0, getAffineDimExpr(0, context) + tileSize);
+    LoopBound blockedUb = ub;
+    lb = LoopBound();
+    lb.append(tileMap, tileIV);
+    ub = LoopBound();
+    ub.append(nextTileMap, tileIV);
+    ub.append(blockedUb);
+  }
 };
 
 //===----------------------------------------------------------------------===//
@@ -109,6 +808,10 @@ public:
 // Krnl to Affine Rewrite Patterns: KrnlOptimizeLoops operation.
 //===----------------------------------------------------------------------===//
 
+// The schedule held in the region of a krnl.optimize_loops operation is
+// applied when lowering the krnl.iterate operations using its loops. The
+// schedule operations are dropped together with the enclosing operation.
+
 class KrnlOptimizeLoopsLowering : public OpRewritePattern<KrnlOptimizeLoopsOp> {
 public:
   using OpRewritePattern<KrnlOptimizeLoopsOp>::OpRewritePattern;
@@ -139,11 +842,15 @@ void KrnlToAffineLoweringPass::runOnFunction() {
 
   ConversionTarget target(getContext());
 
-  target.addLegalDialect<AffineOpsDialect, StandardOpsDialect>();
+  target.addLegalDialect<AffineOpsDialect, StandardOpsDialect,
+                         loop::LoopOpsDialect>();
   // We expect IR to be free of Krnl Dialect Ops.
   target.addIllegalDialect<KrnlOpsDialect>();
   target.addLegalOp<KrnlMemcpyOp>();
+  target.addLegalOp<KrnlReshapeOp>();
   target.addLegalOp<KrnlEntryPointOp>();
+  target.addLegalOp<KrnlAllocaOp>();
+  target.addLegalOp<KrnlGlobalOp>();
 
   OwningRewritePatternList patterns;
   patterns.insert<KrnlIterateOpLowering, KrnlTerminatorLowering,
@@ -152,6 +859,58 @@ void KrnlToAffineLoweringPass::runOnFunction() {
 
   if (failed(applyPartialConversion(getFunction(), target, patterns))) {
     signalPassFailure();
+    return;
+  }
+
+  // Express the memory accesses in affine form where possible, to let the
+  // following transformations analyze them.
+  promoteToAffineAccesses(function.getOperation());
+
+  // Only keep the parallel mark on the loops whose iterations are proven
+  // independent.
+  auto parallelAttrName = KrnlParallelOp::getParallelLoopAttrName();
+  function.walk([&](AffineForOp forOp) {
+    if (forOp.getAttr(parallelAttrName) && !isParallelLoop(forOp)) {
+      forOp.removeAttr(parallelAttrName);
+      forOp.emitRemark("loop-carried dependence may exist, loop scheduled as "
+                       "parallel is executed sequentially");
+    }
+  });
+
+  // Apply the vectorization directives. Vectorization is an optimization:
+  // loops that cannot be vectorized are left scalar.
+  SmallVector<AffineForOp, 4> vectorizedLoops;
+  function.walk([&](AffineForOp forOp) {
+    if (forOp.getAttr(vectorWidthAttrName))
+      vectorizedLoops.emplace_back(forOp);
+  });
+  for (auto forOp : vectorizedLoops) {
+    auto width = forOp.getAttrOfType<IntegerAttr>(vectorWidthAttrName);
+    forOp.removeAttr(vectorWidthAttrName);
+    vectorizeLoop(forOp, width.getInt());
+  }
+
+  // Apply the unrolling directives. The walk visits inner loops before the
+  // loops enclosing them, so that an unrolled inner loop is jammed as a whole
+  // into the copies of its enclosing loop.
+  SmallVector<AffineForOp, 4> unrolledLoops;
+  function.walk([&](AffineForOp forOp) {
+    if (forOp.getAttr(unrollFactorAttrName) ||
+        forOp.getAttr(unrollJamFactorAttrName))
+      unrolledLoops.emplace_back(forOp);
+  });
+  for (auto forOp : unrolledLoops) {
+    // Unrolling is an optimization: loops that cannot be unrolled, e.g.
+    // because their trip count is lower than the unroll factor, are left
+    // untouched.
+    if (auto factor = forOp.getAttrOfType<IntegerAttr>(unrollFactorAttrName)) {
+      forOp.removeAttr(unrollFactorAttrName);
+      loopUnrollByFactor(forOp, factor.getInt());
+    } else {
+      factor = forOp.getAttrOfType<IntegerAttr>(unrollJamFactorAttrName);
+      forOp.removeAttr(unrollJamFactorAttrName);
+      loopUnrollJamByFactor(forOp, factor.getInt());
+    }
   }
 }
 
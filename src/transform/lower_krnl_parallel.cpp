@@ -0,0 +1,169 @@
+//===------ lower_krnl_parallel.cpp - Lowering of parallel Krnl loops -----===//
+//
+// Copyright 2019 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file outlines the bodies of the affine loops scheduled with
+// krnl.parallel into functions, and replaces the loops by krnl.parallel_call
+// operations executing these functions on the thread pool of the runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/AffineOps/AffineOps.h"
+#include "mlir/Dialect/StandardOps/Ops.h"
+#include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/SetVector.h"
+
+#include "src/dialect/krnl/krnl_ops.hpp"
+#include "src/pass/passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// Outlining of parallel loops.
+//===----------------------------------------------------------------------===//
+
+// Outline the body of the parallel loop `forOp` into a function named `name`
+// taking the range [begin, end) of iterations to execute, the lower bound of
+// the loop and the values used by the body. Replace the loop by a
+// krnl.parallel_call of that function.
+LogicalResult outlineParallelLoop(AffineForOp forOp, StringRef name) {
+  if (forOp.getLowerBoundMap().getNumResults() != 1 ||
+      forOp.getUpperBoundMap().getNumResults() != 1)
+    return failure();
+
+  auto loc = forOp.getLoc();
+  auto context = forOp.getContext();
+  auto parentFunc = forOp.getParentOfType<FuncOp>();
+  OpBuilder builder(forOp);
+
+  // Compute the lower bound and the trip count of the loop.
+  Value lb = builder.create<AffineApplyOp>(loc, forOp.getLowerBoundMap(),
+                                           forOp.getLowerBoundOperands());
+  Value ub = builder.create<AffineApplyOp>(loc, forOp.getUpperBoundMap(),
+                                           forOp.getUpperBoundOperands());
+  int64_t step = forOp.getStep();
+  auto d0 = getAffineDimExpr(0, context);
+  auto d1 = getAffineDimExpr(1, context);
+  Value tripCount = builder.create<AffineApplyOp>(
+      loc, AffineMap::get(2, 0, (d1 - d0).ceilDiv(step)),
+      ArrayRef<Value>({lb, ub}));
+
+  // Values defined outside of the loop and used by its body are passed to
+  // the outlined function, except for constants which are cloned into it.
+  llvm::SetVector<Value> capturedValues;
+  forOp.walk([&](Operation *op) {
+    if (op == forOp.getOperation())
+      return;
+    for (auto operand : op->getOperands())
+      if (!forOp.region().isAncestor(operand.getParentRegion()))
+        capturedValues.insert(operand);
+  });
+  SmallVector<Value, 8> arguments = {lb};
+  SmallVector<Operation *, 4> constantOps;
+  for (auto value : capturedValues) {
+    if (auto constantOp = dyn_cast_or_null<ConstantOp>(value.getDefiningOp()))
+      constantOps.emplace_back(constantOp);
+    else
+      arguments.emplace_back(value);
+  }
+
+  // Create the outlined function before the function holding the loop.
+  SmallVector<Type, 8> argTypes = {builder.getIndexType(),
+                                   builder.getIndexType()};
+  for (auto argument : arguments)
+    argTypes.emplace_back(argument.getType());
+  auto outlinedFunc =
+      FuncOp::create(loc, name, builder.getFunctionType(argTypes, {}));
+  parentFunc.getOperation()->getBlock()->getOperations().insert(
+      Block::iterator(parentFunc.getOperation()), outlinedFunc.getOperation());
+
+  auto *entryBlock = outlinedFunc.addEntryBlock();
+  OpBuilder bodyBuilder(entryBlock);
+  BlockAndValueMapping mapper;
+  for (auto *constantOp : constantOps)
+    mapper.map(constantOp->getResult(0),
+               bodyBuilder.clone(*constantOp)->getResult(0));
+  for (auto argument : llvm::enumerate(arguments))
+    mapper.map(argument.value(),
+               entryBlock->getArgument(argument.index() + 2));
+
+  // Iterate over the range of iterations given to the function, and recover
+  // the induction variable of the original loop from the iteration number.
+  auto identityMap = bodyBuilder.getSymbolIdentityMap();
+  auto iterationLoop = bodyBuilder.create<AffineForOp>(
+      loc, entryBlock->getArgument(0), identityMap, entryBlock->getArgument(1),
+      identityMap);
+  bodyBuilder.create<ReturnOp>(loc);
+
+  auto loopBuilder = OpBuilder::atBlockTerminator(iterationLoop.getBody());
+  auto ivMap = AffineMap::get(
+      1, 1, d0 * step + getAffineSymbolExpr(0, context));
+  Value iv = loopBuilder.create<AffineApplyOp>(
+      loc, ivMap,
+      ArrayRef<Value>({iterationLoop.getInductionVar(), mapper.lookup(lb)}));
+  mapper.map(forOp.getInductionVar(), iv);
+  for (auto &op : forOp.getBody()->without_terminator())
+    loopBuilder.clone(op, mapper);
+
+  builder.create<KrnlParallelCallOp>(loc, builder.getSymbolRefAttr(name),
+                                     tripCount, arguments);
+  forOp.erase();
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlParallelLoweringPass
+//===----------------------------------------------------------------------===//
+
+/// This pass executes the affine loops marked as parallel on the thread pool
+/// of the runtime. The lowering of Krnl loops only keeps the mark on the
+/// loops whose iterations have been proven independent.
+struct KrnlParallelLoweringPass : public ModulePass<KrnlParallelLoweringPass> {
+  void runOnModule() final;
+};
+} // end anonymous namespace.
+
+void KrnlParallelLoweringPass::runOnModule() {
+  auto attrName = KrnlParallelOp::getParallelLoopAttrName();
+
+  SmallVector<FuncOp, 4> functions(getModule().getOps<FuncOp>());
+  for (auto function : functions) {
+    SmallVector<AffineForOp, 4> parallelLoops;
+    function.walk([&](AffineForOp forOp) {
+      if (!forOp.getAttr(attrName))
+        return;
+      forOp.removeAttr(attrName);
+      parallelLoops.emplace_back(forOp);
+    });
+    // Only the outermost parallel loop of a nest is executed in parallel.
+    llvm::erase_if(parallelLoops, [&](AffineForOp forOp) {
+      return llvm::any_of(parallelLoops, [&](AffineForOp otherOp) {
+        return otherOp != forOp &&
+               otherOp.getOperation()->isProperAncestor(forOp);
+      });
+    });
+
+    unsigned outlinedLoopCount = 0;
+    for (auto forOp : parallelLoops) {
+      auto name = (function.getName() + "_parallel_" +
+                   Twine(outlinedLoopCount++))
+                      .str();
+      if (failed(outlineParallelLoop(forOp, name)))
+        forOp.emitRemark("unsupported loop bounds, loop scheduled as "
+                         "parallel is executed sequentially");
+    }
+  }
+}
+
+std::unique_ptr<Pass> mlir::createLowerKrnlParallelPass() {
+  return std::make_unique<KrnlParallelLoweringPass>();
+}
+
+static PassRegistration<KrnlParallelLoweringPass>
+    pass("lower-krnl-parallel",
+         "Execute parallel Krnl loops on the runtime thread pool.");
@@ -8,10 +8,12 @@
 #include "mlir/Conversion/LoopToStandard/ConvertLoopToStandard.h"
 #include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVM.h"
 #include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVMPass.h"
+#include "mlir/Conversion/VectorToLLVM/ConvertVectorToLLVM.h"
 #include "mlir/Dialect/AffineOps/AffineOps.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/LoopOps/LoopOps.h"
 #include "mlir/Dialect/StandardOps/Ops.h"
+#include "mlir/Dialect/VectorOps/VectorOps.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "llvm/ADT/Sequence.h"
@@ -28,10 +30,9 @@ static FlatSymbolRefAttr getOrInsertExternFunc(StringRef funcName,
                                                mlir::LLVM::LLVMType funcType,
                                                PatternRewriter &rewriter) {
   auto *context = module.getContext();
-  if (module.lookupSymbol<LLVM::LLVMFuncOp>(funcName)) {
-    auto symbolRef = SymbolRefAttr::get(funcName, context);
-    assert(symbolRef.getType() == funcType && "wrong symbol type");
-    return symbolRef;
+  if (auto funcOp = module.lookupSymbol<LLVM::LLVMFuncOp>(funcName)) {
+    assert(funcOp.getType() == funcType && "wrong symbol type");
+    return SymbolRefAttr::get(funcName, context);
   }
 
   // Insert the function into the body of the parent module.
@@ -58,6 +59,32 @@ static size_t getRankFromMemRefType(LLVM::LLVMType memRefTy) {
     return memRefTy.getStructElementType(3).getArrayNumElements();
 }
 
+// Build the descriptor of a memref of static shape and row-major layout whose
+// elements are stored in `buffer`.
+static Value createStaticMemRefDescriptor(PatternRewriter &rewriter,
+                                          Location loc,
+                                          LLVM::LLVMType descriptorTy,
+                                          MemRefType memRefType, Value buffer,
+                                          LLVM::LLVMDialect *llvmDialect) {
+  auto int64Ty = LLVM::LLVMType::getInt64Ty(llvmDialect);
+  auto emitIndex = [&](int64_t value) -> Value {
+    return rewriter.create<LLVM::ConstantOp>(
+        loc, int64Ty, rewriter.getI64IntegerAttr(value));
+  };
+  auto descriptor = MemRefDescriptor::undef(rewriter, loc, descriptorTy);
+  descriptor.setAllocatedPtr(rewriter, loc, buffer);
+  descriptor.setAlignedPtr(rewriter, loc, buffer);
+  descriptor.setOffset(rewriter, loc, emitIndex(0));
+  auto shape = memRefType.getShape();
+  int64_t stride = 1;
+  for (int i = shape.size() - 1; i >= 0; --i) {
+    descriptor.setSize(rewriter, loc, i, emitIndex(shape[i]));
+    descriptor.setStride(rewriter, loc, i, emitIndex(stride));
+    stride *= shape[i];
+  }
+  return descriptor;
+}
+
 //===----------------------------------------------------------------------===//
 // KRNL to LLVM: KrnlMemcpyOpLowering
 //===----------------------------------------------------------------------===//
@@ -145,6 +172,493 @@ private:
   }
 };
 
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlReshapeOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlReshapeOpLowering : public ConversionPattern {
+public:
+  explicit KrnlReshapeOpLowering(MLIRContext *context,
+                                 LLVMTypeConverter &typeConverter)
+      : ConversionPattern(KrnlReshapeOp::getOperationName(), 1, context),
+        typeConverter(typeConverter) {}
+
+  PatternMatchResult
+  matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto loc = op->getLoc();
+    auto *llvmDialect =
+        op->getContext()->getRegisteredDialect<LLVM::LLVMDialect>();
+    assert(llvmDialect && "expected llvm dialect to be registered");
+    auto int64Ty = LLVM::LLVMType::getInt64Ty(llvmDialect);
+    auto memRefType = op->getResult(0).getType().cast<MemRefType>();
+    auto descriptorTy = typeConverter.convertType(memRefType)
+                            .dyn_cast_or_null<LLVM::LLVMType>();
+    if (!descriptorTy)
+      return matchFailure();
+
+    // The view points to the buffer of the source, with its own sizes and
+    // the strides of the row-major layout.
+    MemRefDescriptor src(operands[0]);
+    auto view = MemRefDescriptor::undef(rewriter, loc, descriptorTy);
+    view.setAllocatedPtr(rewriter, loc, src.allocatedPtr(rewriter, loc));
+    view.setAlignedPtr(rewriter, loc, src.alignedPtr(rewriter, loc));
+    view.setOffset(rewriter, loc, src.offset(rewriter, loc));
+
+    auto shape = memRefType.getShape();
+    auto dynamicSizes = operands.drop_front();
+    SmallVector<Value, 4> sizes;
+    for (auto dimSize : shape) {
+      if (dimSize < 0) {
+        sizes.emplace_back(dynamicSizes.front());
+        dynamicSizes = dynamicSizes.drop_front();
+      } else {
+        sizes.emplace_back(rewriter.create<LLVM::ConstantOp>(
+            loc, int64Ty, rewriter.getI64IntegerAttr(dimSize)));
+      }
+    }
+    Value stride = rewriter.create<LLVM::ConstantOp>(
+        loc, int64Ty, rewriter.getI64IntegerAttr(1));
+    for (int i = shape.size() - 1; i >= 0; --i) {
+      view.setSize(rewriter, loc, i, sizes[i]);
+      view.setStride(rewriter, loc, i, stride);
+      if (i != 0)
+        stride = rewriter.create<LLVM::MulOp>(loc, int64Ty, stride, sizes[i]);
+    }
+
+    rewriter.replaceOp(op, Value(view));
+    return matchSuccess();
+  }
+
+private:
+  LLVMTypeConverter &typeConverter;
+};
+
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlAllocaOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlAllocaOpLowering : public ConversionPattern {
+public:
+  explicit KrnlAllocaOpLowering(MLIRContext *context,
+                                LLVMTypeConverter &typeConverter)
+      : ConversionPattern(KrnlAllocaOp::getOperationName(), 1, context),
+        typeConverter(typeConverter) {}
+
+  PatternMatchResult
+  matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto loc = op->getLoc();
+    auto *llvmDialect =
+        op->getContext()->getRegisteredDialect<LLVM::LLVMDialect>();
+    assert(llvmDialect && "expected llvm dialect to be registered");
+    auto memRefType = op->getResult(0).getType().cast<MemRefType>();
+    auto descriptorTy = typeConverter.convertType(memRefType)
+                            .dyn_cast_or_null<LLVM::LLVMType>();
+    auto elementTy = typeConverter.convertType(memRefType.getElementType())
+                         .dyn_cast_or_null<LLVM::LLVMType>();
+    if (!descriptorTy || !elementTy)
+      return matchFailure();
+
+    Value buffer;
+    {
+      // Allocate the buffer in the entry block of the function, so that
+      // buffers allocated in loop bodies do not grow the stack.
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      auto parentFunc = op->getParentOfType<LLVM::LLVMFuncOp>();
+      rewriter.setInsertionPointToStart(&parentFunc.getBody().front());
+      auto numElements = rewriter.create<LLVM::ConstantOp>(
+          loc, LLVM::LLVMType::getInt64Ty(llvmDialect),
+          rewriter.getI64IntegerAttr(memRefType.getNumElements()));
+      buffer = rewriter.create<LLVM::AllocaOp>(
+          loc, elementTy.getPointerTo(), numElements, /*alignment=*/0);
+    }
+
+    rewriter.replaceOp(op, createStaticMemRefDescriptor(
+                               rewriter, loc, descriptorTy, memRefType,
+                               buffer, llvmDialect));
+    return matchSuccess();
+  }
+
+private:
+  LLVMTypeConverter &typeConverter;
+};
+
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlGlobalOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlGlobalOpLowering : public ConversionPattern {
+public:
+  explicit KrnlGlobalOpLowering(MLIRContext *context,
+                                LLVMTypeConverter &typeConverter)
+      : ConversionPattern(KrnlGlobalOp::getOperationName(), 1, context),
+        typeConverter(typeConverter) {}
+
+  PatternMatchResult
+  matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto loc = op->getLoc();
+    auto *llvmDialect =
+        op->getContext()->getRegisteredDialect<LLVM::LLVMDialect>();
+    assert(llvmDialect && "expected llvm dialect to be registered");
+    auto globalOp = cast<KrnlGlobalOp>(op);
+    ModuleOp parentModule = op->getParentOfType<ModuleOp>();
+    auto memRefType = op->getResult(0).getType().cast<MemRefType>();
+    auto descriptorTy = typeConverter.convertType(memRefType)
+                            .dyn_cast_or_null<LLVM::LLVMType>();
+    auto elementTy = typeConverter.convertType(memRefType.getElementType())
+                         .dyn_cast_or_null<LLVM::LLVMType>();
+    if (!descriptorTy || !elementTy)
+      return matchFailure();
+
+    // The elements are stored in a constant global of nested array type.
+    auto arrayTy = elementTy;
+    auto shape = memRefType.getShape();
+    for (int i = shape.size() - 1; i >= 0; --i)
+      arrayTy = LLVM::LLVMType::getArrayTy(arrayTy, shape[i]);
+    LLVM::GlobalOp global;
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      rewriter.setInsertionPointToStart(parentModule.getBody());
+      global = rewriter.create<LLVM::GlobalOp>(
+          loc, arrayTy, /*isConstant=*/true, LLVM::Linkage::Internal,
+          getGlobalName(parentModule), globalOp.value());
+    }
+
+    Value address = rewriter.create<LLVM::AddressOfOp>(loc, global);
+    Value buffer = rewriter.create<LLVM::BitcastOp>(
+        loc, elementTy.getPointerTo(), address);
+    rewriter.replaceOp(op, createStaticMemRefDescriptor(
+                               rewriter, loc, descriptorTy, memRefType,
+                               buffer, llvmDialect));
+    return matchSuccess();
+  }
+
+private:
+  LLVMTypeConverter &typeConverter;
+
+  /// Return a name for a new global, not used by another symbol of the
+  /// module.
+  static std::string getGlobalName(ModuleOp module) {
+    for (int i = 0;; ++i) {
+      auto name = "krnl_global_" + std::to_string(i);
+      if (!module.lookupSymbol(name))
+        return name;
+    }
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlParallelCallOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlParallelCallOpLowering : public ConversionPattern {
+public:
+  explicit KrnlParallelCallOpLowering(MLIRContext *context)
+      : ConversionPattern(KrnlParallelCallOp::getOperationName(), 1, context) {}
+
+  PatternMatchResult
+  matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto loc = op->getLoc();
+    auto *llvmDialect =
+        op->getContext()->getRegisteredDialect<LLVM::LLVMDialect>();
+    assert(llvmDialect && "expected llvm dialect to be registered");
+    auto parallelCallOp = cast<KrnlParallelCallOp>(op);
+    ModuleOp parentModule = op->getParentOfType<ModuleOp>();
+
+    using LLVMType = LLVM::LLVMType;
+    auto opaquePtrTy = LLVMType::getInt8PtrTy(llvmDialect);
+    auto int32Ty = LLVMType::getInt32Ty(llvmDialect);
+
+    // The arguments of the outlined loop body are passed to the threads of
+    // the runtime through a context structure allocated on the stack.
+    auto arguments = operands.drop_front();
+    SmallVector<LLVMType, 4> argTys;
+    for (auto argument : arguments)
+      argTys.emplace_back(argument.getType().cast<LLVMType>());
+    auto contextTy = LLVMType::getStructTy(llvmDialect, argTys);
+
+    Value contextPtr;
+    {
+      // Allocate the context in the entry block of the function, so that
+      // parallel loops nested in sequential loops do not grow the stack.
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      auto parentFunc = op->getParentOfType<LLVM::LLVMFuncOp>();
+      rewriter.setInsertionPointToStart(&parentFunc.getBody().front());
+      auto one = rewriter.create<LLVM::ConstantOp>(
+          loc, int32Ty, rewriter.getI32IntegerAttr(1));
+      contextPtr = rewriter.create<LLVM::AllocaOp>(
+          loc, contextTy.getPointerTo(), one, /*alignment=*/0);
+    }
+    Value context = rewriter.create<LLVM::UndefOp>(loc, contextTy);
+    for (auto argument : llvm::enumerate(arguments))
+      context = rewriter.create<LLVM::InsertValueOp>(
+          loc, contextTy, context, argument.value(),
+          rewriter.getI64ArrayAttr(argument.index()));
+    rewriter.create<LLVM::StoreOp>(loc, context, contextPtr);
+    Value opaqueContextPtr =
+        rewriter.create<LLVM::BitcastOp>(loc, opaquePtrTy, contextPtr);
+
+    // Run the iterations of the loop on the thread pool of the runtime.
+    auto trampolineTy = getTrampolineTy(llvmDialect);
+    auto trampolineRef = getOrInsertTrampoline(
+        rewriter, parentModule, parallelCallOp, contextTy, llvmDialect);
+    Value trampolinePtr = rewriter.create<LLVM::ConstantOp>(
+        loc, trampolineTy.getPointerTo(), trampolineRef);
+    auto parallelForRef =
+        getOrInsertParallelFor(rewriter, parentModule, llvmDialect);
+    rewriter.create<LLVM::CallOp>(
+        loc, ArrayRef<Type>({}), parallelForRef,
+        ArrayRef<Value>({operands[0], trampolinePtr, opaqueContextPtr}));
+
+    rewriter.eraseOp(op);
+    return matchSuccess();
+  }
+
+private:
+  /// Return the type of the functions run by the threads of the runtime:
+  ///   * `void (i64, i64, i8*)`
+  /// taking the range of iterations to execute and the context of the loop.
+  static LLVM::LLVMType getTrampolineTy(LLVM::LLVMDialect *llvmDialect) {
+    auto llvmVoidTy = LLVM::LLVMType::getVoidTy(llvmDialect);
+    auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(llvmDialect);
+    auto llvmI64Ty = LLVM::LLVMType::getInt64Ty(llvmDialect);
+    return LLVM::LLVMType::getFunctionTy(
+        llvmVoidTy,
+        ArrayRef<mlir::LLVM::LLVMType>({llvmI64Ty, llvmI64Ty, llvmI8PtrTy}),
+        false);
+  }
+
+  /// Return a symbol reference to the krnlParallelFor function of the
+  /// runtime, inserting it into the module if necessary.
+  static FlatSymbolRefAttr
+  getOrInsertParallelFor(PatternRewriter &rewriter, ModuleOp module,
+                         LLVM::LLVMDialect *llvmDialect) {
+    auto *context = module.getContext();
+    if (module.lookupSymbol<LLVM::LLVMFuncOp>("krnlParallelFor"))
+      return SymbolRefAttr::get("krnlParallelFor", context);
+    // Create a function declaration for krnlParallelFor, the signature is:
+    //   * `void (i64, void (i64, i64, i8*)*, i8*)`
+    auto llvmVoidTy = LLVM::LLVMType::getVoidTy(llvmDialect);
+    auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(llvmDialect);
+    auto llvmI64Ty = LLVM::LLVMType::getInt64Ty(llvmDialect);
+    auto llvmFnType = LLVM::LLVMType::getFunctionTy(
+        llvmVoidTy,
+        ArrayRef<mlir::LLVM::LLVMType>(
+            {llvmI64Ty, getTrampolineTy(llvmDialect).getPointerTo(),
+             llvmI8PtrTy}),
+        false);
+
+    // Insert the krnlParallelFor function into the body of the parent module.
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    rewriter.create<LLVM::LLVMFuncOp>(module.getLoc(), "krnlParallelFor",
+                                      llvmFnType);
+    return SymbolRefAttr::get("krnlParallelFor", context);
+  }
+
+  /// Return a symbol reference to the function run by the threads of the
+  /// runtime for the outlined loop body called by `parallelCallOp`, inserting
+  /// it into the module if necessary. This function unpacks the arguments of
+  /// the loop body from the context structure, and calls the C interface of
+  /// the outlined function.
+  static FlatSymbolRefAttr
+  getOrInsertTrampoline(PatternRewriter &rewriter, ModuleOp module,
+                        KrnlParallelCallOp parallelCallOp,
+                        LLVM::LLVMType contextTy,
+                        LLVM::LLVMDialect *llvmDialect) {
+    auto *context = module.getContext();
+    auto loc = parallelCallOp.getLoc();
+    auto callee = parallelCallOp.callee();
+    auto trampolineName = (callee + "_trampoline").str();
+    if (module.lookupSymbol<LLVM::LLVMFuncOp>(trampolineName))
+      return SymbolRefAttr::get(trampolineName, context);
+
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    auto trampoline = rewriter.create<LLVM::LLVMFuncOp>(
+        loc, trampolineName, getTrampolineTy(llvmDialect));
+    auto *entryBlock = trampoline.addEntryBlock();
+    rewriter.setInsertionPointToStart(entryBlock);
+
+    auto int32Ty = LLVM::LLVMType::getInt32Ty(llvmDialect);
+    Value contextPtr = rewriter.create<LLVM::BitcastOp>(
+        loc, contextTy.getPointerTo(), entryBlock->getArgument(2));
+    Value zero = rewriter.create<LLVM::ConstantOp>(
+        loc, int32Ty, rewriter.getI32IntegerAttr(0));
+    SmallVector<Value, 8> calleeArgs = {entryBlock->getArgument(0),
+                                        entryBlock->getArgument(1)};
+    for (auto argument : llvm::enumerate(parallelCallOp.arguments())) {
+      auto fieldTy = contextTy.getStructElementType(argument.index());
+      Value fieldIdx = rewriter.create<LLVM::ConstantOp>(
+          loc, int32Ty, rewriter.getI32IntegerAttr(argument.index()));
+      Value fieldPtr = rewriter.create<LLVM::GEPOp>(
+          loc, fieldTy.getPointerTo(), contextPtr,
+          ArrayRef<Value>({zero, fieldIdx}));
+      // The C interface of a function takes memref descriptors by pointer.
+      if (argument.value().getType().isa<MemRefType>())
+        calleeArgs.emplace_back(fieldPtr);
+      else
+        calleeArgs.emplace_back(
+            rewriter.create<LLVM::LoadOp>(loc, fieldTy, fieldPtr));
+    }
+    rewriter.create<LLVM::CallOp>(
+        loc, ArrayRef<Type>({}),
+        rewriter.getSymbolRefAttr(("_mlir_ciface_" + callee).str()),
+        calleeArgs);
+    rewriter.create<LLVM::ReturnOp>(loc, ArrayRef<Value>({}));
+    return SymbolRefAttr::get(trampolineName, context);
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// Vector to LLVM: VectorTransferOpLowering
+//===----------------------------------------------------------------------===//
+
+/// Lower the 1-D vector transfers along the innermost dimension of a memref,
+/// as emitted when vectorizing Krnl loops, to the LLVM masked load and store
+/// intrinsics. Lanes past the end of the innermost dimension are masked off:
+/// they are not accessed in memory, and read as the padding value.
+template <typename TransferOp>
+class VectorTransferOpLowering : public ConversionPattern {
+public:
+  explicit VectorTransferOpLowering(MLIRContext *context)
+      : ConversionPattern(TransferOp::getOperationName(), 1, context) {}
+
+  PatternMatchResult
+  matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto loc = op->getLoc();
+    auto *llvmDialect =
+        op->getContext()->getRegisteredDialect<LLVM::LLVMDialect>();
+    assert(llvmDialect && "expected llvm dialect to be registered");
+    auto transferOp = cast<TransferOp>(op);
+    auto memRefType = transferOp.getMemRefType();
+    auto vectorType = transferOp.getVectorType();
+    auto rank = memRefType.getRank();
+    auto permutationMap = transferOp.permutation_map();
+    if (vectorType.getRank() != 1 || rank == 0 ||
+        permutationMap != AffineMap::get(rank, 0,
+                                         rewriter.getAffineDimExpr(rank - 1)))
+      return matchFailure();
+
+    using LLVMType = LLVM::LLVMType;
+    auto int32Ty = LLVMType::getInt32Ty(llvmDialect);
+    auto int64Ty = LLVMType::getInt64Ty(llvmDialect);
+    int64_t width = vectorType.getDimSize(0);
+    auto int64VectorTy = LLVMType::getVectorTy(int64Ty, width);
+
+    // Operands of the lowered transfer: the memref descriptor and the indices
+    // of the first element, preceded by the vector for a write and followed
+    // by the padding value for a read.
+    bool isRead = isa<vector::TransferReadOp>(op);
+    auto memRefOperands = operands.drop_front(isRead ? 0 : 1);
+    MemRefDescriptor memRef(memRefOperands[0]);
+    auto indices = memRefOperands.slice(1, rank);
+
+    // Compute the address of the first element.
+    Value offset = memRef.offset(rewriter, loc);
+    for (int64_t i = 0; i < rank; ++i) {
+      Value index = rewriter.create<LLVM::MulOp>(loc, int64Ty, indices[i],
+                                                 memRef.stride(rewriter, loc, i));
+      offset = rewriter.create<LLVM::AddOp>(loc, int64Ty, offset, index);
+    }
+    Value alignedPtr = memRef.alignedPtr(rewriter, loc);
+    auto elementTy =
+        alignedPtr.getType().cast<LLVMType>().getPointerElementTy();
+    auto llvmVectorTy = LLVMType::getVectorTy(elementTy, width);
+    Value elementPtr = rewriter.create<LLVM::GEPOp>(
+        loc, alignedPtr.getType(), alignedPtr, ArrayRef<Value>({offset}));
+    Value vectorPtr = rewriter.create<LLVM::BitcastOp>(
+        loc, llvmVectorTy.getPointerTo(), elementPtr);
+
+    // Only the lanes before the end of the innermost dimension are enabled.
+    SmallVector<int64_t, 16> lanes;
+    for (int64_t i = 0; i < width; ++i)
+      lanes.emplace_back(i);
+    Value laneIndices = rewriter.create<LLVM::ConstantOp>(
+        loc, int64VectorTy,
+        DenseElementsAttr::get(
+            VectorType::get(width, rewriter.getIntegerType(64)),
+            llvm::makeArrayRef(lanes)));
+    Value remaining = rewriter.create<LLVM::SubOp>(
+        loc, int64Ty, memRef.size(rewriter, loc, rank - 1), indices.back());
+    Value mask = rewriter.create<LLVM::ICmpOp>(
+        loc, LLVM::ICmpPredicate::slt, laneIndices,
+        splat(rewriter, loc, remaining, int64VectorTy, llvmDialect));
+
+    // Memory is only guaranteed to be aligned on its elements.
+    unsigned alignment = memRefType.getElementTypeBitWidth() / 8;
+    Value alignmentValue = rewriter.create<LLVM::ConstantOp>(
+        loc, int32Ty, rewriter.getI32IntegerAttr(alignment));
+
+    auto maskTy =
+        LLVMType::getVectorTy(LLVMType::getInt1Ty(llvmDialect), width);
+    auto intrinsicSuffix = getIntrinsicSuffix(llvmVectorTy);
+    auto parentModule = op->getParentOfType<ModuleOp>();
+    if (isRead) {
+      auto intrinsicTy = LLVMType::getFunctionTy(
+          llvmVectorTy, {llvmVectorTy.getPointerTo(), int32Ty, maskTy,
+                         llvmVectorTy},
+          false);
+      auto intrinsicRef = getOrInsertExternFunc(
+          "llvm.masked.load." + intrinsicSuffix, parentModule, intrinsicTy,
+          rewriter);
+      Value passThrough =
+          splat(rewriter, loc, memRefOperands.back(), llvmVectorTy,
+                llvmDialect);
+      auto callOp = rewriter.create<LLVM::CallOp>(
+          loc, ArrayRef<Type>({llvmVectorTy}), intrinsicRef,
+          ArrayRef<Value>({vectorPtr, alignmentValue, mask, passThrough}));
+      rewriter.replaceOp(op, callOp.getResult(0));
+    } else {
+      auto intrinsicTy = LLVMType::getFunctionTy(
+          LLVMType::getVoidTy(llvmDialect),
+          {llvmVectorTy, llvmVectorTy.getPointerTo(), int32Ty, maskTy}, false);
+      auto intrinsicRef = getOrInsertExternFunc(
+          "llvm.masked.store." + intrinsicSuffix, parentModule, intrinsicTy,
+          rewriter);
+      rewriter.create<LLVM::CallOp>(
+          loc, ArrayRef<Type>({}), intrinsicRef,
+          ArrayRef<Value>({operands[0], vectorPtr, alignmentValue, mask}));
+      rewriter.eraseOp(op);
+    }
+    return matchSuccess();
+  }
+
+private:
+  /// Return a vector of type `vectorTy` with all its lanes set to `value`.
+  static Value splat(ConversionPatternRewriter &rewriter, Location loc,
+                     Value value, LLVM::LLVMType vectorTy,
+                     LLVM::LLVMDialect *llvmDialect) {
+    auto int32Ty = LLVM::LLVMType::getInt32Ty(llvmDialect);
+    Value undef = rewriter.create<LLVM::UndefOp>(loc, vectorTy);
+    Value zero = rewriter.create<LLVM::ConstantOp>(
+        loc, int32Ty, rewriter.getI32IntegerAttr(0));
+    Value vector = rewriter.create<LLVM::InsertElementOp>(loc, vectorTy, undef,
+                                                          value, zero);
+    SmallVector<int32_t, 16> zeros(vectorTy.getVectorNumElements(), 0);
+    return rewriter.create<LLVM::ShuffleVectorOp>(
+        loc, vector, undef, rewriter.getI32ArrayAttr(zeros));
+  }
+
+  /// Return the suffix of the name of the masked load and store intrinsics
+  /// operating on vectors of type `vectorTy`, e.g. `v8f32.p0v8f32`.
+  static std::string getIntrinsicSuffix(LLVM::LLVMType vectorTy) {
+    std::string typeName;
+    llvm::raw_string_ostream typeNameStream(typeName);
+    auto *llvmElementTy =
+        vectorTy.getVectorElementType().getUnderlyingType();
+    typeNameStream << "v" << vectorTy.getVectorNumElements()
+                   << (llvmElementTy->isIntegerTy() ? "i" : "f")
+                   << llvmElementTy->getScalarSizeInBits();
+    auto vectorName = typeNameStream.str();
+    return vectorName + ".p0" + vectorName;
+  }
+};
+
 //===----------------------------------------------------------------------===//
 // KRNL to LLVM: KrnlEntryPointOp
 //===----------------------------------------------------------------------===//
@@ -511,7 +1025,15 @@ void KrnlToLLVMLoweringPass::runOnModule() {
                                       /*emitCWrapper=*/true);
 
   // Lower from the `krnl` dialect i.e. the Reshape operation.
-  patterns.insert<KrnlMemcpyOpLowering, KrnlEntryPointOpLowering>(
+  patterns.insert<KrnlMemcpyOpLowering, KrnlParallelCallOpLowering,
+                  KrnlEntryPointOpLowering>(&getContext());
+  patterns.insert<KrnlReshapeOpLowering, KrnlAllocaOpLowering,
+                  KrnlGlobalOpLowering>(&getContext(), typeConverter);
+
+  // Lower the vector operations emitted when vectorizing Krnl loops.
+  populateVectorToLLVMConversionPatterns(typeConverter, patterns);
+  patterns.insert<VectorTransferOpLowering<vector::TransferReadOp>,
+                  VectorTransferOpLowering<vector::TransferWriteOp>>(
       &getContext());
 
   // We want to completely lower to LLVM, so we use a `FullConversion`. This
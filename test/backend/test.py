@@ -46,7 +46,7 @@ class DummyBackend(onnx.backend.base.Backend):
         # Generate shared library from object file, linking with c runtime.
         execute_commands([
             CXX, "-shared", "-fPIC", "model.o", "-o", "model.so",
-            "-L" + RUNTIME_DIR, "-lcruntime"
+            "-L" + RUNTIME_DIR, "-lcruntime", "-lpthread"
         ])
         return ExecutionSession("./model.so", "_dyn_entry_point_main_graph")
 
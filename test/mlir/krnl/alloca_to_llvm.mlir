@@ -0,0 +1,22 @@
+// RUN: onnf-opt --lower-all-llvm %s | FileCheck %s
+
+// The buffer is allocated once in the entry block of the function, and is
+// not freed.
+func @test_alloca(%arg0 : memref<10x8xf32>) {
+  affine.for %i = 0 to 10 {
+    %0 = "krnl.alloca"() : () -> memref<4x8xf32>
+    %1 = affine.load %arg0[%i, 0] : memref<10x8xf32>
+    affine.store %1, %0[0, 0] : memref<4x8xf32>
+  }
+  return
+
+  // CHECK-LABEL: llvm.func @test_alloca
+  // CHECK: [[SIZE:%.+]] = llvm.mlir.constant(32 : i64) : !llvm.i64
+  // CHECK-NEXT: [[BUFFER:%.+]] = llvm.alloca [[SIZE]] x !llvm.float
+  // CHECK: llvm.br
+  // CHECK: [[DESC:%.+]] = llvm.mlir.undef : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK-NEXT: llvm.insertvalue [[BUFFER]], [[DESC]][0]
+  // CHECK-NOT: llvm.call @malloc
+  // CHECK-NOT: llvm.call @free
+  // CHECK: llvm.return
+}
@@ -0,0 +1,232 @@
+// RUN: onnf-opt --fuse-krnl-loops %s -split-input-file | FileCheck %s
+
+// The intermediate buffer, accessed through views, is replaced by the value
+// computed by the producer in the fused loop nest.
+func @test_fuse_views(%arg0 : memref<10x20xf32>) -> memref<10x20xf32> {
+  %0 = alloc() : memref<10x20xf32>
+  %1 = alloc() : memref<10x20xf32>
+  %2 = "krnl.reshape"(%arg0) : (memref<10x20xf32>) -> memref<200xf32>
+  %3 = "krnl.reshape"(%1) : (memref<10x20xf32>) -> memref<200xf32>
+  %4 = krnl.define_loops 1
+  %5 = krnl.optimize_loops  {
+    krnl.return_loops %4
+  } : () -> !krnl.loop
+  krnl.iterate(%5) with (%4 -> %i = 0 to 200) {
+    %6 = load %2[%i] : memref<200xf32>
+    %7 = exp %6 : f32
+    store %7, %3[%i] : memref<200xf32>
+  }
+  %8 = "krnl.reshape"(%1) : (memref<10x20xf32>) -> memref<200xf32>
+  %9 = "krnl.reshape"(%0) : (memref<10x20xf32>) -> memref<200xf32>
+  %10 = krnl.define_loops 1
+  %11 = krnl.optimize_loops  {
+    krnl.parallel %10
+    krnl.return_loops %10
+  } : () -> !krnl.loop
+  krnl.iterate(%11) with (%10 -> %j = 0 to 200) {
+    %12 = load %8[%j] : memref<200xf32>
+    %13 = load %2[%j] : memref<200xf32>
+    %14 = addf %12, %13 : f32
+    store %14, %9[%j] : memref<200xf32>
+  }
+  dealloc %1 : memref<10x20xf32>
+  return %0 : memref<10x20xf32>
+
+  // CHECK-LABEL: test_fuse_views
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x20xf32>
+  // CHECK-NOT: alloc
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0) : (memref<10x20xf32>) -> memref<200xf32>
+  // CHECK-NEXT: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x20xf32>) -> memref<200xf32>
+  // CHECK-NEXT: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK-NEXT: [[OPT_LOOPS:%.+]] = krnl.optimize_loops  {
+  // CHECK-NEXT:   krnl.parallel [[DEF_LOOPS]]
+  // CHECK: krnl.iterate([[OPT_LOOPS]]) with ([[DEF_LOOPS]] -> %arg1 = 0 to 200) {
+  // CHECK-NEXT: [[LOAD:%.+]] = load [[VIEW]][%arg1] : memref<200xf32>
+  // CHECK-NEXT: [[EXP:%.+]] = exp [[LOAD]] : f32
+  // CHECK-NEXT: [[LOAD2:%.+]] = load [[VIEW]][%arg1] : memref<200xf32>
+  // CHECK-NEXT: [[ADDF:%.+]] = addf [[EXP]], [[LOAD2]] : f32
+  // CHECK-NEXT: store [[ADDF]], [[RES_VIEW]][%arg1] : memref<200xf32>
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<10x20xf32>
+}
+
+// -----
+
+// The sizes of the dynamic dimensions of the buffers are those given to their
+// allocation, so the loop nests have the same iteration space. A chain of loop
+// nests is fused into a single loop nest.
+func @test_fuse_dynamic_chain(%arg0 : memref<?x10xf32>) -> memref<?x10xf32> {
+  %0 = dim %arg0, 0 : memref<?x10xf32>
+  %1 = alloc(%0) : memref<?x10xf32>
+  %2:2 = krnl.define_loops 2
+  %3:2 = krnl.optimize_loops  {
+    krnl.return_loops %2#0, %2#1
+  } : () -> (!krnl.loop, !krnl.loop)
+  %4 = dim %1, 0 : memref<?x10xf32>
+  krnl.iterate(%3#0, %3#1) with (%2#0 -> %i = 0 to %4, %2#1 -> %j = 0 to 10) {
+    %5 = load %arg0[%i, %j] : memref<?x10xf32>
+    %6 = exp %5 : f32
+    store %6, %1[%i, %j] : memref<?x10xf32>
+  }
+  %7 = dim %1, 0 : memref<?x10xf32>
+  %8 = alloc(%7) : memref<?x10xf32>
+  %9:2 = krnl.define_loops 2
+  %10:2 = krnl.optimize_loops  {
+    krnl.return_loops %9#0, %9#1
+  } : () -> (!krnl.loop, !krnl.loop)
+  %11 = dim %8, 0 : memref<?x10xf32>
+  krnl.iterate(%10#0, %10#1) with (%9#0 -> %k = 0 to %11, %9#1 -> %l = 0 to 10) {
+    %12 = load %1[%k, %l] : memref<?x10xf32>
+    %13 = mulf %12, %12 : f32
+    store %13, %8[%k, %l] : memref<?x10xf32>
+  }
+  %14 = dim %8, 0 : memref<?x10xf32>
+  %15 = alloc(%14) : memref<?x10xf32>
+  %16:2 = krnl.define_loops 2
+  %17:2 = krnl.optimize_loops  {
+    krnl.return_loops %16#0, %16#1
+  } : () -> (!krnl.loop, !krnl.loop)
+  %18 = dim %15, 0 : memref<?x10xf32>
+  krnl.iterate(%17#0, %17#1) with (%16#0 -> %m = 0 to %18, %16#1 -> %n = 0 to 10) {
+    %19 = load %8[%m, %n] : memref<?x10xf32>
+    %20 = addf %19, %19 : f32
+    store %20, %15[%m, %n] : memref<?x10xf32>
+  }
+  dealloc %1 : memref<?x10xf32>
+  dealloc %8 : memref<?x10xf32>
+  return %15 : memref<?x10xf32>
+
+  // CHECK-LABEL: test_fuse_dynamic_chain
+  // CHECK: [[DIM:%.+]] = dim %arg0, 0 : memref<?x10xf32>
+  // CHECK-NEXT: [[RES:%.+]] = alloc([[DIM]]) : memref<?x10xf32>
+  // CHECK-NEXT: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: [[RES_DIM:%.+]] = dim [[RES]], 0 : memref<?x10xf32>
+  // CHECK-NEXT: krnl.iterate({{.*}}) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to [[RES_DIM]], [[DEF_LOOPS]]#1 -> %arg2 = 0 to 10) {
+  // CHECK-NEXT: [[LOAD:%.+]] = load %arg0[%arg1, %arg2] : memref<?x10xf32>
+  // CHECK-NEXT: [[EXP:%.+]] = exp [[LOAD]] : f32
+  // CHECK-NEXT: [[MULF:%.+]] = mulf [[EXP]], [[EXP]] : f32
+  // CHECK-NEXT: [[ADDF:%.+]] = addf [[MULF]], [[MULF]] : f32
+  // CHECK-NEXT: store [[ADDF]], [[RES]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK-NEXT: }
+  // CHECK-NEXT: return [[RES]] : memref<?x10xf32>
+}
+
+// -----
+
+// Loop nests are not fused when the consumer reads elements computed by other
+// iterations of the producer.
+func @test_no_fusion_transposed(%arg0 : memref<10x10xf32>) -> memref<10x10xf32> {
+  %0 = alloc() : memref<10x10xf32>
+  %1 = alloc() : memref<10x10xf32>
+  %2:2 = krnl.define_loops 2
+  %3:2 = krnl.optimize_loops  {
+    krnl.return_loops %2#0, %2#1
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%3#0, %3#1) with (%2#0 -> %i = 0 to 10, %2#1 -> %j = 0 to 10) {
+    %4 = load %arg0[%i, %j] : memref<10x10xf32>
+    %5 = exp %4 : f32
+    store %5, %1[%i, %j] : memref<10x10xf32>
+  }
+  %6:2 = krnl.define_loops 2
+  %7:2 = krnl.optimize_loops  {
+    krnl.return_loops %6#0, %6#1
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%7#0, %7#1) with (%6#0 -> %k = 0 to 10, %6#1 -> %l = 0 to 10) {
+    %8 = load %1[%l, %k] : memref<10x10xf32>
+    store %8, %0[%k, %l] : memref<10x10xf32>
+  }
+  dealloc %1 : memref<10x10xf32>
+  return %0 : memref<10x10xf32>
+
+  // CHECK-LABEL: test_no_fusion_transposed
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[BUF:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: krnl.iterate
+  // CHECK: store {{%.+}}, [[BUF]][%arg1, %arg2] : memref<10x10xf32>
+  // CHECK: krnl.iterate
+  // CHECK: load [[BUF]][%arg2, %arg1] : memref<10x10xf32>
+  // CHECK: dealloc [[BUF]] : memref<10x10xf32>
+}
+
+// -----
+
+// Loop nests are not fused when the producer accumulates into the buffer, as
+// the final value of an element is only known after the loop nest.
+func @test_no_fusion_accumulation(%arg0 : memref<10x10xf32>) -> memref<10x10xf32> {
+  %0 = alloc() : memref<10x10xf32>
+  %1 = alloc() : memref<10x10xf32>
+  %2:2 = krnl.define_loops 2
+  %3:2 = krnl.optimize_loops  {
+    krnl.return_loops %2#0, %2#1
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%3#0, %3#1) with (%2#0 -> %i = 0 to 10, %2#1 -> %j = 0 to 10) {
+    %4 = load %1[%i, %j] : memref<10x10xf32>
+    %5 = load %arg0[%i, %j] : memref<10x10xf32>
+    %6 = addf %4, %5 : f32
+    store %6, %1[%i, %j] : memref<10x10xf32>
+  }
+  %7:2 = krnl.define_loops 2
+  %8:2 = krnl.optimize_loops  {
+    krnl.return_loops %7#0, %7#1
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%8#0, %8#1) with (%7#0 -> %k = 0 to 10, %7#1 -> %l = 0 to 10) {
+    %9 = load %1[%k, %l] : memref<10x10xf32>
+    %10 = exp %9 : f32
+    store %10, %0[%k, %l] : memref<10x10xf32>
+  }
+  dealloc %1 : memref<10x10xf32>
+  return %0 : memref<10x10xf32>
+
+  // CHECK-LABEL: test_no_fusion_accumulation
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[BUF:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: krnl.iterate
+  // CHECK: store {{%.+}}, [[BUF]][%arg1, %arg2] : memref<10x10xf32>
+  // CHECK: krnl.iterate
+  // CHECK: load [[BUF]][%arg1, %arg2] : memref<10x10xf32>
+  // CHECK: dealloc [[BUF]] : memref<10x10xf32>
+}
+
+// -----
+
+// A consumer executed in place overwrites the elements stored by the producer,
+// whose store is removed. The buffer holds the result of the fused loop nest.
+func @test_fuse_in_place(%arg0 : memref<10x20xf32>) -> memref<10x20xf32> {
+  %0 = alloc() : memref<10x20xf32>
+  %1 = "krnl.reshape"(%arg0) : (memref<10x20xf32>) -> memref<200xf32>
+  %2 = "krnl.reshape"(%0) : (memref<10x20xf32>) -> memref<200xf32>
+  %3 = krnl.define_loops 1
+  %4 = krnl.optimize_loops  {
+    krnl.return_loops %3
+  } : () -> !krnl.loop
+  krnl.iterate(%4) with (%3 -> %i = 0 to 200) {
+    %5 = load %1[%i] : memref<200xf32>
+    %6 = exp %5 : f32
+    store %6, %2[%i] : memref<200xf32>
+  }
+  %7 = "krnl.reshape"(%0) : (memref<10x20xf32>) -> memref<200xf32>
+  %8 = "krnl.reshape"(%0) : (memref<10x20xf32>) -> memref<200xf32>
+  %9 = krnl.define_loops 1
+  %10 = krnl.optimize_loops  {
+    krnl.return_loops %9
+  } : () -> !krnl.loop
+  krnl.iterate(%10) with (%9 -> %j = 0 to 200) {
+    %11 = load %7[%j] : memref<200xf32>
+    %12 = mulf %11, %11 : f32
+    store %12, %8[%j] : memref<200xf32>
+  }
+  return %0 : memref<10x20xf32>
+
+  // CHECK-LABEL: test_fuse_in_place
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x20xf32>
+  // CHECK-NEXT: [[VIEW:%.+]] = "krnl.reshape"(%arg0) : (memref<10x20xf32>) -> memref<200xf32>
+  // CHECK-NEXT: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x20xf32>) -> memref<200xf32>
+  // CHECK-NEXT: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate({{.*}}) with ([[DEF_LOOPS]] -> %arg1 = 0 to 200) {
+  // CHECK-NEXT: [[LOAD:%.+]] = load [[VIEW]][%arg1] : memref<200xf32>
+  // CHECK-NEXT: [[EXP:%.+]] = exp [[LOAD]] : f32
+  // CHECK-NEXT: [[MULF:%.+]] = mulf [[EXP]], [[EXP]] : f32
+  // CHECK-NEXT: store [[MULF]], [[RES_VIEW]][%arg1] : memref<200xf32>
+  // CHECK-NEXT: }
+  // CHECK-NEXT: return [[RES]] : memref<10x20xf32>
+}
@@ -0,0 +1,19 @@
+// RUN: onnf-opt --lower-all-llvm %s | FileCheck %s
+
+// The elements are stored in a constant global, and the buffer points to it.
+func @test_global(%arg0 : memref<2x2xf32>) {
+  %0 = "krnl.global"() {value = dense<[[1.0, 2.0], [3.0, 4.0]]> : tensor<2x2xf32>} : () -> memref<2x2xf32>
+  %c1 = constant 1 : index
+  %1 = load %0[%c1, %c1] : memref<2x2xf32>
+  store %1, %arg0[%c1, %c1] : memref<2x2xf32>
+  return
+
+  // CHECK: llvm.mlir.global {{.*}}constant @krnl_global_0(dense<{{\[\[}}1.000000e+00, 2.000000e+00], [3.000000e+00, 4.000000e+00]]> : tensor<2x2xf32>) : !llvm<"[2 x [2 x float]]">
+  // CHECK-LABEL: llvm.func @test_global
+  // CHECK: [[ADDRESS:%.+]] = llvm.mlir.addressof @krnl_global_0 : !llvm<"[2 x [2 x float]]*">
+  // CHECK: [[BUFFER:%.+]] = llvm.bitcast [[ADDRESS]] : !llvm<"[2 x [2 x float]]*"> to !llvm<"float*">
+  // CHECK: [[DESC:%.+]] = llvm.mlir.undef : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK-NEXT: llvm.insertvalue [[BUFFER]], [[DESC]][0]
+  // CHECK-NOT: llvm.call @malloc
+  // CHECK: llvm.return
+}
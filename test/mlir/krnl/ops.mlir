@@ -72,4 +72,28 @@ func @affine_map_bound(%N : index) {
   }
 
   return
-}
\ No newline at end of file
+}
+func @schedule_intrinsics(%N : index) {
+  %ii, %ij = krnl.define_loops 2
+  // CHECK: [[OPT_LOOPS:%.+]]:3 = krnl.optimize_loops  {
+  // CHECK-NEXT: [[TILE:%.+]]:2 = krnl.block %{{.*}} 4
+  // CHECK-NEXT: [[PERM:%.+]]:2 = krnl.permute([[TILE]]#1, %{{.*}}) [1, 0]
+  // CHECK-NEXT: krnl.parallel [[TILE]]#0
+  // CHECK-NEXT: krnl.vectorize [[PERM]]#1 8
+  // CHECK-NEXT: krnl.return_loops [[TILE]]#0, [[PERM]]#0, [[PERM]]#1
+  // CHECK-NEXT: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop)
+  %ot, %oj, %oi = krnl.optimize_loops  {
+    %it, %il = krnl.block %ii 4
+    %pj, %pi = krnl.permute(%il, %ij) [1, 0]
+    krnl.parallel %it
+    krnl.vectorize %pi 8
+    krnl.return_loops %it, %pj, %pi
+  } : () -> (!krnl.loop, !krnl.loop, !krnl.loop)
+
+  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1, [[OPT_LOOPS]]#2) with (%{{.*}} -> %{{.*}} = 0 to %{{.*}}, %{{.*}} -> %{{.*}} = 0 to 10) {
+  krnl.iterate(%ot, %oj, %oi) with (%ii -> %i = 0 to %N, %ij -> %j = 0 to 10) {
+
+  }
+
+  return
+}
@@ -0,0 +1,79 @@
+// RUN: onnf-opt --lower-krnl-parallel %s -split-input-file | FileCheck %s
+
+func @test_parallel(%arg0 : memref<10x20xf32>, %arg1 : memref<10x20xf32>) {
+  %cst = constant 1.000000e+00 : f32
+  affine.for %i = 0 to 10 {
+    affine.for %j = 0 to 20 {
+      %0 = affine.load %arg0[%i, %j] : memref<10x20xf32>
+      %1 = addf %0, %cst : f32
+      affine.store %1, %arg1[%i, %j] : memref<10x20xf32>
+    }
+  } {krnl.parallel}
+  return
+
+  // CHECK-DAG: [[IV_MAP:#.+]] = affine_map<(d0)[s0] -> (d0 + s0)>
+  // CHECK-LABEL: func @test_parallel_parallel_0
+  // CHECK-SAME: ([[BEGIN:%.+]]: index, [[END:%.+]]: index, [[LB:%.+]]: index, [[IN:%.+]]: memref<10x20xf32>, [[OUT:%.+]]: memref<10x20xf32>)
+  // CHECK: [[CST:%.+]] = constant 1.000000e+00 : f32
+  // CHECK: affine.for [[IT:%.+]] = [[BEGIN]] to [[END]] {
+  // CHECK-NEXT: [[I:%.+]] = affine.apply [[IV_MAP]]([[IT]]){{\[}}[[LB]]{{\]}}
+  // CHECK-NEXT: affine.for [[J:%.+]] = 0 to 20 {
+  // CHECK-NEXT: [[LOAD:%.+]] = affine.load [[IN]]{{\[}}[[I]], [[J]]{{\]}} : memref<10x20xf32>
+  // CHECK-NEXT: [[ADD:%.+]] = addf [[LOAD]], [[CST]] : f32
+  // CHECK-NEXT: affine.store [[ADD]], [[OUT]]{{\[}}[[I]], [[J]]{{\]}} : memref<10x20xf32>
+
+  // CHECK-LABEL: func @test_parallel(
+  // CHECK: [[LB:%.+]] = affine.apply
+  // CHECK: [[UB:%.+]] = affine.apply
+  // CHECK: [[TRIP_COUNT:%.+]] = affine.apply #{{.*}}([[LB]], [[UB]])
+  // CHECK: "krnl.parallel_call"([[TRIP_COUNT]], [[LB]], %arg0, %arg1) {callee = @test_parallel_parallel_0} : (index, index, memref<10x20xf32>, memref<10x20xf32>) -> ()
+  // CHECK-NOT: affine.for
+}
+
+// -----
+
+// Scalar buffers allocated in the loop body are private to each iteration.
+func @test_parallel_private_alloc(%arg0 : memref<10x20xf32>, %arg1 : memref<10xf32>) {
+  %cst = constant 0.000000e+00 : f32
+  affine.for %i = 0 to 10 {
+    %sum = alloc() : memref<f32>
+    store %cst, %sum[] : memref<f32>
+    affine.for %j = 0 to 20 {
+      %0 = load %arg0[%i, %j] : memref<10x20xf32>
+      %1 = load %sum[] : memref<f32>
+      %2 = addf %0, %1 : f32
+      store %2, %sum[] : memref<f32>
+    }
+    %3 = load %sum[] : memref<f32>
+    store %3, %arg1[%i] : memref<10xf32>
+    dealloc %sum : memref<f32>
+  } {krnl.parallel}
+  return
+
+  // CHECK-LABEL: func @test_parallel_private_alloc_parallel_0
+  // CHECK: alloc() : memref<f32>
+  // CHECK: dealloc
+  // CHECK-LABEL: func @test_parallel_private_alloc(
+  // CHECK: "krnl.parallel_call"
+}
+
+// -----
+
+// Only the outermost of nested parallel loops is executed in parallel.
+func @test_parallel_nested(%arg0 : memref<10x20xf32>) {
+  %cst = constant 0.000000e+00 : f32
+  affine.for %i = 0 to 10 {
+    affine.for %j = 0 to 20 {
+      store %cst, %arg0[%i, %j] : memref<10x20xf32>
+    } {krnl.parallel}
+  } {krnl.parallel}
+  return
+
+  // CHECK-LABEL: func @test_parallel_nested_parallel_0
+  // CHECK: affine.for
+  // CHECK: affine.for
+  // CHECK-NOT: krnl.parallel
+  // CHECK-LABEL: func @test_parallel_nested(
+  // CHECK: "krnl.parallel_call"
+  // CHECK-NOT: krnl.parallel_call
+}
@@ -0,0 +1,25 @@
+// RUN: onnf-opt --lower-krnl-parallel --lower-all-llvm %s | FileCheck %s
+
+func @test_parallel(%arg0 : memref<10xf32>) {
+  %cst = constant 0.000000e+00 : f32
+  affine.for %i = 0 to 10 {
+    store %cst, %arg0[%i] : memref<10xf32>
+  } {krnl.parallel}
+  return
+
+  // CHECK: llvm.func @krnlParallelFor(!llvm.i64, !llvm<"void (i64, i64, i8*)*">, !llvm<"i8*">)
+  // CHECK: llvm.func @test_parallel_parallel_0_trampoline([[BEGIN:%.+]]: !llvm.i64, [[END:%.+]]: !llvm.i64, [[CONTEXT:%.+]]: !llvm<"i8*">) {
+  // CHECK: [[CONTEXT_PTR:%.+]] = llvm.bitcast [[CONTEXT]] : !llvm<"i8*"> to !llvm<"{ i64, { float*, float*, i64, [1 x i64], [1 x i64] } }*">
+  // CHECK: [[LB_PTR:%.+]] = llvm.getelementptr [[CONTEXT_PTR]]
+  // CHECK: [[LB:%.+]] = llvm.load [[LB_PTR]] : !llvm<"i64*">
+  // CHECK: [[MEMREF_PTR:%.+]] = llvm.getelementptr [[CONTEXT_PTR]]
+  // CHECK: llvm.call @_mlir_ciface_test_parallel_parallel_0([[BEGIN]], [[END]], [[LB]], [[MEMREF_PTR]])
+  // CHECK: llvm.return
+
+  // CHECK-LABEL: llvm.func @test_parallel(
+  // CHECK: [[CONTEXT_ALLOCA:%.+]] = llvm.alloca %{{.*}} x !llvm<"{ i64, { float*, float*, i64, [1 x i64], [1 x i64] } }">
+  // CHECK: llvm.store %{{.*}}, [[CONTEXT_ALLOCA]]
+  // CHECK: [[CONTEXT_ARG:%.+]] = llvm.bitcast [[CONTEXT_ALLOCA]]
+  // CHECK: [[TRAMPOLINE:%.+]] = llvm.mlir.constant(@test_parallel_parallel_0_trampoline) : !llvm<"void (i64, i64, i8*)*">
+  // CHECK: llvm.call @krnlParallelFor(%{{.*}}, [[TRAMPOLINE]], [[CONTEXT_ARG]])
+}
@@ -4,22 +4,44 @@ func @test_reshape(%arg0 : tensor<?x10xf32>, %arg1 : tensor<4xi32>) -> tensor<*x
   %0 = "onnx.Reshape"(%arg0, %arg1) : (tensor<?x10xf32>, tensor<4xi32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
 
-  // CHECK: llvm.func @llvm.memcpy.p0i8.p0i8.i64(!llvm<"i8*">, !llvm<"i8*">, !llvm.i64, !llvm.i1)
-  // CHECK: [[TMP:%.+]] = llvm.mlir.undef : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // The result is a view of the buffer of the input, with the sizes computed
+  // from the shape and the strides of the row-major layout.
+  // CHECK-NOT: llvm.memcpy
   // CHECK: llvm.insertvalue %arg0, %0[0] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: llvm.insertvalue %arg1, %1[1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: llvm.insertvalue %arg2, %2[2] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: llvm.insertvalue %arg3, %3[3, 0] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: llvm.insertvalue %arg5, %4[4, 0] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: llvm.insertvalue %arg4, %5[3, 1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: [[TMP1:%.+]] = llvm.insertvalue %arg6, %6[4, 1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: [[RES:%.+]] = llvm.insertvalue {{.*}}[4, 3] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
-  // CHECK: [[EXT_VAL_0:%.+]] = llvm.extractvalue [[RES]][1] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
-  // CHECK: [[DST:%.+]] = llvm.bitcast [[EXT_VAL_0]] : !llvm<"float*"> to !llvm<"i8*">
-  // CHECK: [[EXT_VAL_1:%.+]] = llvm.extractvalue [[TMP1]][1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
-  // CHECK: [[SRC:%.+]] = llvm.bitcast [[EXT_VAL_1]] : !llvm<"float*"> to !llvm<"i8*">
-  // CHECK: [[SIZE:%.+]] = llvm.sext %{{.*}} : !llvm.i64 to !llvm.i64
-  // CHECK: [[VOLATILE:%.+]] = llvm.mlir.constant(0 : i1) : !llvm.i1
-  // CHECK: llvm.call @llvm.memcpy.p0i8.p0i8.i64([[DST]], [[SRC]], [[SIZE]], [[VOLATILE]]) : (!llvm<"i8*">, !llvm<"i8*">, !llvm.i64, !llvm.i1) -> !llvm.void
+  // CHECK: [[SRC:%.+]] = llvm.insertvalue %arg6, %6[4, 1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK: [[UNDEF:%.+]] = llvm.mlir.undef : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
+  // CHECK: [[ALLOCATED:%.+]] = llvm.extractvalue [[SRC]][0] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK: [[VIEW0:%.+]] = llvm.insertvalue [[ALLOCATED]], [[UNDEF]][0] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
+  // CHECK: [[ALIGNED:%.+]] = llvm.extractvalue [[SRC]][1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK: [[VIEW1:%.+]] = llvm.insertvalue [[ALIGNED]], [[VIEW0]][1] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
+  // CHECK: [[OFFSET:%.+]] = llvm.extractvalue [[SRC]][2] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK: [[VIEW2:%.+]] = llvm.insertvalue [[OFFSET]], [[VIEW1]][2] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
+  // CHECK: [[STRIDE3:%.+]] = llvm.mlir.constant(1 : i64) : !llvm.i64
+  // CHECK: [[VIEW3:%.+]] = llvm.insertvalue [[SIZE3:%.+]], [[VIEW2]][3, 3] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
+  // CHECK: [[VIEW4:%.+]] = llvm.insertvalue [[STRIDE3]], [[VIEW3]][4, 3] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
+  // CHECK: [[STRIDE2:%.+]] = llvm.mul [[STRIDE3]], [[SIZE3]] : !llvm.i64
+  // CHECK: llvm.insertvalue [[STRIDE2]], %{{.+}}[4, 2] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
+  // CHECK: [[RES:%.+]] = llvm.insertvalue %{{.+}}, %{{.+}}[4, 0] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
   // CHECK: llvm.return [[RES]] : !llvm<"{ float*, float*, i64, [4 x i64], [4 x i64] }">
 }
+
+// -----
+
+func @test_memcpy(%arg0 : memref<10x10xf32>, %arg1 : memref<100xf32>) {
+  %0 = constant 400 : i64
+  "krnl.memcpy"(%arg1, %arg0, %0) : (memref<100xf32>, memref<10x10xf32>, i64) -> ()
+  return
+
+  // CHECK: llvm.func @llvm.memcpy.p0i8.p0i8.i64(!llvm<"i8*">, !llvm<"i8*">, !llvm.i64, !llvm.i1)
+  // CHECK-LABEL: llvm.func @test_memcpy
+  // CHECK: [[SRC:%.+]] = llvm.insertvalue %arg6, %{{.+}}[4, 1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK: [[DST:%.+]] = llvm.insertvalue %arg11, %{{.+}}[4, 0] : !llvm<"{ float*, float*, i64, [1 x i64], [1 x i64] }">
+  // CHECK: [[SIZE_VAL:%.+]] = llvm.mlir.constant(400 : i64) : !llvm.i64
+  // CHECK: [[EXT_VAL_0:%.+]] = llvm.extractvalue [[DST]][1] : !llvm<"{ float*, float*, i64, [1 x i64], [1 x i64] }">
+  // CHECK: [[DST_PTR:%.+]] = llvm.bitcast [[EXT_VAL_0]] : !llvm<"float*"> to !llvm<"i8*">
+  // CHECK: [[EXT_VAL_1:%.+]] = llvm.extractvalue [[SRC]][1] : !llvm<"{ float*, float*, i64, [2 x i64], [2 x i64] }">
+  // CHECK: [[SRC_PTR:%.+]] = llvm.bitcast [[EXT_VAL_1]] : !llvm<"float*"> to !llvm<"i8*">
+  // CHECK: [[SIZE:%.+]] = llvm.sext [[SIZE_VAL]] : !llvm.i64 to !llvm.i64
+  // CHECK: [[VOLATILE:%.+]] = llvm.mlir.constant(0 : i1) : !llvm.i1
+  // CHECK: llvm.call @llvm.memcpy.p0i8.p0i8.i64([[DST_PTR]], [[SRC_PTR]], [[SIZE]], [[VOLATILE]]) : (!llvm<"i8*">, !llvm<"i8*">, !llvm.i64, !llvm.i1) -> !llvm.void
+}
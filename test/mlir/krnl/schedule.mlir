@@ -0,0 +1,275 @@
+// RUN: onnf-opt --lower-krnl %s -split-input-file | FileCheck %s
+
+func @test_block(%arg0 : memref<10xf32>) {
+  %ii = krnl.define_loops 1
+  %ot, %ol = krnl.optimize_loops  {
+    %it, %il = krnl.block %ii 4
+    krnl.return_loops %it, %il
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%ot, %ol) with (%ii -> %i = 0 to 10) {
+    %0 = load %arg0[%i] : memref<10xf32>
+  }
+  return
+
+  // CHECK-DAG: [[TILE_LB:#.+]] = affine_map<(d0) -> (d0)>
+  // CHECK-DAG: [[TILE_UB:#.+]] = affine_map<(d0) -> (d0 + 4, 10)>
+  // CHECK-LABEL: test_block
+  // CHECK: affine.for [[TILE:%.+]] = 0 to 10 step 4 {
+  // CHECK-NEXT: affine.for [[I:%.+]] = [[TILE_LB]]([[TILE]]) to min [[TILE_UB]]([[TILE]]) {
+  // CHECK-NEXT: load %arg0{{\[}}[[I]]{{\]}} : memref<10xf32>
+}
+
+// -----
+
+func @test_permute(%arg0 : memref<10x20xf32>) {
+  %ii, %ij = krnl.define_loops 2
+  %oj, %oi = krnl.optimize_loops  {
+    %pj, %pi = krnl.permute(%ii, %ij) [1, 0]
+    krnl.return_loops %pj, %pi
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%oj, %oi) with (%ii -> %i = 0 to 10, %ij -> %j = 0 to 20) {
+    %0 = load %arg0[%i, %j] : memref<10x20xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_permute
+  // CHECK: affine.for [[J:%.+]] = 0 to 20 {
+  // CHECK-NEXT: affine.for [[I:%.+]] = 0 to 10 {
+  // CHECK-NEXT: load %arg0{{\[}}[[I]], [[J]]{{\]}} : memref<10x20xf32>
+}
+
+// -----
+
+func @test_tile_2d(%arg0 : memref<?x10xf32>) {
+  %N = dim %arg0, 0 : memref<?x10xf32>
+  %ii, %ij = krnl.define_loops 2
+  %oit, %ojt, %oil, %ojl = krnl.optimize_loops  {
+    %it, %il = krnl.block %ii 4
+    %jt, %jl = krnl.block %ij 8
+    %p0, %p1, %p2, %p3 = krnl.permute(%it, %il, %jt, %jl) [0, 2, 1, 3]
+    krnl.return_loops %p0, %p1, %p2, %p3
+  } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
+  krnl.iterate(%oit, %ojt, %oil, %ojl) with (%ii -> %i = 0 to %N, %ij -> %j = 0 to 10) {
+    %0 = load %arg0[%i, %j] : memref<?x10xf32>
+  }
+  return
+
+  // CHECK-DAG: [[TILE_LB:#.+]] = affine_map<(d0) -> (d0)>
+  // CHECK-DAG: [[I_UB:#.+]] = affine_map<(d0)[s0] -> (d0 + 4, s0)>
+  // CHECK-DAG: [[J_UB:#.+]] = affine_map<(d0) -> (d0 + 8, 10)>
+  // CHECK-LABEL: test_tile_2d
+  // CHECK: [[N:%.+]] = dim %arg0, 0 : memref<?x10xf32>
+  // CHECK: affine.for [[I_TILE:%.+]] = 0 to [[N]] step 4 {
+  // CHECK-NEXT: affine.for [[J_TILE:%.+]] = 0 to 10 step 8 {
+  // CHECK-NEXT: affine.for [[I:%.+]] = [[TILE_LB]]([[I_TILE]]) to min [[I_UB]]([[I_TILE]]){{\[}}[[N]]{{\]}} {
+  // CHECK-NEXT: affine.for [[J:%.+]] = [[TILE_LB]]([[J_TILE]]) to min [[J_UB]]([[J_TILE]]) {
+  // CHECK-NEXT: load %arg0{{\[}}[[I]], [[J]]{{\]}} : memref<?x10xf32>
+}
+
+// -----
+
+func @test_unroll(%arg0 : memref<8xf32>) {
+  %ii = krnl.define_loops 1
+  %oi = krnl.optimize_loops  {
+    krnl.unroll %ii 4
+    krnl.return_loops %ii
+  } : () -> !krnl.loop
+  krnl.iterate(%oi) with (%ii -> %i = 0 to 8) {
+    %0 = load %arg0[%i] : memref<8xf32>
+    %1 = addf %0, %0 : f32
+    store %1, %arg0[%i] : memref<8xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_unroll
+  // CHECK: affine.for [[I:%.+]] = 0 to 8 step 4 {
+  // CHECK-NEXT: [[LOAD0:%.+]] = load %arg0{{\[}}[[I]]{{\]}} : memref<8xf32>
+  // CHECK: [[I1:%.+]] = affine.apply #{{.*}}([[I]])
+  // CHECK-NEXT: load %arg0{{\[}}[[I1]]{{\]}} : memref<8xf32>
+  // CHECK: [[I2:%.+]] = affine.apply #{{.*}}([[I]])
+  // CHECK-NEXT: load %arg0{{\[}}[[I2]]{{\]}} : memref<8xf32>
+  // CHECK: [[I3:%.+]] = affine.apply #{{.*}}([[I]])
+  // CHECK-NEXT: load %arg0{{\[}}[[I3]]{{\]}} : memref<8xf32>
+  // CHECK-NOT: affine.for
+}
+
+// -----
+
+func @test_unroll_jam(%arg0 : memref<4x8xf32>, %arg1 : memref<4xf32>) {
+  %ii, %ik = krnl.define_loops 2
+  %oi, %ok = krnl.optimize_loops  {
+    krnl.unroll_jam %ii 2
+    krnl.return_loops %ii, %ik
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%oi) with (%ii -> %i = 0 to 4) {
+    krnl.iterate(%ok) with (%ik -> %k = 0 to 8) {
+      %0 = load %arg0[%i, %k] : memref<4x8xf32>
+      %1 = load %arg1[%i] : memref<4xf32>
+      %2 = addf %0, %1 : f32
+      store %2, %arg1[%i] : memref<4xf32>
+    }
+  }
+  return
+
+  // CHECK-LABEL: test_unroll_jam
+  // CHECK: affine.for [[I:%.+]] = 0 to 4 step 2 {
+  // CHECK-NEXT: affine.for [[K:%.+]] = 0 to 8 {
+  // CHECK-NEXT: load %arg0{{\[}}[[I]], [[K]]{{\]}} : memref<4x8xf32>
+  // CHECK: store {{.*}}, %arg1{{\[}}[[I]]{{\]}} : memref<4xf32>
+  // CHECK-NEXT: [[I1:%.+]] = affine.apply #{{.*}}([[I]])
+  // CHECK-NEXT: load %arg0{{\[}}[[I1]], [[K]]{{\]}} : memref<4x8xf32>
+  // CHECK: store {{.*}}, %arg1{{\[}}[[I1]]{{\]}} : memref<4xf32>
+  // CHECK-NEXT: }
+  // CHECK-NEXT: }
+}
+
+// -----
+
+func @test_parallel(%arg0 : memref<10x20xf32>) {
+  %ii, %ij = krnl.define_loops 2
+  %oi, %oj = krnl.optimize_loops  {
+    krnl.parallel %ii
+    krnl.return_loops %ii, %ij
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%oi, %oj) with (%ii -> %i = 0 to 10, %ij -> %j = 0 to 20) {
+    %0 = load %arg0[%i, %j] : memref<10x20xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_parallel
+  // CHECK: affine.for [[I:%.+]] = 0 to 10 {
+  // CHECK-NEXT: affine.for [[J:%.+]] = 0 to 20 {
+  // CHECK-NEXT: load %arg0{{\[}}[[I]], [[J]]{{\]}} : memref<10x20xf32>
+  // CHECK-NEXT: }
+  // CHECK-NEXT: } {krnl.parallel}
+}
+
+// -----
+
+// Iterations reading an element written by the previous one are executed
+// sequentially.
+func @test_parallel_carried_dependence(%arg0 : memref<11xf32>) {
+  %ii = krnl.define_loops 1
+  %oi = krnl.optimize_loops  {
+    krnl.parallel %ii
+    krnl.return_loops %ii
+  } : () -> !krnl.loop
+  krnl.iterate(%oi) with (%ii -> %i = 0 to 10) {
+    %0 = load %arg0[%i] : memref<11xf32>
+    %c1 = constant 1 : index
+    %1 = addi %i, %c1 : index
+    store %0, %arg0[%1] : memref<11xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_parallel_carried_dependence
+  // CHECK: affine.for
+  // CHECK-NOT: krnl.parallel
+}
+
+// -----
+
+// Stack buffers allocated in the loop body are private to each iteration.
+func @test_parallel_private_alloca(%arg0 : memref<10x8xf32>) {
+  %ii = krnl.define_loops 1
+  %oi = krnl.optimize_loops  {
+    krnl.parallel %ii
+    krnl.return_loops %ii
+  } : () -> !krnl.loop
+  krnl.iterate(%oi) with (%ii -> %i = 0 to 10) {
+    %0 = "krnl.alloca"() : () -> memref<8xf32>
+    %c0 = constant 0 : index
+    %1 = load %arg0[%i, %c0] : memref<10x8xf32>
+    store %1, %0[%c0] : memref<8xf32>
+    %2 = load %0[%c0] : memref<8xf32>
+    store %2, %arg0[%i, %c0] : memref<10x8xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_parallel_private_alloca
+  // CHECK: affine.for
+  // CHECK: "krnl.alloca"() : () -> memref<8xf32>
+  // CHECK: } {krnl.parallel}
+}
+
+// -----
+
+func @test_vectorize(%arg0 : memref<10x20xf32>, %arg1 : memref<10x20xf32>) {
+  %ii, %ij = krnl.define_loops 2
+  %oi, %oj = krnl.optimize_loops  {
+    krnl.vectorize %ij 8
+    krnl.return_loops %ii, %ij
+  } : () -> (!krnl.loop, !krnl.loop)
+  %cst = constant 1.000000e+00 : f32
+  krnl.iterate(%oi, %oj) with (%ii -> %i = 0 to 10, %ij -> %j = 0 to 20) {
+    %0 = load %arg0[%i, %j] : memref<10x20xf32>
+    %1 = addf %0, %cst : f32
+    store %1, %arg1[%i, %j] : memref<10x20xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_vectorize
+  // CHECK: [[CST:%.+]] = constant 1.000000e+00 : f32
+  // CHECK: affine.for [[I:%.+]] = 0 to 10 {
+  // CHECK-NEXT: affine.for [[J:%.+]] = 0 to 16 step 8 {
+  // CHECK: [[LOAD:%.+]] = vector.transfer_read %arg0{{\[}}{{%.+}}, {{%.+}}{{\]}}, {{%.+}} {permutation_map = {{.*}}} : memref<10x20xf32>, vector<8xf32>
+  // CHECK-NEXT: [[SPLAT:%.+]] = vector.broadcast [[CST]] : f32 to vector<8xf32>
+  // CHECK-NEXT: [[ADD:%.+]] = addf [[LOAD]], [[SPLAT]] : vector<8xf32>
+  // CHECK: vector.transfer_write [[ADD]], %arg1{{\[}}{{%.+}}, {{%.+}}{{\]}} {permutation_map = {{.*}}} : vector<8xf32>, memref<10x20xf32>
+  // CHECK-NEXT: }
+  // The remaining iterations are executed by a scalar loop.
+  // CHECK-NEXT: affine.for [[J:%.+]] = 16 to 20 {
+  // CHECK-NEXT: [[LOAD:%.+]] = affine.load %arg0{{\[}}[[I]], [[J]]{{\]}} : memref<10x20xf32>
+  // CHECK-NEXT: [[ADD:%.+]] = addf [[LOAD]], [[CST]] : f32
+  // CHECK-NEXT: affine.store [[ADD]], %arg1{{\[}}[[I]], [[J]]{{\]}} : memref<10x20xf32>
+}
+
+// -----
+
+// Loops whose iterations access memory with a non unit stride are left scalar.
+func @test_vectorize_strided(%arg0 : memref<20x10xf32>, %arg1 : memref<20x10xf32>) {
+  %ii, %ij = krnl.define_loops 2
+  %oi, %oj = krnl.optimize_loops  {
+    krnl.vectorize %ij 8
+    krnl.return_loops %ii, %ij
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%oi, %oj) with (%ii -> %i = 0 to 10, %ij -> %j = 0 to 20) {
+    %0 = load %arg0[%j, %i] : memref<20x10xf32>
+    store %0, %arg1[%j, %i] : memref<20x10xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_vectorize_strided
+  // CHECK-NOT: vector
+  // CHECK: affine.for [[J:%.+]] = 0 to 20 {
+  // CHECK-NOT: vector
+}
+
+// -----
+
+// Indices computed from the induction variables are folded into the access
+// maps, so that sliding window accesses are vectorized.
+func @test_vectorize_sliding_window(%arg0 : memref<10x22xf32>, %arg1 : memref<10x20xf32>) {
+  %ik, %ij = krnl.define_loops 2
+  %ok, %oj = krnl.optimize_loops  {
+    krnl.vectorize %ij 8
+    krnl.return_loops %ik, %ij
+  } : () -> (!krnl.loop, !krnl.loop)
+  krnl.iterate(%ok, %oj) with (%ik -> %k = 0 to 3, %ij -> %j = 0 to 16) {
+    %0 = addi %j, %k : index
+    %1 = load %arg0[%k, %0] : memref<10x22xf32>
+    %2 = load %arg1[%k, %j] : memref<10x20xf32>
+    %3 = addf %1, %2 : f32
+    store %3, %arg1[%k, %j] : memref<10x20xf32>
+  }
+  return
+
+  // CHECK-LABEL: test_vectorize_sliding_window
+  // CHECK: affine.for [[K:%.+]] = 0 to 3 {
+  // CHECK-NEXT: affine.for [[J:%.+]] = 0 to 16 step 8 {
+  // CHECK-NOT: addi
+  // CHECK: vector.transfer_read %arg0{{\[}}{{%.+}}, {{%.+}}{{\]}}, {{%.+}} {permutation_map = {{.*}}} : memref<10x22xf32>, vector<8xf32>
+  // CHECK: vector.transfer_read %arg1{{\[}}{{%.+}}, {{%.+}}{{\]}}, {{%.+}} {permutation_map = {{.*}}} : memref<10x20xf32>, vector<8xf32>
+  // CHECK: addf {{%.+}}, {{%.+}} : vector<8xf32>
+  // CHECK: vector.transfer_write
+}
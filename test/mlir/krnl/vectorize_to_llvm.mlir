@@ -0,0 +1,21 @@
+// RUN: onnf-opt --lower-all-llvm %s | FileCheck %s
+
+func @test_vectorize(%arg0 : memref<10x20xf32>, %i : index, %j : index) {
+  %cst = constant 0.000000e+00 : f32
+  %0 = vector.transfer_read %arg0[%i, %j], %cst {permutation_map = affine_map<(d0, d1) -> (d1)>} : memref<10x20xf32>, vector<8xf32>
+  vector.transfer_write %0, %arg0[%i, %j] {permutation_map = affine_map<(d0, d1) -> (d1)>} : vector<8xf32>, memref<10x20xf32>
+  return
+
+  // CHECK-DAG: llvm.func @llvm.masked.load.v8f32.p0v8f32(!llvm<"<8 x float>*">, !llvm.i32, !llvm<"<8 x i1>">, !llvm<"<8 x float>">) -> !llvm<"<8 x float>">
+  // CHECK-DAG: llvm.func @llvm.masked.store.v8f32.p0v8f32(!llvm<"<8 x float>">, !llvm<"<8 x float>*">, !llvm.i32, !llvm<"<8 x i1>">)
+  // CHECK-LABEL: llvm.func @test_vectorize
+
+  // Lanes past the end of the innermost dimension are disabled.
+  // CHECK: [[PTR:%.+]] = llvm.bitcast %{{.*}} : !llvm<"float*"> to !llvm<"<8 x float>*">
+  // CHECK: [[LANES:%.+]] = llvm.mlir.constant(dense<[0, 1, 2, 3, 4, 5, 6, 7]> : vector<8xi64>) : !llvm<"<8 x i64>">
+  // CHECK: [[REMAINING:%.+]] = llvm.sub
+  // CHECK: [[MASK:%.+]] = llvm.icmp "slt" [[LANES]], %{{.*}} : !llvm<"<8 x i64>">
+  // CHECK: [[ALIGNMENT:%.+]] = llvm.mlir.constant(4 : i32) : !llvm.i32
+  // CHECK: [[LOAD:%.+]] = llvm.call @llvm.masked.load.v8f32.p0v8f32([[PTR]], [[ALIGNMENT]], [[MASK]], %{{.*}}) : (!llvm<"<8 x float>*">, !llvm.i32, !llvm<"<8 x i1>">, !llvm<"<8 x float>">) -> !llvm<"<8 x float>">
+  // CHECK: llvm.call @llvm.masked.store.v8f32.p0v8f32([[LOAD]], %{{.*}}, %{{.*}}, %{{.*}}) : (!llvm<"<8 x float>">, !llvm<"<8 x float>*">, !llvm.i32, !llvm<"<8 x i1>">) -> ()
+}
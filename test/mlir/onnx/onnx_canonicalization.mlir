@@ -46,13 +46,21 @@ func @test_constant_pad(%arg0 : tensor<?x?xf32>) -> tensor<*xf32> {
   "std.return"(%2) : (tensor<*xf32>) -> ()
 }
 
-// CHECK-LABEL: @test_conv_split(%{{.*}}: tensor<1x9x32x64xf32>, %{{.*}}: tensor<5x9x6x7xf32>) -> tensor<*xf32> {
-func @test_conv_split(%arg0 : tensor<1x9x32x64xf32>, %arg1 : tensor<5x9x6x7xf32>) -> tensor<*xf32> {
+// CHECK-LABEL: @test_constant_pad_dense(%{{.*}}: tensor<?x?xf32>) -> tensor<*xf32> {
+func @test_constant_pad_dense(%arg0 : tensor<?x?xf32>) -> tensor<*xf32> {
+  // CHECK-NEXT: [[SQUARE:%.+]] = "onnx.PadConstantValuePad"(%arg0) {constant_value = 0.000000e+00 : f32, mode = "constant", pads = [0, 2, 0, 0]} : (tensor<?x?xf32>) -> tensor<*xf32>
+  %0 = "onnx.Constant"() {value = dense<[0, 2, 0, 0]> : tensor<4xi64>} : () -> tensor<4xi64>
+  %2 = "onnx.PadConstantValue"(%arg0, %0) {constant_value=0. : f32, mode = "constant"} : (tensor<?x?xf32>, tensor<4xi64>)-> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+}
+
+// Padded convolutions are lowered without materializing the padding.
+// CHECK-LABEL: @test_conv_pads_kept(%{{.*}}: tensor<1x9x32x64xf32>, %{{.*}}: tensor<5x9x6x7xf32>) -> tensor<*xf32> {
+func @test_conv_pads_kept(%arg0 : tensor<1x9x32x64xf32>, %arg1 : tensor<5x9x6x7xf32>) -> tensor<*xf32> {
   %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64, pads = [2, 3, 4, 5]} : (tensor<1x9x32x64xf32>, tensor<5x9x6x7xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
-  // CHECK-NEXT: %0 = "onnx.PadConstantValuePad"(%arg0) {constant_value = 0.000000e+00 : f32, mode = "constant", pads = [0, 0, 2, 3, 0, 0, 4, 5]} : (tensor<1x9x32x64xf32>) -> tensor<1x9x38x72xf32>
-  // CHECK-NEXT: %1 = "onnx.ConvNoBias"(%0, %arg1) {auto_pad = "NOTSET", group = 1 : i64, pads = [0, 0, 0, 0]} : (tensor<1x9x38x72xf32>, tensor<5x9x6x7xf32>) -> tensor<*xf32>
-  // CHECK-NEXT: return %1 : tensor<*xf32>
+  // CHECK-NEXT: %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64, pads = [2, 3, 4, 5]} : (tensor<1x9x32x64xf32>, tensor<5x9x6x7xf32>) -> tensor<*xf32>
+  // CHECK-NEXT: return %0 : tensor<*xf32>
 }
 
 //CHECK-LABEL: @test_gemm_add_fusion(%{{.*}}: tensor<128x128xf32>, %{{.*}}: tensor<128x128xf32>, %{{.*}}: tensor<128xf32>) -> tensor<*xf32> {
@@ -77,23 +85,101 @@ func @test_gemm_add_fusion_rank3(%arg0: tensor<128x128x256xf32>, %arg1: tensor<1
   // return [[GEMM]] : tensor<*xf32>
 }
 
-//CHECK-LABEL: @test_maxpoolsingleout_split(%{{.*}}: tensor<5x5x32x32xf32>) -> tensor<5x8x32x39xf32> {
-func @test_maxpoolsingleout_split(%arg0: tensor<5x5x32x32xf32>) -> tensor<5x8x32x39xf32> {
-  %0 = "onnx.MaxPoolSingleOut"(%arg0) {auto_pad = "NOTSET", ceil_mode = 0, kernel_shape = [5,3], pads = [1, 2, 3, 4] } : (tensor<5x5x32x32xf32>) -> tensor<5x8x32x39xf32>
-  "std.return"(%0) : (tensor<5x8x32x39xf32>) -> ()
+// Padded poolings are lowered without materializing the padding.
+//CHECK-LABEL: @test_maxpoolsingleout_pads_kept(%{{.*}}: tensor<5x5x32x32xf32>) -> tensor<5x5x32x36xf32> {
+func @test_maxpoolsingleout_pads_kept(%arg0: tensor<5x5x32x32xf32>) -> tensor<5x5x32x36xf32> {
+  %0 = "onnx.MaxPoolSingleOut"(%arg0) {auto_pad = "NOTSET", ceil_mode = 0, kernel_shape = [5,3], pads = [1, 2, 3, 4] } : (tensor<5x5x32x32xf32>) -> tensor<5x5x32x36xf32>
+  "std.return"(%0) : (tensor<5x5x32x36xf32>) -> ()
 
-  // CHECK-NEXT: %0 = "onnx.PadConstantValuePad"(%arg0) {constant_value = 0xFF800000 : f32, mode = "constant", pads = [0, 0, 1, 2, 0, 0, 3, 4]} : (tensor<5x5x32x32xf32>) -> tensor<5x8x32x39xf32>
-  // CHECK-NEXT: %1 = "onnx.MaxPoolSingleOut"(%0) {auto_pad = "NOTSET", ceil_mode = 0 : i64, kernel_shape = [5, 3], pads = [0, 0, 0, 0], storage_order = 0 : i64} : (tensor<5x8x32x39xf32>) -> tensor<5x8x32x39xf32>
-  // CHECK-NEXT: return %1 : tensor<5x8x32x39xf32>
+  // CHECK-NEXT: %0 = "onnx.MaxPoolSingleOut"(%arg0) {auto_pad = "NOTSET", ceil_mode = 0 : i64, kernel_shape = [5, 3], pads = [1, 2, 3, 4]} : (tensor<5x5x32x32xf32>) -> tensor<5x5x32x36xf32>
+  // CHECK-NEXT: return %0 : tensor<5x5x32x36xf32>
 }
 
-//CHECK-LABEL: @test_maxpoolsingleout_split_unknown_dims(%{{.*}}: tensor<*xf32>) -> tensor<*xf32> {
-func @test_maxpoolsingleout_split_unknown_dims(%arg0: tensor<*xf32>) -> tensor<*xf32> {
-  %0 = "onnx.MaxPoolSingleOut"(%arg0) {auto_pad = "NOTSET", ceil_mode = 0, kernel_shape = [5,3], pads = [1, 2, 3, 4] } : (tensor<*xf32>) -> tensor<*xf32>
-  "std.return"(%0) : (tensor<*xf32>) -> ()
 
-  // CHECK-NEXT: %0 = "onnx.PadConstantValuePad"(%arg0) {constant_value = 0xFF800000 : f32, mode = "constant", pads = [0, 0, 1, 2, 0, 0, 3, 4]} : (tensor<*xf32>) -> tensor<*xf32>
-  // CHECK-NEXT: %1 = "onnx.MaxPoolSingleOut"(%0) {auto_pad = "NOTSET", ceil_mode = 0 : i64, kernel_shape = [5, 3], pads = [0, 0, 0, 0], storage_order = 0 : i64} : (tensor<*xf32>) -> tensor<*xf32>
-  // CHECK-NEXT: return %1 : tensor<*xf32>
+// Constant kernels are converted to the OIHWio layout at compile time.
+//CHECK-LABEL: @test_constant_kernel_layout_transform() -> tensor<1x1x1x1x2x2xf32> {
+func @test_constant_kernel_layout_transform() -> tensor<1x1x1x1x2x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[[[1.000000e+00]], [[2.000000e+00]]], [[[3.000000e+00]], [[4.000000e+00]]]]> : tensor<2x2x1x1xf32>} : () -> tensor<2x2x1x1xf32>
+  %1 = "onnx.LayoutTransform"(%0) {channel_block = 2 : i64, target_layout = "OIHWio"} : (tensor<2x2x1x1xf32>) -> tensor<1x1x1x1x2x2xf32>
+  "std.return"(%1) : (tensor<1x1x1x1x2x2xf32>) -> ()
+
+  // CHECK-NEXT: [[KERNELS:%.+]] = "onnx.Constant"() {value = dense<{{\[}}{{\[}}{{\[}}{{\[}}{{\[}}[1.000000e+00, 3.000000e+00], [2.000000e+00, 4.000000e+00]]]]]]> : tensor<1x1x1x1x2x2xf32>} : () -> tensor<1x1x1x1x2x2xf32>
+  // CHECK-NEXT: return [[KERNELS]] : tensor<1x1x1x1x2x2xf32>
+}
+
+// Activations following a convolution are fused into its epilogue.
+//CHECK-LABEL: @test_conv_no_bias_relu_fusion(%{{.*}}: tensor<1x2x32x64xf32>, %{{.*}}: tensor<5x2x6x7xf32>) -> tensor<1x5x27x58xf32> {
+func @test_conv_no_bias_relu_fusion(%arg0 : tensor<1x2x32x64xf32>, %arg1 : tensor<5x2x6x7xf32>) -> tensor<1x5x27x58xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>) -> tensor<1x5x27x58xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<1x5x27x58xf32>) -> tensor<1x5x27x58xf32>
+  "std.return"(%1) : (tensor<1x5x27x58xf32>) -> ()
+
+  // CHECK-NEXT: [[NONE:%.+]] = constant unit
+  // CHECK-NEXT: [[CONV:%.+]] = "onnx.ConvActivation"(%arg0, %arg1, [[NONE]]) {activation = "Relu", activation_alpha = 0.000000e+00 : f32, activation_beta = 0.000000e+00 : f32, auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>, none) -> tensor<1x5x27x58xf32>
+  // CHECK-NEXT: return [[CONV]] : tensor<1x5x27x58xf32>
+}
+
+//CHECK-LABEL: @test_conv_leakyrelu_fusion(%{{.*}}: tensor<1x2x32x64xf32>, %{{.*}}: tensor<5x2x6x7xf32>, %{{.*}}: tensor<5xf32>) -> tensor<1x5x27x58xf32> {
+func @test_conv_leakyrelu_fusion(%arg0 : tensor<1x2x32x64xf32>, %arg1 : tensor<5x2x6x7xf32>, %arg2 : tensor<5xf32>) -> tensor<1x5x27x58xf32> {
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>, tensor<5xf32>) -> tensor<1x5x27x58xf32>
+  %1 = "onnx.LeakyRelu"(%0) {alpha = 5.000000e-01 : f32} : (tensor<1x5x27x58xf32>) -> tensor<1x5x27x58xf32>
+  "std.return"(%1) : (tensor<1x5x27x58xf32>) -> ()
+
+  // CHECK-NEXT: [[CONV:%.+]] = "onnx.ConvActivation"(%arg0, %arg1, %arg2) {activation = "LeakyRelu", activation_alpha = 5.000000e-01 : f32, activation_beta = 0.000000e+00 : f32, auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>, tensor<5xf32>) -> tensor<1x5x27x58xf32>
+  // CHECK-NEXT: return [[CONV]] : tensor<1x5x27x58xf32>
+}
+
+// Clip is only fused when its bounds are constants.
+//CHECK-LABEL: @test_conv_clip_fusion(%{{.*}}: tensor<1x2x32x64xf32>, %{{.*}}: tensor<5x2x6x7xf32>, %{{.*}}: tensor<5xf32>) -> tensor<1x5x27x58xf32> {
+func @test_conv_clip_fusion(%arg0 : tensor<1x2x32x64xf32>, %arg1 : tensor<5x2x6x7xf32>, %arg2 : tensor<5xf32>) -> tensor<1x5x27x58xf32> {
+  %min = "onnx.Constant"() {value = dense<0.000000e+00> : tensor<f32>} : () -> tensor<f32>
+  %max = "onnx.Constant"() {value = dense<6.000000e+00> : tensor<f32>} : () -> tensor<f32>
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>, tensor<5xf32>) -> tensor<1x5x27x58xf32>
+  %1 = "onnx.Clip"(%0, %min, %max) : (tensor<1x5x27x58xf32>, tensor<f32>, tensor<f32>) -> tensor<1x5x27x58xf32>
+  "std.return"(%1) : (tensor<1x5x27x58xf32>) -> ()
+
+  // CHECK-NOT: "onnx.Clip"
+  // CHECK: [[CONV:%.+]] = "onnx.ConvActivation"(%arg0, %arg1, %arg2) {activation = "Clip", activation_alpha = 0.000000e+00 : f32, activation_beta = 6.000000e+00 : f32, auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>, tensor<5xf32>) -> tensor<1x5x27x58xf32>
+  // CHECK-NEXT: return [[CONV]] : tensor<1x5x27x58xf32>
+}
+
+//CHECK-LABEL: @test_conv_clip_no_fusion(%{{.*}}: tensor<1x2x32x64xf32>, %{{.*}}: tensor<5x2x6x7xf32>, %{{.*}}: tensor<5xf32>, %{{.*}}: tensor<f32>, %{{.*}}: tensor<f32>) -> tensor<1x5x27x58xf32> {
+func @test_conv_clip_no_fusion(%arg0 : tensor<1x2x32x64xf32>, %arg1 : tensor<5x2x6x7xf32>, %arg2 : tensor<5xf32>, %arg3 : tensor<f32>, %arg4 : tensor<f32>) -> tensor<1x5x27x58xf32> {
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>, tensor<5xf32>) -> tensor<1x5x27x58xf32>
+  %1 = "onnx.Clip"(%0, %arg3, %arg4) : (tensor<1x5x27x58xf32>, tensor<f32>, tensor<f32>) -> tensor<1x5x27x58xf32>
+  "std.return"(%1) : (tensor<1x5x27x58xf32>) -> ()
+
+  // CHECK-NEXT: [[CONV:%.+]] = "onnx.Conv"(%arg0, %arg1, %arg2)
+  // CHECK-NEXT: [[CLIP:%.+]] = "onnx.Clip"([[CONV]], %arg3, %arg4)
+  // CHECK-NEXT: return [[CLIP]] : tensor<1x5x27x58xf32>
+}
+
+// A batch normalization following a convolution of constant weights is folded into the weights.
+//CHECK-LABEL: @test_conv_batchnorm_fusion(%{{.*}}: tensor<1x2x4x4xf32>) -> tensor<1x2x4x4xf32> {
+func @test_conv_batchnorm_fusion(%arg0 : tensor<1x2x4x4xf32>) -> tensor<1x2x4x4xf32> {
+  %weights = "onnx.Constant"() {value = dense<1.000000e+00> : tensor<2x2x1x1xf32>} : () -> tensor<2x2x1x1xf32>
+  %scale = "onnx.Constant"() {value = dense<2.000000e+00> : tensor<2xf32>} : () -> tensor<2xf32>
+  %bias = "onnx.Constant"() {value = dense<1.000000e+00> : tensor<2xf32>} : () -> tensor<2xf32>
+  %mean = "onnx.Constant"() {value = dense<[0.000000e+00, 1.000000e+00]> : tensor<2xf32>} : () -> tensor<2xf32>
+  %var = "onnx.Constant"() {value = dense<[3.000000e+00, 1.500000e+01]> : tensor<2xf32>} : () -> tensor<2xf32>
+  %0 = "onnx.ConvNoBias"(%arg0, %weights) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x4x4xf32>, tensor<2x2x1x1xf32>) -> tensor<1x2x4x4xf32>
+  %1 = "onnx.BatchNormalizationTestMode"(%0, %scale, %bias, %mean, %var) {epsilon = 1.000000e+00 : f32} : (tensor<1x2x4x4xf32>, tensor<2xf32>, tensor<2xf32>, tensor<2xf32>, tensor<2xf32>) -> tensor<1x2x4x4xf32>
+  "std.return"(%1) : (tensor<1x2x4x4xf32>) -> ()
+
+  // CHECK-NOT: "onnx.BatchNormalizationTestMode"
+  // CHECK-DAG: [[WEIGHTS:%.+]] = "onnx.Constant"() {value = dense<{{\[}}{{\[}}{{\[}}[1.000000e+00]], {{\[}}[1.000000e+00]]], {{\[}}{{\[}}[5.000000e-01]], {{\[}}[5.000000e-01]]]]> : tensor<2x2x1x1xf32>} : () -> tensor<2x2x1x1xf32>
+  // CHECK-DAG: [[BIAS:%.+]] = "onnx.Constant"() {value = dense<[1.000000e+00, 5.000000e-01]> : tensor<2xf32>} : () -> tensor<2xf32>
+  // CHECK: [[CONV:%.+]] = "onnx.Conv"(%arg0, [[WEIGHTS]], [[BIAS]]) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x4x4xf32>, tensor<2x2x1x1xf32>, tensor<2xf32>) -> tensor<1x2x4x4xf32>
+  // CHECK-NEXT: return [[CONV]] : tensor<1x2x4x4xf32>
 }
 
+//CHECK-LABEL: @test_conv_batchnorm_no_fusion(%{{.*}}: tensor<1x2x4x4xf32>, %{{.*}}: tensor<2x2x1x1xf32>, %{{.*}}: tensor<2xf32>) -> tensor<1x2x4x4xf32> {
+func @test_conv_batchnorm_no_fusion(%arg0 : tensor<1x2x4x4xf32>, %arg1 : tensor<2x2x1x1xf32>, %arg2 : tensor<2xf32>) -> tensor<1x2x4x4xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x4x4xf32>, tensor<2x2x1x1xf32>) -> tensor<1x2x4x4xf32>
+  %1 = "onnx.BatchNormalizationTestMode"(%0, %arg2, %arg2, %arg2, %arg2) : (tensor<1x2x4x4xf32>, tensor<2xf32>, tensor<2xf32>, tensor<2xf32>, tensor<2xf32>) -> tensor<1x2x4x4xf32>
+  "std.return"(%1) : (tensor<1x2x4x4xf32>) -> ()
+
+  // CHECK-NEXT: [[CONV:%.+]] = "onnx.ConvNoBias"(%arg0, %arg1)
+  // CHECK-NEXT: [[BN:%.+]] = "onnx.BatchNormalizationTestMode"([[CONV]], %arg2, %arg2, %arg2, %arg2)
+  // CHECK-NEXT: return [[BN]] : tensor<1x2x4x4xf32>
+}
@@ -0,0 +1,100 @@
+// RUN: onnf-opt --fuse-elementwise %s -split-input-file | FileCheck %s
+
+// CHECK-LABEL: func @test_fuse_swish
+func @test_fuse_swish(%arg0 : tensor<10x10xf32>) -> tensor<10x10xf32> {
+  %0 = "onnx.Sigmoid"(%arg0) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  %1 = "onnx.Mul"(%arg0, %0) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  "std.return"(%1) : (tensor<10x10xf32>) -> ()
+
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"(%arg0)
+  // CHECK: ^bb0([[X:%[a-z0-9]+]]: tensor<10x10xf32>):
+  // CHECK: [[SIGMOID:%.+]] = "onnx.Sigmoid"([[X]]) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK: [[MUL:%.+]] = "onnx.Mul"([[X]], [[SIGMOID]]) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK: "onnx.Yield"([[MUL]]) : (tensor<10x10xf32>) -> ()
+  // CHECK: }) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK: return [[FUSED]] : tensor<10x10xf32>
+}
+
+// -----
+
+// Inputs of static shapes are broadcasted to the result.
+// CHECK-LABEL: func @test_fuse_chain_broadcast
+func @test_fuse_chain_broadcast(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>, %arg2 : tensor<10x10xf32>, %arg3 : tensor<10xf32>) -> tensor<10x10xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  %1 = "onnx.Mul"(%0, %arg2) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  %2 = "onnx.Add"(%1, %arg3) : (tensor<10x10xf32>, tensor<10xf32>) -> tensor<10x10xf32>
+  "std.return"(%2) : (tensor<10x10xf32>) -> ()
+
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"(%arg0, %arg1, %arg2, %arg3)
+  // CHECK: ^bb0([[A:%[a-z0-9]+]]: tensor<10x10xf32>, [[B:%[a-z0-9]+]]: tensor<10x10xf32>, [[C:%[a-z0-9]+]]: tensor<10x10xf32>, [[D:%[a-z0-9]+]]: tensor<10xf32>):
+  // CHECK: [[ADD:%.+]] = "onnx.Add"([[A]], [[B]])
+  // CHECK: [[MUL:%.+]] = "onnx.Mul"([[ADD]], [[C]])
+  // CHECK: [[RES:%.+]] = "onnx.Add"([[MUL]], [[D]]) : (tensor<10x10xf32>, tensor<10xf32>) -> tensor<10x10xf32>
+  // CHECK: "onnx.Yield"([[RES]]) : (tensor<10x10xf32>) -> ()
+  // CHECK: }) : (tensor<10x10xf32>, tensor<10x10xf32>, tensor<10x10xf32>, tensor<10xf32>) -> tensor<10x10xf32>
+  // CHECK: return [[FUSED]] : tensor<10x10xf32>
+}
+
+// -----
+
+// A value used several times within the graph is fused once all its users
+// are.
+// CHECK-LABEL: func @test_fuse_dag
+func @test_fuse_dag(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<10x10xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  %2 = "onnx.Sigmoid"(%0) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  %3 = "onnx.Mul"(%1, %2) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  "std.return"(%3) : (tensor<10x10xf32>) -> ()
+
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"(%arg0, %arg1)
+  // CHECK: [[ADD:%.+]] = "onnx.Add"
+  // CHECK: [[RELU:%.+]] = "onnx.Relu"([[ADD]])
+  // CHECK: [[SIGMOID:%.+]] = "onnx.Sigmoid"([[ADD]])
+  // CHECK: [[MUL:%.+]] = "onnx.Mul"([[RELU]], [[SIGMOID]])
+  // CHECK: "onnx.Yield"([[MUL]])
+  // CHECK: return [[FUSED]] : tensor<10x10xf32>
+}
+
+// -----
+
+// Values used outside of the graph, or of another shape than its result,
+// are inputs of the graph.
+// CHECK-LABEL: func @test_partial_fusion
+func @test_partial_fusion(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10xf32>) -> (tensor<10x10xf32>, tensor<10x10xf32>) {
+  %0 = "onnx.Relu"(%arg0) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  %1 = "onnx.Exp"(%0) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  %2 = "onnx.Relu"(%arg1) : (tensor<10xf32>) -> tensor<10xf32>
+  %3 = "onnx.Add"(%1, %2) : (tensor<10x10xf32>, tensor<10xf32>) -> tensor<10x10xf32>
+  "std.return"(%0, %3) : (tensor<10x10xf32>, tensor<10x10xf32>) -> ()
+
+  // CHECK: [[RELU:%.+]] = "onnx.Relu"(%arg0)
+  // CHECK: [[RELU_BIAS:%.+]] = "onnx.Relu"(%arg1)
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"([[RELU]], [[RELU_BIAS]])
+  // CHECK: ^bb0([[X:%[a-z0-9]+]]: tensor<10x10xf32>, [[BIAS:%[a-z0-9]+]]: tensor<10xf32>):
+  // CHECK: [[EXP:%.+]] = "onnx.Exp"([[X]])
+  // CHECK: [[ADD:%.+]] = "onnx.Add"([[EXP]], [[BIAS]])
+  // CHECK: "onnx.Yield"([[ADD]])
+  // CHECK: return [[RELU]], [[FUSED]] : tensor<10x10xf32>, tensor<10x10xf32>
+}
+
+// -----
+
+// Inputs with dynamic dimensions may be broadcasted to one another at
+// runtime, so a single one of them is fused into a graph.
+// CHECK-LABEL: func @test_fuse_dynamic
+func @test_fuse_dynamic(%arg0 : tensor<?x4xf32>, %arg1 : tensor<?x4xf32>, %arg2 : tensor<4xf32>) -> tensor<?x4xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<?x4xf32>, tensor<?x4xf32>) -> tensor<?x4xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<?x4xf32>) -> tensor<?x4xf32>
+  %2 = "onnx.Mul"(%1, %arg2) : (tensor<?x4xf32>, tensor<4xf32>) -> tensor<?x4xf32>
+  "std.return"(%2) : (tensor<?x4xf32>) -> ()
+
+  // CHECK: [[ADD:%.+]] = "onnx.Add"(%arg0, %arg1) : (tensor<?x4xf32>, tensor<?x4xf32>) -> tensor<?x4xf32>
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"([[ADD]], %arg2)
+  // CHECK: ^bb0([[X:%[a-z0-9]+]]: tensor<?x4xf32>, [[B:%[a-z0-9]+]]: tensor<4xf32>):
+  // CHECK: [[RELU:%.+]] = "onnx.Relu"([[X]]) : (tensor<?x4xf32>) -> tensor<?x4xf32>
+  // CHECK: [[MUL:%.+]] = "onnx.Mul"([[RELU]], [[B]]) : (tensor<?x4xf32>, tensor<4xf32>) -> tensor<?x4xf32>
+  // CHECK: "onnx.Yield"([[MUL]]) : (tensor<?x4xf32>) -> ()
+  // CHECK: }) : (tensor<?x4xf32>, tensor<4xf32>) -> tensor<?x4xf32>
+  // CHECK: return [[FUSED]] : tensor<?x4xf32>
+}
@@ -1,4 +1,4 @@
-// RUN: onnf-opt --shape-inference --lower-frontend %s -split-input-file | FileCheck %s
+// RUN: onnf-opt --shape-inference --lower-frontend --math-max-ulps=0 --collapse-elementwise-loops=false --elementwise-in-place=false %s -split-input-file | FileCheck %s
 
 func @test_add(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<*xf32> {
   %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<*xf32>
@@ -8,6 +8,8 @@ func @test_add(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<*
   // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
   // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
   // CHECK: [[OPT_LOOPS:%.+]]:2 = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#0
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]]#1 8
   // CHECK:   krnl.return_loops [[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1
   // CHECK: } : () -> (!krnl.loop, !krnl.loop)
   // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 10) {
@@ -363,9 +365,56 @@ func @test_reshape(%arg0 : tensor<?x10xf32>, %arg1 : tensor<4xi32>) -> tensor<*x
   // CHECK: [[SELECT_5:%.+]] = select [[CMP_5]], [[DIVISIGNED_3]], [[ZEXTI_3]] : i64
   // CHECK: [[CAST_3:%.+]] = index_cast [[SELECT_5]] : i64 to index
 
-  // CHECK: [[ALLOC:%.+]] = alloc([[CAST_0]], [[CAST_1]], [[CAST_2]], [[CAST_3]]) : memref<?x?x?x?xf32>
-  // CHECK: "krnl.memcpy"([[ALLOC]], %arg0, [[TENSOR_SIZE]]) : (memref<?x?x?x?xf32>, memref<?x10xf32>, i64) -> ()
-  // CHECK: return [[ALLOC]] : memref<?x?x?x?xf32>
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0, [[CAST_0]], [[CAST_1]], [[CAST_2]], [[CAST_3]]) : (memref<?x10xf32>, index, index, index, index) -> memref<?x?x?x?xf32>
+  // CHECK-NOT: krnl.memcpy
+  // CHECK: return [[VIEW]] : memref<?x?x?x?xf32>
+}
+
+func @test_reshape_returned_buffer(%arg0 : tensor<10x10xf32>, %arg1 : tensor<2xi64>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Unsqueeze"(%0) {axes=[0]} : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Reshape"(%1, %arg1) : (tensor<*xf32>, tensor<2xi64>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // The returned view owns the buffer it aliases, which is not deallocated.
+  // CHECK-LABEL: test_reshape_returned_buffer
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[VIEW0:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<1x10x10xf32>
+  // CHECK: [[VIEW1:%.+]] = "krnl.reshape"([[VIEW0]], %{{.+}}, %{{.+}}) : (memref<1x10x10xf32>, index, index) -> memref<?x?xf32>
+  // CHECK-NOT: dealloc
+  // CHECK: return [[VIEW1]] : memref<?x?xf32>
+}
+
+func @test_reshape_local_buffer(%arg0 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Unsqueeze"(%0) {axes=[0]} : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Exp"(%1) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // The view is used within the function: the buffer it aliases is
+  // deallocated after its last use.
+  // CHECK-LABEL: test_reshape_local_buffer
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x10x10xf32>
+  // CHECK: [[RELU:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"([[RELU]]) : (memref<10x10xf32>) -> memref<1x10x10xf32>
+  // CHECK: load [[VIEW]]
+  // CHECK: dealloc [[RELU]] : memref<10x10xf32>
+  // CHECK: return [[RES]] : memref<1x10x10xf32>
+}
+
+func @test_reshape_aliased_buffer(%arg0 : tensor<10x10xf32>) -> (tensor<*xf32>, tensor<*xf32>) {
+  %0 = "onnx.Relu"(%arg0) : (tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Unsqueeze"(%0) {axes=[0]} : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> ()
+
+  // The buffer is already returned: the view would not own it, and it is
+  // copied instead.
+  // CHECK-LABEL: test_reshape_aliased_buffer
+  // CHECK: [[COPY:%.+]] = alloc() : memref<1x10x10xf32>
+  // CHECK: [[RELU:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: "krnl.memcpy"([[COPY]], [[RELU]], %{{.+}}) : (memref<1x10x10xf32>, memref<10x10xf32>, i64) -> ()
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RELU]], [[COPY]] : memref<10x10xf32>, memref<1x10x10xf32>
 }
 
 func @test_sum(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<*xf32> {
@@ -602,22 +651,67 @@ func @test_add_with_broadcasting(%arg0 : tensor<?xf32>, %arg1 : tensor<?x10xf32>
   // CHECK: [[DIM2:%.+]] = dim %arg0, 0 : memref<?xf32>
   // CHECK: [[ONE:%.+]] = constant 1 : index
   // CHECK: [[IS_ONE:%.+]] = cmpi "eq", [[DIM2]], [[ONE]] : index
+  // CHECK: loop.if [[IS_ONE]] {
   // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
   // CHECK: [[OPT_LOOPS:%.+]]:2 = krnl.optimize_loops  {
   // CHECK: krnl.return_loops [[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1
   // CHECK: } : () -> (!krnl.loop, !krnl.loop)
   // CHECK: [[DIM3:%.+]] = dim [[RES]], 0 : memref<?x10xf32>
   // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to [[DIM3]], [[DEF_LOOPS]]#1 -> %arg3 = 0 to 10) {
+  // CHECK-NOT: select
   // CHECK: [[ZERO:%.+]] = constant 0 : index
-  // CHECK: %[[SELECT1:.+]] = select [[IS_ONE]], [[ZERO]], %arg3 : index
-  // CHECK: [[LOAD1:%.+]] = load %arg0[%[[SELECT1]]] : memref<?xf32>
+  // CHECK: [[LOAD1:%.+]] = load %arg0{{\[}}[[ZERO]]{{\]}} : memref<?xf32>
   // CHECK: [[LOAD2:%.+]] = load %arg1[%arg2, %arg3] : memref<?x10xf32>
   // CHECK: [[ADD:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
   // CHECK: store [[ADD]], [[RES]][%arg2, %arg3] : memref<?x10xf32>
+  // CHECK: } else {
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: [[OPT_LOOPS:%.+]]:2 = krnl.optimize_loops  {
+  // CHECK: krnl.return_loops [[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1
+  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[DIM3:%.+]] = dim [[RES]], 0 : memref<?x10xf32>
+  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %[[I:[a-z0-9]+]] = 0 to [[DIM3]], [[DEF_LOOPS]]#1 -> %[[J:[a-z0-9]+]] = 0 to 10) {
+  // CHECK-NOT: select
+  // CHECK: [[LOAD1:%.+]] = load %arg0[%[[J]]] : memref<?xf32>
+  // CHECK: [[LOAD2:%.+]] = load %arg1[%[[I]], %[[J]]] : memref<?x10xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[ADD]], [[RES]][%[[I]], %[[J]]] : memref<?x10xf32>
+  // CHECK: }
   // CHECK: }
   // CHECK: return [[RES]] : memref<?x10xf32>
 }
 
+// With too many combinations of broadcasted dimensions, only the loop nest
+// where no dimension is broadcasted is specialized.
+func @test_add_with_dynamic_broadcasting(%arg0 : tensor<?x?xf32>, %arg1 : tensor<?x?xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<?x?xf32>, tensor<?x?xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_with_dynamic_broadcasting
+  // CHECK: [[RES:%.+]] = alloc({{.*}}) : memref<?x?xf32>
+  // CHECK: [[IS_ONE_0:%.+]] = cmpi "eq", {{.*}} : index
+  // CHECK: [[IS_ONE_1:%.+]] = cmpi "eq", {{.*}} : index
+  // CHECK: [[IS_ONE_2:%.+]] = cmpi "eq", {{.*}} : index
+  // CHECK: [[IS_ONE_3:%.+]] = cmpi "eq", {{.*}} : index
+  // CHECK: [[OR_0:%.+]] = or [[IS_ONE_0]], [[IS_ONE_1]] : i1
+  // CHECK: [[OR_1:%.+]] = or [[OR_0]], [[IS_ONE_2]] : i1
+  // CHECK: [[IS_BROADCASTED:%.+]] = or [[OR_1]], [[IS_ONE_3]] : i1
+  // CHECK: loop.if [[IS_BROADCASTED]] {
+  // CHECK: krnl.iterate
+  // CHECK: select [[IS_ONE_1]]
+  // CHECK: select [[IS_ONE_0]]
+  // CHECK: select [[IS_ONE_3]]
+  // CHECK: select [[IS_ONE_2]]
+  // CHECK: } else {
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %[[I:[a-z0-9]+]] = 0 to {{.*}}, {{.*}} -> %[[J:[a-z0-9]+]] = 0 to {{.*}}) {
+  // CHECK-NOT: select
+  // CHECK: [[LOAD1:%.+]] = load %arg0[%[[I]], %[[J]]] : memref<?x?xf32>
+  // CHECK: [[LOAD2:%.+]] = load %arg1[%[[I]], %[[J]]] : memref<?x?xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[ADD]], [[RES]][%[[I]], %[[J]]] : memref<?x?xf32>
+  // CHECK: return [[RES]] : memref<?x?xf32>
+}
+
 func @test_reducemax(%arg0 : tensor<3x2x2xf32>) -> tensor<*xf32> {
   %0 ="onnx.ReduceMax"(%arg0) {axes=[1], keepdims = 0 : i64} : (tensor<3x2x2xf32>)-> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -727,50 +821,208 @@ func @test_reducesum(%arg0 : tensor<3x2x2xf32>) -> tensor<*xf32> {
   // CHECK: }
   // CHECK: return [[RES]] : memref<3x2xf32>
 }
+
+
+func @test_reducesum_channels(%arg0 : tensor<2x16x4x32xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceSum"(%arg0) {axes=[1], keepdims = 1 : i64} : (tensor<2x16x4x32xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducesum_channels
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x1x4x32xf32>
+  // CHECK: [[INIT_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[INIT_LOOPS]]#0
+  // CHECK:   krnl.vectorize [[INIT_LOOPS]]#3 8
+  // CHECK: krnl.iterate({{.*}}) with ([[INIT_LOOPS]]#0 -> %{{.*}} = 0 to 2, [[INIT_LOOPS]]#1 -> %{{.*}} = 0 to 1, [[INIT_LOOPS]]#2 -> %{{.*}} = 0 to 4, [[INIT_LOOPS]]#3 -> %{{.*}} = 0 to 32) {
+
+  // The rows of the result along the innermost dimension accumulate the rows
+  // of the input, in the order of the input.
+  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[LOOPS]]#0
+  // CHECK:   krnl.vectorize [[LOOPS]]#3 8
+  // CHECK: krnl.iterate({{.*}}) with ([[LOOPS]]#0 -> %[[N:[a-z0-9]+]] = 0 to 2, [[LOOPS]]#1 -> %[[C:[a-z0-9]+]] = 0 to 16, [[LOOPS]]#2 -> %[[H:[a-z0-9]+]] = 0 to 4, [[LOOPS]]#3 -> %[[W:[a-z0-9]+]] = 0 to 32) {
+  // CHECK:   [[X:%.+]] = load %arg0[%[[N]], %[[C]], %[[H]], %[[W]]] : memref<2x16x4x32xf32>
+  // CHECK:   [[ACC:%.+]] = load [[RES]][%[[N]], %{{.+}}, %[[H]], %[[W]]] : memref<2x1x4x32xf32>
+  // CHECK:   [[SUM:%.+]] = addf [[ACC]], [[X]] : f32
+  // CHECK:   store [[SUM]], [[RES]][%[[N]], %{{.+}}, %[[H]], %[[W]]] : memref<2x1x4x32xf32>
+  // CHECK: return [[RES]] : memref<2x1x4x32xf32>
+}
+
+func @test_reducesum_interleaved(%arg0 : tensor<3x4x16xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceSum"(%arg0) {axes=[0, 2], keepdims = 0 : i64} : (tensor<3x4x16xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducesum_interleaved
+  // CHECK: [[RES:%.+]] = alloc() : memref<4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %[[J:[a-z0-9]+]] = 0 to 4) {
+  // CHECK:   store %{{.+}}, [[RES]][%[[J]]] : memref<4xf32>
+
+  // The runs along the innermost dimension are reduced into vector lanes and
+  // accumulated into the result, sequentially along the reduced dimension 0.
+  // CHECK: [[RUN_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK-NOT: krnl.parallel
+  // CHECK: krnl.iterate({{.*}}) with ([[RUN_LOOPS]]#0 -> %[[I:[a-z0-9]+]] = 0 to 3, [[RUN_LOOPS]]#1 -> %[[J:[a-z0-9]+]] = 0 to 4) {
+  // CHECK:   [[LANES:%.+]] = "krnl.alloca"() : () -> memref<8xf32>
+  // CHECK:     krnl.vectorize {{.*}} 8
+  // CHECK:     load %arg0[%[[I]], %[[J]], %{{.+}}] : memref<3x4x16xf32>
+  // CHECK-NOT: dealloc [[LANES]]
+  // CHECK:   [[ACC:%.+]] = load [[RES]][%[[J]]] : memref<4xf32>
+  // CHECK:   [[SUM:%.+]] = addf [[ACC]], %{{.+}} : f32
+  // CHECK:   store [[SUM]], [[RES]][%[[J]]] : memref<4xf32>
+  // CHECK: return [[RES]] : memref<4xf32>
+}
+
+func @test_reducesum_innermost(%arg0 : tensor<4x20xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceSum"(%arg0) {axes=[1], keepdims = 0 : i64} : (tensor<4x20xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducesum_innermost
+  // CHECK: [[RES:%.+]] = alloc() : memref<4xf32>
+  // CHECK: [[IDENTITY:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[RUN_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.parallel [[RUN_LOOPS]]
+  // CHECK: krnl.iterate({{.*}}) with ([[RUN_LOOPS]] -> %[[I:[a-z0-9]+]] = 0 to 4) {
+  // CHECK:   [[LANES:%.+]] = "krnl.alloca"() : () -> memref<8xf32>
+  // CHECK:   [[INIT_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:     krnl.vectorize [[INIT_LOOPS]] 8
+  // CHECK:   krnl.iterate({{.*}}) with ([[INIT_LOOPS]] -> %[[L:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:     store [[IDENTITY]], [[LANES]][%[[L]]] : memref<8xf32>
+
+  // Whole vectors of the run, accumulated into the lanes.
+  // CHECK:   [[BLOCK_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:     krnl.vectorize [[BLOCK_LOOPS]]#1 8
+  // CHECK:   krnl.iterate({{.*}}) with ([[BLOCK_LOOPS]]#0 -> %[[B:[a-z0-9]+]] = 0 to 2, [[BLOCK_LOOPS]]#1 -> %[[L:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:     [[J:%.+]] = affine.apply #{{.*}}(%[[B]], %[[L]])
+  // CHECK:     [[X:%.+]] = load %arg0[%[[I]], [[J]]] : memref<4x20xf32>
+  // CHECK:     [[ACC:%.+]] = load [[LANES]][%[[L]]] : memref<8xf32>
+  // CHECK:     [[SUM:%.+]] = addf [[ACC]], [[X]] : f32
+  // CHECK:     store [[SUM]], [[LANES]][%[[L]]] : memref<8xf32>
+
+  // Remaining elements, accumulated into the first lanes.
+  // CHECK:   [[TAIL_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate({{.*}}) with ([[TAIL_LOOPS]] -> %[[T:[a-z0-9]+]] = 0 to 4) {
+  // CHECK:     [[J:%.+]] = affine.apply #{{.*}}(%[[T]])
+  // CHECK:     [[X:%.+]] = load %arg0[%[[I]], [[J]]] : memref<4x20xf32>
+  // CHECK:     [[ACC:%.+]] = load [[LANES]][%[[T]]] : memref<8xf32>
+
+  // Lanes combined pairwise.
+  // CHECK:   [[C0:%.+]] = constant 0 : index
+  // CHECK:   [[LANE0:%.+]] = load [[LANES]]{{\[}}[[C0]]{{\]}} : memref<8xf32>
+  // CHECK:   [[C1:%.+]] = constant 1 : index
+  // CHECK:   [[LANE1:%.+]] = load [[LANES]]{{\[}}[[C1]]{{\]}} : memref<8xf32>
+  // CHECK:   [[SUM01:%.+]] = addf [[LANE0]], [[LANE1]] : f32
+  // CHECK-NOT: krnl.iterate
+  // CHECK-NOT: dealloc [[LANES]]
+  // CHECK:   store %{{.+}}, [[RES]][%[[I]]] : memref<4xf32>
+  // CHECK: return [[RES]] : memref<4xf32>
+}
+
+func @test_reducesum_whole_tensor(%arg0 : tensor<64x1024xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceSum"(%arg0) : (tensor<64x1024xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducesum_whole_tensor
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x1xf32>
+  // CHECK: [[IDENTITY:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[ZERO:%.+]] = constant 0 : index
+  // CHECK: [[LANES:%.+]] = "krnl.alloca"() : () -> memref<8xf32>
+  // CHECK: [[PARTIALS:%.+]] = alloc() : memref<64x8xf32>
+
+  // Rows accumulated into partial results in parallel.
+  // CHECK: [[SLICE_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.parallel [[SLICE_LOOPS]]
+  // CHECK: krnl.iterate({{.*}}) with ([[SLICE_LOOPS]] -> %[[S:[a-z0-9]+]] = 0 to 64) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %[[L:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:     store [[IDENTITY]], [[PARTIALS]][%[[S]], %[[L]]] : memref<64x8xf32>
+  // CHECK:   [[BLOCK_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:     krnl.vectorize [[BLOCK_LOOPS]]#1 8
+  // CHECK:   krnl.iterate({{.*}}) with ([[BLOCK_LOOPS]]#0 -> %[[B:[a-z0-9]+]] = 0 to 128, [[BLOCK_LOOPS]]#1 -> %[[L:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:     [[J:%.+]] = affine.apply #{{.*}}(%[[B]], %[[L]])
+  // CHECK:     [[X:%.+]] = load %arg0[%[[S]], [[J]]] : memref<64x1024xf32>
+  // CHECK:     [[ACC:%.+]] = load [[PARTIALS]][%[[S]], %[[L]]] : memref<64x8xf32>
+  // CHECK:     [[SUM:%.+]] = addf [[ACC]], [[X]] : f32
+  // CHECK:     store [[SUM]], [[PARTIALS]][%[[S]], %[[L]]] : memref<64x8xf32>
+
+  // Partial results combined in order.
+  // CHECK: [[COMBINE_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.vectorize [[COMBINE_LOOPS]]#1 8
+  // CHECK: krnl.iterate({{.*}}) with ([[COMBINE_LOOPS]]#0 -> %[[S:[a-z0-9]+]] = 0 to 64, [[COMBINE_LOOPS]]#1 -> %[[L:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:   [[PARTIAL:%.+]] = load [[PARTIALS]][%[[S]], %[[L]]] : memref<64x8xf32>
+  // CHECK:   [[ACC:%.+]] = load [[LANES]][%[[L]]] : memref<8xf32>
+  // CHECK:   [[SUM:%.+]] = addf [[ACC]], [[PARTIAL]] : f32
+  // CHECK:   store [[SUM]], [[LANES]][%[[L]]] : memref<8xf32>
+  // CHECK: dealloc [[PARTIALS]] : memref<64x8xf32>
+  // CHECK-NOT: dealloc [[LANES]]
+  // CHECK: store %{{.+}}, [[RES]]{{\[}}[[ZERO]], [[ZERO]]{{\]}} : memref<1x1xf32>
+  // CHECK: return [[RES]] : memref<1x1xf32>
+}
   
 func @test_softmax(%arg0 : tensor<10x10xf32>) -> tensor<*xf32> {
   %0 = "onnx.Softmax"(%arg0) {axis=1:i64} : (tensor<10x10xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
 
   // CHECK-LABEL: test_softmax
-  // CHECK: [[MAX:%.+]] = alloc() : memref<f32>
-  // CHECK: [[SUM:%.+]] = alloc() : memref<f32>
   // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
-  // CHECK: [[CST:%.+]] = constant 0.000000e+00 : f32
-  // CHECK: [[CST_0:%.+]] = constant 0xFF800000 : f32
-  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK: [[OPT_LOOPS:%.+]]:2 = krnl.optimize_loops  {
-  // CHECK:  krnl.return_loops [[DEF_LOOPS]]#0, %3#1
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#0) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 10) {
-  // CHECK: store [[CST]], [[SUM]][] : memref<f32>
-  // CHECK: store [[CST_0]], [[MAX]][] : memref<f32>
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#1 -> %arg2 = 0 to 10) {
-  // CHECK:   [[LOAD1:%.+]] = load [[MAX]][] : memref<f32>
-  // CHECK:   [[LOAD2:%.+]] = load %arg0[%arg1, %arg2] : memref<10x10xf32>
-  // CHECK:   [[COND:%.+]] = cmpf "ogt", [[LOAD1]], [[LOAD2]] : f32
-  // CHECK:   [[SELECT:%.+]] = select [[COND]], [[LOAD1]], [[LOAD2]] : f32
-  // CHECK:   store [[SELECT]], [[MAX]][] : memref<f32>
-  // CHECK: }
-  // CHECK: %5 = load [[MAX]][] : memref<f32>
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#1 -> %arg2 = 0 to 10) {
-  // CHECK:   [[LOAD1]] = load [[SUM]][] : memref<f32>
-  // CHECK:   [[LOAD2]] = load %arg0[%arg1, %arg2] : memref<10x10xf32>
-  // CHECK:   [[SUB:%.+]] = subf [[LOAD2]], %5 : f32
-  // CHECK:   [[EXP:%.+]] = exp [[SUB]] : f32
-  // CHECK:   [[ADD:%.+]] = addf [[LOAD1]], [[EXP]] : f32
-  // CHECK:   store [[ADD]], [[SUM]][] : memref<f32>
-  // CHECK:   store %10, [[RES]][%arg1, %arg2] : memref<10x10xf32>
-  // CHECK: }
-  // CHECK: %6 = load [[SUM]][] : memref<f32>
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#1 -> %arg2 = 0 to 10) {
-  // CHECK:   [[LOAD1]] = load [[RES]][%arg1, %arg2] : memref<10x10xf32>
-  // CHECK:   [[DIV:%.+]] = divf [[LOAD1]], %6 : f32
-  // CHECK:   store [[DIV]], [[RES]][%arg1, %arg2] : memref<10x10xf32>
-  // CHECK: }
-  // CHECK: }
-  // CHECK: dealloc [[SUM]] : memref<f32>
-  // CHECK: dealloc [[MAX]] : memref<f32>
+  // CHECK: [[OUTER_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[OUTER_LOOPS]]
+  // CHECK: krnl.iterate({{.*}}) with ([[OUTER_LOOPS]] -> %[[I:[a-z0-9]+]] = 0 to 10) {
+  // CHECK:   [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK:   [[ONE:%.+]] = constant 1.000000e+00 : f32
+  // CHECK:   [[LOWEST:%.+]] = constant -3.40282347E+38 : f32
+  // CHECK:   [[LANE_MAX:%.+]] = "krnl.alloca"() : () -> memref<8xf32>
+  // CHECK:   [[LANE_SUM:%.+]] = "krnl.alloca"() : () -> memref<8xf32>
+  // CHECK:   [[INIT_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:     krnl.vectorize [[INIT_LOOPS]] 8
+  // CHECK:   krnl.iterate({{.*}}) with ([[INIT_LOOPS]] -> %[[L:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:     store [[LOWEST]], [[LANE_MAX]][%[[L]]] : memref<8xf32>
+  // CHECK:     store [[ZERO]], [[LANE_SUM]][%[[L]]] : memref<8xf32>
+
+  // Online max and sum over the blocks of 8 elements, vectorized.
+  // CHECK:   [[BLOCK_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:     krnl.vectorize [[BLOCK_LOOPS]]#1 8
+  // CHECK:   krnl.iterate({{.*}}) with ([[BLOCK_LOOPS]]#0 -> %[[B:[a-z0-9]+]] = 0 to 1, [[BLOCK_LOOPS]]#1 -> %[[L:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:     [[J:%.+]] = affine.apply #{{.*}}(%[[B]], %[[L]])
+  // CHECK:     [[X:%.+]] = load %arg0[%[[I]], [[J]]] : memref<10x10xf32>
+  // CHECK:     [[MAX:%.+]] = load [[LANE_MAX]][%[[L]]] : memref<8xf32>
+  // CHECK:     [[SUM:%.+]] = load [[LANE_SUM]][%[[L]]] : memref<8xf32>
+  // CHECK:     [[GT:%.+]] = cmpf "ogt", [[X]], [[MAX]] : f32
+  // CHECK:     [[NEW_MAX:%.+]] = select [[GT]], [[X]], [[MAX]] : f32
+  // CHECK:     [[NEW_MIN:%.+]] = select [[GT]], [[MAX]], [[X]] : f32
+  // CHECK:     [[SUB:%.+]] = subf [[NEW_MIN]], [[NEW_MAX]] : f32
+  // CHECK:     [[EXP:%.+]] = exp [[SUB]] : f32
+  // CHECK:     [[MUL:%.+]] = mulf [[SUM]], [[EXP]] : f32
+  // CHECK:     [[RESCALED:%.+]] = addf [[MUL]], [[ONE]] : f32
+  // CHECK:     [[INCREASED:%.+]] = addf [[SUM]], [[EXP]] : f32
+  // CHECK:     [[NEW_SUM:%.+]] = select [[GT]], [[RESCALED]], [[INCREASED]] : f32
+  // CHECK:     store [[NEW_MAX]], [[LANE_MAX]][%[[L]]] : memref<8xf32>
+  // CHECK:     store [[NEW_SUM]], [[LANE_SUM]][%[[L]]] : memref<8xf32>
+
+  // Tail of the row, accumulated into the first lanes.
+  // CHECK:   [[TAIL_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate({{.*}}) with ([[TAIL_LOOPS]] -> %[[L:[a-z0-9]+]] = 0 to 2) {
+  // CHECK:     [[J:%.+]] = affine.apply #{{.*}}(%[[L]])
+  // CHECK:     load %arg0[%[[I]], [[J]]] : memref<10x10xf32>
+
+  // Combination of the lanes.
+  // CHECK:   [[C0:%.+]] = constant 0 : index
+  // CHECK:   [[MAX0:%.+]] = load [[LANE_MAX]]{{\[}}[[C0]]{{\]}} : memref<8xf32>
+  // CHECK:   [[SUM0:%.+]] = load [[LANE_SUM]]{{\[}}[[C0]]{{\]}} : memref<8xf32>
+  // CHECK-NOT: dealloc [[LANE_MAX]]
+  // CHECK-NOT: dealloc [[LANE_SUM]]
+  // CHECK-NOT: krnl.iterate
+  // CHECK:   [[RECIPROCAL:%.+]] = divf [[ONE]], %{{.+}} : f32
+
+  // Normalization, vectorized.
+  // CHECK:   [[SOFTMAX_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:     krnl.vectorize [[SOFTMAX_LOOPS]] 8
+  // CHECK:   krnl.iterate({{.*}}) with ([[SOFTMAX_LOOPS]] -> %[[J:[a-z0-9]+]] = 0 to 10) {
+  // CHECK:     [[X:%.+]] = load %arg0[%[[I]], %[[J]]] : memref<10x10xf32>
+  // CHECK:     [[SUB:%.+]] = subf [[X]], %{{.+}} : f32
+  // CHECK:     [[EXP:%.+]] = exp [[SUB]] : f32
+  // CHECK:     [[Y:%.+]] = mulf [[EXP]], [[RECIPROCAL]] : f32
+  // CHECK:     store [[Y]], [[RES]][%[[I]], %[[J]]] : memref<10x10xf32>
   // CHECK: return [[RES]] : memref<10x10xf32>
 }
 
@@ -782,28 +1034,76 @@ func @test_gemm(%arg0 : tensor<5x10xf32>, %arg1 : tensor<5x10xf32>, %arg2: tenso
   // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
   // CHECK: [[ALPHA:%.+]] = constant 1.000000e+00 : f32
   // CHECK: [[BETA:%.+]] = constant 5.000000e+00 : f32
-  // CHECK: [[DEF_LOOPS:%.+]]:3 = krnl.define_loops 3
-  // CHECK: [[OPT_LOOPS:%.+]]:3 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop)
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg3 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg4 = 0 to 10) {
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#2) with ([[DEF_LOOPS]]#2 -> %arg5 = 0 to 5) {
-  // CHECK: [[A:%.+]] = load %arg0[%arg5, %arg3] : memref<5x10xf32>
-  // CHECK: [[B:%.+]] = load %arg1[%arg5, %arg4] : memref<5x10xf32>
-  // CHECK: [[Y:%.+]] = load [[RES]][%arg3, %arg4] : memref<10x10xf32>
-  // CHECK: [[AB:%.+]] = mulf [[A]], [[B]] : f32
-  // CHECK: [[SUM:%.+]] = addf [[Y]], [[AB]] : f32
-  // CHECK: store [[SUM]], [[RES]][%arg3, %arg4] : memref<10x10xf32>
-  // CHECK: }
-  // CHECK: [[LOAD_Y:%.+]] = load [[RES]][%arg3, %arg4] : memref<10x10xf32>
-  // CHECK: [[ALPHA_AB:%.+]] = mulf [[ALPHA]], [[LOAD_Y]] : f32
-  // CHECK: [[C:%.+]] = load %arg2[%arg4] : memref<10xf32>
-  // CHECK: [[BETA_C:%.+]] = mulf [[BETA]], [[C]] : f32
-  // CHECK: [[Y_RES:%.+]] = addf [[ALPHA_AB]], [[BETA_C]] : f32
-  // CHECK: store [[Y_RES]], [[RES]][%arg3, %arg4] : memref<10x10xf32>
-  // CHECK: }
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#0
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]]#1 8
+  // CHECK: krnl.iterate({{.*}}) with ([[DEF_LOOPS]]#0 -> %[[I:[a-z0-9]+]] = 0 to 10, [[DEF_LOOPS]]#1 -> %[[J:[a-z0-9]+]] = 0 to 10) {
+  // CHECK:   [[C:%.+]] = load %arg2[%[[J]]] : memref<10xf32>
+  // CHECK:   [[BETA_C:%.+]] = mulf [[BETA]], [[C]] : f32
+  // CHECK:   store [[BETA_C]], [[RES]][%[[I]], %[[J]]] : memref<10x10xf32>
+  // CHECK: [[PANEL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate({{.*}}) with ([[PANEL_LOOPS]]#0 -> %{{.*}} = 0 to 1, [[PANEL_LOOPS]]#1 -> %{{.*}} = 0 to 1) {
+  // CHECK:   [[PACKED_B:%.+]] = alloc() : memref<2x5x8xf32>
+  // CHECK:   krnl.iterate
+  // CHECK:     [[B:%.+]] = load %arg1[{{.*}}] : memref<5x10xf32>
+  // CHECK:     store [[B]], [[PACKED_B]][{{.*}}] : memref<2x5x8xf32>
+  // CHECK:   krnl.iterate
+  // CHECK:     store {{.*}}, [[PACKED_B]][{{.*}}] : memref<2x5x8xf32>
+  // CHECK:   [[BLOCK_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.optimize_loops  {
+  // CHECK:     krnl.parallel [[BLOCK_LOOPS]]
+  // CHECK:   krnl.iterate({{.*}}) with ([[BLOCK_LOOPS]] -> %{{.*}} = 0 to 1) {
+  // CHECK:     [[PACKED_A:%.+]] = alloc() : memref<3x5x4xf32>
+  // CHECK:     [[ACC:%.+]] = "krnl.alloca"() : () -> memref<4x8xf32>
+  // CHECK:     krnl.iterate
+  // CHECK:       [[A:%.+]] = load %arg0[{{.*}}] : memref<5x10xf32>
+  // CHECK:       [[ALPHA_A:%.+]] = mulf [[ALPHA]], [[A]] : f32
+  // CHECK:       store [[ALPHA_A]], [[PACKED_A]][{{.*}}] : memref<3x5x4xf32>
+  // CHECK:     krnl.iterate
+  // CHECK:       store {{.*}}, [[PACKED_A]][{{.*}}] : memref<3x5x4xf32>
+  // CHECK:     krnl.iterate({{.*}}) with ({{.*}} -> %[[JR:[a-z0-9]+]] = 0 to min {{.*}}, {{.*}} -> %[[IR:[a-z0-9]+]] = 0 to min {{.*}}) {
+  // CHECK:       [[CLEAR_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:         krnl.vectorize [[CLEAR_LOOPS]]#1 8
+  // CHECK:         store {{.*}}, [[ACC]][{{.*}}] : memref<4x8xf32>
+  // CHECK:       [[KERNEL_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK:       krnl.optimize_loops  {
+  // CHECK:         krnl.unroll_jam [[KERNEL_LOOPS]]#1 4
+  // CHECK:         krnl.vectorize [[KERNEL_LOOPS]]#2 8
+  // CHECK:       krnl.iterate({{.*}}) with ([[KERNEL_LOOPS]]#0 -> %[[K:[a-z0-9]+]] = 0 to min {{.*}}, [[KERNEL_LOOPS]]#1 -> %[[TI:[a-z0-9]+]] = 0 to 4, [[KERNEL_LOOPS]]#2 -> %[[TJ:[a-z0-9]+]] = 0 to 8) {
+  // CHECK:         [[LOAD_A:%.+]] = load [[PACKED_A]][%[[IR]], %[[K]], %[[TI]]] : memref<3x5x4xf32>
+  // CHECK:         [[LOAD_B:%.+]] = load [[PACKED_B]][%[[JR]], %[[K]], %[[TJ]]] : memref<2x5x8xf32>
+  // CHECK:         [[LOAD_ACC:%.+]] = load [[ACC]][%[[TI]], %[[TJ]]] : memref<4x8xf32>
+  // CHECK:         [[AB:%.+]] = mulf [[LOAD_A]], [[LOAD_B]] : f32
+  // CHECK:         [[SUM:%.+]] = addf [[LOAD_ACC]], [[AB]] : f32
+  // CHECK:         store [[SUM]], [[ACC]][%[[TI]], %[[TJ]]] : memref<4x8xf32>
+  // CHECK:       krnl.iterate
+  // CHECK:         [[LOAD_TILE:%.+]] = load [[ACC]][{{.*}}] : memref<4x8xf32>
+  // CHECK:         [[LOAD_Y:%.+]] = load [[RES]][{{.*}}] : memref<10x10xf32>
+  // CHECK:         [[Y:%.+]] = addf [[LOAD_Y]], [[LOAD_TILE]] : f32
+  // CHECK:         store [[Y]], [[RES]][{{.*}}] : memref<10x10xf32>
+  // CHECK-NOT: dealloc [[ACC]]
+  // CHECK:     dealloc [[PACKED_A]] : memref<3x5x4xf32>
+  // CHECK:   dealloc [[PACKED_B]] : memref<2x5x8xf32>
   // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// An empty reduction leaves the output initialized with beta * C.
+func @test_gemm_empty_reduction(%arg0 : tensor<10x0xf32>, %arg1 : tensor<0x10xf32>, %arg2: tensor<10xf32>) -> tensor<*xf32> {
+  %0 ="onnx.Gemm"(%arg0, %arg1, %arg2) {alpha = 1.0 : f32, beta = 5.0 : f32, transA = 0, transB = 0} : (tensor<10x0xf32>, tensor<0x10xf32>, tensor<10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_gemm_empty_reduction
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[BETA:%.+]] = constant 5.000000e+00 : f32
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %[[I:[a-z0-9]+]] = 0 to 10, {{.*}} -> %[[J:[a-z0-9]+]] = 0 to 10) {
+  // CHECK:   [[C:%.+]] = load %arg2[%[[J]]] : memref<10xf32>
+  // CHECK:   [[BETA_C:%.+]] = mulf [[BETA]], [[C]] : f32
+  // CHECK:   store [[BETA_C]], [[RES]][%[[I]], %[[J]]] : memref<10x10xf32>
   // CHECK: }
+  // CHECK-NOT: alloc
+  // CHECK-NOT: krnl.iterate
+  // CHECK: return [[RES]] : memref<10x10xf32>
 }
 
 func @test_sqrt(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
@@ -830,18 +1130,8 @@ func @test_unsqueeze(%arg0 : tensor<10x10xf32>) -> tensor<*xf32> {
   "std.return"(%0) : (tensor<*xf32>) -> ()
 
   // CHECK-LABEL: test_unsqueeze
-  // CHECK: [[RES:%.+]] = alloc() : memref<1x10x10x1xf32>
-  // CHECK: [[INBYTES:%.+]] = constant 4 : i64
-  // CHECK: [[DIM1:%.+]] = constant 1 : i64
-  // CHECK: [[SIZE1:%.+]] = muli [[INBYTES]], [[DIM1]] : i64
-  // CHECK: [[DIM2:%.+]] = constant 10 : i64
-  // CHECK: [[SIZE2:%.+]] = muli [[SIZE1]], [[DIM2]] : i64
-  // CHECK: [[DIM3:%.+]] = constant 10 : i64
-  // CHECK: [[SIZE3:%.+]] = muli [[SIZE2]], [[DIM3]] : i64
-  // CHECK: [[DIM4:%.+]] = constant 1 : i64
-  // CHECK: [[SIZE4:%.+]] = muli [[SIZE3]], [[DIM4]] : i64
-  // CHECK: "krnl.memcpy"([[RES]], %arg0, [[SIZE4]]) : (memref<1x10x10x1xf32>, memref<10x10xf32>, i64) -> ()
-  // CHECK: return [[RES]] : memref<1x10x10x1xf32>
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0) : (memref<10x10xf32>) -> memref<1x10x10x1xf32>
+  // CHECK: return [[VIEW]] : memref<1x10x10x1xf32>
 }
 
 func @test_transpose(%arg0 : tensor<10x20x30x40xf32>) -> tensor<*xf32> {
@@ -853,26 +1143,69 @@ func @test_transpose(%arg0 : tensor<10x20x30x40xf32>) -> tensor<*xf32> {
   // CHECK: [[RES0:%.+]] = alloc() : memref<40x10x30x20xf32>
   // CHECK: [[RES1:%.+]] = alloc() : memref<40x30x20x10xf32>
 
+  // The innermost dimension of the input is transposed by strips of 16
+  // columns, the columns of a strip being unrolled.
+  // CHECK: [[LOOPS:%.+]]:5 = krnl.define_loops 5
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[LOOPS]]#0
+  // CHECK:   krnl.unroll [[LOOPS]]#4 16
+  // CHECK: krnl.iterate({{.*}}) with ([[LOOPS]]#0 -> %[[I:[a-z0-9]+]] = 0 to 30, [[LOOPS]]#1 -> %[[J:[a-z0-9]+]] = 0 to 20, [[LOOPS]]#2 -> %[[S:[a-z0-9]+]] = 0 to 2, [[LOOPS]]#3 -> %[[R:[a-z0-9]+]] = 0 to 10, [[LOOPS]]#4 -> %[[C:[a-z0-9]+]] = 0 to 16) {
+  // CHECK:   [[COL:%.+]] = affine.apply #{{.*}}(%[[S]], %[[C]])
+  // CHECK:   [[LOAD:%.+]] = load %arg0[%[[R]], %[[J]], %[[I]], [[COL]]] : memref<10x20x30x40xf32>
+  // CHECK:   store [[LOAD]], [[RES1]]{{\[}}[[COL]], %[[I]], %[[J]], %[[R]]] : memref<40x30x20x10xf32>
+
+  // The columns following the last strip.
   // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
-  // CHECK: [[OPT_LOOPS:%.+]]:4 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[LOOPS]]#0, [[LOOPS]]#1, [[LOOPS]]#2, [[LOOPS]]#3
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1, [[OPT_LOOPS]]#2, [[OPT_LOOPS]]#3) with ([[LOOPS]]#0 -> %arg1 = 0 to 10, [[LOOPS]]#1 -> %arg2 = 0 to 20, [[LOOPS]]#2 -> %arg3 = 0 to 30, [[LOOPS]]#3 -> %arg4 = 0 to 40) {
-  // CHECK: [[LOAD:%.+]] = load %arg0[%arg1, %arg2, %arg3, %arg4] : memref<10x20x30x40xf32>
-  // CHECK: store [[LOAD]], [[RES1]][%arg4, %arg3, %arg2, %arg1] : memref<40x30x20x10xf32>
-
-  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
-  // CHECK: [[OPT_LOOPS:%.+]]:4 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[LOOPS]]#0, [[LOOPS]]#1, [[LOOPS]]#2, [[LOOPS]]#3
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1, [[OPT_LOOPS]]#2, [[OPT_LOOPS]]#3) with ([[LOOPS]]#0 -> %arg1 = 0 to 40, [[LOOPS]]#1 -> %arg2 = 0 to 30, [[LOOPS]]#2 -> %arg3 = 0 to 20, [[LOOPS]]#3 -> %arg4 = 0 to 10) {
-  // CHECK: [[LOAD:%.+]] = load [[RES1]][%arg1, %arg2, %arg3, %arg4] : memref<40x30x20x10xf32>
-  // CHECK: store [[LOAD]], [[RES0]][%arg1, %arg4, %arg2, %arg3] : memref<40x10x30x20xf32>
+  // CHECK: krnl.iterate({{.*}}) with ([[LOOPS]]#0 -> %[[I:[a-z0-9]+]] = 0 to 30, [[LOOPS]]#1 -> %[[J:[a-z0-9]+]] = 0 to 20, [[LOOPS]]#2 -> %[[R:[a-z0-9]+]] = 0 to 10, [[LOOPS]]#3 -> %[[C:[a-z0-9]+]] = 32 to 40) {
+  // CHECK:   [[LOAD:%.+]] = load %arg0[%[[R]], %[[J]], %[[I]], %[[C]]] : memref<10x20x30x40xf32>
+  // CHECK:   store [[LOAD]], [[RES1]][%[[C]], %[[I]], %[[J]], %[[R]]] : memref<40x30x20x10xf32>
+
+  // Dimensions 1 and 2 stay adjacent and are transposed as a single
+  // dimension of 600 rows, narrower than a strip.
+  // CHECK: [[LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[LOOPS]]#0
+  // CHECK: krnl.iterate({{.*}}) with ([[LOOPS]]#0 -> %[[I:[a-z0-9]+]] = 0 to 40, [[LOOPS]]#1 -> %[[R:[a-z0-9]+]] = 0 to 600, [[LOOPS]]#2 -> %[[C:[a-z0-9]+]] = 0 to 10) {
+  // CHECK:   [[R2:%.+]] = affine.apply #{{.*}}(%[[R]])
+  // CHECK:   [[R1:%.+]] = affine.apply #{{.*}}(%[[R]])
+  // CHECK:   [[LOAD:%.+]] = load [[RES1]][%[[I]], [[R1]], [[R2]], %[[C]]] : memref<40x30x20x10xf32>
+  // CHECK:   store [[LOAD]], [[RES0]][%[[I]], %[[C]], [[R1]], [[R2]]] : memref<40x10x30x20xf32>
 
   // CHECK: dealloc [[RES1]] : memref<40x30x20x10xf32>
   // CHECK: return [[RES0]] : memref<40x10x30x20xf32>
 }
 
+func @test_transpose_collapsed(%arg0 : tensor<2x32x7x7xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Transpose"(%arg0) {perm = [0, 2, 3, 1]} : (tensor<2x32x7x7xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // The spatial dimensions are transposed as 49 columns: 3 strips and one
+  // remaining column.
+  // CHECK-LABEL: test_transpose_collapsed
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x7x7x32xf32>
+  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK:   krnl.parallel [[LOOPS]]#0
+  // CHECK:   krnl.unroll [[LOOPS]]#3 16
+  // CHECK: krnl.iterate({{.*}}) with ([[LOOPS]]#0 -> %[[N:[a-z0-9]+]] = 0 to 2, [[LOOPS]]#1 -> %[[S:[a-z0-9]+]] = 0 to 3, [[LOOPS]]#2 -> %[[R:[a-z0-9]+]] = 0 to 32, [[LOOPS]]#3 -> %[[C:[a-z0-9]+]] = 0 to 16) {
+  // CHECK:   [[W:%.+]] = affine.apply #{{.*}}(%[[S]], %[[C]])
+  // CHECK:   [[H:%.+]] = affine.apply #{{.*}}(%[[S]], %[[C]])
+  // CHECK:   [[LOAD:%.+]] = load %arg0[%[[N]], %[[R]], [[H]], [[W]]] : memref<2x32x7x7xf32>
+  // CHECK:   store [[LOAD]], [[RES]][%[[N]], [[H]], [[W]], %[[R]]] : memref<2x7x7x32xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} = 0 to 2, {{.*}} = 0 to 32, {{.*}} -> %[[C:[a-z0-9]+]] = 48 to 49) {
+  // CHECK: return [[RES]] : memref<2x7x7x32xf32>
+}
+
+func @test_transpose_noop(%arg0 : tensor<1x4x8xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Transpose"(%arg0) {perm = [1, 0, 2]} : (tensor<1x4x8xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // Only dimensions of size 1 move: the result is a view of the input.
+  // CHECK-LABEL: test_transpose_noop
+  // CHECK-NOT: krnl.iterate
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0) : (memref<1x4x8xf32>) -> memref<4x1x8xf32>
+  // CHECK: return [[VIEW]] : memref<4x1x8xf32>
+}
+
 func @test_identity(%arg0 : tensor<10x20x30x40xf32>) -> tensor<*xf32> {
   %0 = "onnx.Identity"(%arg0) : (tensor<10x20x30x40xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -881,6 +1214,33 @@ func @test_identity(%arg0 : tensor<10x20x30x40xf32>) -> tensor<*xf32> {
   // CHECK: return %arg0 : memref<10x20x30x40xf32>
 }
 
+func @test_constant_dense(%arg0 : tensor<2xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[1.000000e+00, 2.000000e+00]> : tensor<2xf32>} : () -> tensor<2xf32>
+  %1 = "onnx.Add"(%arg0, %0) : (tensor<2xf32>, tensor<2xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_constant_dense
+  // CHECK: [[CONST:%.+]] = "krnl.global"() {value = dense<[1.000000e+00, 2.000000e+00]> : tensor<2xf32>} : () -> memref<2xf32>
+  // CHECK-NOT: store {{.*}}, [[CONST]]
+  // CHECK: [[RES:%.+]] = alloc() : memref<2xf32>
+  // CHECK: [[LOAD:%.+]] = load [[CONST]][%{{.+}}] : memref<2xf32>
+  // CHECK: addf %{{.+}}, [[LOAD]] : f32
+  // CHECK-NOT: dealloc [[CONST]]
+  // CHECK: return [[RES]] : memref<2xf32>
+}
+
+func @test_constant_returned() -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = [1.000000e+00 : f32, 2.000000e+00 : f32, 3.000000e+00 : f32, 4.000000e+00 : f32]} : () -> tensor<2x2xf32>
+  "std.return"(%0) : (tensor<2x2xf32>) -> ()
+
+  // CHECK-LABEL: test_constant_returned
+  // CHECK: [[CONST:%.+]] = "krnl.global"() {value = dense<{{\[}}[1.000000e+00, 2.000000e+00], [3.000000e+00, 4.000000e+00]]> : tensor<2x2xf32>} : () -> memref<2x2xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x2xf32>
+  // CHECK: [[SIZE:%.+]] = constant 16 : i64
+  // CHECK: "krnl.memcpy"([[RES]], [[CONST]], [[SIZE]]) : (memref<2x2xf32>, memref<2x2xf32>, i64) -> ()
+  // CHECK: return [[RES]] : memref<2x2xf32>
+}
+
 func @test_sign_f(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
   %0 = "onnx.Sign"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -938,26 +1298,27 @@ func @test_matmul1(%arg0 : tensor<10x5xf32>, %arg1 : tensor<5x10xf32>) -> tensor
 
   // CHECK-LABEL: test_matmul1
   // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
-  // CHECK: [[CONSTANT:%.+]] = constant 0.000000e+00 : f32
   // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
   // CHECK: [[OPT_LOOPS:%.+]]:2 = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[LOOPS]]#0
+  // CHECK:   krnl.vectorize [[LOOPS]]#1 8
   // CHECK:   krnl.return_loops [[LOOPS]]#0, [[LOOPS]]#1
   // CHECK: } : () -> (!krnl.loop, !krnl.loop)
   // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1) with ([[LOOPS]]#0 -> %arg2 = 0 to 10, [[LOOPS]]#1 -> %arg3 = 0 to 10) {
+  // CHECK:   [[CONSTANT:%.+]] = constant 0.000000e+00 : f32
   // CHECK:   store [[CONSTANT]], [[RES]][%arg2, %arg3] : memref<10x10xf32>
-  // CHECK:   [[LOOPS_REDUCE:%.+]] = krnl.define_loops 1
-  // CHECK:   [[OPT_LOOPS_REDUCE:%.+]] = krnl.optimize_loops  {
-  // CHECK:     krnl.return_loops [[LOOPS_REDUCE]]
-  // CHECK:   } : () -> !krnl.loop
-  // CHECK:   krnl.iterate([[OPT_LOOPS_REDUCE]]) with ([[LOOPS_REDUCE]] -> %arg4 = 0 to 5) {
-  // CHECK:     [[LOAD_0:%.+]] = load %arg0[%arg2, %arg4] : memref<10x5xf32>
-  // CHECK:     [[LOAD_1:%.+]] = load %arg1[%arg4, %arg3] : memref<5x10xf32>
-  // CHECK:     [[LOAD_RES:%.+]] = load [[RES]][%arg2, %arg3] : memref<10x10xf32>
-  // CHECK:     [[MUL:%.+]] = mulf [[LOAD_0]], [[LOAD_1]] : f32
-  // CHECK:     [[ADD:%.+]] = addf [[LOAD_RES]], [[MUL]] : f32
-  // CHECK:     store [[ADD]], [[RES]][%arg2, %arg3] : memref<10x10xf32>
-  // CHECK:   }
   // CHECK: }
+  // CHECK: [[PACKED_B:%.+]] = alloc() : memref<2x5x8xf32>
+  // CHECK: load %arg1[{{.*}}] : memref<5x10xf32>
+  // CHECK: krnl.parallel
+  // CHECK: [[PACKED_A:%.+]] = alloc() : memref<3x5x4xf32>
+  // CHECK: [[LOAD_A:%.+]] = load %arg0[{{.*}}] : memref<10x5xf32>
+  // CHECK: store [[LOAD_A]], [[PACKED_A]][{{.*}}] : memref<3x5x4xf32>
+  // CHECK: krnl.unroll_jam {{.*}} 4
+  // CHECK: krnl.vectorize {{.*}} 8
+  // CHECK: [[LOAD_Y:%.+]] = load [[RES]][{{.*}}] : memref<10x10xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD_Y]], {{.*}} : f32
+  // CHECK: store [[ADD]], [[RES]][{{.*}}] : memref<10x10xf32>
   // CHECK: return [[RES]] : memref<10x10xf32>
 }
 
@@ -968,28 +1329,22 @@ func @test_matmul2(%arg0 : tensor<10x5xf32>, %arg1 : tensor<2x3x5x10xf32>) -> te
 
   // CHECK-LABEL: test_matmul2
   // CHECK: [[RES:%.+]] = alloc() : memref<2x3x10x10xf32>
-  // CHECK: [[CONSTANT:%.+]] = constant 0.000000e+00 : f32
-  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
-  // CHECK: [[OPT_LOOPS:%.+]]:4 = krnl.optimize_loops  {
-  // CHECK:   krnl.return_loops [[LOOPS]]#0, [[LOOPS]]#1, [[LOOPS]]#2, [[LOOPS]]#3
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
+  // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: [[OPT_LOOPS:%.+]]:2 = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[LOOPS]]#0
+  // CHECK:   krnl.return_loops [[LOOPS]]#0, [[LOOPS]]#1
+  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
   // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1) with ([[LOOPS]]#0 -> %arg2 = 0 to 2, [[LOOPS]]#1 -> %arg3 = 0 to 3) {
-  // CHECK:   krnl.iterate([[OPT_LOOPS]]#2, [[OPT_LOOPS]]#3) with ([[LOOPS]]#2 -> %arg4 = 0 to 10, [[LOOPS]]#3 -> %arg5 = 0 to 10) {
-  // CHECK:     store [[CONSTANT]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x10x10xf32>
-  // CHECK:     [[LOOPS_REDUCE:%.+]] = krnl.define_loops 1
-  // CHECK:     [[OPT_LOOPS_REDUCE:%.+]] = krnl.optimize_loops  {
-  // CHECK:       krnl.return_loops [[LOOPS_REDUCE]]
-  // CHECK:     } : () -> !krnl.loop
-  // CHECK:     krnl.iterate([[OPT_LOOPS_REDUCE]]) with ([[LOOPS_REDUCE]] -> %arg6 = 0 to 5) {
-  // CHECK:       [[LOAD_0:%.+]] = load %arg0[%arg4, %arg6] : memref<10x5xf32>
-  // CHECK:       [[LOAD_1:%.+]] = load %arg1[%arg2, %arg3, %arg6, %arg5] : memref<2x3x5x10xf32>
-  // CHECK:       [[LOAD_RES:%.+]] = load [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x10x10xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[LOAD_0]], [[LOAD_1]] : f32
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD_RES]], [[MUL]] : f32
-  // CHECK:       store [[ADD]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x10x10xf32>
-  // CHECK:     }
-  // CHECK:   }
-  // CHECK: }
+  // CHECK:   [[FILL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.optimize_loops  {
+  // CHECK-NOT:   krnl.parallel
+  // CHECK:     krnl.vectorize [[FILL_LOOPS]]#1 8
+  // CHECK:   krnl.iterate({{.*}}) with ([[FILL_LOOPS]]#0 -> %[[I:[a-z0-9]+]] = 0 to 10, [[FILL_LOOPS]]#1 -> %[[J:[a-z0-9]+]] = 0 to 10) {
+  // CHECK:     store {{.*}}, [[RES]][%arg2, %arg3, %[[I]], %[[J]]] : memref<2x3x10x10xf32>
+  // CHECK:   [[LOAD_B:%.+]] = load %arg1[%arg2, %arg3, {{.*}}, {{.*}}] : memref<2x3x5x10xf32>
+  // CHECK:   [[LOAD_A:%.+]] = load %arg0[{{.*}}, {{.*}}] : memref<10x5xf32>
+  // CHECK:   load [[RES]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<2x3x10x10xf32>
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<2x3x10x10xf32>
   // CHECK: return [[RES]] : memref<2x3x10x10xf32>
 }
 
@@ -1000,31 +1355,43 @@ func @test_matmul3(%arg0 : tensor<2x3x10x5xf32>, %arg1 : tensor<2x3x5x10xf32>) -
 
   // CHECK-LABEL: test_matmul3
   // CHECK: [[RES:%.+]] = alloc() : memref<2x3x10x10xf32>
-  // CHECK: [[CONSTANT:%.+]] = constant 0.000000e+00 : f32
-  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
-  // CHECK: [[OPT_LOOPS:%.+]]:4 = krnl.optimize_loops  {
-  // CHECK:   krnl.return_loops [[LOOPS]]#0, [[LOOPS]]#1, [[LOOPS]]#2, [[LOOPS]]#3
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
-  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1) with ([[LOOPS]]#0 -> %arg2 = 0 to 2, [[LOOPS]]#1 -> %arg3 = 0 to 3) {
-  // CHECK:   krnl.iterate([[OPT_LOOPS]]#2, [[OPT_LOOPS]]#3) with ([[LOOPS]]#2 -> %arg4 = 0 to 10, [[LOOPS]]#3 -> %arg5 = 0 to 10) {
-  // CHECK:     store [[CONSTANT]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x10x10xf32>
-  // CHECK:     [[LOOPS_REDUCE:%.+]] = krnl.define_loops 1
-  // CHECK:     [[OPT_LOOPS_REDUCE:%.+]] = krnl.optimize_loops  {
-  // CHECK:       krnl.return_loops [[LOOPS_REDUCE]]
-  // CHECK:     } : () -> !krnl.loop
-  // CHECK:     krnl.iterate([[OPT_LOOPS_REDUCE]]) with ([[LOOPS_REDUCE]] -> %arg6 = 0 to 5) {
-  // CHECK:       [[LOAD_0:%.+]] = load %arg0[%arg2, %arg3, %arg4, %arg6] : memref<2x3x10x5xf32>
-  // CHECK:       [[LOAD_1:%.+]] = load %arg1[%arg2, %arg3, %arg6, %arg5] : memref<2x3x5x10xf32>
-  // CHECK:       [[LOAD_RES:%.+]] = load [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x10x10xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[LOAD_0]], [[LOAD_1]] : f32
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD_RES]], [[MUL]] : f32
-  // CHECK:       store [[ADD]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x10x10xf32>
-  // CHECK:     }
-  // CHECK:   }
-  // CHECK: }
+  // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[LOOPS]]#0
+  // CHECK: krnl.iterate({{.*}}) with ([[LOOPS]]#0 -> %arg2 = 0 to 2, [[LOOPS]]#1 -> %arg3 = 0 to 3) {
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<2x3x10x10xf32>
+  // CHECK:   [[LOAD_B:%.+]] = load %arg1[%arg2, %arg3, {{.*}}, {{.*}}] : memref<2x3x5x10xf32>
+  // CHECK:   [[LOAD_A:%.+]] = load %arg0[%arg2, %arg3, {{.*}}, {{.*}}] : memref<2x3x10x5xf32>
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<2x3x10x10xf32>
   // CHECK: return [[RES]] : memref<2x3x10x10xf32>
 }
 
+// N-D x N-D with broadcasting of the batch dimensions
+func @test_matmul_broadcast(%arg0 : tensor<1x3x10x5xf32>, %arg1 : tensor<?x1x5x10xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<1x3x10x5xf32>, tensor<?x1x5x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_broadcast
+  // CHECK: [[DIM_0:%.+]] = dim %arg1, 0 : memref<?x1x5x10xf32>
+  // CHECK: [[RES:%.+]] = alloc([[DIM_0]]) : memref<?x3x10x10xf32>
+  // CHECK: [[DIM_1:%.+]] = dim %arg1, 0 : memref<?x1x5x10xf32>
+  // CHECK: [[ONE:%.+]] = constant 1 : index
+  // CHECK: [[IS_BROADCASTED:%.+]] = cmpi "eq", [[DIM_1]], [[ONE]] : index
+  // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[LOOPS]]#0
+  // CHECK: [[DIM_2:%.+]] = dim [[RES]], 0 : memref<?x3x10x10xf32>
+  // CHECK: krnl.iterate({{.*}}) with ([[LOOPS]]#0 -> %arg2 = 0 to [[DIM_2]], [[LOOPS]]#1 -> %arg3 = 0 to 3) {
+  // CHECK:   constant 0 : index
+  // CHECK:   %[[A_ZERO:[a-z0-9_]+]] = constant 0 : index
+  // CHECK:   %[[B_ZERO_1:[a-z0-9_]+]] = constant 0 : index
+  // CHECK:   %[[B_ZERO_0:[a-z0-9_]+]] = constant 0 : index
+  // CHECK:   [[B_IDX:%.+]] = select [[IS_BROADCASTED]], %[[B_ZERO_0]], %arg2 : index
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<?x3x10x10xf32>
+  // CHECK:   [[LOAD_B:%.+]] = load %arg1[[[B_IDX]], %[[B_ZERO_1]], {{.*}}, {{.*}}] : memref<?x1x5x10xf32>
+  // CHECK:   [[LOAD_A:%.+]] = load %arg0[%[[A_ZERO]], %arg3, {{.*}}, {{.*}}] : memref<1x3x10x5xf32>
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<?x3x10x10xf32>
+  // CHECK: return [[RES]] : memref<?x3x10x10xf32>
+}
+
 // 1-D x 2-D
 func @test_matmul4(%arg0 : tensor<5xf32>, %arg1 : tensor<5x10xf32>) -> tensor<*xf32> {
   %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<5xf32>, tensor<5x10xf32>) -> tensor<*xf32>
@@ -1148,45 +1515,64 @@ func @test_matmul7(%arg0 : tensor<5xf32>, %arg1 : tensor<5xf32>) -> tensor<*xf32
   // CHECK: return [[RES]] : memref<1xf32>
 }
 
+// An empty reduction leaves the output filled with zeros.
+func @test_matmul_empty_reduction(%arg0 : tensor<10x0xf32>, %arg1 : tensor<0x10xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<10x0xf32>, tensor<0x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_empty_reduction
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 10, {{.*}} -> %arg3 = 0 to 10) {
+  // CHECK:   [[CONSTANT:%.+]] = constant 0.000000e+00 : f32
+  // CHECK:   store [[CONSTANT]], [[RES]][%arg2, %arg3] : memref<10x10xf32>
+  // CHECK: }
+  // CHECK-NOT: alloc
+  // CHECK-NOT: krnl.iterate
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
 func @test_conv_no_bias_no_pad(%arg0 : tensor<1x2x32x64xf32>, %arg1 : tensor<5x2x6x7xf32>) -> tensor<*xf32> {
   %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
 
   // CHECK-LABEL: test_conv_no_bias_no_pad
   // CHECK: [[RES:%.+]] = alloc() : memref<1x5x27x58xf32>
-  // CHECK: [[CONST0:%.+]] = constant 5 : index
-  // CHECK: [[CONST1:%.+]] = constant 0.000000e+00 : f32
-  // CHECK: [[CONST2:%.+]] = constant 2 : index
-  // CHECK: [[OUTER_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK: [[OPT_OUTER_LOOPS:%.+]]:2 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[OUTER_LOOPS]]#0, [[OUTER_LOOPS]]#1
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
-
-  // CHECK: krnl.iterate([[OPT_OUTER_LOOPS]]#0, [[OPT_OUTER_LOOPS]]#1) with ([[OUTER_LOOPS]]#0 -> %arg2 = 0 to 1, [[OUTER_LOOPS]]#1 -> %arg3 = 0 to 5) {
-  // CHECK: [[SPATIAL_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK: [[OPT_SPATIAL_LOOPS:%.+]]:2 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[SPATIAL_LOOPS]]#0, [[SPATIAL_LOOPS]]#1
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
-
-  // CHECK: krnl.iterate([[OPT_SPATIAL_LOOPS]]#0, [[OPT_SPATIAL_LOOPS]]#1) with ([[SPATIAL_LOOPS]]#0 -> %arg4 = 0 to 27, [[SPATIAL_LOOPS]]#1 -> %arg5 = 0 to 58) {
-  // CHECK: store [[CONST1]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x5x27x58xf32>
-  // CHECK: [[INNER_LOOPS:%.+]]:3 = krnl.define_loops 3
-  // CHECK: [[OPT_INNER_LOOPS:%.+]]:3 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[INNER_LOOPS]]#0, [[INNER_LOOPS]]#1, [[INNER_LOOPS]]#2
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop)
-
-  // CHECK: krnl.iterate([[OPT_INNER_LOOPS]]#0, [[OPT_INNER_LOOPS]]#1, [[OPT_INNER_LOOPS]]#2) with ([[INNER_LOOPS]]#0 -> %arg6 = 0 to 2, [[INNER_LOOPS]]#1 -> %arg7 = 0 to 6, [[INNER_LOOPS]]#2 -> %arg8 = 0 to 7) {
-  // CHECK: [[R1PLUSK1:%.+]] = addi %arg4, %arg7 : index
-  // CHECK: [[R2PLUSK2:%.+]] = addi %arg5, %arg8 : index
-  // CHECK: [[DATA:%.+]] = load %arg0[%arg2, %arg6, [[R1PLUSK1]], [[R2PLUSK2]]] : memref<1x2x32x64xf32>
-  // CHECK: [[KERNEL:%.+]] = load %arg1[%arg3, %arg6, %arg7, %arg8] : memref<5x2x6x7xf32>
-  // CHECK: [[ACC_RES:%.+]] = load %0[%arg2, %arg3, %arg4, %arg5] : memref<1x5x27x58xf32>
-  // CHECK: [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
-  // CHECK: [[ADD:%.+]] = addf [[ACC_RES]], [[MUL]] : f32
-  // CHECK: store [[ADD]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x5x27x58xf32>
-  // CHECK: }
-  // CHECK: }
+  // CHECK: [[FILL_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[FILL_LOOPS]]#1
+  // CHECK:   krnl.vectorize [[FILL_LOOPS]]#3 8
+  // CHECK: krnl.iterate({{.*}}) with ([[FILL_LOOPS]]#0 -> %arg2 = 0 to 1, [[FILL_LOOPS]]#1 -> %arg3 = 0 to 5, [[FILL_LOOPS]]#2 -> %arg4 = 0 to 27, [[FILL_LOOPS]]#3 -> %arg5 = 0 to 58) {
+  // CHECK:   [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK:   store [[ZERO]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x5x27x58xf32>
   // CHECK: }
+  // CHECK: [[OUTER_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: [[OPT_OUTER_LOOPS:%.+]] = krnl.optimize_loops  {
+  // CHECK-NEXT: krnl.return_loops [[OUTER_LOOPS]]
+  // CHECK: krnl.iterate([[OPT_OUTER_LOOPS]]) with ([[OUTER_LOOPS]] -> %arg2 = 0 to 1) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} = 0 to 2, {{.*}} = 0 to 1) {
+  // CHECK:     [[PACKED_DATA:%.+]] = alloc() : memref<128x84x8xf32>
+  // CHECK:     [[DATA:%.+]] = load %arg0[%arg2, {{.*}}, {{.*}}, {{.*}}] : memref<1x2x32x64xf32>
+  // CHECK:     store [[DATA]], [[PACKED_DATA]][{{.*}}] : memref<128x84x8xf32>
+  // CHECK:     krnl.parallel
+  // CHECK:     [[PACKED_KERNEL:%.+]] = alloc() : memref<2x84x4xf32>
+  // CHECK:     [[ACC:%.+]] = "krnl.alloca"() : () -> memref<4x8xf32>
+  // CHECK:     [[KERNEL:%.+]] = load %arg1[{{.*}}, {{.*}}, {{.*}}, {{.*}}] : memref<5x2x6x7xf32>
+  // CHECK:     store [[KERNEL]], [[PACKED_KERNEL]][{{.*}}] : memref<2x84x4xf32>
+  // CHECK:     krnl.unroll_jam {{.*}} 4
+  // CHECK:     krnl.vectorize {{.*}} 8
+  // CHECK:     [[LOAD_KERNEL:%.+]] = load [[PACKED_KERNEL]][{{.*}}] : memref<2x84x4xf32>
+  // CHECK:     [[LOAD_DATA:%.+]] = load [[PACKED_DATA]][{{.*}}] : memref<128x84x8xf32>
+  // CHECK:     [[LOAD_ACC:%.+]] = load [[ACC]][{{.*}}] : memref<4x8xf32>
+  // CHECK:     [[MUL:%.+]] = mulf [[LOAD_KERNEL]], [[LOAD_DATA]] : f32
+  // CHECK:     [[SUM:%.+]] = addf [[LOAD_ACC]], [[MUL]] : f32
+  // CHECK:     store [[SUM]], [[ACC]][{{.*}}] : memref<4x8xf32>
+  // CHECK:     [[LOAD_TILE:%.+]] = load [[ACC]][{{.*}}] : memref<4x8xf32>
+  // CHECK:     [[ACC_RES:%.+]] = load [[RES]][%arg2, {{.*}}, {{.*}}, {{.*}}] : memref<1x5x27x58xf32>
+  // CHECK:     [[ADD:%.+]] = addf [[ACC_RES]], [[LOAD_TILE]] : f32
+  // CHECK:     store [[ADD]], [[RES]][%arg2, {{.*}}, {{.*}}, {{.*}}] : memref<1x5x27x58xf32>
+  // CHECK-NOT: dealloc [[ACC]]
+  // CHECK:     dealloc [[PACKED_KERNEL]] : memref<2x84x4xf32>
+  // CHECK:     dealloc [[PACKED_DATA]] : memref<128x84x8xf32>
 
   // CHECK: return [[RES]] : memref<1x5x27x58xf32>
 }
@@ -1197,40 +1583,46 @@ func @test_conv_no_bias_no_pad_w_group(%arg0 : tensor<1x9x32x64xf32>, %arg1 : te
 
   // CHECK-LABEL: test_conv_no_bias_no_pad_w_group
   // CHECK: [[RES:%.+]] = alloc() : memref<1x5x27x58xf32>
-  // CHECK: [[CONST0:%.+]] = constant 1 : index
-  // CHECK: [[CONST1:%.+]] = constant 0.000000e+00 : f32
-  // CHECK: [[CONST2:%.+]] = constant 3 : index
   // CHECK: [[OUTER_LOOPS:%.+]]:3 = krnl.define_loops 3
   // CHECK: [[OPT_OUTER_LOOPS:%.+]]:3 = krnl.optimize_loops  {
+  // CHECK: krnl.parallel [[OUTER_LOOPS]]#1
   // CHECK: krnl.return_loops [[OUTER_LOOPS]]#0, [[OUTER_LOOPS]]#1, [[OUTER_LOOPS]]#2
   // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop)
 
+  // With few input channels per group, the convolution is computed one row
+  // of the output at a time, vectorized along the row.
   // CHECK: krnl.iterate([[OPT_OUTER_LOOPS]]#0, [[OPT_OUTER_LOOPS]]#1, [[OPT_OUTER_LOOPS]]#2) with ([[OUTER_LOOPS]]#0 -> %arg2 = 0 to 1, [[OUTER_LOOPS]]#1 -> %arg3 = 0 to 3, [[OUTER_LOOPS]]#2 -> %arg4 = 0 to 1) {
-  // CHECK: [[MUL1:%.+]] = muli %arg3, [[CONST0]] : index
-  // CHECK: %[[ADD1:.+]] = addi [[MUL1]], %arg4 : index
-  // CHECK: [[SPATIAL_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK: [[OPT_SPATIAL_LOOPS:%.+]]:2 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[SPATIAL_LOOPS]]#0, [[SPATIAL_LOOPS]]#1
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[ROW_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: [[OPT_ROW_LOOPS:%.+]] = krnl.optimize_loops  {
+  // CHECK: krnl.return_loops [[ROW_LOOPS]]
+  // CHECK: } : () -> !krnl.loop
+  // CHECK: krnl.iterate([[OPT_ROW_LOOPS]]) with ([[ROW_LOOPS]] -> %arg5 = 0 to 27) {
 
-  // CHECK: krnl.iterate([[OPT_SPATIAL_LOOPS]]#0, [[OPT_SPATIAL_LOOPS]]#1) with ([[SPATIAL_LOOPS]]#0 -> %arg5 = 0 to 27, [[SPATIAL_LOOPS]]#1 -> %arg6 = 0 to 58) {
-  // CHECK: store [[CONST1]], [[RES]][%arg2, %[[ADD1]], %arg5, %arg6] : memref<1x5x27x58xf32>
-  // CHECK: [[INNER_LOOPS:%.+]]:3 = krnl.define_loops 3
-  // CHECK: [[OPT_INNER_LOOPS:%.+]]:3 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[INNER_LOOPS]]#0, [[INNER_LOOPS]]#1, [[INNER_LOOPS]]#2
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop)
+  // CHECK: [[INIT_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: [[OPT_INIT_LOOPS:%.+]] = krnl.optimize_loops  {
+  // CHECK: krnl.vectorize [[INIT_LOOPS]] 8
+  // CHECK: krnl.return_loops [[INIT_LOOPS]]
+  // CHECK: } : () -> !krnl.loop
+  // CHECK: krnl.iterate([[OPT_INIT_LOOPS]]) with ([[INIT_LOOPS]] -> %arg6 = 0 to 58) {
+  // CHECK: store [[ZERO]], [[RES]][%arg2, %arg3, %arg5, %arg6] : memref<1x5x27x58xf32>
+  // CHECK: }
 
-  // CHECK: krnl.iterate([[OPT_INNER_LOOPS]]#0, [[OPT_INNER_LOOPS]]#1, [[OPT_INNER_LOOPS]]#2) with ([[INNER_LOOPS]]#0 -> %arg7 = 0 to 3, [[INNER_LOOPS]]#1 -> %arg8 = 0 to 6, [[INNER_LOOPS]]#2 -> %arg9 = 0 to 7) {
-  // CHECK: [[MUL2:%.+]] = muli [[CONST2]], %arg3 : index
-  // CHECK: [[ADD2:%.+]] = addi %arg7, [[MUL2]] : index
+  // CHECK: [[INNER_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: [[OPT_INNER_LOOPS:%.+]]:4 = krnl.optimize_loops  {
+  // CHECK: krnl.vectorize [[INNER_LOOPS]]#3 8
+  // CHECK: krnl.return_loops [[INNER_LOOPS]]#0, [[INNER_LOOPS]]#1, [[INNER_LOOPS]]#2, [[INNER_LOOPS]]#3
+  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
+  // CHECK: krnl.iterate([[OPT_INNER_LOOPS]]#0, [[OPT_INNER_LOOPS]]#1, [[OPT_INNER_LOOPS]]#2, [[OPT_INNER_LOOPS]]#3) with ([[INNER_LOOPS]]#0 -> %arg7 = 0 to 3, [[INNER_LOOPS]]#1 -> %arg8 = 0 to 6, [[INNER_LOOPS]]#2 -> %arg9 = 0 to 7, [[INNER_LOOPS]]#3 -> %arg10 = 0 to 58) {
+  // CHECK: [[CHANNEL:%.+]] = affine.apply #{{.*}}(%arg3, %arg7)
   // CHECK: [[R1PLUSK1:%.+]] = addi %arg5, %arg8 : index
-  // CHECK: [[R2PLUSK2:%.+]] = addi %arg6, %arg9 : index
-  // CHECK: [[DATA:%.+]] = load %arg0[%arg2, [[ADD2]], [[R1PLUSK1]], [[R2PLUSK2]]] : memref<1x9x32x64xf32>
-  // CHECK: [[KERNEL:%.+]] = load %arg1[%[[ADD1]], %arg7, %arg8, %arg9] : memref<5x3x6x7xf32>
-  // CHECK: [[ACC_RES:%.+]] = load %0[%arg2, %[[ADD1]], %arg5, %arg6] : memref<1x5x27x58xf32>
+  // CHECK: [[R2PLUSK2:%.+]] = addi %arg10, %arg9 : index
+  // CHECK: [[DATA:%.+]] = load %arg0[%arg2, [[CHANNEL]], [[R1PLUSK1]], [[R2PLUSK2]]] : memref<1x9x32x64xf32>
+  // CHECK: [[KERNEL:%.+]] = load %arg1[%arg3, %arg7, %arg8, %arg9] : memref<5x3x6x7xf32>
+  // CHECK: [[ACC_RES:%.+]] = load [[RES]][%arg2, %arg3, %arg5, %arg10] : memref<1x5x27x58xf32>
   // CHECK: [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
   // CHECK: [[ADD:%.+]] = addf [[ACC_RES]], [[MUL]] : f32
-  // CHECK: store [[ADD]], [[RES]][%arg2, %[[ADD1]], %arg5, %arg6] : memref<1x5x27x58xf32>
+  // CHECK: store [[ADD]], [[RES]][%arg2, %arg3, %arg5, %arg10] : memref<1x5x27x58xf32>
   // CHECK: }
   // CHECK: }
   // CHECK: }
@@ -1238,51 +1630,335 @@ func @test_conv_no_bias_no_pad_w_group(%arg0 : tensor<1x9x32x64xf32>, %arg1 : te
   // CHECK: return [[RES]] : memref<1x5x27x58xf32>
 }
 
+func @test_conv_no_bias_w_pads(%arg0 : tensor<1x1x4x4xf32>, %arg1 : tensor<2x1x3x3xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64, pads = [1, 1, 1, 1]} : (tensor<1x1x4x4xf32>, tensor<2x1x3x3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_no_bias_w_pads
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x2x4x4xf32>
+  // CHECK: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 2) {
+
+  // Border of the first spatial dimension, bounds checked in both dimensions.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 1, {{.*}} -> %arg5 = 0 to 4) {
+  // CHECK: store [[ZERO]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x2x4x4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg6 = 0 to 1, {{.*}} -> %arg7 = 0 to 3, {{.*}} -> %arg8 = 0 to 3) {
+  // CHECK: [[R1PLUSK1:%.+]] = addi %arg4, %arg7 : index
+  // CHECK: [[PAD_0:%.+]] = constant 1 : index
+  // CHECK: [[H:%.+]] = subi [[R1PLUSK1]], [[PAD_0]] : index
+  // CHECK: [[R2PLUSK2:%.+]] = addi %arg5, %arg8 : index
+  // CHECK: [[PAD_1:%.+]] = constant 1 : index
+  // CHECK: [[W:%.+]] = subi [[R2PLUSK2]], [[PAD_1]] : index
+  // CHECK: [[ZERO_INDEX:%.+]] = constant 0 : index
+  // CHECK: [[DIM_0:%.+]] = constant 4 : index
+  // CHECK: [[H_NON_NEGATIVE:%.+]] = cmpi "sge", [[H]], [[ZERO_INDEX]] : index
+  // CHECK: [[H_BELOW_DIM:%.+]] = cmpi "slt", [[H]], [[DIM_0]] : index
+  // CHECK: [[H_IN_BOUNDS:%.+]] = and [[H_NON_NEGATIVE]], [[H_BELOW_DIM]] : i1
+  // CHECK: [[CLAMPED_H:%.+]] = select [[H_IN_BOUNDS]], [[H]], [[ZERO_INDEX]] : index
+  // CHECK: [[DIM_1:%.+]] = constant 4 : index
+  // CHECK: [[W_NON_NEGATIVE:%.+]] = cmpi "sge", [[W]], [[ZERO_INDEX]] : index
+  // CHECK: [[W_BELOW_DIM:%.+]] = cmpi "slt", [[W]], [[DIM_1]] : index
+  // CHECK: [[W_IN_BOUNDS:%.+]] = and [[W_NON_NEGATIVE]], [[W_BELOW_DIM]] : i1
+  // CHECK: [[CLAMPED_W:%.+]] = select [[W_IN_BOUNDS]], [[W]], [[ZERO_INDEX]] : index
+  // CHECK: [[IN_BOUNDS:%.+]] = and [[H_IN_BOUNDS]], [[W_IN_BOUNDS]] : i1
+  // CHECK: [[LOAD_DATA:%.+]] = load %arg0[%arg2, %arg6, [[CLAMPED_H]], [[CLAMPED_W]]] : memref<1x1x4x4xf32>
+  // CHECK: [[DATA:%.+]] = select [[IN_BOUNDS]], [[LOAD_DATA]], [[ZERO]] : f32
+  // CHECK: [[KERNEL:%.+]] = load %arg1[%arg3, %arg6, %arg7, %arg8] : memref<2x1x3x3xf32>
+  // CHECK: [[ACC_RES:%.+]] = load [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x2x4x4xf32>
+  // CHECK: [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
+  // CHECK: [[ADD:%.+]] = addf [[ACC_RES]], [[MUL]] : f32
+  // CHECK: store [[ADD]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x2x4x4xf32>
+
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 3 to 4, {{.*}} -> %arg5 = 0 to 4) {
+  // CHECK: select {{.*}} : f32
+
+  // Borders of the second spatial dimension, within the interior of the first one.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 1 to 3, {{.*}} -> %arg5 = 0 to 1) {
+  // CHECK: select {{.*}} : f32
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 1 to 3, {{.*}} -> %arg5 = 3 to 4) {
+  // CHECK: select {{.*}} : f32
+
+  // Interior, free of bounds checks.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 1 to 3, {{.*}} -> %arg5 = 1 to 3) {
+  // CHECK: store [[ZERO]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x2x4x4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg6 = 0 to 1, {{.*}} -> %arg7 = 0 to 3, {{.*}} -> %arg8 = 0 to 3) {
+  // CHECK: [[R1PLUSK1:%.+]] = addi %arg4, %arg7 : index
+  // CHECK: [[PAD_0:%.+]] = constant 1 : index
+  // CHECK: [[H:%.+]] = subi [[R1PLUSK1]], [[PAD_0]] : index
+  // CHECK: [[R2PLUSK2:%.+]] = addi %arg5, %arg8 : index
+  // CHECK: [[PAD_1:%.+]] = constant 1 : index
+  // CHECK: [[W:%.+]] = subi [[R2PLUSK2]], [[PAD_1]] : index
+  // CHECK-NEXT: [[DATA:%.+]] = load %arg0[%arg2, %arg6, [[H]], [[W]]] : memref<1x1x4x4xf32>
+  // CHECK-NEXT: [[KERNEL:%.+]] = load %arg1[%arg3, %arg6, %arg7, %arg8] : memref<2x1x3x3xf32>
+  // CHECK-NEXT: [[ACC_RES:%.+]] = load [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x2x4x4xf32>
+  // CHECK-NEXT: [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
+  // CHECK-NEXT: [[ADD:%.+]] = addf [[ACC_RES]], [[MUL]] : f32
+  // CHECK-NEXT: store [[ADD]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x2x4x4xf32>
+
+  // CHECK: return [[RES]] : memref<1x2x4x4xf32>
+}
+
 func @test_conv_no_bias_no_pad_w_strides(%arg0 : tensor<1x9x32x64xf32>, %arg1 : tensor<5x9x6x7xf32>) -> tensor<*xf32> {
   %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64, strides = [2, 2]} : (tensor<1x9x32x64xf32>, tensor<5x9x6x7xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
 
   // CHECK-LABEL: test_conv_no_bias_no_pad_w_strides
   // CHECK: [[RES:%.+]] = alloc() : memref<1x5x14x29xf32>
-  // CHECK: [[CONST0:%.+]] = constant 5 : index
-  // CHECK: [[CONST1:%.+]] = constant 0.000000e+00 : f32
-  // CHECK: [[CONST2:%.+]] = constant 9 : index
-  // CHECK: [[OUTER_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK: [[OPT_OUTER_LOOPS:%.+]]:2 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[OUTER_LOOPS]]#0, [[OUTER_LOOPS]]#1
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 5, {{.*}} -> %arg4 = 0 to 14, {{.*}} -> %arg5 = 0 to 29) {
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x5x14x29xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} = 0 to 1, {{.*}} = 0 to 2) {
+  // CHECK:     [[PACKED_DATA:%.+]] = alloc() : memref<51x256x8xf32>
+  // CHECK:     [[DATA:%.+]] = load %arg0[%arg2, {{.*}}, {{.*}}, {{.*}}] : memref<1x9x32x64xf32>
+  // CHECK:     store [[DATA]], [[PACKED_DATA]][{{.*}}] : memref<51x256x8xf32>
+  // CHECK:     [[PACKED_KERNEL:%.+]] = alloc() : memref<2x256x4xf32>
+  // CHECK:     [[KERNEL:%.+]] = load %arg1[{{.*}}, {{.*}}, {{.*}}, {{.*}}] : memref<5x9x6x7xf32>
+  // CHECK:     store [[KERNEL]], [[PACKED_KERNEL]][{{.*}}] : memref<2x256x4xf32>
+  // CHECK:     store {{.*}}, [[RES]][%arg2, {{.*}}, {{.*}}, {{.*}}] : memref<1x5x14x29xf32>
 
-  // CHECK: krnl.iterate([[OPT_OUTER_LOOPS]]#0, [[OPT_OUTER_LOOPS]]#1) with ([[OUTER_LOOPS]]#0 -> %arg2 = 0 to 1, [[OUTER_LOOPS]]#1 -> %arg3 = 0 to 5) {
-  // CHECK: [[SPATIAL_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK: [[OPT_SPATIAL_LOOPS:%.+]]:2 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[SPATIAL_LOOPS]]#0, [[SPATIAL_LOOPS]]#1
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop)
+  // CHECK: return [[RES]] : memref<1x5x14x29xf32>
+}
 
-  // CHECK: krnl.iterate([[OPT_SPATIAL_LOOPS]]#0, [[OPT_SPATIAL_LOOPS]]#1) with ([[SPATIAL_LOOPS]]#0 -> %arg4 = 0 to 14, [[SPATIAL_LOOPS]]#1 -> %arg5 = 0 to 29) {
-  // CHECK: store [[CONST1]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x5x14x29xf32>
-  // CHECK: [[INNER_LOOPS:%.+]]:3 = krnl.define_loops 3
-  // CHECK: [[OPT_INNER_LOOPS:%.+]]:3 = krnl.optimize_loops  {
-  // CHECK: krnl.return_loops [[INNER_LOOPS]]#0, [[INNER_LOOPS]]#1, [[INNER_LOOPS]]#2
-  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop)
+func @test_conv_no_bias_winograd(%arg0 : tensor<1x16x10x10xf32>, %arg1 : tensor<16x16x3x3xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x16x10x10xf32>, tensor<16x16x3x3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
 
-  // CHECK: krnl.iterate([[OPT_INNER_LOOPS]]#0, [[OPT_INNER_LOOPS]]#1, [[OPT_INNER_LOOPS]]#2) with ([[INNER_LOOPS]]#0 -> %arg6 = 0 to 9, [[INNER_LOOPS]]#1 -> %arg7 = 0 to 6, [[INNER_LOOPS]]#2 -> %arg8 = 0 to 7) {
-  // CHECK: [[CONST_STRIDE1:%.+]] = constant 2 : index
-  // CHECK: [[MUL1:%.+]] = muli [[CONST_STRIDE1]], %arg4 : index
-  // CHECK: [[R1PLUSK1:%.+]] = addi [[MUL1]], %arg7 : index
-  // CHECK: [[CONST_STRIDE2:%.+]] = constant 2 : index
-  // CHECK: [[MUL2:%.+]] = muli [[CONST_STRIDE2]], %arg5 : index
-  // CHECK: [[R2PLUSK2:%.+]] = addi [[MUL2]], %arg8 : index
-  // CHECK: [[DATA:%.+]] = load %arg0[%arg2, %arg6, [[R1PLUSK1]], [[R2PLUSK2]]] : memref<1x9x32x64xf32>
-  // CHECK: [[KERNEL:%.+]] = load %arg1[%arg3, %arg6, %arg7, %arg8] : memref<5x9x6x7xf32>
-  // CHECK: [[ACC_RES:%.+]] = load %0[%arg2, %arg3, %arg4, %arg5] : memref<1x5x14x29xf32>
-  // CHECK: [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
-  // CHECK: [[ADD:%.+]] = addf [[ACC_RES]], [[MUL]] : f32
-  // CHECK: store [[ADD]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x5x14x29xf32>
+  // CHECK-LABEL: test_conv_no_bias_winograd
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x16x8x8xf32>
+  // CHECK: [[C0:%.+]] = constant 0 : index
+  // CHECK: [[C1:%.+]] = constant 1 : index
+  // CHECK: [[C35:%.+]] = constant 35 : index
+  // CHECK: [[KERNEL_TRANSFORM:%.+]] = alloc() : memref<36x16x16xf32>
+  // CHECK: [[KERNEL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[KERNEL_LOOPS]]#0
+  // CHECK: krnl.iterate({{.*}}) with ([[KERNEL_LOOPS]]#0 -> %arg2 = 0 to 16, [[KERNEL_LOOPS]]#1 -> %arg3 = 0 to 16) {
+  // CHECK:   [[K00:%.+]] = load %arg1[%arg2, %arg3, [[C0]], [[C0]]] : memref<16x16x3x3xf32>
+  // CHECK:   [[K01:%.+]] = load %arg1[%arg2, %arg3, [[C0]], [[C1]]] : memref<16x16x3x3xf32>
+  // CHECK:   [[QUARTER:%.+]] = constant 2.500000e-01 : f32
+  // CHECK:   [[G_K00:%.+]] = mulf [[QUARTER]], [[K00]] : f32
+  // CHECK:   [[U0:%.+]] = mulf [[QUARTER]], [[G_K00]] : f32
+  // CHECK:   store [[U0]], [[KERNEL_TRANSFORM]]{{\[}}[[C0]], %arg2, %arg3] : memref<36x16x16xf32>
+  // CHECK:   store {{.*}}, [[KERNEL_TRANSFORM]]{{\[}}[[C35]], %arg2, %arg3] : memref<36x16x16xf32>
+  // CHECK: }
+  // CHECK: [[DATA_TRANSFORM:%.+]] = alloc() : memref<36x16x4xf32>
+  // CHECK: [[DATA_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DATA_LOOPS]]#1
+  // CHECK: krnl.iterate({{.*}}) with ([[DATA_LOOPS]]#0 -> %arg2 = 0 to 1, [[DATA_LOOPS]]#1 -> %arg3 = 0 to 16, [[DATA_LOOPS]]#2 -> %arg4 = 0 to 2, [[DATA_LOOPS]]#3 -> %arg5 = 0 to 2) {
+  // CHECK:   [[TILE:%.+]] = affine.apply #{{.*}}(%arg2, %arg4, %arg5)
+  // CHECK:   [[ROW:%.+]] = affine.apply #{{.*}}(%arg4)
+  // CHECK:   [[COLUMN:%.+]] = affine.apply #{{.*}}(%arg5)
+  // CHECK:   [[D00:%.+]] = load %arg0[%arg2, %arg3, [[ROW]], [[COLUMN]]] : memref<1x16x10x10xf32>
+  // CHECK:   store {{.*}}, [[DATA_TRANSFORM]]{{\[}}[[C0]], %arg3, [[TILE]]] : memref<36x16x4xf32>
+  // CHECK:   store {{.*}}, [[DATA_TRANSFORM]]{{\[}}[[C35]], %arg3, [[TILE]]] : memref<36x16x4xf32>
   // CHECK: }
+  // CHECK: [[PRODUCTS:%.+]] = alloc() : memref<36x16x4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 36, {{.*}} -> %arg3 = 0 to 16, {{.*}} -> %arg4 = 0 to 4) {
+  // CHECK:   store {{.*}}, [[PRODUCTS]][%arg2, %arg3, %arg4] : memref<36x16x4xf32>
   // CHECK: }
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 36) {
+  // CHECK:   load [[DATA_TRANSFORM]][%arg2, {{.*}}, {{.*}}] : memref<36x16x4xf32>
+  // CHECK:   krnl.parallel
+  // CHECK:   load [[KERNEL_TRANSFORM]][%arg2, {{.*}}, {{.*}}] : memref<36x16x16xf32>
+  // CHECK:   [[PARTIAL:%.+]] = load [[PRODUCTS]][%arg2, {{.*}}, {{.*}}] : memref<36x16x4xf32>
+  // CHECK:   [[SUM:%.+]] = addf [[PARTIAL]], {{.*}} : f32
+  // CHECK:   store [[SUM]], [[PRODUCTS]][%arg2, {{.*}}, {{.*}}] : memref<36x16x4xf32>
   // CHECK: }
+  // CHECK: dealloc [[DATA_TRANSFORM]] : memref<36x16x4xf32>
+  // CHECK: dealloc [[KERNEL_TRANSFORM]] : memref<36x16x16xf32>
+  // CHECK: [[OUTPUT_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[OUTPUT_LOOPS]]#1
+  // CHECK: krnl.iterate({{.*}}) with ([[OUTPUT_LOOPS]]#0 -> %arg2 = 0 to 1, [[OUTPUT_LOOPS]]#1 -> %arg3 = 0 to 16, [[OUTPUT_LOOPS]]#2 -> %arg4 = 0 to 2, [[OUTPUT_LOOPS]]#3 -> %arg5 = 0 to 2) {
+  // CHECK:   [[TILE:%.+]] = affine.apply #{{.*}}(%arg2, %arg4, %arg5)
+  // CHECK:   [[P0:%.+]] = load [[PRODUCTS]]{{\[}}[[C0]], %arg3, [[TILE]]] : memref<36x16x4xf32>
+  // CHECK:   [[P35:%.+]] = load [[PRODUCTS]]{{\[}}[[C35]], %arg3, [[TILE]]] : memref<36x16x4xf32>
+  // CHECK:   [[ROW:%.+]] = affine.apply #{{.*}}(%arg4)
+  // CHECK:   [[COLUMN:%.+]] = affine.apply #{{.*}}(%arg5)
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, [[ROW]], [[COLUMN]]] : memref<1x16x8x8xf32>
+  // CHECK: }
+  // CHECK: dealloc [[PRODUCTS]] : memref<36x16x4xf32>
+  // CHECK: return [[RES]] : memref<1x16x8x8xf32>
+}
 
-  // CHECK: return [[RES]] : memref<1x5x14x29xf32>
+func @test_conv_no_bias_winograd_w_pads(%arg0 : tensor<1x16x7x7xf32>, %arg1 : tensor<16x16x3x3xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64, pads = [1, 1, 1, 1]} : (tensor<1x16x7x7xf32>, tensor<16x16x3x3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_no_bias_winograd_w_pads
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x16x7x7xf32>
+  // CHECK: [[KERNEL_TRANSFORM:%.+]] = alloc() : memref<16x16x16xf32>
+  // CHECK: [[PADDED_DATA:%.+]] = alloc() : memref<1x16x10x10xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 16, {{.*}} -> %arg4 = 0 to 10, {{.*}} -> %arg5 = 0 to 10) {
+  // CHECK:   store {{.*}}, [[PADDED_DATA]][%arg2, %arg3, %arg4, %arg5] : memref<1x16x10x10xf32>
+  // CHECK: }
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 16, {{.*}} -> %arg4 = 0 to 7, {{.*}} -> %arg5 = 0 to 7) {
+  // CHECK:   [[DATA:%.+]] = load %arg0[%arg2, %arg3, %arg4, %arg5] : memref<1x16x7x7xf32>
+  // CHECK:   [[ROW:%.+]] = affine.apply #{{.*}}(%arg4)
+  // CHECK:   [[COLUMN:%.+]] = affine.apply #{{.*}}(%arg5)
+  // CHECK:   store [[DATA]], [[PADDED_DATA]][%arg2, %arg3, [[ROW]], [[COLUMN]]] : memref<1x16x10x10xf32>
+  // CHECK: }
+  // CHECK: [[DATA_TRANSFORM:%.+]] = alloc() : memref<16x16x16xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 16, {{.*}} -> %arg4 = 0 to 4, {{.*}} -> %arg5 = 0 to 4) {
+  // CHECK:   load [[PADDED_DATA]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<1x16x10x10xf32>
+  // CHECK:   store {{.*}}, [[DATA_TRANSFORM]][{{.*}}, %arg3, {{.*}}] : memref<16x16x16xf32>
+  // CHECK: }
+  // CHECK: dealloc [[PADDED_DATA]] : memref<1x16x10x10xf32>
+  // CHECK: [[PRODUCTS:%.+]] = alloc() : memref<16x16x16xf32>
+  // CHECK: dealloc [[DATA_TRANSFORM]] : memref<16x16x16xf32>
+  // CHECK: dealloc [[KERNEL_TRANSFORM]] : memref<16x16x16xf32>
+  // CHECK: [[PADDED_RES:%.+]] = alloc() : memref<1x16x8x8xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 16, {{.*}} -> %arg4 = 0 to 4, {{.*}} -> %arg5 = 0 to 4) {
+  // CHECK:   load [[PRODUCTS]][{{.*}}, %arg3, {{.*}}] : memref<16x16x16xf32>
+  // CHECK:   store {{.*}}, [[PADDED_RES]][%arg2, %arg3, {{.*}}, {{.*}}] : memref<1x16x8x8xf32>
+  // CHECK: }
+  // CHECK: dealloc [[PRODUCTS]] : memref<16x16x16xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 16, {{.*}} -> %arg4 = 0 to 7, {{.*}} -> %arg5 = 0 to 7) {
+  // CHECK:   [[OUTPUT:%.+]] = load [[PADDED_RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x16x8x8xf32>
+  // CHECK:   store [[OUTPUT]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<1x16x7x7xf32>
+  // CHECK: }
+  // CHECK: dealloc [[PADDED_RES]] : memref<1x16x8x8xf32>
+  // CHECK: return [[RES]] : memref<1x16x7x7xf32>
+}
+
+// The transform of constant kernels is computed at compile time: with kernels
+// of ones, U[i * 4 + j] = s[i] * s[j], where s = [1, 1.5, 0.5, 1] are the sums
+// of the rows of G.
+func @test_conv_no_bias_winograd_constant_kernel(%arg0 : tensor<1x16x6x6xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<1.000000e+00> : tensor<16x16x3x3xf32>} : () -> tensor<16x16x3x3xf32>
+  %1 = "onnx.ConvNoBias"(%arg0, %0) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x16x6x6xf32>, tensor<16x16x3x3xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_no_bias_winograd_constant_kernel
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x16x4x4xf32>
+  // CHECK: [[KERNEL_TRANSFORM:%.+]] = "krnl.global"() {value = dense<{{\[\[\[}}1.000000e+00, 1.000000e+00{{.*}}1.500000e+00{{.*}}2.250000e+00{{.*}}> : tensor<16x16x16xf32>} : () -> memref<16x16x16xf32>
+  // CHECK-NOT: store {{.*}}, [[KERNEL_TRANSFORM]]
+  // CHECK: [[DATA_TRANSFORM:%.+]] = alloc() : memref<16x16x4xf32>
+  // CHECK-NOT: dealloc [[KERNEL_TRANSFORM]]
+  // CHECK: return [[RES]] : memref<1x16x4x4xf32>
+}
+
+func @test_conv_no_bias_pointwise(%arg0 : tensor<2x16x7x7xf32>, %arg1 : tensor<32x16x1x1xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", group = 1 : i64} : (tensor<2x16x7x7xf32>, tensor<32x16x1x1xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_no_bias_pointwise
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x32x7x7xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 2, {{.*}} -> %arg3 = 0 to 32, {{.*}} -> %arg4 = 0 to 7, {{.*}} -> %arg5 = 0 to 7) {
+  // CHECK:   store {{%.+}}, [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x32x7x7xf32>
+  // CHECK: }
+  // CHECK: [[ZERO_INDEX:%.+]] = constant 0 : index
+
+  // The images of the batch are the columns of a single 16 x 98 matrix,
+  // read in place from the input.
+  // CHECK: [[N:%.+]] = affine.apply #{{.*}}([[P:%.+]])
+  // CHECK: [[R1:%.+]] = affine.apply #{{.*}}([[P]])
+  // CHECK: [[R2:%.+]] = affine.apply #{{.*}}([[P]])
+  // CHECK: load %arg0{{\[}}[[N]], {{%.+}}, [[R1]], [[R2]]{{\]}} : memref<2x16x7x7xf32>
+  // CHECK: load %arg1{{\[}}{{%.+}}, {{%.+}}, [[ZERO_INDEX]], [[ZERO_INDEX]]{{\]}} : memref<32x16x1x1xf32>
+  // CHECK: [[ACC_RES:%.+]] = load [[RES]]{{\[}}{{%.+}}, {{%.+}}, {{%.+}}, {{%.+}}{{\]}} : memref<2x32x7x7xf32>
+  // CHECK: [[ADD:%.+]] = addf [[ACC_RES]], {{%.+}} : f32
+  // CHECK: store [[ADD]], [[RES]]{{\[}}{{%.+}}, {{%.+}}, {{%.+}}, {{%.+}}{{\]}} : memref<2x32x7x7xf32>
+
+  // CHECK: return [[RES]] : memref<2x32x7x7xf32>
+}
+
+func @test_conv_activation_relu(%arg0 : tensor<1x1x4x4xf32>, %arg1 : tensor<2x1x2x2xf32>, %arg2 : tensor<2xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvActivation"(%arg0, %arg1, %arg2) {activation = "Relu", auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x1x4x4xf32>, tensor<2x1x2x2xf32>, tensor<2xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_activation_relu
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x2x3x3xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg3 = 0 to 1, {{.*}} -> %arg4 = 0 to 2) {
+  // CHECK: [[BIAS:%.+]] = load %arg2[%arg4] : memref<2xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg5 = 0 to 3, {{.*}} -> %arg6 = 0 to 3) {
+  // CHECK: store [[BIAS]], [[RES]][%arg3, %arg4, %arg5, %arg6] : memref<1x2x3x3xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg7 = 0 to 1, {{.*}} -> %arg8 = 0 to 2, {{.*}} -> %arg9 = 0 to 2) {
+  // CHECK: [[ACC_RES:%.+]] = load [[RES]][%arg3, %arg4, %arg5, %arg6] : memref<1x2x3x3xf32>
+  // CHECK: [[ADD:%.+]] = addf [[ACC_RES]], {{.*}} : f32
+  // CHECK: store [[ADD]], [[RES]][%arg3, %arg4, %arg5, %arg6] : memref<1x2x3x3xf32>
+  // CHECK: }
+
+  // The activation is applied once the output element is accumulated.
+  // CHECK: [[RESULT:%.+]] = load [[RES]][%arg3, %arg4, %arg5, %arg6] : memref<1x2x3x3xf32>
+  // CHECK: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[LESS_THAN_ZERO:%.+]] = cmpf "olt", [[RESULT]], [[ZERO]] : f32
+  // CHECK: [[RELU:%.+]] = select [[LESS_THAN_ZERO]], [[ZERO]], [[RESULT]] : f32
+  // CHECK: store [[RELU]], [[RES]][%arg3, %arg4, %arg5, %arg6] : memref<1x2x3x3xf32>
+  // CHECK: }
+
+  // CHECK: return [[RES]] : memref<1x2x3x3xf32>
+}
+
+func @test_conv_activation_clip_gemm(%arg0 : tensor<1x2x32x64xf32>, %arg1 : tensor<5x2x6x7xf32>, %arg2 : tensor<5xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvActivation"(%arg0, %arg1, %arg2) {activation = "Clip", activation_alpha = 0.000000e+00 : f32, activation_beta = 6.000000e+00 : f32, auto_pad = "NOTSET", group = 1 : i64} : (tensor<1x2x32x64xf32>, tensor<5x2x6x7xf32>, tensor<5xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_activation_clip_gemm
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x5x27x58xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg3 = 0 to 1, {{.*}} -> %arg4 = 0 to 5, {{.*}} -> %arg5 = 0 to 27, {{.*}} -> %arg6 = 0 to 58) {
+  // CHECK:   [[BIAS:%.+]] = load %arg2[%arg4] : memref<5xf32>
+  // CHECK:   store [[BIAS]], [[RES]][%arg3, %arg4, %arg5, %arg6] : memref<1x5x27x58xf32>
+  // CHECK: }
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg3 = 0 to 1) {
+
+  // The reduction fits in a single tile: the activation is applied as the
+  // products are accumulated into the output.
+  // CHECK:     [[ACC_RES:%.+]] = load [[RES]][%arg3, {{.*}}, {{.*}}, {{.*}}] : memref<1x5x27x58xf32>
+  // CHECK:     [[ADD:%.+]] = addf [[ACC_RES]], {{.*}} : f32
+  // CHECK:     [[MIN:%.+]] = constant 0.000000e+00 : f32
+  // CHECK:     [[MAX:%.+]] = constant 6.000000e+00 : f32
+  // CHECK:     [[LESS_THAN_MIN:%.+]] = cmpf "olt", [[ADD]], [[MIN]] : f32
+  // CHECK:     [[CLIP_MIN:%.+]] = select [[LESS_THAN_MIN]], [[MIN]], [[ADD]] : f32
+  // CHECK:     [[GREATER_THAN_MAX:%.+]] = cmpf "ogt", [[CLIP_MIN]], [[MAX]] : f32
+  // CHECK:     [[CLIP:%.+]] = select [[GREATER_THAN_MAX]], [[MAX]], [[CLIP_MIN]] : f32
+  // CHECK:     store [[CLIP]], [[RES]][%arg3, {{.*}}, {{.*}}, {{.*}}] : memref<1x5x27x58xf32>
+
+  // CHECK: return [[RES]] : memref<1x5x27x58xf32>
+}
+
+func @test_conv_activation_depthwise_w_pads(%arg0 : tensor<1x4x10x10xf32>, %arg1 : tensor<4x1x3x3xf32>, %arg2 : tensor<4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvActivation"(%arg0, %arg1, %arg2) {activation = "Relu", auto_pad = "NOTSET", group = 4 : i64, pads = [1, 1, 1, 1]} : (tensor<1x4x10x10xf32>, tensor<4x1x3x3xf32>, tensor<4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_activation_depthwise_w_pads
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x4x10x10xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg3 = 0 to 1, {{.*}} -> %arg4 = 0 to 4, {{.*}} -> %arg5 = 0 to 1) {
+  // CHECK: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[BIAS:%.+]] = load %arg2[%arg4] : memref<4xf32>
+
+  // The accesses of the border regions are bounds checked and left scalar.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[R1:%.+]] = 0 to 1) {
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[R2:%.+]] = 0 to 10) {
+  // CHECK: store [[BIAS]], [[RES]][%arg3, %arg4, [[R1]], [[R2]]] : memref<1x4x10x10xf32>
+  // CHECK: [[INNER_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.optimize_loops  {
+  // CHECK-NEXT: krnl.return_loops [[INNER_LOOPS]]#0, [[INNER_LOOPS]]#1, [[INNER_LOOPS]]#2, [[INNER_LOOPS]]#3
+  // CHECK: select {{.*}} : f32
+
+  // The interior region, last, is vectorized along the rows of the output.
+  // CHECK: krnl.vectorize {{%.+}}#3 8
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[C:%.+]] = 0 to 1, {{.*}} -> [[K1:%.+]] = 0 to 3, {{.*}} -> [[K2:%.+]] = 0 to 3, {{.*}} -> [[R2:%.+]] = 1 to 9) {
+  // CHECK-NOT: select
+  // CHECK: [[DATA:%.+]] = load %arg0[%arg3, %arg4, {{%.+}}, {{%.+}}] : memref<1x4x10x10xf32>
+  // CHECK: [[KERNEL:%.+]] = load %arg1[%arg4, [[C]], [[K1]], [[K2]]] : memref<4x1x3x3xf32>
+  // CHECK: [[ACC_RES:%.+]] = load [[RES]][%arg3, %arg4, [[R1:%.+]], [[R2]]] : memref<1x4x10x10xf32>
+  // CHECK: [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
+  // CHECK: [[ADD:%.+]] = addf [[ACC_RES]], [[MUL]] : f32
+  // CHECK: store [[ADD]], [[RES]][%arg3, %arg4, [[R1]], [[R2]]] : memref<1x4x10x10xf32>
+  // CHECK: }
+
+  // The activation is applied to the row once it is accumulated.
+  // CHECK: [[ACTIVATION_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.vectorize [[ACTIVATION_LOOPS]] 8
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[R2:%.+]] = 1 to 9) {
+  // CHECK: [[RESULT:%.+]] = load [[RES]][%arg3, %arg4, [[R1]], [[R2]]] : memref<1x4x10x10xf32>
+  // CHECK: [[LESS_THAN_ZERO:%.+]] = cmpf "olt", [[RESULT]], {{%.+}} : f32
+  // CHECK: [[RELU:%.+]] = select [[LESS_THAN_ZERO]], {{%.+}}, [[RESULT]] : f32
+  // CHECK: store [[RELU]], [[RES]][%arg3, %arg4, [[R1]], [[R2]]] : memref<1x4x10x10xf32>
+
+  // CHECK: return [[RES]] : memref<1x4x10x10xf32>
 }
 
 func @test_batchnorm_testmode_Nd(%arg0: tensor<1x2x1x3xf32>, %arg1: tensor<2xf32>, %arg2: tensor<2xf32>, %arg3: tensor<2xf32>, %arg4: tensor<2xf32>) -> tensor<1x2x1x3xf32> {
@@ -1294,6 +1970,7 @@ func @test_batchnorm_testmode_Nd(%arg0: tensor<1x2x1x3xf32>, %arg1: tensor<2xf32
   // CHECK: [[EPSILON:%.+]] = constant 9.99999974E-6 : f32
   // CHECK: [[DEF_LOOPS:%.+]]:4 = krnl.define_loops 4
   // CHECK: [[OPT_LOOPS:%.+]]:4 = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#1
   // CHECK:   krnl.return_loops [[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2, [[DEF_LOOPS]]#3
   // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
   // CHECK: krnl.iterate([[OPT_LOOPS]]#1) with ([[DEF_LOOPS]]#1 -> %arg5 = 0 to 2) {
@@ -1324,6 +2001,7 @@ func @test_batchnorm_testmode_1d(%arg0: tensor<10xf32>, %arg1: tensor<1xf32>, %a
   // CHECK: [[EPSILON:%.+]] = constant 9.99999974E-6 : f32
   // CHECK: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
   // CHECK: [[OPT_LOOPS:%.+]] = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]
   // CHECK:   krnl.return_loops [[DEF_LOOPS]]
   // CHECK: } : () -> !krnl.loop
   // CHECK: %[[ZERO_INDEX:.+]] = constant 0 : index
@@ -1511,6 +2189,67 @@ func @test_maxpooling_singleout_no_pad_w_strides_w_ceil_mode_w_unknown_dims(%arg
   // CHECK: return [[RES]] : memref<?x3x?x16xf32>
 }
 
+func @test_maxpooling_singleout_w_pads(%arg0 : tensor<1x1x4x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.MaxPoolSingleOut"(%arg0) {auto_pad = "NOTSET", kernel_shape = [3, 3], pads = [1, 1, 1, 1]} : (tensor<1x1x4x4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_maxpooling_singleout_w_pads
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x1x4x4xf32>
+
+  // Border of the first spatial dimension, bounds checked in both dimensions.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg1 = 0 to 1, {{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 0 to 1, {{.*}} -> %arg4 = 0 to 4) {
+  // CHECK:   [[NEGATIVE_INFINITY:%.+]] = constant 0xFF800000 : f32
+  // CHECK:   store [[NEGATIVE_INFINITY]], [[RES]][%arg1, %arg2, %arg3, %arg4] : memref<1x1x4x4xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg5 = 0 to 3, {{.*}} -> %arg6 = 0 to 3) {
+  // CHECK:     [[R1PLUSK1:%.+]] = addi %arg3, %arg5 : index
+  // CHECK:     [[PAD_0:%.+]] = constant 1 : index
+  // CHECK:     [[H:%.+]] = subi [[R1PLUSK1]], [[PAD_0]] : index
+  // CHECK:     [[R2PLUSK2:%.+]] = addi %arg4, %arg6 : index
+  // CHECK:     [[PAD_1:%.+]] = constant 1 : index
+  // CHECK:     [[W:%.+]] = subi [[R2PLUSK2]], [[PAD_1]] : index
+  // CHECK:     [[ZERO_INDEX:%.+]] = constant 0 : index
+  // CHECK:     [[DIM_0:%.+]] = constant 4 : index
+  // CHECK:     [[H_NON_NEGATIVE:%.+]] = cmpi "sge", [[H]], [[ZERO_INDEX]] : index
+  // CHECK:     [[H_BELOW_DIM:%.+]] = cmpi "slt", [[H]], [[DIM_0]] : index
+  // CHECK:     [[H_IN_BOUNDS:%.+]] = and [[H_NON_NEGATIVE]], [[H_BELOW_DIM]] : i1
+  // CHECK:     [[CLAMPED_H:%.+]] = select [[H_IN_BOUNDS]], [[H]], [[ZERO_INDEX]] : index
+  // CHECK:     [[DIM_1:%.+]] = constant 4 : index
+  // CHECK:     [[W_NON_NEGATIVE:%.+]] = cmpi "sge", [[W]], [[ZERO_INDEX]] : index
+  // CHECK:     [[W_BELOW_DIM:%.+]] = cmpi "slt", [[W]], [[DIM_1]] : index
+  // CHECK:     [[W_IN_BOUNDS:%.+]] = and [[W_NON_NEGATIVE]], [[W_BELOW_DIM]] : i1
+  // CHECK:     [[CLAMPED_W:%.+]] = select [[W_IN_BOUNDS]], [[W]], [[ZERO_INDEX]] : index
+  // CHECK:     [[IN_BOUNDS:%.+]] = and [[H_IN_BOUNDS]], [[W_IN_BOUNDS]] : i1
+  // CHECK:     [[LOAD_X:%.+]] = load %arg0[%arg1, %arg2, [[CLAMPED_H]], [[CLAMPED_W]]] : memref<1x1x4x4xf32>
+  // CHECK:     [[X:%.+]] = select [[IN_BOUNDS]], [[LOAD_X]], [[NEGATIVE_INFINITY]] : f32
+  // CHECK:     [[LOAD_Y:%.+]] = load [[RES]][%arg1, %arg2, %arg3, %arg4] : memref<1x1x4x4xf32>
+  // CHECK:     [[COMPARE:%.+]] = cmpf "ogt", [[LOAD_Y]], [[X]] : f32
+  // CHECK:     [[SELECT:%.+]] = select [[COMPARE]], [[LOAD_Y]], [[X]] : f32
+  // CHECK:     store [[SELECT]], [[RES]][%arg1, %arg2, %arg3, %arg4] : memref<1x1x4x4xf32>
+  // CHECK:   }
+  // CHECK: }
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg1 = 0 to 1, {{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 3 to 4, {{.*}} -> %arg4 = 0 to 4) {
+
+  // Borders of the second spatial dimension, within the interior of the first one.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg1 = 0 to 1, {{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 1 to 3, {{.*}} -> %arg4 = 0 to 1) {
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg1 = 0 to 1, {{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 1 to 3, {{.*}} -> %arg4 = 3 to 4) {
+
+  // Interior, free of bounds checks.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg1 = 0 to 1, {{.*}} -> %arg2 = 0 to 1, {{.*}} -> %arg3 = 1 to 3, {{.*}} -> %arg4 = 1 to 3) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg5 = 0 to 3, {{.*}} -> %arg6 = 0 to 3) {
+  // CHECK:     [[R1PLUSK1:%.+]] = addi %arg3, %arg5 : index
+  // CHECK:     [[PAD_0:%.+]] = constant 1 : index
+  // CHECK:     [[H:%.+]] = subi [[R1PLUSK1]], [[PAD_0]] : index
+  // CHECK:     [[R2PLUSK2:%.+]] = addi %arg4, %arg6 : index
+  // CHECK:     [[PAD_1:%.+]] = constant 1 : index
+  // CHECK:     [[W:%.+]] = subi [[R2PLUSK2]], [[PAD_1]] : index
+  // CHECK-NEXT: [[LOAD_X:%.+]] = load %arg0[%arg1, %arg2, [[H]], [[W]]] : memref<1x1x4x4xf32>
+  // CHECK-NEXT: [[LOAD_Y:%.+]] = load [[RES]][%arg1, %arg2, %arg3, %arg4] : memref<1x1x4x4xf32>
+  // CHECK-NEXT: [[COMPARE:%.+]] = cmpf "ogt", [[LOAD_Y]], [[LOAD_X]] : f32
+  // CHECK-NEXT: [[SELECT:%.+]] = select [[COMPARE]], [[LOAD_Y]], [[LOAD_X]] : f32
+  // CHECK-NEXT: store [[SELECT]], [[RES]][%arg1, %arg2, %arg3, %arg4] : memref<1x1x4x4xf32>
+  // CHECK: return [[RES]] : memref<1x1x4x4xf32>
+}
+
 func @test_constant_pad1(%arg0: tensor<16x16xf32>) -> tensor<18x20xf32> {
   %0 = "onnx.PadConstantValuePad"(%arg0) {constant_value = 0.000000e+00 : f32, mode = "constant", pads = [0, 3, 2, 1]} : (tensor<16x16xf32>) -> tensor<18x20xf32>
   return %0 : tensor<18x20xf32>
@@ -1535,3 +2274,124 @@ func @test_constant_pad1(%arg0: tensor<16x16xf32>) -> tensor<18x20xf32> {
   // CHECK: store [[LOAD]], [[RES]][%arg1, [[ADD]]] : memref<18x20xf32>
   // CHECK: }
 }
+
+func @test_layout_transform_nchwc(%arg0 : tensor<1x16x2x2xf32>) -> tensor<1x2x2x2x8xf32> {
+  %0 = "onnx.LayoutTransform"(%arg0) {channel_block = 8 : i64, target_layout = "NCHWc"} : (tensor<1x16x2x2xf32>) -> tensor<1x2x2x2x8xf32>
+  "std.return"(%0) : (tensor<1x2x2x2x8xf32>) -> ()
+
+  // CHECK-LABEL: test_layout_transform_nchwc
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x2x2x2x8xf32>
+  // CHECK: [[DEF_LOOPS:%.+]]:5 = krnl.define_loops 5
+  // CHECK: [[OPT_LOOPS:%.+]]:5 = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#1
+  // CHECK:   krnl.return_loops [[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2, [[DEF_LOOPS]]#3, [[DEF_LOOPS]]#4
+  // CHECK: } : () -> (!krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop)
+  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1, [[OPT_LOOPS]]#2, [[OPT_LOOPS]]#3, [[OPT_LOOPS]]#4) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 1, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 2, [[DEF_LOOPS]]#2 -> %arg3 = 0 to 2, [[DEF_LOOPS]]#3 -> %arg4 = 0 to 2, [[DEF_LOOPS]]#4 -> %arg5 = 0 to 8) {
+  // CHECK:   [[CHANNEL:%.+]] = affine.apply #{{.*}}(%arg2, %arg5)
+  // CHECK:   [[LOAD:%.+]] = load %arg0[%arg1, [[CHANNEL]], %arg3, %arg4] : memref<1x16x2x2xf32>
+  // CHECK:   store [[LOAD]], [[RES]][%arg1, %arg2, %arg3, %arg4, %arg5] : memref<1x2x2x2x8xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<1x2x2x2x8xf32>
+}
+
+func @test_conv_no_bias_nchwc(%arg0 : tensor<1x1x3x3x8xf32>, %arg1 : tensor<1x1x1x1x8x8xf32>) -> tensor<1x1x3x3x8xf32> {
+  %0 = "onnx.ConvNoBiasNCHWc"(%arg0, %arg1) {dilations = [1, 1], strides = [1, 1]} : (tensor<1x1x3x3x8xf32>, tensor<1x1x1x1x8x8xf32>) -> tensor<1x1x3x3x8xf32>
+  "std.return"(%0) : (tensor<1x1x3x3x8xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_no_bias_nchwc
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x1x3x3x8xf32>
+  // CHECK: [[CLEAR_LOOPS:%.+]]:5 = krnl.define_loops 5
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[CLEAR_LOOPS]]#2
+  // CHECK:   krnl.vectorize [[CLEAR_LOOPS]]#4 8
+  // CHECK: krnl.iterate({{.*}}) with ([[CLEAR_LOOPS]]#0 -> %arg2 = 0 to 1, [[CLEAR_LOOPS]]#1 -> %arg3 = 0 to 1, [[CLEAR_LOOPS]]#2 -> %arg4 = 0 to 3, [[CLEAR_LOOPS]]#3 -> %arg5 = 0 to 3, [[CLEAR_LOOPS]]#4 -> %arg6 = 0 to 8) {
+  // CHECK:   store {{.*}}, [[RES]][%arg2, %arg3, %arg4, %arg5, %arg6] : memref<1x1x3x3x8xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS:%.+]]:9 = krnl.define_loops 9
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#2
+  // CHECK:   krnl.unroll_jam [[DEF_LOOPS]]#3 4
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]]#8 8
+  // CHECK: krnl.iterate({{.*}}) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 1, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 1, [[DEF_LOOPS]]#2 -> %arg4 = 0 to 3, [[DEF_LOOPS]]#3 -> %arg5 = 0 to 3, [[DEF_LOOPS]]#4 -> %arg6 = 0 to 1, [[DEF_LOOPS]]#5 -> %arg7 = 0 to 1, [[DEF_LOOPS]]#6 -> %arg8 = 0 to 1, [[DEF_LOOPS]]#7 -> %arg9 = 0 to 8, [[DEF_LOOPS]]#8 -> %arg10 = 0 to 8) {
+  // CHECK:   [[H:%.+]] = affine.apply #{{.*}}(%arg4, %arg7)
+  // CHECK:   [[W:%.+]] = affine.apply #{{.*}}(%arg5, %arg8)
+  // CHECK:   [[DATA:%.+]] = load %arg0[%arg2, %arg6, [[H]], [[W]], %arg9] : memref<1x1x3x3x8xf32>
+  // CHECK:   [[KERNEL:%.+]] = load %arg1[%arg3, %arg6, %arg7, %arg8, %arg9, %arg10] : memref<1x1x1x1x8x8xf32>
+  // CHECK:   [[PARTIAL:%.+]] = load [[RES]][%arg2, %arg3, %arg4, %arg5, %arg10] : memref<1x1x3x3x8xf32>
+  // CHECK:   [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
+  // CHECK:   [[SUM:%.+]] = addf [[PARTIAL]], [[MUL]] : f32
+  // CHECK:   store [[SUM]], [[RES]][%arg2, %arg3, %arg4, %arg5, %arg10] : memref<1x1x3x3x8xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<1x1x3x3x8xf32>
+}
+
+func @test_maxpool_single_out_nchwc(%arg0 : tensor<1x1x4x4x8xf32>) -> tensor<1x1x2x2x8xf32> {
+  %0 = "onnx.MaxPoolSingleOutNCHWc"(%arg0) {kernel_shape = [2, 2], strides = [2, 2]} : (tensor<1x1x4x4x8xf32>) -> tensor<1x1x2x2x8xf32>
+  "std.return"(%0) : (tensor<1x1x2x2x8xf32>) -> ()
+
+  // CHECK-LABEL: test_maxpool_single_out_nchwc
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x1x2x2x8xf32>
+  // CHECK: [[FILL_LOOPS:%.+]]:5 = krnl.define_loops 5
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[FILL_LOOPS]]#2
+  // CHECK:   krnl.vectorize [[FILL_LOOPS]]#4 8
+  // CHECK: krnl.iterate({{.*}}) with ([[FILL_LOOPS]]#0 -> %arg1 = 0 to 1, [[FILL_LOOPS]]#1 -> %arg2 = 0 to 1, [[FILL_LOOPS]]#2 -> %arg3 = 0 to 2, [[FILL_LOOPS]]#3 -> %arg4 = 0 to 2, [[FILL_LOOPS]]#4 -> %arg5 = 0 to 8) {
+  // CHECK:   [[IDENTITY:%.+]] = constant 0xFF800000 : f32
+  // CHECK:   store [[IDENTITY]], [[RES]][%arg1, %arg2, %arg3, %arg4, %arg5] : memref<1x1x2x2x8xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS:%.+]]:7 = krnl.define_loops 7
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#2
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]]#6 8
+  // CHECK: krnl.iterate({{.*}}) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 1, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 1, [[DEF_LOOPS]]#2 -> %arg3 = 0 to 2, [[DEF_LOOPS]]#3 -> %arg4 = 0 to 2, [[DEF_LOOPS]]#4 -> %arg5 = 0 to 2, [[DEF_LOOPS]]#5 -> %arg6 = 0 to 2, [[DEF_LOOPS]]#6 -> %arg7 = 0 to 8) {
+  // CHECK:   [[H:%.+]] = affine.apply #{{.*}}(%arg3, %arg5)
+  // CHECK:   [[W:%.+]] = affine.apply #{{.*}}(%arg4, %arg6)
+  // CHECK:   [[LOAD_X:%.+]] = load %arg0[%arg1, %arg2, [[H]], [[W]], %arg7] : memref<1x1x4x4x8xf32>
+  // CHECK:   [[LOAD_Y:%.+]] = load [[RES]][%arg1, %arg2, %arg3, %arg4, %arg7] : memref<1x1x2x2x8xf32>
+  // CHECK:   [[CMP:%.+]] = cmpf "ogt", [[LOAD_Y]], [[LOAD_X]] : f32
+  // CHECK:   [[SELECT:%.+]] = select [[CMP]], [[LOAD_Y]], [[LOAD_X]] : f32
+  // CHECK:   store [[SELECT]], [[RES]][%arg1, %arg2, %arg3, %arg4, %arg7] : memref<1x1x2x2x8xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<1x1x2x2x8xf32>
+}
+
+func @test_batchnorm_testmode_nchwc(%arg0: tensor<1x1x1x2x8xf32>, %arg1: tensor<8xf32>, %arg2: tensor<8xf32>, %arg3: tensor<8xf32>, %arg4: tensor<8xf32>) -> tensor<1x1x1x2x8xf32> {
+  %0 = "onnx.BatchNormalizationTestModeNCHWc"(%arg0, %arg1, %arg2, %arg3, %arg4) : (tensor<1x1x1x2x8xf32>, tensor<8xf32>, tensor<8xf32>, tensor<8xf32>, tensor<8xf32>) -> tensor<1x1x1x2x8xf32>
+  return %0 : tensor<1x1x1x2x8xf32>
+
+  // CHECK-LABEL: test_batchnorm_testmode_nchwc
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x1x1x2x8xf32>
+  // CHECK: [[EPSILON:%.+]] = constant 9.99999974E-6 : f32
+  // CHECK: [[MULTIPLIERS:%.+]] = alloc() : memref<1x8xf32>
+  // CHECK: [[SHIFTS:%.+]] = alloc() : memref<1x8xf32>
+  // CHECK: [[CHANNEL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate({{.*}}) with ([[CHANNEL_LOOPS]]#0 -> %arg5 = 0 to 1, [[CHANNEL_LOOPS]]#1 -> %arg6 = 0 to 8) {
+  // CHECK:   [[CHANNEL:%.+]] = affine.apply #{{.*}}(%arg5, %arg6)
+  // CHECK:   [[SCALE:%.+]] = load %arg1{{\[}}[[CHANNEL]]] : memref<8xf32>
+  // CHECK:   [[BIAS:%.+]] = load %arg2{{\[}}[[CHANNEL]]] : memref<8xf32>
+  // CHECK:   [[MEAN:%.+]] = load %arg3{{\[}}[[CHANNEL]]] : memref<8xf32>
+  // CHECK:   [[VARIANCE:%.+]] = load %arg4{{\[}}[[CHANNEL]]] : memref<8xf32>
+  // CHECK:   [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
+  // CHECK:   [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
+  // CHECK:   [[MULTIPLIER:%.+]] = divf [[SCALE]], [[DIVISOR]] : f32
+  // CHECK:   [[MEAN_MULTIPLIER:%.+]] = mulf [[MEAN]], [[MULTIPLIER]] : f32
+  // CHECK:   [[SHIFT:%.+]] = subf [[BIAS]], [[MEAN_MULTIPLIER]] : f32
+  // CHECK:   store [[MULTIPLIER]], [[MULTIPLIERS]][%arg5, %arg6] : memref<1x8xf32>
+  // CHECK:   store [[SHIFT]], [[SHIFTS]][%arg5, %arg6] : memref<1x8xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS:%.+]]:5 = krnl.define_loops 5
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#3
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]]#4 8
+  // CHECK: krnl.iterate({{.*}}) with ([[DEF_LOOPS]]#0 -> %arg5 = 0 to 1, [[DEF_LOOPS]]#1 -> %arg6 = 0 to 1, [[DEF_LOOPS]]#2 -> %arg7 = 0 to 1, [[DEF_LOOPS]]#3 -> %arg8 = 0 to 2, [[DEF_LOOPS]]#4 -> %arg9 = 0 to 8) {
+  // CHECK:   [[X:%.+]] = load %arg0[%arg5, %arg6, %arg7, %arg8, %arg9] : memref<1x1x1x2x8xf32>
+  // CHECK:   [[BLOCK_MULTIPLIER:%.+]] = load [[MULTIPLIERS]][%arg6, %arg9] : memref<1x8xf32>
+  // CHECK:   [[BLOCK_SHIFT:%.+]] = load [[SHIFTS]][%arg6, %arg9] : memref<1x8xf32>
+  // CHECK:   [[SCALED:%.+]] = mulf [[X]], [[BLOCK_MULTIPLIER]] : f32
+  // CHECK:   [[NORMALIZED:%.+]] = addf [[SCALED]], [[BLOCK_SHIFT]] : f32
+  // CHECK:   store [[NORMALIZED]], [[RES]][%arg5, %arg6, %arg7, %arg8, %arg9] : memref<1x1x1x2x8xf32>
+  // CHECK: }
+  // CHECK: dealloc [[SHIFTS]] : memref<1x8xf32>
+  // CHECK: dealloc [[MULTIPLIERS]] : memref<1x8xf32>
+  // CHECK: return [[RES]] : memref<1x1x1x2x8xf32>
+}
@@ -0,0 +1,276 @@
+// RUN: onnf-opt --shape-inference --lower-frontend %s -split-input-file | FileCheck %s
+
+// Operands of the same shape as the result are iterated by a single loop.
+func @test_add_same_shape(%arg0 : tensor<2x3x4x5xf32>, %arg1 : tensor<2x3x4x5xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<2x3x4x5xf32>, tensor<2x3x4x5xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_same_shape
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x3x4x5xf32>
+  // CHECK: [[VIEW0:%.+]] = "krnl.reshape"(%arg0) : (memref<2x3x4x5xf32>) -> memref<120xf32>
+  // CHECK: [[VIEW1:%.+]] = "krnl.reshape"(%arg1) : (memref<2x3x4x5xf32>) -> memref<120xf32>
+  // CHECK: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<2x3x4x5xf32>) -> memref<120xf32>
+  // CHECK: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: [[OPT_LOOPS:%.+]] = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]] 8
+  // CHECK:   krnl.return_loops [[DEF_LOOPS]]
+  // CHECK: } : () -> !krnl.loop
+  // CHECK: krnl.iterate([[OPT_LOOPS]]) with ([[DEF_LOOPS]] -> %arg2 = 0 to 120) {
+  // CHECK: [[LOAD1:%.+]] = load [[VIEW0]][%arg2] : memref<120xf32>
+  // CHECK: [[LOAD2:%.+]] = load [[VIEW1]][%arg2] : memref<120xf32>
+  // CHECK: [[ADDF:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[ADDF]], [[RES_VIEW]][%arg2] : memref<120xf32>
+  // CHECK: return [[RES]] : memref<2x3x4x5xf32>
+}
+
+// -----
+
+// The number of iterations of the loop is computed from the dynamic sizes.
+func @test_relu_dynamic(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_relu_dynamic
+  // CHECK: [[DIM_0:%.+]] = dim %arg0, 0 : memref<?x10xf32>
+  // CHECK: [[RES:%.+]] = alloc([[DIM_0]]) : memref<?x10xf32>
+  // CHECK: [[DIM_1:%.+]] = dim [[RES]], 0 : memref<?x10xf32>
+  // CHECK: [[C10:%.+]] = constant 10 : index
+  // CHECK: [[SIZE:%.+]] = muli [[DIM_1]], [[C10]] : index
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0, [[SIZE]]) : (memref<?x10xf32>, index) -> memref<?xf32>
+  // CHECK: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]], [[SIZE]]) : (memref<?x10xf32>, index) -> memref<?xf32>
+  // CHECK: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]] 8
+  // CHECK: krnl.iterate({{.*}}) with ([[DEF_LOOPS]] -> %arg1 = 0 to [[SIZE]]) {
+  // CHECK: [[LOAD:%.+]] = load [[VIEW]][%arg1] : memref<?xf32>
+  // CHECK: [[ZERO:%.+]] = constant {{0.+}} : f32
+  // CHECK: [[LTZERO:%.+]] = cmpf "olt", [[LOAD]], [[ZERO]] : f32
+  // CHECK: [[RELU_RES:%.+]] = select [[LTZERO]], [[ZERO]], [[LOAD]] : f32
+  // CHECK: store [[RELU_RES]], [[RES_VIEW]][%arg1] : memref<?xf32>
+  // CHECK: return [[RES]] : memref<?x10xf32>
+}
+
+// -----
+
+// The dimensions along which the bias is broadcasted are collapsed.
+func @test_add_channel_broadcast(%arg0 : tensor<2x3x4x5xf32>, %arg1 : tensor<3x1x1xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<2x3x4x5xf32>, tensor<3x1x1xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_channel_broadcast
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x3x4x5xf32>
+  // CHECK: [[VIEW0:%.+]] = "krnl.reshape"(%arg0) : (memref<2x3x4x5xf32>) -> memref<2x3x20xf32>
+  // CHECK: [[VIEW1:%.+]] = "krnl.reshape"(%arg1) : (memref<3x1x1xf32>) -> memref<3x1xf32>
+  // CHECK: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<2x3x4x5xf32>) -> memref<2x3x20xf32>
+  // CHECK: [[DEF_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: [[OPT_LOOPS:%.+]]:3 = krnl.optimize_loops  {
+  // CHECK:   krnl.parallel [[DEF_LOOPS]]#0
+  // CHECK:   krnl.vectorize [[DEF_LOOPS]]#2 8
+  // CHECK: krnl.iterate([[OPT_LOOPS]]#0, [[OPT_LOOPS]]#1, [[OPT_LOOPS]]#2) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 2, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 3, [[DEF_LOOPS]]#2 -> %arg4 = 0 to 20) {
+  // CHECK: [[LOAD1:%.+]] = load [[VIEW0]][%arg2, %arg3, %arg4] : memref<2x3x20xf32>
+  // CHECK: [[ZERO:%.+]] = constant 0 : index
+  // CHECK: [[LOAD2:%.+]] = load [[VIEW1]][%arg3, [[ZERO]]] : memref<3x1xf32>
+  // CHECK: [[ADDF:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[ADDF]], [[RES_VIEW]][%arg2, %arg3, %arg4] : memref<2x3x20xf32>
+  // CHECK: return [[RES]] : memref<2x3x4x5xf32>
+}
+
+// -----
+
+// An operand broadcasted along every dimension is loaded without a view.
+func @test_add_scalar_broadcast(%arg0 : tensor<10x10xf32>, %arg1 : tensor<1xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<1xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_scalar_broadcast
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[VIEW0:%.+]] = "krnl.reshape"(%arg0) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK-NOT: "krnl.reshape"(%arg1)
+  // CHECK: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 100) {
+  // CHECK: [[LOAD1:%.+]] = load [[VIEW0]][%arg2] : memref<100xf32>
+  // CHECK: [[ZERO:%.+]] = constant 0 : index
+  // CHECK: [[LOAD2:%.+]] = load %arg1{{\[}}[[ZERO]]{{\]}} : memref<1xf32>
+  // CHECK: [[ADDF:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[ADDF]], [[RES_VIEW]][%arg2] : memref<100xf32>
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+// Each version of the loop nest collapses the dimensions it can: the
+// dimensions are collapsed when the first operand is broadcasted, and not
+// otherwise.
+func @test_add_versioned(%arg0 : tensor<?xf32>, %arg1 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<?xf32>, tensor<?x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_versioned
+  // CHECK: [[RES:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK: [[IS_ONE:%.+]] = cmpi "eq", {{.*}} : index
+  // CHECK: loop.if [[IS_ONE]] {
+  // CHECK: [[DIM:%.+]] = dim [[RES]], 0 : memref<?x10xf32>
+  // CHECK: [[C10:%.+]] = constant 10 : index
+  // CHECK: [[SIZE:%.+]] = muli [[DIM]], [[C10]] : index
+  // CHECK: [[VIEW1:%.+]] = "krnl.reshape"(%arg1, [[SIZE]]) : (memref<?x10xf32>, index) -> memref<?xf32>
+  // CHECK: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]], [[SIZE]]) : (memref<?x10xf32>, index) -> memref<?xf32>
+  // CHECK: krnl.define_loops 1
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %[[I:[a-z0-9]+]] = 0 to [[SIZE]]) {
+  // CHECK: [[ZERO:%.+]] = constant 0 : index
+  // CHECK: [[LOAD1:%.+]] = load %arg0{{\[}}[[ZERO]]{{\]}} : memref<?xf32>
+  // CHECK: [[LOAD2:%.+]] = load [[VIEW1]][%[[I]]] : memref<?xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[ADD]], [[RES_VIEW]][%[[I]]] : memref<?xf32>
+  // CHECK: } else {
+  // CHECK: krnl.define_loops 2
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %[[I:[a-z0-9]+]] = 0 to {{.*}}, {{.*}} -> %[[J:[a-z0-9]+]] = 0 to 10) {
+  // CHECK: [[LOAD1:%.+]] = load %arg0[%[[J]]] : memref<?xf32>
+  // CHECK: [[LOAD2:%.+]] = load %arg1[%[[I]], %[[J]]] : memref<?x10xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[ADD]], [[RES]][%[[I]], %[[J]]] : memref<?x10xf32>
+  // CHECK: return [[RES]] : memref<?x10xf32>
+}
+
+// -----
+
+// The body of a fused operation is evaluated for each element of its result,
+// without intermediate buffers.
+func @test_fused_swish(%arg0 : tensor<10x10xf32>) -> tensor<10x10xf32> {
+  %0 = "onnx.FusedElementwise"(%arg0) ({
+  ^bb0(%x: tensor<10x10xf32>):
+    %1 = "onnx.Sigmoid"(%x) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+    %2 = "onnx.Mul"(%x, %1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+    "onnx.Yield"(%2) : (tensor<10x10xf32>) -> ()
+  }) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  "std.return"(%0) : (tensor<10x10xf32>) -> ()
+
+  // CHECK-LABEL: test_fused_swish
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg1 = 0 to 100) {
+  // CHECK: [[LOAD:%.+]] = load [[VIEW]][%arg1] : memref<100xf32>
+  // CHECK-NOT: alloc
+  // CHECK-NOT: store
+  // CHECK: [[MUL:%.+]] = mulf [[LOAD]], {{.*}} : f32
+  // CHECK-NEXT: store [[MUL]], [[RES_VIEW]][%arg1] : memref<100xf32>
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+// Inputs are broadcasted to the result of a fused operation.
+func @test_fused_bias_relu(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10xf32>) -> tensor<10x10xf32> {
+  %0 = "onnx.FusedElementwise"(%arg0, %arg1) ({
+  ^bb0(%x: tensor<10x10xf32>, %b: tensor<10xf32>):
+    %1 = "onnx.Add"(%x, %b) : (tensor<10x10xf32>, tensor<10xf32>) -> tensor<10x10xf32>
+    %2 = "onnx.Relu"(%1) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+    "onnx.Yield"(%2) : (tensor<10x10xf32>) -> ()
+  }) : (tensor<10x10xf32>, tensor<10xf32>) -> tensor<10x10xf32>
+  "std.return"(%0) : (tensor<10x10xf32>) -> ()
+
+  // CHECK-LABEL: test_fused_bias_relu
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate({{.*}}) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 10) {
+  // CHECK: [[LOAD1:%.+]] = load %arg0[%arg2, %arg3] : memref<10x10xf32>
+  // CHECK: [[LOAD2:%.+]] = load %arg1[%arg3] : memref<10xf32>
+  // CHECK: [[ADDF:%.+]] = addf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: [[ZERO:%.+]] = constant {{0.+}} : f32
+  // CHECK: [[LTZERO:%.+]] = cmpf "olt", [[ADDF]], [[ZERO]] : f32
+  // CHECK: [[RELU:%.+]] = select [[LTZERO]], [[ZERO]], [[ADDF]] : f32
+  // CHECK: store [[RELU]], [[RES]][%arg2, %arg3] : memref<10x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+// The result of an operation is written into the buffer of an operand of the
+// same shape which is no longer used, the last result owning the buffer.
+func @test_in_place_chain(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Mul"(%1, %arg0) : (tensor<*xf32>, tensor<10x10xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_in_place_chain
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: [[ADD_RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: store {{%.+}}, [[ADD_RES_VIEW]][%arg2] : memref<100xf32>
+  // CHECK: [[RELU_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: [[RELU_RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: load [[RELU_VIEW]][%arg2] : memref<100xf32>
+  // CHECK: store {{%.+}}, [[RELU_RES_VIEW]][%arg2] : memref<100xf32>
+  // CHECK: [[MUL_VIEW0:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: [[MUL_VIEW1:%.+]] = "krnl.reshape"(%arg0) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: [[MUL_RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<10x10xf32>) -> memref<100xf32>
+  // CHECK: [[LOAD1:%.+]] = load [[MUL_VIEW0]][%arg2] : memref<100xf32>
+  // CHECK: [[LOAD2:%.+]] = load [[MUL_VIEW1]][%arg2] : memref<100xf32>
+  // CHECK: [[MULF:%.+]] = mulf [[LOAD1]], [[LOAD2]] : f32
+  // CHECK: store [[MULF]], [[MUL_RES_VIEW]][%arg2] : memref<100xf32>
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+// The buffer of an operand used by a later operation is not reused.
+func @test_in_place_live_operand(%arg0 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Add"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_in_place_live_operand
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[RELU:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: dealloc [[RELU]] : memref<10x10xf32>
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+// The buffer of an operand with dynamic dimensions is only reused by unary
+// operations, as it may be broadcasted by other operations.
+func @test_in_place_dynamic(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Add"(%1, %arg0) : (tensor<*xf32>, tensor<?x10xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_in_place_dynamic
+  // CHECK: [[RELU:%.+]] = alloc({{%.+}}) : memref<?x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: [[RES:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: dealloc [[RELU]] : memref<?x10xf32>
+  // CHECK: return [[RES]] : memref<?x10xf32>
+}
+
+// -----
+
+// The result of a fused operation with dynamic dimensions is not written into
+// the buffer of an operand, which may be broadcasted to it.
+func @test_fused_in_place_dynamic(%arg0 : tensor<?x10xf32>, %arg1 : tensor<10xf32>) -> tensor<?x10xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<?x10xf32>) -> tensor<?x10xf32>
+  %1 = "onnx.FusedElementwise"(%0, %arg1) ({
+  ^bb0(%x: tensor<?x10xf32>, %b: tensor<10xf32>):
+    %2 = "onnx.Add"(%x, %b) : (tensor<?x10xf32>, tensor<10xf32>) -> tensor<?x10xf32>
+    %3 = "onnx.Exp"(%2) : (tensor<?x10xf32>) -> tensor<?x10xf32>
+    "onnx.Yield"(%3) : (tensor<?x10xf32>) -> ()
+  }) : (tensor<?x10xf32>, tensor<10xf32>) -> tensor<?x10xf32>
+  "std.return"(%1) : (tensor<?x10xf32>) -> ()
+
+  // CHECK-LABEL: test_fused_in_place_dynamic
+  // CHECK: [[RELU:%.+]] = alloc({{%.+}}) : memref<?x10xf32>
+  // CHECK: [[RES:%.+]] = alloc({{%.+}}) : memref<?x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: dealloc [[RELU]] : memref<?x10xf32>
+  // CHECK: return [[RES]] : memref<?x10xf32>
+}
@@ -0,0 +1,93 @@
+// RUN: onnf-opt --shape-inference --lower-frontend %s -split-input-file | FileCheck %s
+// RUN: onnf-opt --shape-inference --lower-frontend --math-max-ulps=1 %s -split-input-file | FileCheck %s --check-prefix=ULP1
+
+// exp is approximated by a polynomial on f32, after clamping its argument.
+func @test_exp(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Exp"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_exp
+  // CHECK: [[LOAD:%.+]] = load {{%.+}}[%arg1] : memref<?xf32>
+  // CHECK: [[HIGH:%.+]] = constant 88.{{[0-9]+}} : f32
+  // CHECK: [[LOW:%.+]] = constant -1.040000e+02 : f32
+  // CHECK: [[GREATER:%.+]] = cmpf "ogt", [[LOAD]], [[HIGH]] : f32
+  // CHECK: [[CLAMPED_HIGH:%.+]] = select [[GREATER]], [[HIGH]], [[LOAD]] : f32
+  // CHECK: [[LESS:%.+]] = cmpf "olt", [[CLAMPED_HIGH]], [[LOW]] : f32
+  // CHECK: [[CLAMPED:%.+]] = select [[LESS]], [[LOW]], [[CLAMPED_HIGH]] : f32
+  // CHECK: [[LOG2E:%.+]] = constant 1.44269502 : f32
+  // CHECK: mulf [[CLAMPED]], [[LOG2E]] : f32
+  // CHECK: absf
+  // CHECK: constant 1.280000e+02 : f32
+  // CHECK-NOT: exp
+  // CHECK: store {{.*}}, {{.*}}[%arg1] : memref<?xf32>
+
+  // The exp approximations err by at least 2 ULPs.
+  // ULP1-LABEL: test_exp
+  // ULP1: [[LOAD:%.+]] = load {{%.+}}[%arg1] : memref<?xf32>
+  // ULP1: [[EXP:%.+]] = exp [[LOAD]] : f32
+  // ULP1: store [[EXP]], {{.*}}[%arg1] : memref<?xf32>
+}
+
+// -----
+
+// The math library is called on other types than f32.
+func @test_exp_f64(%arg0 : tensor<?x10xf64>) -> tensor<*xf64> {
+  %0 = "onnx.Exp"(%arg0) : (tensor<?x10xf64>) -> tensor<*xf64>
+  "std.return"(%0) : (tensor<*xf64>) -> ()
+
+  // CHECK-LABEL: test_exp_f64
+  // CHECK: [[LOAD:%.+]] = load {{%.+}}[%arg1] : memref<?xf64>
+  // CHECK: [[EXP:%.+]] = exp [[LOAD]] : f64
+  // CHECK: store [[EXP]], {{.*}}[%arg1] : memref<?xf64>
+}
+
+// -----
+
+// log is approximated by a polynomial of the mantissa of its argument, the
+// special values being selected last.
+func @test_log(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Log"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_log
+  // CHECK: [[LOAD:%.+]] = load {{%.+}}[%arg1] : memref<?xf32>
+  // CHECK-NOT: log
+  // CHECK: [[INFINITY:%.+]] = constant 0x7F800000 : f32
+  // CHECK: [[IS_INFINITY:%.+]] = cmpf "oeq", [[LOAD]], [[INFINITY]] : f32
+  // CHECK: [[RES_INFINITY:%.+]] = select [[IS_INFINITY]], [[INFINITY]], {{.*}} : f32
+  // CHECK: [[IS_ZERO:%.+]] = cmpf "oeq", [[LOAD]], {{.*}} : f32
+  // CHECK: [[RES_ZERO:%.+]] = select [[IS_ZERO]], {{.*}}, [[RES_INFINITY]] : f32
+  // CHECK: [[NAN:%.+]] = constant 0x7FC00000 : f32
+  // CHECK: [[IS_NEGATIVE:%.+]] = cmpf "olt", [[LOAD]], {{.*}} : f32
+  // CHECK: [[RES:%.+]] = select [[IS_NEGATIVE]], [[NAN]], [[RES_ZERO]] : f32
+  // CHECK: store [[RES]], {{.*}}[%arg1] : memref<?xf32>
+
+  // A log approximation errs by at most 1 ULP.
+  // ULP1-LABEL: test_log
+  // ULP1-NOT: log
+  // ULP1: [[NAN:%.+]] = constant 0x7FC00000 : f32
+}
+
+// -----
+
+// tanh selects between a polynomial for small arguments and a function of
+// exp(2|x|), approximated as well.
+func @test_tanh(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Tanh"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_tanh
+  // CHECK: [[LOAD:%.+]] = load {{%.+}}[%arg1] : memref<?xf32>
+  // CHECK: [[ABS:%.+]] = absf [[LOAD]] : f32
+  // CHECK-NOT: exp
+  // CHECK-NOT: tanh
+  // CHECK: [[BOUND:%.+]] = constant 6.250000e-01 : f32
+  // CHECK: [[IS_SMALL:%.+]] = cmpf "olt", [[ABS]], [[BOUND]] : f32
+  // CHECK: [[RES:%.+]] = select [[IS_SMALL]], {{.*}}, {{.*}} : f32
+  // CHECK: store [[RES]], {{.*}}[%arg1] : memref<?xf32>
+
+  // ULP1-LABEL: test_tanh
+  // ULP1: [[LOAD:%.+]] = load {{%.+}}[%arg1] : memref<?xf32>
+  // ULP1: [[TANH:%.+]] = tanh [[LOAD]] : f32
+  // ULP1: store [[TANH]], {{.*}}[%arg1] : memref<?xf32>
+}
@@ -0,0 +1,95 @@
+// RUN: onnf-opt --nchwc-layout %s -split-input-file | FileCheck %s
+
+// Chains of converted operations are only converted at their boundaries.
+// CHECK-LABEL: func @test_conv_relu_maxpool_conv
+func @test_conv_relu_maxpool_conv(%arg0 : tensor<1x16x8x8xf32>, %arg1 : tensor<32x16x1x1xf32>, %arg2 : tensor<16x32x1x1xf32>) -> tensor<1x16x4x4xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", dilations = [1, 1], group = 1 : i64, kernel_shape = [1, 1], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x16x8x8xf32>, tensor<32x16x1x1xf32>) -> tensor<1x32x8x8xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<1x32x8x8xf32>) -> tensor<1x32x8x8xf32>
+  %2 = "onnx.MaxPoolSingleOut"(%1) {auto_pad = "NOTSET", ceil_mode = 0 : i64, dilations = [1, 1], kernel_shape = [2, 2], pads = [0, 0, 0, 0], storage_order = 0 : i64, strides = [2, 2]} : (tensor<1x32x8x8xf32>) -> tensor<1x32x4x4xf32>
+  %3 = "onnx.ConvNoBias"(%2, %arg2) {auto_pad = "NOTSET", dilations = [1, 1], group = 1 : i64, kernel_shape = [1, 1], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x32x4x4xf32>, tensor<16x32x1x1xf32>) -> tensor<1x16x4x4xf32>
+  "std.return"(%3) : (tensor<1x16x4x4xf32>) -> ()
+
+  // CHECK: [[DATA:%.+]] = "onnx.LayoutTransform"(%arg0) {channel_block = 8 : i64, target_layout = "NCHWc"} : (tensor<1x16x8x8xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK: [[KERNEL1:%.+]] = "onnx.LayoutTransform"(%arg1) {channel_block = 8 : i64, target_layout = "OIHWio"} : (tensor<32x16x1x1xf32>) -> tensor<4x2x1x1x8x8xf32>
+  // CHECK: [[CONV1:%.+]] = "onnx.ConvNoBiasNCHWc"([[DATA]], [[KERNEL1]]) {dilations = [1, 1], strides = [1, 1]} : (tensor<1x2x8x8x8xf32>, tensor<4x2x1x1x8x8xf32>) -> tensor<1x4x8x8x8xf32>
+  // CHECK-NOT: "onnx.LayoutTransform"
+  // CHECK: [[RELU:%.+]] = "onnx.Relu"([[CONV1]]) : (tensor<1x4x8x8x8xf32>) -> tensor<1x4x8x8x8xf32>
+  // CHECK-NOT: "onnx.LayoutTransform"
+  // CHECK: [[POOL:%.+]] = "onnx.MaxPoolSingleOutNCHWc"([[RELU]]) {dilations = [1, 1], kernel_shape = [2, 2], strides = [2, 2]} : (tensor<1x4x8x8x8xf32>) -> tensor<1x4x4x4x8xf32>
+  // CHECK: [[KERNEL2:%.+]] = "onnx.LayoutTransform"(%arg2) {channel_block = 8 : i64, target_layout = "OIHWio"} : (tensor<16x32x1x1xf32>) -> tensor<2x4x1x1x8x8xf32>
+  // CHECK: [[CONV2:%.+]] = "onnx.ConvNoBiasNCHWc"([[POOL]], [[KERNEL2]]) {dilations = [1, 1], strides = [1, 1]} : (tensor<1x4x4x4x8xf32>, tensor<2x4x1x1x8x8xf32>) -> tensor<1x2x4x4x8xf32>
+  // CHECK: [[RES:%.+]] = "onnx.LayoutTransform"([[CONV2]]) {channel_block = 8 : i64, target_layout = "NCHW"} : (tensor<1x2x4x4x8xf32>) -> tensor<1x16x4x4xf32>
+  // CHECK: return [[RES]] : tensor<1x16x4x4xf32>
+}
+
+// -----
+
+// Operands of elementwise operations that are not produced by converted
+// operations are converted to the NCHWc layout.
+// CHECK-LABEL: func @test_conv_batchnorm_add
+func @test_conv_batchnorm_add(%arg0 : tensor<1x16x8x8xf32>, %arg1 : tensor<16x16x1x1xf32>, %arg2 : tensor<16xf32>, %arg3 : tensor<1x16x8x8xf32>) -> tensor<1x16x8x8xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", dilations = [1, 1], group = 1 : i64, kernel_shape = [1, 1], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x16x8x8xf32>, tensor<16x16x1x1xf32>) -> tensor<1x16x8x8xf32>
+  %1 = "onnx.BatchNormalizationTestMode"(%0, %arg2, %arg2, %arg2, %arg2) {epsilon = 1.000000e-05 : f32} : (tensor<1x16x8x8xf32>, tensor<16xf32>, tensor<16xf32>, tensor<16xf32>, tensor<16xf32>) -> tensor<1x16x8x8xf32>
+  %2 = "onnx.Add"(%1, %arg3) : (tensor<1x16x8x8xf32>, tensor<1x16x8x8xf32>) -> tensor<1x16x8x8xf32>
+  "std.return"(%2) : (tensor<1x16x8x8xf32>) -> ()
+
+  // CHECK: [[CONV:%.+]] = "onnx.ConvNoBiasNCHWc"
+  // CHECK: [[BN:%.+]] = "onnx.BatchNormalizationTestModeNCHWc"([[CONV]], %arg2, %arg2, %arg2, %arg2) {epsilon = 9.99999974E-6 : f32} : (tensor<1x2x8x8x8xf32>, tensor<16xf32>, tensor<16xf32>, tensor<16xf32>, tensor<16xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK: [[OTHER:%.+]] = "onnx.LayoutTransform"(%arg3) {channel_block = 8 : i64, target_layout = "NCHWc"} : (tensor<1x16x8x8xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK: [[ADD:%.+]] = "onnx.Add"([[BN]], [[OTHER]]) : (tensor<1x2x8x8x8xf32>, tensor<1x2x8x8x8xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK: [[RES:%.+]] = "onnx.LayoutTransform"([[ADD]]) {channel_block = 8 : i64, target_layout = "NCHW"} : (tensor<1x2x8x8x8xf32>) -> tensor<1x16x8x8xf32>
+  // CHECK: return [[RES]] : tensor<1x16x8x8xf32>
+}
+
+// -----
+
+// 3x3 convolutions with unit strides are left to the Winograd lowering.
+// CHECK-LABEL: func @test_conv_3x3_unchanged
+func @test_conv_3x3_unchanged(%arg0 : tensor<1x16x10x10xf32>, %arg1 : tensor<16x16x3x3xf32>) -> tensor<1x16x8x8xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", dilations = [1, 1], group = 1 : i64, kernel_shape = [3, 3], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x16x10x10xf32>, tensor<16x16x3x3xf32>) -> tensor<1x16x8x8xf32>
+  "std.return"(%0) : (tensor<1x16x8x8xf32>) -> ()
+
+  // CHECK-NOT: "onnx.LayoutTransform"
+  // CHECK: "onnx.ConvNoBias"(%arg0, %arg1)
+}
+
+// -----
+
+// Channels that cannot be split into whole blocks are not converted.
+// CHECK-LABEL: func @test_conv_partial_block_unchanged
+func @test_conv_partial_block_unchanged(%arg0 : tensor<1x3x8x8xf32>, %arg1 : tensor<16x3x1x1xf32>) -> tensor<1x16x8x8xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", dilations = [1, 1], group = 1 : i64, kernel_shape = [1, 1], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x3x8x8xf32>, tensor<16x3x1x1xf32>) -> tensor<1x16x8x8xf32>
+  "std.return"(%0) : (tensor<1x16x8x8xf32>) -> ()
+
+  // CHECK-NOT: "onnx.LayoutTransform"
+  // CHECK: "onnx.ConvNoBias"(%arg0, %arg1)
+}
+
+// -----
+
+// Constant kernels are converted to the OIHWio layout at compile time.
+// CHECK-LABEL: func @test_conv_constant_kernel
+func @test_conv_constant_kernel(%arg0 : tensor<1x16x8x8xf32>) -> tensor<1x16x8x8xf32> {
+  %0 = "onnx.Constant"() {value = dense<1.000000e+00> : tensor<16x16x1x1xf32>} : () -> tensor<16x16x1x1xf32>
+  %1 = "onnx.ConvNoBias"(%arg0, %0) {auto_pad = "NOTSET", dilations = [1, 1], group = 1 : i64, kernel_shape = [1, 1], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x16x8x8xf32>, tensor<16x16x1x1xf32>) -> tensor<1x16x8x8xf32>
+  "std.return"(%1) : (tensor<1x16x8x8xf32>) -> ()
+
+  // CHECK-DAG: [[DATA:%.+]] = "onnx.LayoutTransform"(%arg0) {channel_block = 8 : i64, target_layout = "NCHWc"} : (tensor<1x16x8x8xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK-DAG: [[KERNEL:%.+]] = "onnx.Constant"() {value = dense<{{.*}}> : tensor<2x2x1x1x8x8xf32>} : () -> tensor<2x2x1x1x8x8xf32>
+  // CHECK-NOT: "onnx.LayoutTransform"({{.*}}) {channel_block = 8 : i64, target_layout = "OIHWio"}
+  // CHECK: [[CONV:%.+]] = "onnx.ConvNoBiasNCHWc"([[DATA]], [[KERNEL]]) {dilations = [1, 1], strides = [1, 1]} : (tensor<1x2x8x8x8xf32>, tensor<2x2x1x1x8x8xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK: [[RES:%.+]] = "onnx.LayoutTransform"([[CONV]]) {channel_block = 8 : i64, target_layout = "NCHW"} : (tensor<1x2x8x8x8xf32>) -> tensor<1x16x8x8xf32>
+  // CHECK: return [[RES]] : tensor<1x16x8x8xf32>
+}
+
+// -----
+
+// Padded convolutions keep the NCHW layout.
+// CHECK-LABEL: func @test_conv_padded_unchanged
+func @test_conv_padded_unchanged(%arg0 : tensor<1x16x8x8xf32>, %arg1 : tensor<16x16x1x1xf32>) -> tensor<1x16x10x10xf32> {
+  %0 = "onnx.ConvNoBias"(%arg0, %arg1) {auto_pad = "NOTSET", dilations = [1, 1], group = 1 : i64, kernel_shape = [1, 1], pads = [1, 1, 1, 1], strides = [1, 1]} : (tensor<1x16x8x8xf32>, tensor<16x16x1x1xf32>) -> tensor<1x16x10x10xf32>
+  "std.return"(%0) : (tensor<1x16x10x10xf32>) -> ()
+
+  // CHECK-NOT: "onnx.LayoutTransform"
+  // CHECK: "onnx.ConvNoBias"(%arg0, %arg1)
+}